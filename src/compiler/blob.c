@@ -231,6 +231,23 @@ blob_overwrite_intptr (struct blob *blob,
    return blob_overwrite_bytes(blob, offset, &value, sizeof(value));
 }
 
+bool
+blob_write_varint(struct blob *blob, uint64_t value)
+{
+   uint8_t bytes[10];
+   size_t size = 0;
+
+   do {
+      bytes[size] = value & 0x7f;
+      value >>= 7;
+      if (value)
+         bytes[size] |= 0x80;
+      size++;
+   } while (value);
+
+   return blob_write_bytes(blob, bytes, size);
+}
+
 bool
 blob_write_string(struct blob *blob, const char *str)
 {
@@ -349,6 +366,38 @@ blob_read_intptr(struct blob_reader *blob)
    return ret;
 }
 
+uint64_t
+blob_read_varint(struct blob_reader *blob)
+{
+   uint64_t ret = 0;
+
+   /* Most values fit in a single byte. */
+   if (blob->current < blob->end && !(*blob->current & 0x80) &&
+       !blob->overrun)
+      return *blob->current++;
+
+   for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (! ensure_can_read(blob, 1))
+         return 0;
+
+      uint8_t byte = *blob->current++;
+      ret |= (uint64_t) (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+         return ret;
+   }
+
+   /* More than ten bytes can't come from blob_write_varint. */
+   blob->overrun = true;
+   return 0;
+}
+
+void
+blob_skip_bytes(struct blob_reader *blob, size_t size)
+{
+   if (ensure_can_read(blob, size))
+      blob->current += size;
+}
+
 char *
 blob_read_string(struct blob_reader *blob)
 {
@@ -252,6 +252,19 @@ blob_overwrite_intptr(struct blob *blob,
                       size_t offset,
                       intptr_t value);
 
+/**
+ * Add an unsigned integer to a blob using a variable-length encoding.
+ *
+ * The value is stored seven bits per byte, least-significant group first,
+ * with the top bit of each byte set if more bytes follow.  Small values,
+ * such as counts and indices, therefore take a single byte.  No alignment
+ * is applied.
+ *
+ * \return True unless allocation failed.
+ */
+bool
+blob_write_varint(struct blob *blob, uint64_t value);
+
 /**
  * Add a NULL-terminated string to a blob, (including the NULL terminator).
  *
@@ -330,6 +343,21 @@ blob_read_uint64(struct blob_reader *blob);
 intptr_t
 blob_read_intptr(struct blob_reader *blob);
 
+/**
+ * Read an unsigned integer written by blob_write_varint() from the current
+ * location, (and update the current location to just past it).
+ *
+ * \return The value read
+ */
+uint64_t
+blob_read_varint(struct blob_reader *blob);
+
+/**
+ * Advance the current location by \size bytes without reading them.
+ */
+void
+blob_skip_bytes(struct blob_reader *blob, size_t size);
+
 /**
  * Read a NULL-terminated string from the current location, (and update the
  * current location to just past this string).
@@ -1979,6 +1979,7 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
 
    struct gl_shader_compiler_options *options =
       &ctx->Const.ShaderCompilerOptions[shader->Stage];
+   void *ir_ctx = NULL;
 
    /* Do some optimization at compile time to reduce shader IR size
     * and reduce later work if the same shader is linked multiple times
@@ -1988,10 +1989,25 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
       do_common_optimization(shader->ir, false, false, options,
                              ctx->Const.NativeIntegers);
    } else {
-      /* Repeat it until it stops making changes. */
+      /* Repeat it until it stops making changes.
+       *
+       * The passes allocate new IR out of the context of the IR they
+       * replace and leave the old IR behind, so move the live IR to a fresh
+       * context after each round and free the previous one.  Otherwise the
+       * garbage of every round stays around until the end of the compile.
+       * The HIR comes out of the parse state, which outlives this function,
+       * so take it off there first.
+       */
+      ir_ctx = ralloc_context(shader);
+      reparent_ir(shader->ir, ir_ctx);
+
       while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+                                    ctx->Const.NativeIntegers)) {
+         void *new_ctx = ralloc_context(shader);
+         reparent_ir(shader->ir, new_ctx);
+         ralloc_free(ir_ctx);
+         ir_ctx = new_ctx;
+      }
    }
 
    validate_ir_tree(shader->ir);
@@ -2018,6 +2034,7 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
 
    /* Retain any live IR, but trash the rest. */
    reparent_ir(shader->ir, shader->ir);
+   ralloc_free(ir_ctx);
 
    /* Destroy the symbol table.  Create a new symbol table that contains only
     * the variables and functions that still exist in the IR.  The symbol
@@ -2033,9 +2050,17 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
                                       shader->symbols);
 }
 
+/**
+ * Compile \p shader.
+ *
+ * \param flags  the GLSL_* debug flags of the current pipeline.  Compiles
+ *               may run on a worker thread, which must not look at
+ *               ctx->_Shader, so the caller samples them.
+ */
 void
 _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
-                          bool dump_ast, bool dump_hir, bool force_recompile)
+                          bool dump_ast, bool dump_hir, bool force_recompile,
+                          unsigned flags)
 {
    const char *source = force_recompile && shader->FallbackSource ?
       shader->FallbackSource : shader->Source;
@@ -2047,7 +2072,7 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
                                 shader->sha1);
          if (disk_cache_has_key(ctx->Cache, shader->sha1)) {
             /* We've seen this shader before and know it compiles */
-            if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+            if (flags & GLSL_CACHE_INFO) {
                _mesa_sha1_format(buf, shader->sha1);
                fprintf(stderr, "deferring compile of shader: %s\n", buf);
             }
@@ -2092,6 +2117,11 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
      do_late_parsing_checks(state);
    }
 
+   /* The preprocessed source was allocated by glcpp out of the parse state
+    * and the lexer copied out everything it needed.
+    */
+   ralloc_free((char *) source);
+
    if (dump_ast) {
       foreach_list_typed(ast_node, ast, link, &state->translation_unit) {
          ast->print();
@@ -2119,6 +2149,14 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
    if (!state->error)
       set_shader_inout_layout(shader, state);
 
+   /* Evaluating the layout qualifiers was the last use of the AST.  Free it,
+    * along with the identifiers the lexer allocated, before the IR gets
+    * optimized instead of when the parse state goes away.
+    */
+   linear_free_parent(state->linalloc);
+   state->linalloc = NULL;
+   state->translation_unit.make_empty();
+
    shader->symbols = new(shader->ir) glsl_symbol_table;
    shader->CompileStatus = state->error ? COMPILE_FAILURE : COMPILE_SUCCESS;
    shader->InfoLog = state->info_log;
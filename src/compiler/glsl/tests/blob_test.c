@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "util/macros.h"
 #include "util/ralloc.h"
 #include "blob.h"
 
@@ -245,6 +246,50 @@ test_alignment(void)
    blob_finish(&blob);
 }
 
+/* Test that variable-length integers round-trip, are as small as expected
+ * and don't introduce any alignment.
+ */
+static void
+test_varint(void)
+{
+   struct blob blob;
+   struct blob_reader reader;
+   static const uint64_t values[] = {
+      0, 1, 127, 128, 300, 16383, 16384, UINT32_MAX, uint64_test, UINT64_MAX,
+   };
+   static const size_t sizes[] = {
+      1, 1, 1, 2, 2, 2, 3, 5, 9, 10,
+   };
+   unsigned i;
+
+   blob_init(&blob);
+
+   for (i = 0; i < ARRAY_SIZE(values); i++) {
+      size_t last = blob.size;
+      blob_write_varint(&blob, values[i]);
+      expect_equal(sizes[i], blob.size - last, "blob_write_varint size");
+   }
+
+   blob_reader_init(&reader, blob.data, blob.size);
+
+   for (i = 0; i < ARRAY_SIZE(values); i++)
+      expect_equal(values[i], blob_read_varint(&reader),
+                   "blob_write/read_varint");
+
+   expect_equal(reader.end - reader.data, reader.current - reader.data,
+                "varint read consumes all bytes");
+   expect_equal(false, reader.overrun, "varint read does not overrun");
+
+   /* A truncated varint is an overrun. */
+   blob_reader_init(&reader, blob.data, blob.size - 1);
+   blob_skip_bytes(&reader, blob.size - sizes[ARRAY_SIZE(sizes) - 1]);
+   expect_equal(false, reader.overrun, "blob_skip_bytes does not overrun");
+   expect_equal(0, blob_read_varint(&reader), "read of truncated varint");
+   expect_equal(true, reader.overrun, "truncated varint sets overrun");
+
+   blob_finish(&blob);
+}
+
 /* Test that we detect overrun. */
 static void
 test_overrun(void)
@@ -317,6 +362,7 @@ main (void)
 {
    test_write_and_read_functions ();
    test_alignment ();
+   test_varint ();
    test_overrun ();
    test_big_objects ();
 
@@ -35,6 +35,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "util/macros.h"
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
 
@@ -442,6 +443,67 @@ test_put_and_get(void)
    disk_cache_destroy(cache);
 }
 
+static void
+test_compression_level(void)
+{
+#ifdef HAVE_ZSTD
+   static const int default_level = 3, max_level = 19;
+#else
+   static const int default_level = 9, max_level = 9;
+#endif
+   static const struct {
+      const char *env;
+      int level;
+   } levels[] = {
+      { "1", 1 },
+      { "99", max_level },
+      { "-5", 1 },
+      { "not-a-number", default_level },
+   };
+   struct disk_cache *cache;
+   uint8_t key[20];
+   uint8_t *data, *result;
+   size_t size;
+   unsigned i, j;
+
+   data = malloc(64 * 1024);
+
+   /* Out of range and bogus levels are clamped or ignored, every level has
+    * to round-trip the same data.
+    */
+   for (i = 0; i < ARRAY_SIZE(levels); i++) {
+      setenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL", levels[i].env, 1);
+      cache = disk_cache_create("test", "make_check", 0);
+
+      expect_equal(disk_cache_get_compression_level(cache), levels[i].level,
+                   "clamped compression level");
+
+      for (j = 0; j < 64 * 1024; j++)
+         data[j] = (j / 256) * (i + 1);
+
+      disk_cache_compute_key(cache, data, 64 * 1024, key);
+      disk_cache_put(cache, key, data, 64 * 1024, NULL);
+
+      /* disk_cache_put() hands things off to a thread give it some time to
+       * finish.
+       */
+      wait_until_file_written(cache, key);
+
+      result = disk_cache_get(cache, key, &size);
+      expect_non_null(result, "disk_cache_get with compression level");
+      expect_equal(size, 64 * 1024,
+                   "disk_cache_get with compression level (size)");
+      expect_true(result && memcmp(result, data, 64 * 1024) == 0,
+                  "disk_cache_get with compression level (data)");
+
+      free(result);
+      disk_cache_destroy(cache);
+   }
+
+   unsetenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL");
+   free(data);
+}
+
 static void
 test_put_key_and_get_key(void)
 {
@@ -505,6 +567,8 @@ main(void)
 
    test_put_and_get();
 
+   test_compression_level();
+
    test_put_key_and_get_key();
 
    err = rmrf_local(CACHE_TEST_TMP);
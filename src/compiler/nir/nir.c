@@ -292,6 +292,7 @@ nir_function_impl_create_bare(nir_shader *shader)
    impl->reg_alloc = 0;
    impl->ssa_alloc = 0;
    impl->valid_metadata = nir_metadata_none;
+   impl->cfg_metadata = nir_metadata_none;
 
    /* create start & end blocks */
    nir_block *start_block = nir_block_create(shader);
@@ -1714,6 +1714,15 @@ typedef struct {
    unsigned num_blocks;
 
    nir_metadata valid_metadata;
+
+   /**
+    * The subset of block_index and dominance metadata which was computed
+    * since the CFG was last modified.  Unlike valid_metadata, this is not
+    * cleared by nir_metadata_preserve(), only by the CFG manipulation
+    * functions in nir_control_flow.c, so nir_metadata_require() can
+    * revalidate these for free after a pass which only touched instructions.
+    */
+   nir_metadata cfg_metadata;
 } nir_function_impl;
 
 ATTRIBUTE_RETURNS_NONNULL static inline nir_block *
@@ -2031,6 +2040,8 @@ nir_function_impl *nir_cf_node_get_function(nir_cf_node *node);
 void nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...);
 /** dirties all but the preserved metadata */
 void nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved);
+/** dirties the metadata derived from the CFG, called when the CFG changes */
+void nir_metadata_cfg_changed(nir_function_impl *impl);
 
 /** creates an instruction with default swizzle/writemask/etc. with NULL registers */
 nir_alu_instr *nir_alu_instr_create(nir_shader *shader, nir_op op);
@@ -2783,6 +2794,8 @@ bool nir_opt_dead_cf(nir_shader *shader);
 
 bool nir_opt_gcm(nir_shader *shader, bool value_number);
 
+bool nir_opt_licm(nir_shader *shader, bool value_number);
+
 bool nir_opt_if(nir_shader *shader);
 
 bool nir_opt_intrinsics(nir_shader *shader);
@@ -2803,6 +2816,8 @@ bool nir_opt_trivial_continues(nir_shader *shader);
 
 bool nir_opt_undef(nir_shader *shader);
 
+bool nir_opt_vectorize(nir_shader *shader);
+
 bool nir_opt_conditional_discard(nir_shader *shader);
 
 void nir_sweep(nir_shader *shader);
@@ -495,6 +495,152 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """A bottom-up tree automaton for the search expressions of a pass.
+
+   Rather than trying every transform whose root opcode matches an
+   instruction and recursing into its sources one transform at a time, we
+   precompute a finite automaton whose states describe which sub-patterns of
+   the search expressions an SSA value can possibly match.  The state of an
+   ALU instruction is then a single table lookup on its opcode and the
+   states of its sources, and the state tells us which transforms are worth
+   handing to nir_replace_instr().
+
+   Each distinct search sub-expression is an "item", identified by its
+   opcode and the items of its sources.  Variables and constants become the
+   wildcard item, which everything matches.  A state is the set of items a
+   value matches, ignoring everything but the opcodes and the shape of the
+   tree: bit sizes, constant values, conditions and variable equality are
+   still checked by nir_search, so the automaton only ever rules out
+   transforms that could not match.
+
+   To keep the tables small, the state of each source is first mapped to a
+   "filtered" state for the opcode, which only keeps the items that appear
+   as a source of some item with that opcode.  The transition table of an
+   opcode is indexed by the filtered states of its sources.
+   """
+
+   def __init__(self, transforms):
+      self.wildcard = 0
+      self.items = [None]
+      self._item_dict = {}
+      self.opcodes = []
+      self._op_items = {}
+      self._op_children = {}
+
+      self.transforms = list(transforms)
+      self.transform_items = [self._add_item(xform.search)
+                              for xform in self.transforms]
+
+      self._build_table()
+
+   def _add_item(self, val):
+      if not isinstance(val, Expression):
+         return self.wildcard
+
+      srcs = tuple(self._add_item(src) for src in val.sources)
+      key = (val.opcode, srcs)
+      if key not in self._item_dict:
+         if val.opcode not in self._op_items:
+            self.opcodes.append(val.opcode)
+            self._op_items[val.opcode] = []
+            self._op_children[val.opcode] = set()
+
+         self._item_dict[key] = len(self.items)
+         self._op_items[val.opcode].append(len(self.items))
+         self._op_children[val.opcode].update(srcs)
+         self.items.append(key)
+
+      return self._item_dict[key]
+
+   def _transition(self, opcode, filtered_states):
+      """Computes the set of items an instruction with the given opcode
+      matches if its sources are in the given filtered states."""
+      commutative = 'commutative' in opcodes[opcode].algebraic_properties
+      state = set([self.wildcard])
+
+      for item in self._op_items[opcode]:
+         srcs = self.items[item][1]
+         if all(srcs[i] in filtered_states[i] for i in range(len(srcs))):
+            state.add(item)
+         elif commutative and len(srcs) == 2 and \
+              srcs[0] in filtered_states[1] and srcs[1] in filtered_states[0]:
+            state.add(item)
+
+      return frozenset(state)
+
+   def _build_table(self):
+      self.states = []
+      self._state_dict = {}
+
+      # For each opcode: the list of filtered states, the filter mapping each
+      # state to its filtered state and the transition table, indexed by
+      # tuples of filtered states.
+      self.filtered_states = dict((op, []) for op in self.opcodes)
+      self._filtered_dict = dict((op, {}) for op in self.opcodes)
+      self.filter = dict((op, []) for op in self.opcodes)
+      self.table = dict((op, {}) for op in self.opcodes)
+
+      def get_state(state):
+         if state not in self._state_dict:
+            self._state_dict[state] = len(self.states)
+            self.states.append(state)
+         return self._state_dict[state]
+
+      # State 0 is the state of anything that isn't one of our ALU
+      # instructions.
+      get_state(frozenset([self.wildcard]))
+
+      # States are processed in the order they were created, so filter[op]
+      # is indexed by state.
+      i = 0
+      while i < len(self.states):
+         state = self.states[i]
+         i += 1
+
+         for op in self.opcodes:
+            filtered = frozenset(state & self._op_children[op])
+            if filtered not in self._filtered_dict[op]:
+               index = len(self.filtered_states[op])
+               self._filtered_dict[op][filtered] = index
+               self.filtered_states[op].append(filtered)
+
+               # Fill in the transitions that involve the new filtered state.
+               num_srcs = opcodes[op].num_inputs
+               num_filtered = len(self.filtered_states[op])
+               for srcs in itertools.product(range(num_filtered),
+                                             repeat=num_srcs):
+                  if index not in srcs:
+                     continue
+
+                  self.table[op][srcs] = get_state(self._transition(
+                     op, [self.filtered_states[op][f] for f in srcs]))
+
+            self.filter[op].append(self._filtered_dict[op][filtered])
+
+      assert len(self.states) < 2**16, "too many automaton states"
+
+   def flat_table(self, op):
+      """Returns the transition table of an opcode as a flat list, where the
+      filtered state of source i is the i-th digit of the index in base
+      num_filtered."""
+      num_srcs = opcodes[op].num_inputs
+      num_filtered = len(self.filtered_states[op])
+      table = []
+      for index in range(num_filtered ** num_srcs):
+         srcs = tuple((index // num_filtered ** i) % num_filtered
+                      for i in range(num_srcs))
+         table.append(self.table[op][srcs])
+      return table
+
+   def state_transforms(self):
+      """Returns, for each state, the transforms whose search expression it
+      can match, in the order they were given to the pass."""
+      return [[xform for xform, item in zip(self.transforms,
+                                            self.transform_items)
+               if item in state]
+              for state in self.states]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -509,27 +655,102 @@ struct transform {
    unsigned condition_offset;
 };
 
+struct transform_list {
+   const struct transform *xforms;
+   unsigned num_xforms;
+};
+
+/* Automaton transitions for one opcode.  filter maps the state of a source
+ * to one of num_filtered_states filtered states, and table is indexed by
+ * the filtered states of the sources, with source 0 as the least
+ * significant digit.
+ */
+struct per_op_table {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+};
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in automaton.transforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
+<% state_xforms = automaton.state_transforms() %>
+% for state_id, xform_list in enumerate(state_xforms):
+% if xform_list:
+static const struct transform ${pass_name}_state${state_id}_xforms[] = {
 % for xform in xform_list:
    { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
 % endfor
 };
+% endif
 % endfor
 
+static const struct transform_list ${pass_name}_state_xforms[] = {
+% for state_id, xform_list in enumerate(state_xforms):
+% if xform_list:
+   { ${pass_name}_state${state_id}_xforms, ${len(xform_list)} },
+% else:
+   { NULL, 0 },
+% endif
+% endfor
+};
+
+<%def name="c_array(values)">
+% for i in range(0, len(values), 16):
+   ${', '.join(str(v) for v in values[i:i + 16])},
+% endfor
+</%def>
+
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {${c_array(automaton.filter[op])}};
+
+static const uint16_t ${pass_name}_${op}_table[] = {${c_array(automaton.flat_table(op))}};
+
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.filtered_states[op])},
+      ${pass_name}_${op}_table,
+   },
+% endfor
+};
+
+static uint16_t
+${pass_name}_automaton(const nir_alu_instr *alu, const uint16_t *states)
+{
+   const struct per_op_table *tbl = &${pass_name}_table[alu->op];
+   unsigned index = 0;
+
+   if (!tbl->filter)
+      return 0;
+
+   for (unsigned i = nir_op_infos[alu->op].num_inputs; i-- > 0;) {
+      uint16_t src_state = 0;
+      if (alu->src[i].src.is_ssa)
+         src_state = states[alu->src[i].src.ssa->index];
+
+      index = index * tbl->num_filtered_states + tbl->filter[src_state];
+   }
+
+   return tbl->table[index];
+}
+
 static bool
 ${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+                   const uint16_t *states, void *mem_ctx)
 {
    bool progress = false;
 
+   /* Instructions inserted by nir_replace_instr() end up behind the
+    * iterator, so every instruction we visit here had its state computed
+    * before we started replacing things.
+    */
    nir_foreach_instr_reverse_safe(instr, block) {
       if (instr->type != nir_instr_type_alu)
          continue;
@@ -538,22 +759,17 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
+      const struct transform_list *list =
+         &${pass_name}_state_xforms[states[alu->dest.dest.ssa.index]];
+
+      for (unsigned i = 0; i < list->num_xforms; i++) {
+         const struct transform *xform = &list->xforms[i];
+         if (condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               mem_ctx)) {
+            progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
@@ -566,10 +782,29 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   /* The automaton states are indexed by SSA index, so make sure every
+    * value has one.  Anything that isn't an ALU instruction is in state 0.
+    */
+   nir_index_ssa_defs(impl);
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(uint16_t));
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         if (alu->dest.dest.is_ssa)
+            states[alu->dest.dest.ssa.index] = ${pass_name}_automaton(alu, states);
+      }
+   }
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, condition_flags, states, mem_ctx);
    }
 
+   free(states);
+
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
                                   nir_metadata_dominance);
@@ -603,6 +838,7 @@ class AlgebraicPass(object):
    def __init__(self, pass_name, transforms):
       self.xform_dict = {}
       self.pass_name = pass_name
+      self.xforms = []
 
       error = False
 
@@ -622,11 +858,14 @@ class AlgebraicPass(object):
             self.xform_dict[xform.search.opcode] = []
 
          self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.automaton = TreeAutomaton(self.xforms)
+
    def render(self):
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
+                                             automaton=self.automaton,
                                              condition_list=condition_list)
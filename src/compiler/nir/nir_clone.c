@@ -687,6 +687,7 @@ clone_function_impl(clone_state *state, const nir_function_impl *fi)
 
    /* All metadata is invalidated in the cloning process */
    nfi->valid_metadata = 0;
+   nfi->cfg_metadata = 0;
 
    return nfi;
 }
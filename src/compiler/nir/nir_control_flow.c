@@ -42,6 +42,10 @@
  *
  * The purpose of the second one is so that we have places to insert code during
  * GCM, as well as eliminating the possibility of critical edges.
+ *
+ * Every entrypoint which changes the CFG calls nir_metadata_cfg_changed().
+ * Block indices and dominance are otherwise kept valid across passes which
+ * only add or remove (non-jump) instructions.
  */
 /*@{*/
 
@@ -458,6 +462,7 @@ nir_handle_add_jump(nir_block *block)
 
    nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
    nir_metadata_preserve(impl, nir_metadata_none);
+   nir_metadata_cfg_changed(impl);
 
    if (jump_instr->type == nir_jump_break ||
        jump_instr->type == nir_jump_continue) {
@@ -518,6 +523,7 @@ nir_handle_remove_jump(nir_block *block, nir_jump_type type)
 
    nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
    nir_metadata_preserve(impl, nir_metadata_none);
+   nir_metadata_cfg_changed(impl);
 }
 
 static void
@@ -580,6 +586,8 @@ nir_cf_node_insert(nir_cursor cursor, nir_cf_node *node)
 
    split_block_cursor(cursor, &before, &after);
 
+   nir_metadata_cfg_changed(nir_cf_node_get_function(&before->cf_node));
+
    if (node->type == nir_cf_node_block) {
       nir_block *block = nir_cf_node_as_block(node);
       exec_node_insert_after(&before->cf_node.node, &block->cf_node.node);
@@ -686,6 +694,7 @@ nir_cf_extract(nir_cf_list *extracted, nir_cursor begin, nir_cursor end)
 
    /* Dominance and other block-related information is toast. */
    nir_metadata_preserve(extracted->impl, nir_metadata_none);
+   nir_metadata_cfg_changed(extracted->impl);
 
    nir_cf_node *cf_node = &block_begin->cf_node;
    nir_cf_node *cf_node_end = &block_end->cf_node;
@@ -715,6 +724,8 @@ nir_cf_reinsert(nir_cf_list *cf_list, nir_cursor cursor)
 
    split_block_cursor(cursor, &before, &after);
 
+   nir_metadata_cfg_changed(nir_cf_node_get_function(&before->cf_node));
+
    foreach_list_typed_safe(nir_cf_node, node, node, &cf_list->list) {
       exec_node_remove(&node->node);
       node->parent = before->cf_node.parent;
@@ -730,6 +741,10 @@ nir_cf_reinsert(nir_cf_list *cf_list, nir_cursor cursor)
 void
 nir_cf_delete(nir_cf_list *cf_list)
 {
+   /* Unlinking jumps may remove predecessors from blocks still in the CFG. */
+   if (cf_list->impl)
+      nir_metadata_cfg_changed(cf_list->impl);
+
    foreach_list_typed(nir_cf_node, node, node, &cf_list->list) {
       cleanup_cf_node(node, cf_list->impl);
    }
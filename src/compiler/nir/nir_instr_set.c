@@ -530,6 +530,16 @@ nir_instr_set_add_or_rewrite(struct set *instr_set, nir_instr *instr)
    return false;
 }
 
+nir_instr *
+nir_instr_set_search(struct set *instr_set, nir_instr *instr)
+{
+   if (!instr_can_rewrite(instr))
+      return NULL;
+
+   struct set_entry *entry = _mesa_set_search(instr_set, instr);
+   return entry ? (nir_instr *) entry->key : NULL;
+}
+
 void
 nir_instr_set_remove(struct set *instr_set, nir_instr *instr)
 {
@@ -53,6 +53,12 @@ void nir_instr_set_destroy(struct set *instr_set);
  */
 bool nir_instr_set_add_or_rewrite(struct set *instr_set, nir_instr *instr);
 
+/**
+ * Returns the instruction in the set that \p instr is a duplicate of, or NULL
+ * if there is none.  Neither the set nor the IR are modified.
+ */
+nir_instr *nir_instr_set_search(struct set *instr_set, nir_instr *instr);
+
 /**
  * Removes an instruction from an instruction set, so that other instructions
  * won't be merged with it.
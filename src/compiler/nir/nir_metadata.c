@@ -30,11 +30,20 @@
  * Handles management of the metadata.
  */
 
+/* Metadata which only depends on the shape of the CFG.  This stays correct
+ * across any number of instruction insertions and removals, so it is tracked
+ * separately in impl->cfg_metadata and only thrown away once
+ * nir_control_flow.c actually changes the CFG.
+ */
+#define CFG_METADATA (nir_metadata_block_index | nir_metadata_dominance)
+
 void
 nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
 {
 #define NEEDS_UPDATE(X) ((required & ~impl->valid_metadata) & (X))
 
+   impl->valid_metadata |= required & impl->cfg_metadata;
+
    if (NEEDS_UPDATE(nir_metadata_block_index))
       nir_index_blocks(impl);
    if (NEEDS_UPDATE(nir_metadata_dominance))
@@ -51,6 +60,7 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
 #undef NEEDS_UPDATE
 
    impl->valid_metadata |= required;
+   impl->cfg_metadata |= required & CFG_METADATA;
 }
 
 void
@@ -59,6 +69,13 @@ nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved)
    impl->valid_metadata &= preserved;
 }
 
+void
+nir_metadata_cfg_changed(nir_function_impl *impl)
+{
+   impl->cfg_metadata = nir_metadata_none;
+   impl->valid_metadata &= ~CFG_METADATA;
+}
+
 #ifndef NDEBUG
 /**
  * Make sure passes properly invalidate metadata (part 1).
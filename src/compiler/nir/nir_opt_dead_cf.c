@@ -163,11 +163,34 @@ cf_node_has_side_effects(nir_cf_node *node)
 }
 
 static bool
-def_not_live_out(nir_ssa_def *def, void *state)
+def_only_used_in_cf_node(nir_ssa_def *def, void *_node)
 {
-   nir_block *after = state;
+   nir_cf_node *node = _node;
+   nir_block *before = nir_cf_node_as_block(nir_cf_node_prev(node));
+   nir_block *after = nir_cf_node_as_block(nir_cf_node_next(node));
+
+   /* Because NIR is structured, the blocks inside the node are exactly the
+    * ones whose index lies strictly between the blocks before and after it,
+    * so we can tell whether a value escapes just by looking at where it is
+    * used.  A use by a phi counts as escaping if the phi is outside the node,
+    * regardless of which predecessor the value comes from.
+    */
+   nir_foreach_use(use, def) {
+      if (use->parent_instr->block->index <= before->index ||
+          use->parent_instr->block->index >= after->index)
+         return false;
+   }
 
-   return !BITSET_TEST(after->live_in, def->live_index);
+   nir_foreach_if_use(use, def) {
+      nir_block *use_block =
+         nir_cf_node_as_block(nir_cf_node_prev(&use->parent_if->cf_node));
+
+      if (use_block->index <= before->index ||
+          use_block->index >= after->index)
+         return false;
+   }
+
+   return true;
 }
 
 /*
@@ -180,17 +203,15 @@ def_not_live_out(nir_ssa_def *def, void *state)
  * 2) It has no phi nodes after it, since those indicate values inside the
  * loop being used after the loop.
  *
- * 3) If there are no phi nodes after the loop, then the only way a value
- * defined inside the loop can be used outside the loop is if its definition
- * dominates the block after the loop. If none of the definitions that
- * dominate the loop exit are used outside the loop, then the loop is dead
- * and it can be deleted.
+ * 3) None of the SSA values defined inside the loop are used outside of it.
+ * This only needs block indices, which unlike liveness survive the
+ * instruction-level changes made by the rest of the optimization loop, so
+ * checking a loop doesn't force a full liveness recomputation.
  */
 
 static bool
 loop_is_dead(nir_loop *loop)
 {
-   nir_block *before = nir_cf_node_as_block(nir_cf_node_prev(&loop->cf_node));
    nir_block *after = nir_cf_node_as_block(nir_cf_node_next(&loop->cf_node));
 
    if (!exec_list_is_empty(&after->instr_list) &&
@@ -201,13 +222,12 @@ loop_is_dead(nir_loop *loop)
       return false;
 
    nir_function_impl *impl = nir_cf_node_get_function(&loop->cf_node);
-   nir_metadata_require(impl, nir_metadata_live_ssa_defs |
-                              nir_metadata_dominance);
+   nir_metadata_require(impl, nir_metadata_block_index);
 
-   for (nir_block *cur = after->imm_dom; cur && cur != before;
-        cur = cur->imm_dom) {
-      nir_foreach_instr(instr, cur) {
-         if (!nir_foreach_ssa_def(instr, def_not_live_out, after))
+   nir_foreach_block_in_cf_node(block, &loop->cf_node) {
+      nir_foreach_instr(instr, block) {
+         if (!nir_foreach_ssa_def(instr, def_only_used_in_cf_node,
+                                  &loop->cf_node))
             return false;
       }
    }
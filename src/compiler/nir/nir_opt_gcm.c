@@ -68,6 +68,10 @@ struct gcm_state {
    struct exec_list instrs;
 
    struct gcm_block_info *blocks;
+
+   /* Scratch space for gcm_is_anticipated(), sized by the number of blocks */
+   BITSET_WORD *visited;
+   nir_block **stack;
 };
 
 /* Recursively walks the CFG and builds the block_info structure */
@@ -99,76 +103,86 @@ gcm_build_block_info(struct exec_list *cf_list, struct gcm_state *state,
    }
 }
 
-/* Walks the instruction list and marks immovable instructions as pinned
+/* Marks the instruction as pinned if it is immovable
  *
  * This function also serves to initialize the instr->pass_flags field.
- * After this is completed, all instructions' pass_flags fields will be set
- * to either GCM_INSTR_PINNED or 0.
+ * Afterwards, it will be set to either GCM_INSTR_PINNED or 0.
  */
-static bool
-gcm_pin_instructions_block(nir_block *block, struct gcm_state *state)
+static void
+gcm_pin_instr(nir_instr *instr)
 {
-   nir_foreach_instr_safe(instr, block) {
-      switch (instr->type) {
-      case nir_instr_type_alu:
-         switch (nir_instr_as_alu(instr)->op) {
-         case nir_op_fddx:
-         case nir_op_fddy:
-         case nir_op_fddx_fine:
-         case nir_op_fddy_fine:
-         case nir_op_fddx_coarse:
-         case nir_op_fddy_coarse:
-            /* These can only go in uniform control flow; pin them for now */
-            instr->pass_flags = GCM_INSTR_PINNED;
-            break;
-
-         default:
-            instr->pass_flags = 0;
-            break;
-         }
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      switch (nir_instr_as_alu(instr)->op) {
+      case nir_op_fddx:
+      case nir_op_fddy:
+      case nir_op_fddx_fine:
+      case nir_op_fddy_fine:
+      case nir_op_fddx_coarse:
+      case nir_op_fddy_coarse:
+         /* These can only go in uniform control flow; pin them for now */
+         instr->pass_flags = GCM_INSTR_PINNED;
          break;
 
-      case nir_instr_type_tex:
-         switch (nir_instr_as_tex(instr)->op) {
-         case nir_texop_tex:
-         case nir_texop_txb:
-         case nir_texop_lod:
-            /* These two take implicit derivatives so they need to be pinned */
-            instr->pass_flags = GCM_INSTR_PINNED;
-            break;
-
-         default:
-            instr->pass_flags = 0;
-            break;
-         }
+      default:
+         instr->pass_flags = 0;
+         break;
+      }
+      break;
+
+   case nir_instr_type_tex:
+      switch (nir_instr_as_tex(instr)->op) {
+      case nir_texop_tex:
+      case nir_texop_txb:
+      case nir_texop_lod:
+         /* These two take implicit derivatives so they need to be pinned */
+         instr->pass_flags = GCM_INSTR_PINNED;
          break;
 
-      case nir_instr_type_load_const:
+      default:
          instr->pass_flags = 0;
          break;
+      }
+      break;
 
-      case nir_instr_type_intrinsic: {
-         const nir_intrinsic_info *info =
-            &nir_intrinsic_infos[nir_instr_as_intrinsic(instr)->intrinsic];
+   case nir_instr_type_load_const:
+      instr->pass_flags = 0;
+      break;
 
-         if ((info->flags & NIR_INTRINSIC_CAN_ELIMINATE) &&
-             (info->flags & NIR_INTRINSIC_CAN_REORDER)) {
-            instr->pass_flags = 0;
-         } else {
-            instr->pass_flags = GCM_INSTR_PINNED;
-         }
-         break;
-      }
+   case nir_instr_type_intrinsic: {
+      const nir_intrinsic_info *info =
+         &nir_intrinsic_infos[nir_instr_as_intrinsic(instr)->intrinsic];
 
-      case nir_instr_type_jump:
-      case nir_instr_type_ssa_undef:
-      case nir_instr_type_phi:
+      if ((info->flags & NIR_INTRINSIC_CAN_ELIMINATE) &&
+          (info->flags & NIR_INTRINSIC_CAN_REORDER)) {
+         instr->pass_flags = 0;
+      } else {
          instr->pass_flags = GCM_INSTR_PINNED;
-         break;
-
-      default:
-         unreachable("Invalid instruction type in GCM");
       }
+      break;
+   }
+
+   case nir_instr_type_jump:
+   case nir_instr_type_ssa_undef:
+   case nir_instr_type_phi:
+      instr->pass_flags = GCM_INSTR_PINNED;
+      break;
+
+   default:
+      unreachable("Invalid instruction type in GCM");
+   }
+}
+
+/* Walks the instruction list and marks immovable instructions as pinned
+ *
+ * After this is completed, all instructions' pass_flags fields will be set
+ * to either GCM_INSTR_PINNED or 0.
+ */
+static bool
+gcm_pin_instructions_block(nir_block *block, struct gcm_state *state)
+{
+   nir_foreach_instr_safe(instr, block) {
+      gcm_pin_instr(instr);
 
       if (!(instr->pass_flags & GCM_INSTR_PINNED)) {
          /* If this is an unpinned instruction, go ahead and pull it out of
@@ -516,3 +530,302 @@ nir_opt_gcm(nir_shader *shader, bool value_number)
 
    return progress;
 }
+
+/*
+ * Conservative code motion
+ *
+ * Moving every instruction around the way GCM does tends to stretch live
+ * ranges, so nir_opt_licm() only ever hoists instructions, and only when that
+ * saves work: loop-invariant instructions are moved out of the loops they are
+ * in and, with value numbering, copies of the same expression which don't
+ * dominate one another are merged at their common dominator, as long as the
+ * expression is computed on every path leaving it anyway.  Instructions are
+ * visited in program order, which means that all of the sources of an
+ * instruction have already found their final place when we get to it.
+ */
+
+static bool
+gcm_block_is_reachable(nir_block *block)
+{
+   nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
+   return block->imm_dom != NULL || block == nir_start_block(impl);
+}
+
+static bool
+gcm_dest_is_ssa(nir_dest *dest, void *state)
+{
+   return dest->is_ssa;
+}
+
+/** Moves the earliest block an instruction can go in down to its source's */
+static bool
+gcm_hoist_src_block(nir_src *src, void *void_early)
+{
+   nir_block **early = void_early;
+
+   if (!src->is_ssa)
+      return false;
+
+   /* See gcm_schedule_early_src() */
+   nir_block *src_block = src->ssa->parent_instr->block;
+   if ((*early)->index < src_block->index)
+      *early = src_block;
+
+   return true;
+}
+
+static void
+gcm_move_instr(nir_instr *instr, nir_block *block)
+{
+   exec_node_remove(&instr->node);
+   instr->block = block;
+
+   nir_instr *jump_instr = nir_block_last_instr(block);
+   if (jump_instr && jump_instr->type == nir_instr_type_jump)
+      exec_node_insert_node_before(&jump_instr->node, &instr->node);
+   else
+      exec_list_push_tail(&block->instr_list, &instr->node);
+}
+
+static nir_loop *
+gcm_innermost_loop(nir_block *block)
+{
+   for (nir_cf_node *node = block->cf_node.parent; node != NULL;
+        node = node->parent) {
+      if (node->type == nir_cf_node_loop)
+         return nir_cf_node_as_loop(node);
+   }
+
+   return NULL;
+}
+
+static bool
+gcm_loop_contains(nir_loop *loop, nir_block *block)
+{
+   for (nir_cf_node *node = block->cf_node.parent; node != NULL;
+        node = node->parent) {
+      if (node == &loop->cf_node)
+         return true;
+   }
+
+   return false;
+}
+
+/** Returns true if \p instr may be executed on paths that didn't execute it
+ *
+ * ALU instructions can't fault, so running them needlessly only costs a bit
+ * of time.  Texture lookups and loads may access memory the shader wasn't
+ * going to touch, e.g. when they're guarded by a bounds check.
+ */
+static bool
+gcm_instr_can_speculate(nir_instr *instr)
+{
+   return instr->type == nir_instr_type_alu ||
+          instr->type == nir_instr_type_load_const;
+}
+
+/** Returns true if \p block is executed whenever \p loop is entered
+ *
+ * Loop bodies run at least once, so this holds if \p block lies on every
+ * path from the top of the loop out of it.  A return inside the loop would
+ * leave it without going through the block after it, so don't bother with
+ * such loops.
+ */
+static bool
+gcm_block_runs_with_loop(nir_block *block, nir_loop *loop,
+                         struct gcm_state *state)
+{
+   nir_block *after =
+      nir_cf_node_as_block(nir_cf_node_next(&loop->cf_node));
+
+   /* Loops without a break never leave, except through returns */
+   if (!gcm_block_is_reachable(after) || !nir_block_dominates(block, after))
+      return false;
+
+   struct set_entry *entry;
+   set_foreach(state->impl->end_block->predecessors, entry) {
+      if (gcm_loop_contains(loop, (nir_block *) entry->key))
+         return false;
+   }
+
+   return true;
+}
+
+/** Hoists an instruction out of as many loops as its sources allow
+ *
+ * This moves it right in front of the outermost loop it can leave.  Unless
+ * the instruction can be speculated, it only leaves loops whose every
+ * entry is certain to execute it anyway.
+ */
+static bool
+gcm_hoist_instr(nir_instr *instr, struct gcm_state *state)
+{
+   nir_block *early = nir_start_block(state->impl);
+   if (!nir_foreach_src(instr, gcm_hoist_src_block, &early))
+      return false;
+
+   bool can_speculate = gcm_instr_can_speculate(instr);
+   nir_block *best = instr->block;
+
+   for (nir_loop *loop = gcm_innermost_loop(instr->block); loop != NULL;
+        loop = gcm_innermost_loop(best)) {
+      /* The block in front of the loop dominates everything inside it, and
+       * so does early; whichever has the greater index comes last.
+       */
+      nir_block *before =
+         nir_cf_node_as_block(nir_cf_node_prev(&loop->cf_node));
+      if (before->index < early->index)
+         break;
+
+      if (!can_speculate && !gcm_block_runs_with_loop(instr->block, loop,
+                                                       state))
+         break;
+
+      best = before;
+   }
+
+   if (best == instr->block)
+      return false;
+
+   gcm_move_instr(instr, best);
+   return true;
+}
+
+/** Returns true if every path leaving \p block runs through \p a or \p b
+ * before reaching the end of the function.
+ */
+static bool
+gcm_is_anticipated(nir_block *block, nir_block *a, nir_block *b,
+                   struct gcm_state *state)
+{
+   nir_function_impl *impl = state->impl;
+   unsigned stack_size = 0;
+
+   memset(state->visited, 0,
+          BITSET_WORDS(impl->num_blocks) * sizeof(BITSET_WORD));
+
+   for (unsigned i = 0; i < 2; i++) {
+      if (block->successors[i])
+         state->stack[stack_size++] = block->successors[i];
+   }
+
+   while (stack_size > 0) {
+      nir_block *cur = state->stack[--stack_size];
+
+      if (cur == a || cur == b)
+         continue;
+
+      if (cur == impl->end_block)
+         return false;
+
+      if (BITSET_TEST(state->visited, cur->index))
+         continue;
+      BITSET_SET(state->visited, cur->index);
+
+      for (unsigned i = 0; i < 2; i++) {
+         nir_block *succ = cur->successors[i];
+         if (succ && (succ == impl->end_block ||
+                      !BITSET_TEST(state->visited, succ->index)))
+            state->stack[stack_size++] = succ;
+      }
+   }
+
+   return true;
+}
+
+/** Tries to merge \p instr into \p match, an equivalent earlier instruction
+ *
+ * If \p match doesn't dominate \p instr, it gets hoisted to their common
+ * dominator first, provided this neither adds work on any path nor moves it
+ * into a loop.
+ */
+static bool
+gcm_merge_instr(nir_instr *instr, nir_instr *match, struct gcm_state *state)
+{
+   nir_block *lca = nir_dominance_lca(match->block, instr->block);
+
+   if (lca != match->block) {
+      nir_loop *loop = gcm_innermost_loop(lca);
+      if (loop && (!gcm_loop_contains(loop, match->block) ||
+                   !gcm_loop_contains(loop, instr->block)))
+         return false;
+
+      if (!gcm_is_anticipated(lca, match->block, instr->block, state))
+         return false;
+
+      gcm_move_instr(match, lca);
+      gcm_hoist_instr(match, state);
+   }
+
+   return true;
+}
+
+static bool
+opt_licm_impl(nir_function_impl *impl, bool value_number)
+{
+   nir_metadata_require(impl, nir_metadata_block_index |
+                              nir_metadata_dominance);
+
+   struct gcm_state state;
+
+   state.impl = impl;
+   state.blocks = rzalloc_array(NULL, struct gcm_block_info, impl->num_blocks);
+   state.visited = ralloc_array(state.blocks, BITSET_WORD,
+                                BITSET_WORDS(impl->num_blocks));
+   /* Each block is visited at most once and pushes at most two successors */
+   state.stack = ralloc_array(state.blocks, nir_block *,
+                              2 * impl->num_blocks + 2);
+
+   gcm_build_block_info(&impl->body, &state, 0);
+
+   struct set *gvn_set = value_number ? nir_instr_set_create(NULL) : NULL;
+   bool progress = false;
+
+   nir_foreach_block(block, impl) {
+      if (!gcm_block_is_reachable(block))
+         continue;
+
+      nir_foreach_instr_safe(instr, block) {
+         gcm_pin_instr(instr);
+         if ((instr->pass_flags & GCM_INSTR_PINNED) ||
+             !nir_foreach_dest(instr, gcm_dest_is_ssa, NULL))
+            continue;
+
+         nir_instr *match =
+            gvn_set ? nir_instr_set_search(gvn_set, instr) : NULL;
+         if (match && gcm_merge_instr(instr, match, &state)) {
+            nir_instr_set_add_or_rewrite(gvn_set, instr);
+            nir_instr_remove(instr);
+            progress = true;
+            continue;
+         }
+
+         progress |= gcm_hoist_instr(instr, &state);
+
+         if (gvn_set && !match)
+            nir_instr_set_add_or_rewrite(gvn_set, instr);
+      }
+   }
+
+   if (gvn_set)
+      nir_instr_set_destroy(gvn_set);
+   ralloc_free(state.blocks);
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+
+   return progress;
+}
+
+bool
+nir_opt_licm(nir_shader *shader, bool value_number)
+{
+   bool progress = false;
+
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= opt_licm_impl(function->impl, value_number);
+   }
+
+   return progress;
+}
@@ -0,0 +1,544 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/hash_table.h"
+#include "util/set.h"
+
+/**
+ * \file nir_opt_vectorize.c
+ *
+ * Merges independent instructions that do the same thing on different
+ * components of the same values back into vector instructions, undoing what
+ * nir_lower_alu_to_scalar and nir_lower_io_to_scalar did for backends that
+ * prefer vectors:
+ *
+ *     vec1 32 ssa_2 = fadd ssa_0.x, ssa_1.x
+ *     vec1 32 ssa_3 = fadd ssa_0.y, ssa_1.y
+ *
+ * becomes
+ *
+ *     vec2 32 ssa_4 = fadd ssa_0.xy, ssa_1.xy
+ *
+ * Two ALU instructions can be merged if they have the same opcode and
+ * modifiers, and each pair of sources either reads the same SSA value (with
+ * any swizzle) or two constants.  Two loads can be merged if they are the
+ * same intrinsic with the same sources and indices, and read adjacent
+ * components.  Since the sources are the same, the merged instruction can be
+ * put right after the first of the two, from where it dominates all uses of
+ * both.
+ *
+ * Like CSE, this walks the dominance tree keeping a set of the candidates
+ * which dominate the current block, so instructions in different blocks get
+ * merged too.  Only per-component ALU opcodes are considered, and movs and
+ * phis are left alone.
+ */
+
+#define HASH(hash, data) _mesa_fnv32_1a_accumulate((hash), (data))
+
+static bool
+alu_can_vectorize(const nir_alu_instr *alu)
+{
+   const nir_op_info *info = &nir_op_infos[alu->op];
+
+   /* Merging movs only makes new movs for the users which can't take a
+    * swizzle, and copy propagation deals with them anyway.
+    */
+   if (alu->op == nir_op_imov || alu->op == nir_op_fmov)
+      return false;
+
+   if (info->output_size != 0 || !alu->dest.dest.is_ssa)
+      return false;
+
+   for (unsigned i = 0; i < info->num_inputs; i++) {
+      if (info->input_sizes[i] != 0 || !alu->src[i].src.is_ssa)
+         return false;
+   }
+
+   return alu->dest.dest.ssa.num_components < 4;
+}
+
+static bool
+intrinsic_can_vectorize(const nir_intrinsic_instr *intrin)
+{
+   switch (intrin->intrinsic) {
+   case nir_intrinsic_load_input:
+   case nir_intrinsic_load_per_vertex_input:
+   case nir_intrinsic_load_interpolated_input:
+      break;
+   default:
+      return false;
+   }
+
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin->intrinsic];
+   for (unsigned i = 0; i < info->num_srcs; i++) {
+      if (!intrin->src[i].is_ssa)
+         return false;
+   }
+
+   /* Components are counted in 32-bit units for 64-bit inputs. */
+   return intrin->dest.is_ssa &&
+          intrin->dest.ssa.bit_size == 32 &&
+          intrin->dest.ssa.num_components < 4;
+}
+
+static bool
+instr_can_vectorize(const nir_instr *instr)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      return alu_can_vectorize(nir_instr_as_alu(instr));
+   case nir_instr_type_intrinsic:
+      return intrinsic_can_vectorize(nir_instr_as_intrinsic(instr));
+   default:
+      return false;
+   }
+}
+
+static bool
+src_is_load_const(const nir_src *src)
+{
+   return src->ssa->parent_instr->type == nir_instr_type_load_const;
+}
+
+static uint32_t
+hash_alu(uint32_t hash, const nir_alu_instr *alu)
+{
+   hash = HASH(hash, alu->op);
+   hash = HASH(hash, alu->exact);
+   hash = HASH(hash, alu->dest.saturate);
+   hash = HASH(hash, alu->dest.dest.ssa.bit_size);
+
+   for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+      const nir_alu_src *src = &alu->src[i];
+
+      hash = HASH(hash, src->abs);
+      hash = HASH(hash, src->negate);
+      /* Any two constants can be merged, so only their size matters. */
+      if (src_is_load_const(&src->src))
+         hash = HASH(hash, src->src.ssa->bit_size);
+      else
+         hash = HASH(hash, src->src.ssa);
+   }
+
+   return hash;
+}
+
+static uint32_t
+hash_intrinsic(uint32_t hash, const nir_intrinsic_instr *intrin)
+{
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin->intrinsic];
+
+   hash = HASH(hash, intrin->intrinsic);
+   hash = HASH(hash, intrin->dest.ssa.bit_size);
+
+   for (unsigned i = 0; i < info->num_srcs; i++)
+      hash = HASH(hash, intrin->src[i].ssa);
+
+   for (unsigned i = 0; i < info->num_indices; i++) {
+      if (i != info->index_map[NIR_INTRINSIC_COMPONENT] - 1)
+         hash = HASH(hash, intrin->const_index[i]);
+   }
+
+   return hash;
+}
+
+static uint32_t
+hash_instr(const void *data)
+{
+   const nir_instr *instr = data;
+   uint32_t hash = _mesa_fnv32_1a_offset_bias;
+
+   hash = HASH(hash, instr->type);
+   if (instr->type == nir_instr_type_alu)
+      return hash_alu(hash, nir_instr_as_alu(instr));
+   else
+      return hash_intrinsic(hash, nir_instr_as_intrinsic(instr));
+}
+
+/* Whether two instructions are close enough to be merged, not counting
+ * their size or components.  That makes this an equivalence relation, so
+ * the set holds at most one candidate of each kind.
+ */
+static bool
+alus_equal(const nir_alu_instr *alu1, const nir_alu_instr *alu2)
+{
+   if (alu1->op != alu2->op ||
+       alu1->exact != alu2->exact ||
+       alu1->dest.saturate != alu2->dest.saturate ||
+       alu1->dest.dest.ssa.bit_size != alu2->dest.dest.ssa.bit_size)
+      return false;
+
+   for (unsigned i = 0; i < nir_op_infos[alu1->op].num_inputs; i++) {
+      const nir_alu_src *src1 = &alu1->src[i];
+      const nir_alu_src *src2 = &alu2->src[i];
+
+      if (src1->abs != src2->abs || src1->negate != src2->negate)
+         return false;
+
+      if (src_is_load_const(&src1->src) && src_is_load_const(&src2->src)) {
+         if (src1->src.ssa->bit_size != src2->src.ssa->bit_size)
+            return false;
+      } else if (src1->src.ssa != src2->src.ssa) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static bool
+intrinsics_equal(const nir_intrinsic_instr *intrin1,
+                 const nir_intrinsic_instr *intrin2)
+{
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin1->intrinsic];
+
+   if (intrin1->intrinsic != intrin2->intrinsic ||
+       intrin1->dest.ssa.bit_size != intrin2->dest.ssa.bit_size)
+      return false;
+
+   for (unsigned i = 0; i < info->num_srcs; i++) {
+      if (intrin1->src[i].ssa != intrin2->src[i].ssa)
+         return false;
+   }
+
+   for (unsigned i = 0; i < info->num_indices; i++) {
+      if (i != info->index_map[NIR_INTRINSIC_COMPONENT] - 1 &&
+          intrin1->const_index[i] != intrin2->const_index[i])
+         return false;
+   }
+
+   return true;
+}
+
+static bool
+instrs_equal(const void *data1, const void *data2)
+{
+   const nir_instr *instr1 = data1;
+   const nir_instr *instr2 = data2;
+
+   if (instr1->type != instr2->type)
+      return false;
+
+   if (instr1->type == nir_instr_type_alu)
+      return alus_equal(nir_instr_as_alu(instr1), nir_instr_as_alu(instr2));
+   else
+      return intrinsics_equal(nir_instr_as_intrinsic(instr1),
+                              nir_instr_as_intrinsic(instr2));
+}
+
+static void
+copy_const_component(nir_const_value *dst, unsigned dst_comp,
+                     const nir_const_value *src, unsigned src_comp,
+                     unsigned bit_size)
+{
+   switch (bit_size) {
+   case 64:
+      dst->u64[dst_comp] = src->u64[src_comp];
+      break;
+   case 32:
+      dst->u32[dst_comp] = src->u32[src_comp];
+      break;
+   case 16:
+      dst->u16[dst_comp] = src->u16[src_comp];
+      break;
+   case 8:
+      dst->u8[dst_comp] = src->u8[src_comp];
+      break;
+   default:
+      unreachable("Invalid bit size");
+   }
+}
+
+/**
+ * Points all uses of \p old_def at components \p offset and up of
+ * \p new_def.  ALU instructions get their swizzles adjusted, everything else
+ * reads a mov of the right components inserted at the builder's cursor.
+ */
+static void
+rewrite_uses(nir_builder *b, nir_ssa_def *old_def, nir_ssa_def *new_def,
+             unsigned offset)
+{
+   nir_ssa_def *channels = NULL;
+   const unsigned mask =
+      ((1 << old_def->num_components) - 1) << offset;
+
+   nir_foreach_use_safe(src, old_def) {
+      if (src->parent_instr->type == nir_instr_type_alu) {
+         nir_alu_src *alu_src = exec_node_data(nir_alu_src, src, src);
+
+         for (unsigned i = 0; i < 4; i++) {
+            alu_src->swizzle[i] = MIN2(alu_src->swizzle[i] + offset,
+                                       new_def->num_components - 1);
+         }
+         nir_instr_rewrite_src(src->parent_instr, src,
+                               nir_src_for_ssa(new_def));
+      } else {
+         if (channels == NULL)
+            channels = nir_channels(b, new_def, mask);
+         nir_instr_rewrite_src(src->parent_instr, src,
+                               nir_src_for_ssa(channels));
+      }
+   }
+
+   nir_foreach_if_use_safe(src, old_def) {
+      if (channels == NULL)
+         channels = nir_channels(b, new_def, mask);
+      nir_if_rewrite_condition(src->parent_if, nir_src_for_ssa(channels));
+   }
+}
+
+static nir_instr *
+alu_combine(nir_builder *b, nir_alu_instr *alu1, nir_alu_instr *alu2)
+{
+   const unsigned comps1 = alu1->dest.dest.ssa.num_components;
+   const unsigned comps2 = alu2->dest.dest.ssa.num_components;
+   const unsigned total = comps1 + comps2;
+
+   nir_alu_instr *alu = nir_alu_instr_create(b->shader, alu1->op);
+   nir_ssa_dest_init(&alu->instr, &alu->dest.dest, total,
+                     alu1->dest.dest.ssa.bit_size, NULL);
+   alu->dest.write_mask = (1 << total) - 1;
+   alu->dest.saturate = alu1->dest.saturate;
+   alu->exact = alu1->exact;
+
+   b->cursor = nir_after_instr(&alu1->instr);
+
+   for (unsigned i = 0; i < nir_op_infos[alu1->op].num_inputs; i++) {
+      const nir_alu_src *src1 = &alu1->src[i];
+      const nir_alu_src *src2 = &alu2->src[i];
+
+      alu->src[i].abs = src1->abs;
+      alu->src[i].negate = src1->negate;
+
+      if (src1->src.ssa == src2->src.ssa) {
+         alu->src[i].src = nir_src_for_ssa(src1->src.ssa);
+         for (unsigned j = 0; j < comps1; j++)
+            alu->src[i].swizzle[j] = src1->swizzle[j];
+         for (unsigned j = 0; j < comps2; j++)
+            alu->src[i].swizzle[comps1 + j] = src2->swizzle[j];
+      } else {
+         /* Two different constants, build one with the components both
+          * of them read.
+          */
+         const unsigned bit_size = src1->src.ssa->bit_size;
+         nir_load_const_instr *const1 =
+            nir_instr_as_load_const(src1->src.ssa->parent_instr);
+         nir_load_const_instr *const2 =
+            nir_instr_as_load_const(src2->src.ssa->parent_instr);
+         nir_load_const_instr *load =
+            nir_load_const_instr_create(b->shader, total, bit_size);
+
+         for (unsigned j = 0; j < comps1; j++) {
+            copy_const_component(&load->value, j,
+                                 &const1->value, src1->swizzle[j], bit_size);
+         }
+         for (unsigned j = 0; j < comps2; j++) {
+            copy_const_component(&load->value, comps1 + j,
+                                 &const2->value, src2->swizzle[j], bit_size);
+         }
+         nir_builder_instr_insert(b, &load->instr);
+
+         alu->src[i].src = nir_src_for_ssa(&load->def);
+         for (unsigned j = 0; j < total; j++)
+            alu->src[i].swizzle[j] = j;
+      }
+
+      for (unsigned j = total; j < 4; j++)
+         alu->src[i].swizzle[j] = alu->src[i].swizzle[total - 1];
+   }
+
+   nir_builder_instr_insert(b, &alu->instr);
+
+   rewrite_uses(b, &alu1->dest.dest.ssa, &alu->dest.dest.ssa, 0);
+   rewrite_uses(b, &alu2->dest.dest.ssa, &alu->dest.dest.ssa, comps1);
+
+   return &alu->instr;
+}
+
+static nir_instr *
+intrinsic_combine(nir_builder *b, nir_intrinsic_instr *intrin1,
+                  nir_intrinsic_instr *intrin2)
+{
+   const unsigned comp1 = nir_intrinsic_component(intrin1);
+   const unsigned comp2 = nir_intrinsic_component(intrin2);
+   const unsigned comps1 = intrin1->num_components;
+   const unsigned comps2 = intrin2->num_components;
+
+   /* Only merge loads which read adjacent components. */
+   if (comp1 + comps1 != comp2 && comp2 + comps2 != comp1)
+      return NULL;
+
+   if (comps1 + comps2 > 4)
+      return NULL;
+
+   const unsigned first = MIN2(comp1, comp2);
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin1->intrinsic];
+
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, intrin1->intrinsic);
+   load->num_components = comps1 + comps2;
+   for (unsigned i = 0; i < info->num_srcs; i++)
+      nir_src_copy(&load->src[i], &intrin1->src[i], load);
+   memcpy(load->const_index, intrin1->const_index,
+          sizeof(load->const_index));
+   nir_intrinsic_set_component(load, first);
+   nir_ssa_dest_init(&load->instr, &load->dest, load->num_components,
+                     intrin1->dest.ssa.bit_size, NULL);
+
+   b->cursor = nir_after_instr(&intrin1->instr);
+   nir_builder_instr_insert(b, &load->instr);
+
+   rewrite_uses(b, &intrin1->dest.ssa, &load->dest.ssa, comp1 - first);
+   rewrite_uses(b, &intrin2->dest.ssa, &load->dest.ssa, comp2 - first);
+
+   return &load->instr;
+}
+
+/**
+ * Tries to merge \p instr2 into \p instr1, which dominates it.  Returns the
+ * merged instruction, or NULL if they can't be merged.
+ */
+static nir_instr *
+instr_try_combine(nir_builder *b, nir_instr *instr1, nir_instr *instr2)
+{
+   nir_instr *combined;
+
+   if (instr1->type == nir_instr_type_alu) {
+      nir_alu_instr *alu1 = nir_instr_as_alu(instr1);
+      nir_alu_instr *alu2 = nir_instr_as_alu(instr2);
+
+      if (alu1->dest.dest.ssa.num_components +
+          alu2->dest.dest.ssa.num_components > 4)
+         return NULL;
+
+      combined = alu_combine(b, alu1, alu2);
+   } else {
+      combined = intrinsic_combine(b, nir_instr_as_intrinsic(instr1),
+                                   nir_instr_as_intrinsic(instr2));
+      if (combined == NULL)
+         return NULL;
+   }
+
+   nir_instr_remove(instr1);
+   nir_instr_remove(instr2);
+
+   return combined;
+}
+
+/**
+ * Merges \p instr with its candidate in the set if possible, and makes the
+ * result (or \p instr if they couldn't be merged) the new candidate.
+ */
+static bool
+vec_instr_set_add_or_combine(nir_builder *b, struct set *instr_set,
+                             nir_instr *instr)
+{
+   if (!instr_can_vectorize(instr))
+      return false;
+
+   struct set_entry *entry = _mesa_set_search(instr_set, instr);
+   if (entry) {
+      nir_instr *match = (nir_instr *) entry->key;
+      nir_instr *combined = instr_try_combine(b, match, instr);
+
+      if (combined) {
+         _mesa_set_remove(instr_set, entry);
+         if (instr_can_vectorize(combined))
+            _mesa_set_add(instr_set, combined);
+         return true;
+      }
+   }
+
+   /* This replaces the old candidate, if there was one. */
+   _mesa_set_add(instr_set, instr);
+   return false;
+}
+
+static void
+vec_instr_set_remove(struct set *instr_set, nir_instr *instr)
+{
+   if (!instr_can_vectorize(instr))
+      return;
+
+   struct set_entry *entry = _mesa_set_search(instr_set, instr);
+   if (entry && entry->key == instr)
+      _mesa_set_remove(instr_set, entry);
+}
+
+static bool
+vectorize_block(nir_builder *b, nir_block *block, struct set *instr_set)
+{
+   bool progress = false;
+
+   nir_foreach_instr_safe(instr, block)
+      progress |= vec_instr_set_add_or_combine(b, instr_set, instr);
+
+   for (unsigned i = 0; i < block->num_dom_children; i++) {
+      nir_block *child = block->dom_children[i];
+      progress |= vectorize_block(b, child, instr_set);
+   }
+
+   nir_foreach_instr(instr, block)
+      vec_instr_set_remove(instr_set, instr);
+
+   return progress;
+}
+
+static bool
+nir_opt_vectorize_impl(nir_function_impl *impl)
+{
+   struct set *instr_set = _mesa_set_create(NULL, hash_instr, instrs_equal);
+   nir_builder b;
+
+   nir_builder_init(&b, impl);
+   nir_metadata_require(impl, nir_metadata_dominance);
+
+   /* Only the most recent candidate of each kind is kept, so loads which
+    * come in the wrong order can need another go.
+    */
+   bool progress = false;
+   while (vectorize_block(&b, nir_start_block(impl), instr_set))
+      progress = true;
+
+   if (progress)
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+
+   _mesa_set_destroy(instr_set, NULL);
+   return progress;
+}
+
+bool
+nir_opt_vectorize(nir_shader *shader)
+{
+   bool progress = false;
+
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= nir_opt_vectorize_impl(function->impl);
+   }
+
+   return progress;
+}
@@ -25,11 +25,17 @@
 #include "nir_control_flow.h"
 #include "util/u_dynarray.h"
 
-typedef struct {
-   size_t blob_offset;
-   nir_ssa_def *src;
-   nir_block *block;
-} write_phi_fixup;
+/* The serialized form is meant to be small, since it ends up in the shader
+ * cache, and cheap to read.  Almost everything is written as a varint; in
+ * particular objects (variables, registers, SSA values, blocks, functions)
+ * are referenced by an index assigned in the order they are written.
+ *
+ * Shader-level objects take the first indices.  Every function impl then
+ * uses its own index space starting right after them, and is prefixed with
+ * its size in bytes, so that a reader can decode any one impl without
+ * looking at the others; see nir_deserialize_function().  Types are likewise
+ * written once per index space and referenced by index afterwards.
+ */
 
 typedef struct {
    const nir_shader *nir;
@@ -42,12 +48,22 @@ typedef struct {
    /* the next index to assign to a NIR in-memory object */
    uintptr_t next_idx;
 
-   /* Array of write_phi_fixup structs representing phi sources that need to
-    * be resolved in the second pass.
+   /* maps glsl_type pointer to index, and the next type index to assign */
+   struct hash_table *type_table;
+   uintptr_t next_type_idx;
+
+   /* Phis in the function impl being written.  Their sources may refer to
+    * blocks and SSA values which haven't been written yet, so they are
+    * written at the end of the impl.
     */
-   struct util_dynarray phi_fixups;
+   struct util_dynarray phis;
 } write_ctx;
 
+typedef struct {
+   nir_phi_instr *phi;
+   unsigned num_srcs;
+} read_phi_fixup;
+
 typedef struct {
    nir_shader *nir;
 
@@ -56,15 +72,17 @@ typedef struct {
    /* the next index to assign to a NIR in-memory object */
    uintptr_t next_idx;
 
-   /* The length of the index -> object table */
+   /* The allocated length of the index -> object table */
    uintptr_t idx_table_len;
 
    /* map from index to deserialized pointer */
    void **idx_table;
 
-   /* List of phi sources. */
-   struct list_head phi_srcs;
+   /* map from index to glsl_type */
+   struct util_dynarray types;
 
+   /* Array of read_phi_fixup structs for the function impl being read. */
+   struct util_dynarray phis;
 } read_ctx;
 
 static void
@@ -85,34 +103,79 @@ write_lookup_object(write_ctx *ctx, const void *obj)
 static void
 write_object(write_ctx *ctx, const void *obj)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, obj));
+   blob_write_varint(ctx->blob, write_lookup_object(ctx, obj));
 }
 
 static void
 read_add_object(read_ctx *ctx, void *obj)
 {
-   assert(ctx->next_idx < ctx->idx_table_len);
+   if (ctx->next_idx == ctx->idx_table_len) {
+      ctx->idx_table_len = MAX2(64, ctx->idx_table_len * 2);
+      ctx->idx_table = realloc(ctx->idx_table,
+                               ctx->idx_table_len * sizeof(void *));
+   }
    ctx->idx_table[ctx->next_idx++] = obj;
 }
 
 static void *
 read_lookup_object(read_ctx *ctx, uintptr_t idx)
 {
-   assert(idx < ctx->idx_table_len);
+   assert(idx < ctx->next_idx);
    return ctx->idx_table[idx];
 }
 
 static void *
 read_object(read_ctx *ctx)
 {
-   return read_lookup_object(ctx, blob_read_intptr(ctx->blob));
+   return read_lookup_object(ctx, blob_read_varint(ctx->blob));
+}
+
+static void
+write_type(write_ctx *ctx, const struct glsl_type *type)
+{
+   /* Index 0 means a type we haven't seen yet, which follows inline. */
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->type_table, type);
+   if (entry) {
+      blob_write_varint(ctx->blob, (uintptr_t) entry->data + 1);
+   } else {
+      blob_write_varint(ctx->blob, 0);
+      encode_type_to_blob(ctx->blob, type);
+      _mesa_hash_table_insert(ctx->type_table, type,
+                              (void *) ctx->next_type_idx++);
+   }
+}
+
+static void
+write_forget_types(write_ctx *ctx, uintptr_t first_type_idx)
+{
+   struct hash_entry *entry;
+   hash_table_foreach(ctx->type_table, entry) {
+      if ((uintptr_t) entry->data >= first_type_idx)
+         _mesa_hash_table_remove(ctx->type_table, entry);
+   }
+   ctx->next_type_idx = first_type_idx;
+}
+
+static const struct glsl_type *
+read_type(read_ctx *ctx)
+{
+   uintptr_t idx = blob_read_varint(ctx->blob);
+   if (idx == 0) {
+      const struct glsl_type *type = decode_type_from_blob(ctx->blob);
+      util_dynarray_append(&ctx->types, const struct glsl_type *, type);
+      return type;
+   }
+
+   assert((idx - 1) * sizeof(const struct glsl_type *) < ctx->types.size);
+   return *util_dynarray_element(&ctx->types, const struct glsl_type *,
+                                 idx - 1);
 }
 
 static void
 write_constant(write_ctx *ctx, const nir_constant *c)
 {
    blob_write_bytes(ctx->blob, c->values, sizeof(c->values));
-   blob_write_uint32(ctx->blob, c->num_elements);
+   blob_write_varint(ctx->blob, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       write_constant(ctx, c->elements[i]);
 }
@@ -123,7 +186,7 @@ read_constant(read_ctx *ctx, nir_variable *nvar)
    nir_constant *c = ralloc(nvar, nir_constant);
 
    blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
-   c->num_elements = blob_read_uint32(ctx->blob);
+   c->num_elements = blob_read_varint(ctx->blob);
    c->elements = ralloc_array(ctx->nir, nir_constant *, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       c->elements[i] = read_constant(ctx, nvar);
@@ -135,20 +198,23 @@ static void
 write_variable(write_ctx *ctx, const nir_variable *var)
 {
    write_add_object(ctx, var);
-   encode_type_to_blob(ctx->blob, var->type);
-   blob_write_uint32(ctx->blob, !!(var->name));
+   write_type(ctx, var->type);
+
+   uint32_t flags = !!(var->name);
+   flags |= !!(var->constant_initializer) << 1;
+   flags |= !!(var->interface_type) << 2;
+   blob_write_varint(ctx->blob, flags);
+
    if (var->name)
       blob_write_string(ctx->blob, var->name);
    blob_write_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   blob_write_uint32(ctx->blob, var->num_state_slots);
+   blob_write_varint(ctx->blob, var->num_state_slots);
    blob_write_bytes(ctx->blob, (uint8_t *) var->state_slots,
                     var->num_state_slots * sizeof(nir_state_slot));
-   blob_write_uint32(ctx->blob, !!(var->constant_initializer));
    if (var->constant_initializer)
       write_constant(ctx, var->constant_initializer);
-   blob_write_uint32(ctx->blob, !!(var->interface_type));
    if (var->interface_type)
-      encode_type_to_blob(ctx->blob, var->interface_type);
+      write_type(ctx, var->interface_type);
 }
 
 static nir_variable *
@@ -157,8 +223,13 @@ read_variable(read_ctx *ctx)
    nir_variable *var = rzalloc(ctx->nir, nir_variable);
    read_add_object(ctx, var);
 
-   var->type = decode_type_from_blob(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
+   var->type = read_type(ctx);
+
+   uint32_t flags = blob_read_varint(ctx->blob);
+   bool has_name = flags & 0x1;
+   bool has_const_initializer = flags & 0x2;
+   bool has_interface_type = flags & 0x4;
+
    if (has_name) {
       const char *name = blob_read_string(ctx->blob);
       var->name = ralloc_strdup(var, name);
@@ -166,18 +237,16 @@ read_variable(read_ctx *ctx)
       var->name = NULL;
    }
    blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   var->num_state_slots = blob_read_uint32(ctx->blob);
+   var->num_state_slots = blob_read_varint(ctx->blob);
    var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
    blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
                    var->num_state_slots * sizeof(nir_state_slot));
-   bool has_const_initializer = blob_read_uint32(ctx->blob);
    if (has_const_initializer)
       var->constant_initializer = read_constant(ctx, var);
    else
       var->constant_initializer = NULL;
-   bool has_interface_type = blob_read_uint32(ctx->blob);
    if (has_interface_type)
-      var->interface_type = decode_type_from_blob(ctx->blob);
+      var->interface_type = read_type(ctx);
    else
       var->interface_type = NULL;
 
@@ -187,7 +256,7 @@ read_variable(read_ctx *ctx)
 static void
 write_var_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_variable, var, node, src) {
       write_variable(ctx, var);
    }
@@ -197,7 +266,7 @@ static void
 read_var_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_vars = blob_read_uint32(ctx->blob);
+   unsigned num_vars = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_vars; i++) {
       nir_variable *var = read_variable(ctx);
       exec_list_push_tail(dst, &var->node);
@@ -208,14 +277,14 @@ static void
 write_register(write_ctx *ctx, const nir_register *reg)
 {
    write_add_object(ctx, reg);
-   blob_write_uint32(ctx->blob, reg->num_components);
-   blob_write_uint32(ctx->blob, reg->bit_size);
-   blob_write_uint32(ctx->blob, reg->num_array_elems);
-   blob_write_uint32(ctx->blob, reg->index);
-   blob_write_uint32(ctx->blob, !!(reg->name));
+   blob_write_varint(ctx->blob, reg->num_components);
+   blob_write_varint(ctx->blob, reg->bit_size);
+   blob_write_varint(ctx->blob, reg->num_array_elems);
+   blob_write_varint(ctx->blob, reg->index);
+   blob_write_varint(ctx->blob, !!(reg->name) << 2 |
+                                reg->is_global << 1 | reg->is_packed);
    if (reg->name)
       blob_write_string(ctx->blob, reg->name);
-   blob_write_uint32(ctx->blob, reg->is_global << 1 | reg->is_packed);
 }
 
 static nir_register *
@@ -223,20 +292,19 @@ read_register(read_ctx *ctx)
 {
    nir_register *reg = ralloc(ctx->nir, nir_register);
    read_add_object(ctx, reg);
-   reg->num_components = blob_read_uint32(ctx->blob);
-   reg->bit_size = blob_read_uint32(ctx->blob);
-   reg->num_array_elems = blob_read_uint32(ctx->blob);
-   reg->index = blob_read_uint32(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
-   if (has_name) {
+   reg->num_components = blob_read_varint(ctx->blob);
+   reg->bit_size = blob_read_varint(ctx->blob);
+   reg->num_array_elems = blob_read_varint(ctx->blob);
+   reg->index = blob_read_varint(ctx->blob);
+   unsigned flags = blob_read_varint(ctx->blob);
+   reg->is_global = flags & 0x2;
+   reg->is_packed = flags & 0x1;
+   if (flags & 0x4) {
       const char *name = blob_read_string(ctx->blob);
       reg->name = ralloc_strdup(reg, name);
    } else {
       reg->name = NULL;
    }
-   unsigned flags = blob_read_uint32(ctx->blob);
-   reg->is_global = flags & 0x2;
-   reg->is_packed = flags & 0x1;
 
    list_inithead(&reg->uses);
    list_inithead(&reg->defs);
@@ -248,7 +316,7 @@ read_register(read_ctx *ctx)
 static void
 write_reg_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_register, reg, node, src)
       write_register(ctx, reg);
 }
@@ -257,7 +325,7 @@ static void
 read_reg_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_regs = blob_read_uint32(ctx->blob);
+   unsigned num_regs = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_regs; i++) {
       nir_register *reg = read_register(ctx);
       exec_list_push_tail(dst, &reg->node);
@@ -269,20 +337,21 @@ write_src(write_ctx *ctx, const nir_src *src)
 {
    /* Since sources are very frequent, we try to save some space when storing
     * them. In particular, we store whether the source is a register and
-    * whether the register has an indirect index in the low two bits. We can
-    * assume that the high two bits of the index are zero, since otherwise our
-    * address space would've been exhausted allocating the remap table!
+    * whether the register has an indirect index in the low two bits.  SSA
+    * values are referenced relative to the next index to be assigned:  they
+    * are always written before their uses (phi sources are handled
+    * separately) and tend to be used soon after, so this usually fits in a
+    * single byte.
     */
    if (src->is_ssa) {
-      uintptr_t idx = write_lookup_object(ctx, src->ssa) << 2;
-      idx |= 1;
-      blob_write_intptr(ctx->blob, idx);
+      uintptr_t idx = ctx->next_idx - write_lookup_object(ctx, src->ssa);
+      blob_write_varint(ctx->blob, idx << 2 | 1);
    } else {
       uintptr_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
       if (src->reg.indirect)
          idx |= 2;
-      blob_write_intptr(ctx->blob, idx);
-      blob_write_uint32(ctx->blob, src->reg.base_offset);
+      blob_write_varint(ctx->blob, idx);
+      blob_write_varint(ctx->blob, src->reg.base_offset);
       if (src->reg.indirect) {
          write_src(ctx, src->reg.indirect);
       }
@@ -292,15 +361,15 @@ write_src(write_ctx *ctx, const nir_src *src)
 static void
 read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 {
-   uintptr_t val = blob_read_intptr(ctx->blob);
+   uintptr_t val = blob_read_varint(ctx->blob);
    uintptr_t idx = val >> 2;
    src->is_ssa = val & 0x1;
    if (src->is_ssa) {
-      src->ssa = read_lookup_object(ctx, idx);
+      src->ssa = read_lookup_object(ctx, ctx->next_idx - idx);
    } else {
       bool is_indirect = val & 0x2;
       src->reg.reg = read_lookup_object(ctx, idx);
-      src->reg.base_offset = blob_read_uint32(ctx->blob);
+      src->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          src->reg.indirect = ralloc(mem_ctx, nir_src);
          read_src(ctx, src->reg.indirect, mem_ctx);
@@ -317,18 +386,18 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
    if (dst->is_ssa) {
       val |= !!(dst->ssa.name) << 1;
       val |= dst->ssa.num_components << 2;
-      val |= dst->ssa.bit_size << 5;
+      val |= (ffs(dst->ssa.bit_size) - 1) << 5;
    } else {
       val |= !!(dst->reg.indirect) << 1;
    }
-   blob_write_uint32(ctx->blob, val);
+   blob_write_varint(ctx->blob, val);
    if (dst->is_ssa) {
       write_add_object(ctx, &dst->ssa);
       if (dst->ssa.name)
          blob_write_string(ctx->blob, dst->ssa.name);
    } else {
-      blob_write_intptr(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
-      blob_write_uint32(ctx->blob, dst->reg.base_offset);
+      write_object(ctx, dst->reg.reg);
+      blob_write_varint(ctx->blob, dst->reg.base_offset);
       if (dst->reg.indirect)
          write_src(ctx, dst->reg.indirect);
    }
@@ -337,19 +406,19 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
 static void
 read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
    bool is_ssa = val & 0x1;
    if (is_ssa) {
       bool has_name = val & 0x2;
       unsigned num_components = (val >> 2) & 0x7;
-      unsigned bit_size = val >> 5;
+      unsigned bit_size = 1 << (val >> 5);
       char *name = has_name ? blob_read_string(ctx->blob) : NULL;
       nir_ssa_dest_init(instr, dst, num_components, bit_size, name);
       read_add_object(ctx, &dst->ssa);
    } else {
       bool is_indirect = val & 0x2;
       dst->reg.reg = read_object(ctx);
-      dst->reg.base_offset = blob_read_uint32(ctx->blob);
+      dst->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          dst->reg.indirect = ralloc(instr, nir_src);
          read_src(ctx, dst->reg.indirect, instr);
@@ -365,29 +434,30 @@ write_deref_chain(write_ctx *ctx, const nir_deref_var *deref_var)
    uint32_t len = 0;
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child)
       len++;
-   blob_write_uint32(ctx->blob, len);
+   blob_write_varint(ctx->blob, len);
 
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child) {
-      blob_write_uint32(ctx->blob, d->deref_type);
       switch (d->deref_type) {
       case nir_deref_type_array: {
          const nir_deref_array *deref_array = nir_deref_as_array(d);
-         blob_write_uint32(ctx->blob, deref_array->deref_array_type);
-         blob_write_uint32(ctx->blob, deref_array->base_offset);
+         blob_write_varint(ctx->blob, deref_array->deref_array_type << 2 |
+                                      nir_deref_type_array);
+         blob_write_varint(ctx->blob, deref_array->base_offset);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             write_src(ctx, &deref_array->indirect);
          break;
       }
       case nir_deref_type_struct: {
          const nir_deref_struct *deref_struct = nir_deref_as_struct(d);
-         blob_write_uint32(ctx->blob, deref_struct->index);
+         blob_write_varint(ctx->blob, deref_struct->index << 2 |
+                                      nir_deref_type_struct);
          break;
       }
       case nir_deref_type_var:
          unreachable("Invalid deref type");
       }
 
-      encode_type_to_blob(ctx->blob, d->type);
+      write_type(ctx, d->type);
    }
 }
 
@@ -397,25 +467,25 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
    nir_variable *var = read_object(ctx);
    nir_deref_var *deref_var = nir_deref_var_create(mem_ctx, var);
 
-   uint32_t len = blob_read_uint32(ctx->blob);
+   uint32_t len = blob_read_varint(ctx->blob);
 
    nir_deref *tail = &deref_var->deref;
    for (uint32_t i = 0; i < len; i++) {
-      nir_deref_type deref_type = blob_read_uint32(ctx->blob);
+      uint32_t val = blob_read_varint(ctx->blob);
+      nir_deref_type deref_type = val & 0x3;
       nir_deref *deref = NULL;
       switch (deref_type) {
       case nir_deref_type_array: {
          nir_deref_array *deref_array = nir_deref_array_create(tail);
-         deref_array->deref_array_type = blob_read_uint32(ctx->blob);
-         deref_array->base_offset = blob_read_uint32(ctx->blob);
+         deref_array->deref_array_type = val >> 2;
+         deref_array->base_offset = blob_read_varint(ctx->blob);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             read_src(ctx, &deref_array->indirect, mem_ctx);
          deref = &deref_array->deref;
          break;
       }
       case nir_deref_type_struct: {
-         uint32_t index = blob_read_uint32(ctx->blob);
-         nir_deref_struct *deref_struct = nir_deref_struct_create(tail, index);
+         nir_deref_struct *deref_struct = nir_deref_struct_create(tail, val >> 2);
          deref = &deref_struct->deref;
          break;
       }
@@ -423,7 +493,7 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
          unreachable("Invalid deref type");
       }
 
-      deref->type = decode_type_from_blob(ctx->blob);
+      deref->type = read_type(ctx);
 
       tail->child = deref;
       tail = deref;
@@ -435,44 +505,51 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
 static void
 write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 {
-   blob_write_uint32(ctx->blob, alu->op);
-   uint32_t flags = alu->exact;
-   flags |= alu->dest.saturate << 1;
-   flags |= alu->dest.write_mask << 2;
-   blob_write_uint32(ctx->blob, flags);
+   uint32_t header = alu->exact;
+   header |= alu->dest.saturate << 1;
+   header |= alu->dest.write_mask << 2;
+   header |= alu->op << 6;
+   blob_write_varint(ctx->blob, header);
 
    write_dest(ctx, &alu->dest.dest);
 
    for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
       write_src(ctx, &alu->src[i].src);
-      flags = alu->src[i].negate;
+
+      /* Store the swizzle relative to the identity one, and leave unused
+       * channels as identity, so that a source without modifiers takes a
+       * single zero byte.
+       */
+      uint32_t flags = alu->src[i].negate;
       flags |= alu->src[i].abs << 1;
-      for (unsigned j = 0; j < 4; j++)
-         flags |= alu->src[i].swizzle[j] << (2 + 2 * j);
-      blob_write_uint32(ctx->blob, flags);
+      for (unsigned j = 0; j < 4; j++) {
+         if (nir_alu_instr_channel_used(alu, i, j))
+            flags |= (alu->src[i].swizzle[j] ^ j) << (2 + 2 * j);
+      }
+      blob_write_varint(ctx->blob, flags);
    }
 }
 
 static nir_alu_instr *
 read_alu(read_ctx *ctx)
 {
-   nir_op op = blob_read_uint32(ctx->blob);
+   uint32_t header = blob_read_varint(ctx->blob);
+   nir_op op = header >> 6;
    nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, op);
 
-   uint32_t flags = blob_read_uint32(ctx->blob);
-   alu->exact = flags & 1;
-   alu->dest.saturate = flags & 2;
-   alu->dest.write_mask = flags >> 2;
+   alu->exact = header & 1;
+   alu->dest.saturate = header & 2;
+   alu->dest.write_mask = (header >> 2) & 0xf;
 
    read_dest(ctx, &alu->dest.dest, &alu->instr);
 
    for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
       read_src(ctx, &alu->src[i].src, &alu->instr);
-      flags = blob_read_uint32(ctx->blob);
+      uint32_t flags = blob_read_varint(ctx->blob);
       alu->src[i].negate = flags & 1;
       alu->src[i].abs = flags & 2;
       for (unsigned j = 0; j < 4; j++)
-         alu->src[i].swizzle[j] = (flags >> (2 * j + 2)) & 3;
+         alu->src[i].swizzle[j] = ((flags >> (2 * j + 2)) & 3) ^ j;
    }
 
    return alu;
@@ -481,13 +558,11 @@ read_alu(read_ctx *ctx)
 static void
 write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 {
-   blob_write_uint32(ctx->blob, intrin->intrinsic);
-
    unsigned num_variables = nir_intrinsic_infos[intrin->intrinsic].num_variables;
    unsigned num_srcs = nir_intrinsic_infos[intrin->intrinsic].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[intrin->intrinsic].num_indices;
 
-   blob_write_uint32(ctx->blob, intrin->num_components);
+   blob_write_varint(ctx->blob, intrin->intrinsic << 3 | intrin->num_components);
 
    if (nir_intrinsic_infos[intrin->intrinsic].has_dest)
       write_dest(ctx, &intrin->dest);
@@ -499,13 +574,14 @@ write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
       write_src(ctx, &intrin->src[i]);
 
    for (unsigned i = 0; i < num_indices; i++)
-      blob_write_uint32(ctx->blob, intrin->const_index[i]);
+      blob_write_varint(ctx->blob, (uint32_t) intrin->const_index[i]);
 }
 
 static nir_intrinsic_instr *
 read_intrinsic(read_ctx *ctx)
 {
-   nir_intrinsic_op op = blob_read_uint32(ctx->blob);
+   uint32_t header = blob_read_varint(ctx->blob);
+   nir_intrinsic_op op = header >> 3;
 
    nir_intrinsic_instr *intrin = nir_intrinsic_instr_create(ctx->nir, op);
 
@@ -513,7 +589,7 @@ read_intrinsic(read_ctx *ctx)
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[op].num_indices;
 
-   intrin->num_components = blob_read_uint32(ctx->blob);
+   intrin->num_components = header & 0x7;
 
    if (nir_intrinsic_infos[op].has_dest)
       read_dest(ctx, &intrin->dest, &intrin->instr);
@@ -525,7 +601,7 @@ read_intrinsic(read_ctx *ctx)
       read_src(ctx, &intrin->src[i], &intrin->instr);
 
    for (unsigned i = 0; i < num_indices; i++)
-      intrin->const_index[i] = blob_read_uint32(ctx->blob);
+      intrin->const_index[i] = (uint32_t) blob_read_varint(ctx->blob);
 
    return intrin;
 }
@@ -534,21 +610,24 @@ static void
 write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
 {
    uint32_t val = lc->def.num_components;
-   val |= lc->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   val |= (ffs(lc->def.bit_size) - 1) << 3;
+   blob_write_varint(ctx->blob, val);
+   /* Only the components which are actually used. */
+   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value,
+                    lc->def.num_components * lc->def.bit_size / 8);
    write_add_object(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
 read_load_const(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
 
    nir_load_const_instr *lc =
-      nir_load_const_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_load_const_instr_create(ctx->nir, val & 0x7, 1 << (val >> 3));
 
-   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                   lc->def.num_components * lc->def.bit_size / 8);
    read_add_object(ctx, &lc->def);
    return lc;
 }
@@ -557,18 +636,18 @@ static void
 write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
 {
    uint32_t val = undef->def.num_components;
-   val |= undef->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
+   val |= (ffs(undef->def.bit_size) - 1) << 3;
+   blob_write_varint(ctx->blob, val);
    write_add_object(ctx, &undef->def);
 }
 
 static nir_ssa_undef_instr *
 read_ssa_undef(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
 
    nir_ssa_undef_instr *undef =
-      nir_ssa_undef_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_ssa_undef_instr_create(ctx->nir, val & 0x7, 1 << (val >> 3));
 
    read_add_object(ctx, &undef->def);
    return undef;
@@ -593,11 +672,11 @@ union packed_tex_data {
 static void
 write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 {
-   blob_write_uint32(ctx->blob, tex->num_srcs);
-   blob_write_uint32(ctx->blob, tex->op);
-   blob_write_uint32(ctx->blob, tex->texture_index);
-   blob_write_uint32(ctx->blob, tex->texture_array_size);
-   blob_write_uint32(ctx->blob, tex->sampler_index);
+   blob_write_varint(ctx->blob, tex->num_srcs);
+   blob_write_varint(ctx->blob, tex->op);
+   blob_write_varint(ctx->blob, tex->texture_index);
+   blob_write_varint(ctx->blob, tex->texture_array_size);
+   blob_write_varint(ctx->blob, tex->sampler_index);
 
    STATIC_ASSERT(sizeof(union packed_tex_data) == sizeof(uint32_t));
    union packed_tex_data packed = {
@@ -611,11 +690,11 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
       .u.has_texture_deref = tex->texture != NULL,
       .u.has_sampler_deref = tex->sampler != NULL,
    };
-   blob_write_uint32(ctx->blob, packed.u32);
+   blob_write_varint(ctx->blob, packed.u32);
 
    write_dest(ctx, &tex->dest);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      blob_write_uint32(ctx->blob, tex->src[i].src_type);
+      blob_write_varint(ctx->blob, tex->src[i].src_type);
       write_src(ctx, &tex->src[i].src);
    }
 
@@ -628,16 +707,16 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 static nir_tex_instr *
 read_tex(read_ctx *ctx)
 {
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = blob_read_varint(ctx->blob);
    nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
 
-   tex->op = blob_read_uint32(ctx->blob);
-   tex->texture_index = blob_read_uint32(ctx->blob);
-   tex->texture_array_size = blob_read_uint32(ctx->blob);
-   tex->sampler_index = blob_read_uint32(ctx->blob);
+   tex->op = blob_read_varint(ctx->blob);
+   tex->texture_index = blob_read_varint(ctx->blob);
+   tex->texture_array_size = blob_read_varint(ctx->blob);
+   tex->sampler_index = blob_read_varint(ctx->blob);
 
    union packed_tex_data packed;
-   packed.u32 = blob_read_uint32(ctx->blob);
+   packed.u32 = blob_read_varint(ctx->blob);
    tex->sampler_dim = packed.u.sampler_dim;
    tex->dest_type = packed.u.dest_type;
    tex->coord_components = packed.u.coord_components;
@@ -648,7 +727,7 @@ read_tex(read_ctx *ctx)
 
    read_dest(ctx, &tex->dest, &tex->instr);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      tex->src[i].src_type = blob_read_uint32(ctx->blob);
+      tex->src[i].src_type = blob_read_varint(ctx->blob);
       read_src(ctx, &tex->src[i].src, &tex->instr);
    }
 
@@ -664,38 +743,29 @@ static void
 write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 {
    /* Phi nodes are special, since they may reference SSA definitions and
-    * basic blocks that don't exist yet. We leave two empty uintptr_t's here,
-    * and then store enough information so that a later fixup pass can fill
-    * them in correctly.
+    * basic blocks that don't exist yet.  We only write the number of sources
+    * here; the sources themselves are written by write_phi_srcs() once the
+    * whole function impl has been written.
     */
    write_dest(ctx, &phi->dest);
 
-   blob_write_uint32(ctx->blob, exec_list_length(&phi->srcs));
-
-   nir_foreach_phi_src(src, phi) {
-      assert(src->src.is_ssa);
-      size_t blob_offset = blob_reserve_intptr(ctx->blob);
-      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_intptr(ctx->blob);
-      assert(blob_offset + sizeof(uintptr_t) == blob_offset2);
-      write_phi_fixup fixup = {
-         .blob_offset = blob_offset,
-         .src = src->src.ssa,
-         .block = src->pred,
-      };
-      util_dynarray_append(&ctx->phi_fixups, write_phi_fixup, fixup);
-   }
+   blob_write_varint(ctx->blob, exec_list_length(&phi->srcs));
+
+   util_dynarray_append(&ctx->phis, const nir_phi_instr *, phi);
 }
 
 static void
-write_fixup_phis(write_ctx *ctx)
+write_phi_srcs(write_ctx *ctx)
 {
-   util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
-      uintptr_t *blob_ptr = (uintptr_t *)(ctx->blob->data + fixup->blob_offset);
-      blob_ptr[0] = write_lookup_object(ctx, fixup->src);
-      blob_ptr[1] = write_lookup_object(ctx, fixup->block);
+   util_dynarray_foreach(&ctx->phis, const nir_phi_instr *, phi) {
+      nir_foreach_phi_src(src, *phi) {
+         assert(src->src.is_ssa);
+         write_object(ctx, src->src.ssa);
+         write_object(ctx, src->pred);
+      }
    }
 
-   util_dynarray_clear(&ctx->phi_fixups);
+   util_dynarray_clear(&ctx->phis);
 }
 
 static nir_phi_instr *
@@ -705,67 +775,53 @@ read_phi(read_ctx *ctx, nir_block *blk)
 
    read_dest(ctx, &phi->dest, &phi->instr);
 
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   read_phi_fixup fixup = {
+      .phi = phi,
+      .num_srcs = blob_read_varint(ctx->blob),
+   };
+   util_dynarray_append(&ctx->phis, read_phi_fixup, fixup);
 
-   /* For similar reasons as before, we just store the index directly into the
-    * pointer, and let a later pass resolve the phi sources.
-    *
-    * In order to ensure that the copied sources (which are just the indices
-    * from the blob for now) don't get inserted into the old shader's use-def
-    * lists, we have to add the phi instruction *before* we set up its
-    * sources.
+   /* The sources are read by read_phi_srcs() at the end of the function
+    * impl, and since they won't go through nir_instr_insert's use/def
+    * handling, it doesn't matter that the phi gets inserted first.
     */
    nir_instr_insert_after_block(blk, &phi->instr);
 
-   for (unsigned i = 0; i < num_srcs; i++) {
-      nir_phi_src *src = ralloc(phi, nir_phi_src);
-
-      src->src.is_ssa = true;
-      src->src.ssa = (nir_ssa_def *) blob_read_intptr(ctx->blob);
-      src->pred = (nir_block *) blob_read_intptr(ctx->blob);
-
-      /* Since we're not letting nir_insert_instr handle use/def stuff for us,
-       * we have to set the parent_instr manually.  It doesn't really matter
-       * when we do it, so we might as well do it here.
-       */
-      src->src.parent_instr = &phi->instr;
-
-      /* Stash it in the list of phi sources.  We'll walk this list and fix up
-       * sources at the very end of read_function_impl.
-       */
-      list_add(&src->src.use_link, &ctx->phi_srcs);
-
-      exec_list_push_tail(&phi->srcs, &src->node);
-   }
-
    return phi;
 }
 
 static void
-read_fixup_phis(read_ctx *ctx)
+read_phi_srcs(read_ctx *ctx)
 {
-   list_for_each_entry_safe(nir_phi_src, src, &ctx->phi_srcs, src.use_link) {
-      src->pred = read_lookup_object(ctx, (uintptr_t)src->pred);
-      src->src.ssa = read_lookup_object(ctx, (uintptr_t)src->src.ssa);
+   util_dynarray_foreach(&ctx->phis, read_phi_fixup, fixup) {
+      nir_phi_instr *phi = fixup->phi;
 
-      /* Remove from this list */
-      list_del(&src->src.use_link);
+      for (unsigned i = 0; i < fixup->num_srcs; i++) {
+         nir_phi_src *src = ralloc(phi, nir_phi_src);
 
-      list_addtail(&src->src.use_link, &src->src.ssa->uses);
+         src->src.is_ssa = true;
+         src->src.ssa = read_object(ctx);
+         src->pred = read_object(ctx);
+         src->src.parent_instr = &phi->instr;
+         list_addtail(&src->src.use_link, &src->src.ssa->uses);
+
+         exec_list_push_tail(&phi->srcs, &src->node);
+      }
    }
-   assert(list_empty(&ctx->phi_srcs));
+
+   util_dynarray_clear(&ctx->phis);
 }
 
 static void
 write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
 {
-   blob_write_uint32(ctx->blob, jmp->type);
+   blob_write_varint(ctx->blob, jmp->type);
 }
 
 static nir_jump_instr *
 read_jump(read_ctx *ctx)
 {
-   nir_jump_type type = blob_read_uint32(ctx->blob);
+   nir_jump_type type = blob_read_varint(ctx->blob);
    nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, type);
    return jmp;
 }
@@ -773,7 +829,7 @@ read_jump(read_ctx *ctx)
 static void
 write_call(write_ctx *ctx, const nir_call_instr *call)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, call->callee));
+   write_object(ctx, call->callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       write_deref_chain(ctx, call->params[i]);
@@ -798,7 +854,7 @@ read_call(read_ctx *ctx)
 static void
 write_instr(write_ctx *ctx, const nir_instr *instr)
 {
-   blob_write_uint32(ctx->blob, instr->type);
+   blob_write_varint(ctx->blob, instr->type);
    switch (instr->type) {
    case nir_instr_type_alu:
       write_alu(ctx, nir_instr_as_alu(instr));
@@ -834,7 +890,7 @@ write_instr(write_ctx *ctx, const nir_instr *instr)
 static void
 read_instr(read_ctx *ctx, nir_block *block)
 {
-   nir_instr_type type = blob_read_uint32(ctx->blob);
+   nir_instr_type type = blob_read_varint(ctx->blob);
    nir_instr *instr;
    switch (type) {
    case nir_instr_type_alu:
@@ -879,7 +935,7 @@ static void
 write_block(write_ctx *ctx, const nir_block *block)
 {
    write_add_object(ctx, block);
-   blob_write_uint32(ctx->blob, exec_list_length(&block->instr_list));
+   blob_write_varint(ctx->blob, exec_list_length(&block->instr_list));
    nir_foreach_instr(instr, block)
       write_instr(ctx, instr);
 }
@@ -895,7 +951,7 @@ read_block(read_ctx *ctx, struct exec_list *cf_list)
       exec_node_data(nir_block, exec_list_get_tail(cf_list), cf_node.node);
 
    read_add_object(ctx, block);
-   unsigned num_instrs = blob_read_uint32(ctx->blob);
+   unsigned num_instrs = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_instrs; i++) {
       read_instr(ctx, block);
    }
@@ -948,7 +1004,7 @@ read_loop(read_ctx *ctx, struct exec_list *cf_list)
 static void
 write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 {
-   blob_write_uint32(ctx->blob, cf->type);
+   blob_write_varint(ctx->blob, cf->type);
 
    switch (cf->type) {
    case nir_cf_node_block:
@@ -968,7 +1024,7 @@ write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 static void
 read_cf_node(read_ctx *ctx, struct exec_list *list)
 {
-   nir_cf_node_type type = blob_read_uint32(ctx->blob);
+   nir_cf_node_type type = blob_read_varint(ctx->blob);
 
    switch (type) {
    case nir_cf_node_block:
@@ -988,7 +1044,7 @@ read_cf_node(read_ctx *ctx, struct exec_list *list)
 static void
 write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(cf_list));
+   blob_write_varint(ctx->blob, exec_list_length(cf_list));
    foreach_list_typed(nir_cf_node, cf, node, cf_list) {
       write_cf_node(ctx, cf);
    }
@@ -997,7 +1053,7 @@ write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 static void
 read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
 {
-   uint32_t num_cf_nodes = blob_read_uint32(ctx->blob);
+   uint32_t num_cf_nodes = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_cf_nodes; i++)
       read_cf_node(ctx, cf_list);
 }
@@ -1007,19 +1063,19 @@ write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
    write_var_list(ctx, &fi->locals);
    write_reg_list(ctx, &fi->registers);
-   blob_write_uint32(ctx->blob, fi->reg_alloc);
+   blob_write_varint(ctx->blob, fi->reg_alloc);
 
-   blob_write_uint32(ctx->blob, fi->num_params);
+   blob_write_varint(ctx->blob, fi->num_params);
    for (unsigned i = 0; i < fi->num_params; i++) {
       write_variable(ctx, fi->params[i]);
    }
 
-   blob_write_uint32(ctx->blob, !!(fi->return_var));
+   blob_write_varint(ctx->blob, !!(fi->return_var));
    if (fi->return_var)
       write_variable(ctx, fi->return_var);
 
    write_cf_list(ctx, &fi->body);
-   write_fixup_phis(ctx);
+   write_phi_srcs(ctx);
 }
 
 static nir_function_impl *
@@ -1030,23 +1086,25 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 
    read_var_list(ctx, &fi->locals);
    read_reg_list(ctx, &fi->registers);
-   fi->reg_alloc = blob_read_uint32(ctx->blob);
+   fi->reg_alloc = blob_read_varint(ctx->blob);
 
-   fi->num_params = blob_read_uint32(ctx->blob);
+   fi->num_params = blob_read_varint(ctx->blob);
+   fi->params = ralloc_array(fi, nir_variable *, fi->num_params);
    for (unsigned i = 0; i < fi->num_params; i++) {
       fi->params[i] = read_variable(ctx);
    }
 
-   bool has_return = blob_read_uint32(ctx->blob);
+   bool has_return = blob_read_varint(ctx->blob);
    if (has_return)
       fi->return_var = read_variable(ctx);
    else
       fi->return_var = NULL;
 
    read_cf_list(ctx, &fi->body);
-   read_fixup_phis(ctx);
+   read_phi_srcs(ctx);
 
    fi->valid_metadata = 0;
+   fi->cfg_metadata = 0;
 
    return fi;
 }
@@ -1054,19 +1112,19 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 static void
 write_function(write_ctx *ctx, const nir_function *fxn)
 {
-   blob_write_uint32(ctx->blob, !!(fxn->name));
+   blob_write_varint(ctx->blob, !!(fxn->name));
    if (fxn->name)
       blob_write_string(ctx->blob, fxn->name);
 
    write_add_object(ctx, fxn);
 
-   blob_write_uint32(ctx->blob, fxn->num_params);
+   blob_write_varint(ctx->blob, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      blob_write_uint32(ctx->blob, fxn->params[i].param_type);
-      encode_type_to_blob(ctx->blob, fxn->params[i].type);
+      blob_write_varint(ctx->blob, fxn->params[i].param_type);
+      write_type(ctx, fxn->params[i].type);
    }
 
-   encode_type_to_blob(ctx->blob, fxn->return_type);
+   write_type(ctx, fxn->return_type);
 
    /* At first glance, it looks like we should write the function_impl here.
     * However, call instructions need to be able to reference at least the
@@ -1078,20 +1136,72 @@ write_function(write_ctx *ctx, const nir_function *fxn)
 static void
 read_function(read_ctx *ctx)
 {
-   bool has_name = blob_read_uint32(ctx->blob);
+   bool has_name = blob_read_varint(ctx->blob);
    char *name = has_name ? blob_read_string(ctx->blob) : NULL;
 
    nir_function *fxn = nir_function_create(ctx->nir, name);
 
    read_add_object(ctx, fxn);
 
-   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->num_params = blob_read_varint(ctx->blob);
+   fxn->params = ralloc_array(fxn, nir_parameter, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      fxn->params[i].param_type = blob_read_uint32(ctx->blob);
-      fxn->params[i].type = decode_type_from_blob(ctx->blob);
+      fxn->params[i].param_type = blob_read_varint(ctx->blob);
+      fxn->params[i].type = read_type(ctx);
    }
 
-   fxn->return_type = decode_type_from_blob(ctx->blob);
+   fxn->return_type = read_type(ctx);
+}
+
+static void
+write_function_impls(write_ctx *ctx)
+{
+   nir_foreach_function(fxn, ctx->nir) {
+      /* Each impl is prefixed with its size, zero meaning that the function
+       * has no impl, so that readers can skip over it.
+       */
+      size_t size_offset = blob_reserve_uint32(ctx->blob);
+      if (!fxn->impl) {
+         blob_overwrite_uint32(ctx->blob, size_offset, 0);
+         continue;
+      }
+
+      /* Objects and types in the impl are numbered after the shader-level
+       * ones, but independently of the other impls.
+       */
+      uintptr_t first_idx = ctx->next_idx;
+      uintptr_t first_type_idx = ctx->next_type_idx;
+      size_t start = ctx->blob->size;
+
+      write_function_impl(ctx, fxn->impl);
+
+      blob_overwrite_uint32(ctx->blob, size_offset, ctx->blob->size - start);
+      ctx->next_idx = first_idx;
+      write_forget_types(ctx, first_type_idx);
+   }
+}
+
+static void
+read_function_impls(read_ctx *ctx, const char *name)
+{
+   nir_foreach_function(fxn, ctx->nir) {
+      uint32_t size = blob_read_uint32(ctx->blob);
+      if (size == 0)
+         continue;
+
+      if (name && (!fxn->name || strcmp(fxn->name, name) != 0)) {
+         blob_skip_bytes(ctx->blob, size);
+         continue;
+      }
+
+      uintptr_t first_idx = ctx->next_idx;
+      unsigned types_size = ctx->types.size;
+
+      fxn->impl = read_function_impl(ctx, fxn);
+
+      ctx->next_idx = first_idx;
+      util_dynarray_resize(&ctx->types, types_size);
+   }
 }
 
 void
@@ -1101,11 +1211,12 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    ctx.remap_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
                                              _mesa_key_pointer_equal);
    ctx.next_idx = 0;
+   ctx.type_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                            _mesa_key_pointer_equal);
+   ctx.next_type_idx = 0;
    ctx.blob = blob;
    ctx.nir = nir;
-   util_dynarray_init(&ctx.phi_fixups, NULL);
-
-   size_t idx_size_offset = blob_reserve_intptr(blob);
+   util_dynarray_init(&ctx.phis, NULL);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -1113,7 +1224,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       strings |= 0x1;
    if (info.label)
       strings |= 0x2;
-   blob_write_uint32(blob, strings);
+   blob_write_varint(blob, strings);
    if (info.name)
       blob_write_string(blob, info.name);
    if (info.label)
@@ -1129,40 +1240,37 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    write_var_list(&ctx, &nir->system_values);
 
    write_reg_list(&ctx, &nir->registers);
-   blob_write_uint32(blob, nir->reg_alloc);
-   blob_write_uint32(blob, nir->num_inputs);
-   blob_write_uint32(blob, nir->num_uniforms);
-   blob_write_uint32(blob, nir->num_outputs);
-   blob_write_uint32(blob, nir->num_shared);
+   blob_write_varint(blob, nir->reg_alloc);
+   blob_write_varint(blob, nir->num_inputs);
+   blob_write_varint(blob, nir->num_uniforms);
+   blob_write_varint(blob, nir->num_outputs);
+   blob_write_varint(blob, nir->num_shared);
 
-   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   blob_write_varint(blob, exec_list_length(&nir->functions));
    nir_foreach_function(fxn, nir) {
       write_function(&ctx, fxn);
    }
 
-   nir_foreach_function(fxn, nir) {
-      write_function_impl(&ctx, fxn->impl);
-   }
-
-   *(uintptr_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   write_function_impls(&ctx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
-   util_dynarray_fini(&ctx.phi_fixups);
+   _mesa_hash_table_destroy(ctx.type_table, NULL);
+   util_dynarray_fini(&ctx.phis);
 }
 
-nir_shader *
-nir_deserialize(void *mem_ctx,
-                const struct nir_shader_compiler_options *options,
-                struct blob_reader *blob)
+static nir_shader *
+deserialize(void *mem_ctx, const struct nir_shader_compiler_options *options,
+            struct blob_reader *blob, const char *function_name)
 {
    read_ctx ctx;
    ctx.blob = blob;
-   list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_intptr(blob);
-   ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+   ctx.idx_table_len = 0;
+   ctx.idx_table = NULL;
    ctx.next_idx = 0;
+   util_dynarray_init(&ctx.types, NULL);
+   util_dynarray_init(&ctx.phis, NULL);
 
-   uint32_t strings = blob_read_uint32(blob);
+   uint32_t strings = blob_read_varint(blob);
    char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
    char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
 
@@ -1184,24 +1292,43 @@ nir_deserialize(void *mem_ctx,
    read_var_list(&ctx, &ctx.nir->system_values);
 
    read_reg_list(&ctx, &ctx.nir->registers);
-   ctx.nir->reg_alloc = blob_read_uint32(blob);
-   ctx.nir->num_inputs = blob_read_uint32(blob);
-   ctx.nir->num_uniforms = blob_read_uint32(blob);
-   ctx.nir->num_outputs = blob_read_uint32(blob);
-   ctx.nir->num_shared = blob_read_uint32(blob);
+   ctx.nir->reg_alloc = blob_read_varint(blob);
+   ctx.nir->num_inputs = blob_read_varint(blob);
+   ctx.nir->num_uniforms = blob_read_varint(blob);
+   ctx.nir->num_outputs = blob_read_varint(blob);
+   ctx.nir->num_shared = blob_read_varint(blob);
 
-   unsigned num_functions = blob_read_uint32(blob);
+   unsigned num_functions = blob_read_varint(blob);
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
-   nir_foreach_function(fxn, ctx.nir)
-      fxn->impl = read_function_impl(&ctx, fxn);
+   read_function_impls(&ctx, function_name);
 
    free(ctx.idx_table);
+   util_dynarray_fini(&ctx.types);
+   util_dynarray_fini(&ctx.phis);
 
    return ctx.nir;
 }
 
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   return deserialize(mem_ctx, options, blob, NULL);
+}
+
+nir_shader *
+nir_deserialize_function(void *mem_ctx,
+                         const struct nir_shader_compiler_options *options,
+                         struct blob_reader *blob,
+                         const char *function_name)
+{
+   assert(function_name);
+   return deserialize(mem_ctx, options, blob, function_name);
+}
+
 nir_shader *
 nir_shader_serialize_deserialize(void *mem_ctx, nir_shader *s)
 {
@@ -36,6 +36,15 @@ nir_shader *nir_deserialize(void *mem_ctx,
                             const struct nir_shader_compiler_options *options,
                             struct blob_reader *blob);
 
+/* Like nir_deserialize(), but only reads the impl of the function called
+ * \p function_name.  The other functions are created without an impl and
+ * their serialized bodies are skipped without being decoded.
+ */
+nir_shader *nir_deserialize_function(void *mem_ctx,
+                                     const struct nir_shader_compiler_options *options,
+                                     struct blob_reader *blob,
+                                     const char *function_name);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
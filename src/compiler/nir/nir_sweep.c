@@ -131,8 +131,12 @@ sweep_impl(nir_shader *nir, nir_function_impl *impl)
 
    sweep_block(nir, impl->end_block);
 
-   /* Wipe out all the metadata, if any. */
+   /* Wipe out all the metadata, if any.  The dominance tree was allocated
+    * out of the shader and has just been freed, so it can't be reused even
+    * though the CFG didn't change.
+    */
    nir_metadata_preserve(impl, nir_metadata_none);
+   nir_metadata_cfg_changed(impl);
 }
 
 static void
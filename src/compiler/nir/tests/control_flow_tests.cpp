@@ -146,3 +146,60 @@ TEST_F(nir_cf_test, delete_break_in_loop)
 
    nir_metadata_require(b.impl, nir_metadata_dominance);
 }
+
+TEST_F(nir_cf_test, cfg_metadata_survives_instr_changes)
+{
+   nir_metadata_require(b.impl, nir_metadata_block_index);
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   /* Poison the block index so we can tell whether it gets recomputed. */
+   nir_block *start_block = nir_start_block(b.impl);
+   start_block->index = 42;
+
+   /* Adding instructions leaves the CFG alone, so even though the pass
+    * claims to preserve nothing the block index shouldn't be recomputed.
+    */
+   nir_ssa_def *one = nir_imm_int(&b, 1);
+   nir_iadd(&b, one, one);
+   nir_metadata_preserve(b.impl, nir_metadata_none);
+
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_block_index);
+   nir_metadata_require(b.impl, nir_metadata_block_index);
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   EXPECT_EQ(42u, start_block->index);
+
+   /* Inserting an if changes the CFG and must throw everything away. */
+   nir_if *nif = nir_push_if(&b, one);
+   nir_pop_if(&b, nif);
+
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_block_index);
+   EXPECT_FALSE(b.impl->valid_metadata & nir_metadata_dominance);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   EXPECT_EQ(0u, start_block->index);
+   EXPECT_EQ(4u, b.impl->num_blocks);
+   EXPECT_EQ(3u, nir_impl_last_block(b.impl)->index);
+   EXPECT_EQ(start_block, nir_impl_last_block(b.impl)->imm_dom);
+}
+
+TEST_F(nir_cf_test, cfg_metadata_dropped_by_sweep)
+{
+   nir_ssa_def *one = nir_imm_int(&b, 1);
+   nir_if *nif = nir_push_if(&b, one);
+   nir_pop_if(&b, nif);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   /* nir_sweep() frees whatever it doesn't know about, which includes the
+    * dominance tree, so it must not be reused afterwards.
+    */
+   nir_sweep(b.shader);
+   EXPECT_FALSE(b.impl->cfg_metadata & nir_metadata_dominance);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   nir_block *start_block = nir_start_block(b.impl);
+   ASSERT_EQ(3u, start_block->num_dom_children);
+   for (unsigned i = 0; i < start_block->num_dom_children; i++)
+      EXPECT_EQ(start_block, start_block->dom_children[i]->imm_dom);
+}
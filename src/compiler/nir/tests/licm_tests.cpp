@@ -0,0 +1,281 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+class nir_licm_test : public ::testing::Test {
+protected:
+   nir_licm_test();
+   ~nir_licm_test();
+
+   nir_ssa_def *load_uniform(unsigned base);
+   nir_ssa_def *load_ubo(unsigned offset);
+   nir_ssa_def *txf(nir_ssa_def *coord);
+   void store_output(unsigned base, nir_ssa_def *value);
+   void break_if(nir_ssa_def *cond);
+
+   nir_block *block_before(nir_cf_node *node);
+
+   nir_builder b;
+   nir_ssa_def *zero;
+   nir_ssa_def *cond;
+   nir_ssa_def *coord;
+};
+
+nir_licm_test::nir_licm_test()
+{
+   static const nir_shader_compiler_options options = { };
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   zero = nir_imm_int(&b, 0);
+   cond = nir_ine(&b, nir_channel(&b, load_uniform(0), 0), zero);
+   coord = nir_channels(&b, load_uniform(1), 0x3);
+}
+
+nir_licm_test::~nir_licm_test()
+{
+   ralloc_free(b.shader);
+}
+
+nir_ssa_def *
+nir_licm_test::load_uniform(unsigned base)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_uniform);
+   load->num_components = 4;
+   load->src[0] = nir_src_for_ssa(zero);
+   nir_intrinsic_set_base(load, base);
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+   return &load->dest.ssa;
+}
+
+nir_ssa_def *
+nir_licm_test::load_ubo(unsigned offset)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_ubo);
+   load->num_components = 4;
+   load->src[0] = nir_src_for_ssa(zero);
+   load->src[1] = nir_src_for_ssa(nir_imm_int(&b, offset));
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+   return &load->dest.ssa;
+}
+
+nir_ssa_def *
+nir_licm_test::txf(nir_ssa_def *coord)
+{
+   nir_tex_instr *tex = nir_tex_instr_create(b.shader, 2);
+   tex->op = nir_texop_txf;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->coord_components = 2;
+   tex->dest_type = nir_type_float;
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(coord);
+   tex->src[1].src_type = nir_tex_src_lod;
+   tex->src[1].src = nir_src_for_ssa(zero);
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &tex->instr);
+   return &tex->dest.ssa;
+}
+
+void
+nir_licm_test::store_output(unsigned base, nir_ssa_def *value)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_store_output);
+   store->num_components = value->num_components;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(zero);
+   nir_intrinsic_set_base(store, base);
+   nir_intrinsic_set_write_mask(store, (1 << value->num_components) - 1);
+   nir_builder_instr_insert(&b, &store->instr);
+}
+
+void
+nir_licm_test::break_if(nir_ssa_def *cond)
+{
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, nif);
+}
+
+nir_block *
+nir_licm_test::block_before(nir_cf_node *node)
+{
+   return nir_cf_node_as_block(nir_cf_node_prev(node));
+}
+
+TEST_F(nir_licm_test, alu_leaves_loop)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   nir_ssa_def *x = nir_fmul(&b, coord, coord);
+   store_output(0, x);
+   break_if(cond);
+   nir_pop_loop(&b, loop);
+
+   ASSERT_TRUE(nir_opt_licm(b.shader, false));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block_before(&loop->cf_node), x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, alu_leaves_if_in_loop)
+{
+   /* ALU instructions can't fault, so they're speculated */
+   nir_loop *loop = nir_push_loop(&b);
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_ssa_def *x = nir_fmul(&b, coord, coord);
+   store_output(0, x);
+   nir_pop_if(&b, nif);
+   break_if(cond);
+   nir_pop_loop(&b, loop);
+
+   ASSERT_TRUE(nir_opt_licm(b.shader, false));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block_before(&loop->cf_node), x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, ubo_load_leaves_loop)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   nir_ssa_def *x = load_ubo(16);
+   store_output(0, x);
+   break_if(cond);
+   nir_pop_loop(&b, loop);
+
+   ASSERT_TRUE(nir_opt_licm(b.shader, false));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block_before(&loop->cf_node), x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, ubo_load_stays_in_if)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_ssa_def *x = load_ubo(16);
+   store_output(0, x);
+   nir_block *then_block = nir_cursor_current_block(b.cursor);
+   nir_pop_if(&b, nif);
+   break_if(cond);
+   nir_pop_loop(&b, loop);
+
+   nir_opt_licm(b.shader, false);
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(then_block, x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, txf_stays_after_break)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   break_if(cond);
+   nir_ssa_def *x = txf(nir_f2i32(&b, coord));
+   nir_block *block = nir_cursor_current_block(b.cursor);
+   store_output(0, x);
+   nir_pop_loop(&b, loop);
+
+   nir_opt_licm(b.shader, false);
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block, x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, txf_stays_after_return)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_return);
+   nir_pop_if(&b, nif);
+   nir_ssa_def *x = txf(nir_f2i32(&b, coord));
+   nir_block *block = nir_cursor_current_block(b.cursor);
+   store_output(0, x);
+   nir_jump(&b, nir_jump_break);
+   nir_pop_loop(&b, loop);
+
+   nir_opt_licm(b.shader, false);
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block, x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, txf_leaves_loop)
+{
+   nir_loop *loop = nir_push_loop(&b);
+   nir_ssa_def *x = txf(nir_f2i32(&b, coord));
+   store_output(0, x);
+   break_if(cond);
+   nir_pop_loop(&b, loop);
+
+   ASSERT_TRUE(nir_opt_licm(b.shader, false));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(block_before(&loop->cf_node), x->parent_instr->block);
+}
+
+TEST_F(nir_licm_test, ubo_loads_merged_at_if)
+{
+   /* Both sides of the if load the same value, so one copy goes in front */
+   nir_if *nif = nir_push_if(&b, cond);
+   store_output(0, load_ubo(16));
+   nir_push_else(&b, nif);
+   store_output(1, load_ubo(16));
+   nir_pop_if(&b, nif);
+
+   ASSERT_TRUE(nir_opt_licm(b.shader, true));
+   nir_validate_shader(b.shader);
+
+   unsigned count = 0;
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_intrinsic &&
+             nir_instr_as_intrinsic(instr)->intrinsic ==
+             nir_intrinsic_load_ubo) {
+            EXPECT_EQ(block_before(&nif->cf_node), block);
+            count++;
+         }
+      }
+   }
+   EXPECT_EQ(1u, count);
+}
+
+TEST_F(nir_licm_test, ubo_loads_not_merged_when_partial)
+{
+   /* Neither copy runs when both conditions are false, so merging them in
+    * front of the first if would speculate the load.
+    */
+   nir_ssa_def *cond2 = nir_ine(&b, nir_channel(&b, load_uniform(2), 0), zero);
+
+   nir_if *nif = nir_push_if(&b, cond);
+   nir_ssa_def *x = load_ubo(16);
+   store_output(0, x);
+   nir_block *then_block = nir_cursor_current_block(b.cursor);
+   nir_pop_if(&b, nif);
+
+   nif = nir_push_if(&b, cond2);
+   nir_ssa_def *y = load_ubo(16);
+   store_output(1, y);
+   nir_block *then_block2 = nir_cursor_current_block(b.cursor);
+   nir_pop_if(&b, nif);
+
+   nir_opt_licm(b.shader, true);
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(then_block, x->parent_instr->block);
+   EXPECT_EQ(then_block2, y->parent_instr->block);
+}
@@ -0,0 +1,612 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+class nir_serialize_test : public ::testing::Test {
+protected:
+   nir_serialize_test();
+   ~nir_serialize_test();
+
+   void build_body(nir_builder *b, unsigned num_alu);
+   nir_shader *round_trip(struct blob *blob, const char *function_name);
+   nir_shader *check_round_trip();
+
+   nir_ssa_def *load_uniform(unsigned base);
+   void store_output(unsigned base, nir_ssa_def *value);
+
+   nir_builder b;
+};
+
+static const nir_shader_compiler_options options = { };
+
+nir_serialize_test::nir_serialize_test()
+{
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+}
+
+nir_serialize_test::~nir_serialize_test()
+{
+   ralloc_free(b.shader);
+}
+
+/* Emits a loop containing an if and a chain of \p num_alu additions, with
+ * the values carried around in local variables so that lowering them to SSA
+ * gives us phis.
+ */
+void
+nir_serialize_test::build_body(nir_builder *b, unsigned num_alu)
+{
+   nir_variable *v = nir_local_variable_create(b->impl, glsl_int_type(), "v");
+   nir_store_var(b, v, nir_imm_int(b, 0), 1);
+
+   nir_loop *loop = nir_push_loop(b);
+   {
+      nir_ssa_def *x = nir_load_var(b, v);
+
+      nir_if *nif = nir_push_if(b, nir_ilt(b, nir_imm_int(b, 100), x));
+      nir_jump(b, nir_jump_break);
+      nir_pop_if(b, nif);
+
+      for (unsigned i = 0; i < num_alu; i++)
+         x = nir_iadd(b, x, nir_imm_int(b, i));
+      nir_store_var(b, v, nir_ineg(b, x), 1);
+   }
+   nir_pop_loop(b, loop);
+}
+
+nir_shader *
+nir_serialize_test::round_trip(struct blob *blob, const char *function_name)
+{
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob->data, blob->size);
+
+   nir_shader *shader = function_name ?
+      nir_deserialize_function(b.shader, &options, &reader, function_name) :
+      nir_deserialize(b.shader, &options, &reader);
+
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.end, reader.current);
+   nir_validate_shader(shader);
+
+   return shader;
+}
+
+static char *
+print_shader(nir_shader *shader)
+{
+   /* The reader numbers SSA values densely, do the same here */
+   nir_foreach_function(func, shader) {
+      if (func->impl)
+         nir_index_ssa_defs(func->impl);
+   }
+
+   char *str = NULL;
+   size_t size = 0;
+   FILE *f = open_memstream(&str, &size);
+   nir_print_shader(shader, f);
+   fclose(f);
+   return str;
+}
+
+/* Serializes the shader being built, reads it back and checks that the copy
+ * prints the same and serializes to the same bytes.
+ */
+nir_shader *
+nir_serialize_test::check_round_trip()
+{
+   nir_validate_shader(b.shader);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b.shader);
+
+   nir_shader *shader = round_trip(&blob, NULL);
+
+   char *expected = print_shader(b.shader);
+   char *actual = print_shader(shader);
+   EXPECT_STREQ(expected, actual);
+   free(expected);
+   free(actual);
+
+   struct blob copy;
+   blob_init(&copy);
+   nir_serialize(&copy, shader);
+   EXPECT_EQ(blob.size, copy.size);
+   EXPECT_TRUE(blob.size == copy.size &&
+               memcmp(blob.data, copy.data, blob.size) == 0);
+
+   blob_finish(&copy);
+   blob_finish(&blob);
+
+   return shader;
+}
+
+nir_ssa_def *
+nir_serialize_test::load_uniform(unsigned base)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_uniform);
+   load->num_components = 4;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(&b, 0));
+   nir_intrinsic_set_base(load, base);
+   nir_intrinsic_set_range(load, 16);
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+   return &load->dest.ssa;
+}
+
+void
+nir_serialize_test::store_output(unsigned base, nir_ssa_def *value)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_store_output);
+   store->num_components = value->num_components;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(nir_imm_int(&b, 0));
+   nir_intrinsic_set_base(store, base);
+   nir_intrinsic_set_component(store, 4 - value->num_components);
+   nir_intrinsic_set_write_mask(store, (1 << value->num_components) - 1);
+   nir_builder_instr_insert(&b, &store->instr);
+}
+
+static unsigned
+count_instrs(nir_function_impl *impl)
+{
+   unsigned count = 0;
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         count++;
+   }
+   return count;
+}
+
+static nir_function *
+find_function(nir_shader *shader, const char *name)
+{
+   nir_foreach_function(func, shader) {
+      if (strcmp(func->name, name) == 0)
+         return func;
+   }
+   return NULL;
+}
+
+TEST_F(nir_serialize_test, round_trip)
+{
+   build_body(&b, 10);
+   nir_lower_vars_to_ssa(b.shader);
+   nir_validate_shader(b.shader);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b.shader);
+
+   nir_shader *shader = round_trip(&blob, NULL);
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   EXPECT_EQ(count_instrs(b.impl), count_instrs(impl));
+
+   /* Serializing the copy has to give us the exact same bytes. */
+   struct blob copy;
+   blob_init(&copy);
+   nir_serialize(&copy, shader);
+   ASSERT_EQ(blob.size, copy.size);
+   EXPECT_EQ(0, memcmp(blob.data, copy.data, blob.size));
+
+   blob_finish(&copy);
+   blob_finish(&blob);
+}
+
+TEST_F(nir_serialize_test, compact)
+{
+   build_body(&b, 0);
+   nir_lower_vars_to_ssa(b.shader);
+
+   struct blob small;
+   blob_init(&small);
+   nir_serialize(&small, b.shader);
+
+   ralloc_free(b.shader);
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   build_body(&b, 100);
+   nir_lower_vars_to_ssa(b.shader);
+
+   struct blob big;
+   blob_init(&big);
+   nir_serialize(&big, b.shader);
+
+   /* Each iteration is a load_const and an iadd whose sources are close
+    * by, which should only take a handful of bytes each.
+    */
+   EXPECT_LE(big.size - small.size, 100u * 16);
+
+   blob_finish(&big);
+   blob_finish(&small);
+}
+
+TEST_F(nir_serialize_test, lazy_function)
+{
+   build_body(&b, 10);
+
+   nir_function *helper = nir_function_create(b.shader, "helper");
+   nir_builder hb;
+   nir_builder_init(&hb, nir_function_impl_create(helper));
+   hb.cursor = nir_after_cf_list(&hb.impl->body);
+   build_body(&hb, 20);
+
+   nir_function_create(b.shader, "decl");
+
+   nir_lower_vars_to_ssa(b.shader);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b.shader);
+
+   nir_shader *shader = round_trip(&blob, "helper");
+   EXPECT_TRUE(find_function(shader, "main")->impl == NULL);
+   EXPECT_TRUE(find_function(shader, "decl")->impl == NULL);
+   ASSERT_TRUE(find_function(shader, "helper")->impl != NULL);
+   EXPECT_EQ(count_instrs(helper->impl),
+             count_instrs(find_function(shader, "helper")->impl));
+
+   /* And the other way around. */
+   shader = round_trip(&blob, "main");
+   EXPECT_TRUE(find_function(shader, "helper")->impl == NULL);
+   ASSERT_TRUE(find_function(shader, "main")->impl != NULL);
+   EXPECT_EQ(count_instrs(b.impl),
+             count_instrs(find_function(shader, "main")->impl));
+
+   blob_finish(&blob);
+}
+
+TEST_F(nir_serialize_test, intrinsics)
+{
+   nir_ssa_def *x = load_uniform(3);
+   store_output(1, x);
+   store_output(2, nir_channels(&b, x, 0x3));
+
+   nir_intrinsic_instr *discard =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_discard_if);
+   discard->src[0] = nir_src_for_ssa(nir_ine(&b, nir_channel(&b, x, 0),
+                                             nir_imm_int(&b, 0)));
+   nir_builder_instr_insert(&b, &discard->instr);
+
+   nir_intrinsic_instr *barrier =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_barrier);
+   nir_builder_instr_insert(&b, &barrier->instr);
+
+   nir_shader *shader = check_round_trip();
+
+   nir_foreach_block(block, nir_shader_get_entrypoint(shader)) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_intrinsic)
+            continue;
+
+         nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+         if (intrin->intrinsic == nir_intrinsic_load_uniform) {
+            EXPECT_EQ(3, nir_intrinsic_base(intrin));
+            EXPECT_EQ(16u, nir_intrinsic_range(intrin));
+         } else if (intrin->intrinsic == nir_intrinsic_store_output &&
+                    intrin->num_components == 2) {
+            EXPECT_EQ(2, nir_intrinsic_base(intrin));
+            EXPECT_EQ(2u, nir_intrinsic_component(intrin));
+            EXPECT_EQ(0x3u, nir_intrinsic_write_mask(intrin));
+         }
+      }
+   }
+}
+
+TEST_F(nir_serialize_test, tex)
+{
+   nir_variable *sampler =
+      nir_variable_create(b.shader, nir_var_uniform,
+                          glsl_sampler_type(GLSL_SAMPLER_DIM_2D, false, false,
+                                            GLSL_TYPE_FLOAT), "s");
+   nir_ssa_def *x = load_uniform(0);
+
+   nir_tex_instr *txl = nir_tex_instr_create(b.shader, 3);
+   txl->op = nir_texop_txl;
+   txl->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   txl->coord_components = 2;
+   txl->dest_type = nir_type_float;
+   txl->texture = nir_deref_var_create(txl, sampler);
+   txl->sampler = nir_deref_var_create(txl, sampler);
+   txl->src[0].src_type = nir_tex_src_coord;
+   txl->src[0].src = nir_src_for_ssa(nir_channels(&b, x, 0x3));
+   txl->src[1].src_type = nir_tex_src_lod;
+   txl->src[1].src = nir_src_for_ssa(nir_channel(&b, x, 2));
+   txl->src[2].src_type = nir_tex_src_offset;
+   txl->src[2].src = nir_src_for_ssa(nir_vec2(&b, nir_imm_int(&b, 1),
+                                                nir_imm_int(&b, -1)));
+   nir_ssa_dest_init(&txl->instr, &txl->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &txl->instr);
+   store_output(0, &txl->dest.ssa);
+
+   nir_tex_instr *txf = nir_tex_instr_create(b.shader, 2);
+   txf->op = nir_texop_txf;
+   txf->sampler_dim = GLSL_SAMPLER_DIM_BUF;
+   txf->coord_components = 1;
+   txf->dest_type = nir_type_int;
+   txf->texture_index = 5;
+   txf->texture_array_size = 8;
+   txf->src[0].src_type = nir_tex_src_coord;
+   txf->src[0].src = nir_src_for_ssa(nir_f2i32(&b, nir_channel(&b, x, 3)));
+   txf->src[1].src_type = nir_tex_src_texture_offset;
+   txf->src[1].src = nir_src_for_ssa(nir_imm_int(&b, 2));
+   nir_ssa_dest_init(&txf->instr, &txf->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &txf->instr);
+   store_output(1, &txf->dest.ssa);
+
+   nir_shader *shader = check_round_trip();
+
+   unsigned num_tex = 0;
+   nir_foreach_block(block, nir_shader_get_entrypoint(shader)) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_tex)
+            continue;
+
+         nir_tex_instr *tex = nir_instr_as_tex(instr);
+         if (tex->op == nir_texop_txl) {
+            ASSERT_TRUE(tex->texture != NULL && tex->sampler != NULL);
+            EXPECT_EQ(exec_list_get_head(&shader->uniforms),
+                      &tex->texture->var->node);
+            EXPECT_EQ(tex->texture->var, tex->sampler->var);
+            EXPECT_EQ(3u, tex->num_srcs);
+         } else {
+            EXPECT_EQ(nir_texop_txf, tex->op);
+            EXPECT_TRUE(tex->texture == NULL && tex->sampler == NULL);
+            EXPECT_EQ(5u, tex->texture_index);
+            EXPECT_EQ(8u, tex->texture_array_size);
+            EXPECT_EQ(nir_type_int, tex->dest_type);
+         }
+         num_tex++;
+      }
+   }
+   EXPECT_EQ(2u, num_tex);
+}
+
+TEST_F(nir_serialize_test, registers)
+{
+   build_body(&b, 3);
+   nir_lower_vars_to_ssa(b.shader);
+   nir_convert_from_ssa(b.shader, false);
+
+   /* An array register written and read indirectly */
+   nir_register *reg = nir_local_reg_create(b.impl);
+   reg->num_components = 4;
+   reg->num_array_elems = 4;
+   reg->name = ralloc_strdup(reg, "arr");
+
+   nir_register *global = nir_global_reg_create(b.shader);
+   global->num_components = 1;
+
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *index = nir_channel(&b, x, 0);
+
+   nir_alu_instr *mov = nir_alu_instr_create(b.shader, nir_op_imov);
+   mov->src[0].src = nir_src_for_ssa(x);
+   mov->dest.dest = nir_dest_for_reg(reg);
+   mov->dest.dest.reg.base_offset = 1;
+   mov->dest.dest.reg.indirect = ralloc(mov, nir_src);
+   *mov->dest.dest.reg.indirect = nir_src_for_ssa(index);
+   mov->dest.write_mask = 0xf;
+   nir_builder_instr_insert(&b, &mov->instr);
+
+   mov = nir_alu_instr_create(b.shader, nir_op_imov);
+   mov->src[0].src = nir_src_for_reg(reg);
+   mov->src[0].src.reg.base_offset = 2;
+   mov->src[0].src.reg.indirect = ralloc(mov, nir_src);
+   *mov->src[0].src.reg.indirect = nir_src_for_ssa(index);
+   mov->src[0].swizzle[0] = 3;
+   mov->dest.dest = nir_dest_for_reg(global);
+   mov->dest.write_mask = 0x1;
+   nir_builder_instr_insert(&b, &mov->instr);
+
+   nir_shader *shader = check_round_trip();
+
+   EXPECT_EQ(exec_list_length(&b.impl->registers),
+             exec_list_length(&nir_shader_get_entrypoint(shader)->registers));
+   ASSERT_EQ(1u, exec_list_length(&shader->registers));
+   nir_register *copy = exec_node_data(nir_register,
+                                       exec_list_get_head(&shader->registers),
+                                       node);
+   EXPECT_TRUE(copy->is_global);
+   EXPECT_EQ(1u, list_length(&copy->defs));
+}
+
+TEST_F(nir_serialize_test, derefs)
+{
+   const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_float_type(), "f"),
+      glsl_struct_field(glsl_array_type(glsl_vec4_type(), 3), "a"),
+   };
+   const struct glsl_type *s_type = glsl_struct_type(fields, 2, "S");
+   nir_variable *var =
+      nir_local_variable_create(b.impl, glsl_array_type(s_type, 2), "v");
+
+   nir_ssa_def *x = load_uniform(0);
+
+   /* v[1].a[index + 2] = x */
+   nir_deref_var *deref = nir_deref_var_create(b.shader, var);
+   nir_deref_array *outer = nir_deref_array_create(deref);
+   outer->deref_array_type = nir_deref_array_type_direct;
+   outer->base_offset = 1;
+   outer->deref.type = s_type;
+   deref->deref.child = &outer->deref;
+   nir_deref_struct *field = nir_deref_struct_create(outer, 1);
+   field->deref.type = fields[1].type;
+   outer->deref.child = &field->deref;
+   nir_deref_array *inner = nir_deref_array_create(field);
+   inner->deref_array_type = nir_deref_array_type_indirect;
+   inner->base_offset = 2;
+   inner->indirect = nir_src_for_ssa(nir_channel(&b, nir_f2i32(&b, x), 0));
+   inner->deref.type = glsl_vec4_type();
+   field->deref.child = &inner->deref;
+
+   nir_store_deref_var(&b, deref, x, 0xf);
+   store_output(0, nir_load_deref_var(&b, deref));
+
+   check_round_trip();
+}
+
+TEST_F(nir_serialize_test, constant_initializer)
+{
+   nir_variable *var =
+      nir_local_variable_create(b.impl, glsl_array_type(glsl_vec4_type(), 2),
+                                "table");
+
+   nir_constant *c = rzalloc(var, nir_constant);
+   c->num_elements = 2;
+   c->elements = ralloc_array(var, nir_constant *, 2);
+   for (unsigned i = 0; i < 2; i++) {
+      c->elements[i] = rzalloc(var, nir_constant);
+      for (unsigned j = 0; j < 4; j++)
+         c->elements[i]->values[0].f32[j] = i * 4 + j + 0.5f;
+   }
+   var->constant_initializer = c;
+
+   nir_deref_var *deref = nir_deref_var_create(b.shader, var);
+   nir_deref_array *element = nir_deref_array_create(deref);
+   element->deref_array_type = nir_deref_array_type_direct;
+   element->base_offset = 1;
+   element->deref.type = glsl_vec4_type();
+   deref->deref.child = &element->deref;
+   store_output(0, nir_load_deref_var(&b, deref));
+
+   nir_shader *shader = check_round_trip();
+
+   nir_variable *copy =
+      exec_node_data(nir_variable,
+                     exec_list_get_head(&nir_shader_get_entrypoint(shader)->locals),
+                     node);
+   ASSERT_TRUE(copy->constant_initializer != NULL);
+   ASSERT_EQ(2u, copy->constant_initializer->num_elements);
+   for (unsigned i = 0; i < 2; i++) {
+      for (unsigned j = 0; j < 4; j++) {
+         EXPECT_EQ(i * 4 + j + 0.5f,
+                   copy->constant_initializer->elements[i]->values[0].f32[j]);
+      }
+   }
+}
+
+TEST_F(nir_serialize_test, calls)
+{
+   nir_function *helper = nir_function_create(b.shader, "helper");
+   helper->num_params = 2;
+   helper->params = ralloc_array(helper, nir_parameter, 2);
+   helper->params[0].param_type = nir_parameter_in;
+   helper->params[0].type = glsl_vec4_type();
+   helper->params[1].param_type = nir_parameter_out;
+   helper->params[1].type = glsl_float_type();
+   helper->return_type = glsl_float_type();
+
+   nir_builder hb;
+   nir_builder_init(&hb, nir_function_impl_create(helper));
+   hb.cursor = nir_after_cf_list(&hb.impl->body);
+   nir_ssa_def *v = nir_load_var(&hb, hb.impl->params[0]);
+   nir_store_var(&hb, hb.impl->params[1], nir_channel(&hb, v, 1), 0x1);
+   nir_store_var(&hb, hb.impl->return_var, nir_channel(&hb, v, 0), 0x1);
+
+   nir_variable *in =
+      nir_local_variable_create(b.impl, glsl_vec4_type(), "in");
+   nir_variable *out =
+      nir_local_variable_create(b.impl, glsl_float_type(), "out");
+   nir_variable *ret =
+      nir_local_variable_create(b.impl, glsl_float_type(), "ret");
+   nir_store_var(&b, in, load_uniform(0), 0xf);
+
+   nir_call_instr *call = nir_call_instr_create(b.shader, helper);
+   call->params[0] = nir_deref_var_create(call, in);
+   call->params[1] = nir_deref_var_create(call, out);
+   call->return_deref = nir_deref_var_create(call, ret);
+   nir_builder_instr_insert(&b, &call->instr);
+
+   store_output(0, nir_vec2(&b, nir_load_var(&b, out), nir_load_var(&b, ret)));
+
+   nir_shader *shader = check_round_trip();
+
+   nir_function *helper_copy = find_function(shader, "helper");
+   ASSERT_TRUE(helper_copy != NULL && helper_copy->impl != NULL);
+   EXPECT_EQ(2u, helper_copy->num_params);
+   EXPECT_EQ(nir_parameter_out, helper_copy->params[1].param_type);
+   EXPECT_TRUE(helper_copy->impl->return_var != NULL);
+
+   nir_foreach_block(block, find_function(shader, "main")->impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_call)
+            continue;
+
+         nir_call_instr *call_copy = nir_instr_as_call(instr);
+         EXPECT_EQ(helper_copy, call_copy->callee);
+         EXPECT_STREQ("out", call_copy->params[1]->var->name);
+         EXPECT_STREQ("ret", call_copy->return_deref->var->name);
+      }
+   }
+}
+
+TEST_F(nir_serialize_test, size)
+{
+   /* Something resembling a real fragment shader: a few uniforms, a texture
+    * lookup and a loop with a bit of arithmetic.
+    */
+   nir_variable *sampler =
+      nir_variable_create(b.shader, nir_var_uniform,
+                          glsl_sampler_type(GLSL_SAMPLER_DIM_2D, false, false,
+                                            GLSL_TYPE_FLOAT), "s");
+   nir_variable_create(b.shader, nir_var_uniform, glsl_vec4_type(), "u0");
+   nir_variable_create(b.shader, nir_var_uniform, glsl_vec4_type(), "u1");
+   nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                       "color");
+
+   build_body(&b, 20);
+
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *y = load_uniform(1);
+   nir_tex_instr *tex = nir_tex_instr_create(b.shader, 1);
+   tex->op = nir_texop_tex;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->coord_components = 2;
+   tex->dest_type = nir_type_float;
+   tex->texture = nir_deref_var_create(tex, sampler);
+   tex->sampler = nir_deref_var_create(tex, sampler);
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(nir_channels(&b, x, 0x3));
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &tex->instr);
+   store_output(0, nir_ffma(&b, &tex->dest.ssa, y, x));
+
+   nir_lower_vars_to_ssa(b.shader);
+   check_round_trip();
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b.shader);
+
+   /* That's 58 instructions, which took 3156 bytes with fixed-size fields
+    * and take 936 now.  Leave a little slack for format changes.
+    */
+   EXPECT_LE(blob.size, 1024u);
+
+   blob_finish(&blob);
+}
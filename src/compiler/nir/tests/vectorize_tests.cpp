@@ -0,0 +1,257 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+class nir_vectorize_test : public ::testing::Test {
+protected:
+   nir_vectorize_test();
+   ~nir_vectorize_test();
+
+   nir_ssa_def *load_input(unsigned base, unsigned component,
+                           unsigned num_components);
+   nir_ssa_def *load_uniform(unsigned base);
+   void store_output(unsigned base, nir_ssa_def *value);
+   unsigned count_alu(nir_op op);
+   unsigned count_intrinsics(nir_intrinsic_op op);
+
+   nir_builder b;
+   nir_ssa_def *zero;
+};
+
+nir_vectorize_test::nir_vectorize_test()
+{
+   static const nir_shader_compiler_options options = { };
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   zero = nir_imm_int(&b, 0);
+}
+
+nir_vectorize_test::~nir_vectorize_test()
+{
+   ralloc_free(b.shader);
+}
+
+nir_ssa_def *
+nir_vectorize_test::load_input(unsigned base, unsigned component,
+                               unsigned num_components)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_input);
+   load->num_components = num_components;
+   load->src[0] = nir_src_for_ssa(zero);
+   nir_intrinsic_set_base(load, base);
+   nir_intrinsic_set_component(load, component);
+   nir_ssa_dest_init(&load->instr, &load->dest, num_components, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+   return &load->dest.ssa;
+}
+
+nir_ssa_def *
+nir_vectorize_test::load_uniform(unsigned base)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_uniform);
+   load->num_components = 4;
+   load->src[0] = nir_src_for_ssa(zero);
+   nir_intrinsic_set_base(load, base);
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+   return &load->dest.ssa;
+}
+
+void
+nir_vectorize_test::store_output(unsigned base, nir_ssa_def *value)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_store_output);
+   store->num_components = value->num_components;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(zero);
+   nir_intrinsic_set_base(store, base);
+   nir_intrinsic_set_write_mask(store, (1 << value->num_components) - 1);
+   nir_builder_instr_insert(&b, &store->instr);
+}
+
+unsigned
+nir_vectorize_test::count_alu(nir_op op)
+{
+   unsigned count = 0;
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_alu &&
+             nir_instr_as_alu(instr)->op == op)
+            count++;
+      }
+   }
+   return count;
+}
+
+unsigned
+nir_vectorize_test::count_intrinsics(nir_intrinsic_op op)
+{
+   unsigned count = 0;
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_intrinsic &&
+             nir_instr_as_intrinsic(instr)->intrinsic == op)
+            count++;
+      }
+   }
+   return count;
+}
+
+TEST_F(nir_vectorize_test, same_sources)
+{
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *y = load_uniform(1);
+   nir_ssa_def *chan[4];
+
+   for (unsigned i = 0; i < 4; i++)
+      chan[i] = nir_fadd(&b, nir_channel(&b, x, i), nir_channel(&b, y, 3 - i));
+   store_output(0, nir_vec(&b, chan, 4));
+
+   nir_lower_alu_to_scalar(b.shader);
+   nir_copy_prop(b.shader);
+   nir_opt_dce(b.shader);
+   ASSERT_EQ(4, count_alu(nir_op_fadd));
+
+   ASSERT_TRUE(nir_opt_vectorize(b.shader));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(1, count_alu(nir_op_fadd));
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu ||
+             nir_instr_as_alu(instr)->op != nir_op_fadd)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         EXPECT_EQ(4, alu->dest.dest.ssa.num_components);
+         for (unsigned i = 0; i < 4; i++) {
+            EXPECT_EQ(i, alu->src[0].swizzle[i]);
+            EXPECT_EQ(3 - i, alu->src[1].swizzle[i]);
+         }
+      }
+   }
+
+   EXPECT_FALSE(nir_opt_vectorize(b.shader));
+}
+
+TEST_F(nir_vectorize_test, constants)
+{
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *a = nir_fmul(&b, nir_channel(&b, x, 0), nir_imm_float(&b, 2.0));
+   nir_ssa_def *c = nir_fmul(&b, nir_channel(&b, x, 1), nir_imm_float(&b, 3.0));
+   store_output(0, nir_vec2(&b, a, c));
+
+   nir_copy_prop(b.shader);
+   ASSERT_TRUE(nir_opt_vectorize(b.shader));
+   nir_validate_shader(b.shader);
+   nir_opt_dce(b.shader);
+   EXPECT_EQ(1, count_alu(nir_op_fmul));
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu ||
+             nir_instr_as_alu(instr)->op != nir_op_fmul)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         nir_load_const_instr *load =
+            nir_instr_as_load_const(alu->src[1].src.ssa->parent_instr);
+         EXPECT_EQ(2.0, load->value.f32[alu->src[1].swizzle[0]]);
+         EXPECT_EQ(3.0, load->value.f32[alu->src[1].swizzle[1]]);
+      }
+   }
+}
+
+TEST_F(nir_vectorize_test, different_sources)
+{
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *y = load_uniform(1);
+   nir_ssa_def *a = nir_fadd(&b, nir_channel(&b, x, 0), nir_channel(&b, y, 0));
+   nir_ssa_def *c = nir_fadd(&b, nir_channel(&b, y, 1), nir_channel(&b, y, 0));
+   nir_ssa_def *d = nir_fadd(&b, nir_fabs(&b, nir_channel(&b, x, 1)),
+                                 nir_channel(&b, y, 1));
+   nir_ssa_def *e = nir_fmax(&b, nir_channel(&b, x, 1), nir_channel(&b, y, 1));
+   store_output(0, nir_vec4(&b, a, c, d, e));
+
+   nir_lower_alu_to_scalar(b.shader);
+   nir_copy_prop(b.shader);
+   nir_opt_dce(b.shader);
+
+   EXPECT_FALSE(nir_opt_vectorize(b.shader));
+}
+
+TEST_F(nir_vectorize_test, inputs)
+{
+   nir_ssa_def *w = load_input(0, 3, 1);
+   nir_ssa_def *xy = load_input(0, 0, 2);
+   nir_ssa_def *z = load_input(0, 2, 1);
+   nir_ssa_def *other = load_input(1, 1, 1);
+   store_output(0, nir_vec4(&b, nir_channel(&b, xy, 1), z, w,
+                            nir_channel(&b, xy, 0)));
+   store_output(1, other);
+
+   ASSERT_TRUE(nir_opt_vectorize(b.shader));
+   nir_validate_shader(b.shader);
+   nir_copy_prop(b.shader);
+   EXPECT_EQ(2, count_intrinsics(nir_intrinsic_load_input));
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu ||
+             nir_instr_as_alu(instr)->op != nir_op_vec4)
+            continue;
+
+         /* All four channels come from one load, in the same order. */
+         nir_alu_instr *vec = nir_instr_as_alu(instr);
+         nir_intrinsic_instr *load =
+            nir_instr_as_intrinsic(vec->src[0].src.ssa->parent_instr);
+         EXPECT_EQ(4, load->num_components);
+         EXPECT_EQ(0, nir_intrinsic_component(load));
+         for (unsigned i = 0; i < 4; i++) {
+            EXPECT_EQ(&load->dest.ssa, vec->src[i].src.ssa);
+            EXPECT_EQ((i + 1) % 4, vec->src[i].swizzle[0]);
+         }
+      }
+   }
+}
+
+TEST_F(nir_vectorize_test, across_blocks)
+{
+   nir_ssa_def *x = load_uniform(0);
+   nir_ssa_def *a = nir_fsqrt(&b, nir_channel(&b, x, 0));
+
+   nir_if *nif = nir_push_if(&b, nir_flt(&b, a, nir_imm_float(&b, 1.0)));
+   nir_ssa_def *c = nir_fsqrt(&b, nir_channel(&b, x, 1));
+   nir_pop_if(&b, nif);
+
+   store_output(0, nir_vec2(&b, a, nir_if_phi(&b, c, a)));
+
+   nir_copy_prop(b.shader);
+   ASSERT_TRUE(nir_opt_vectorize(b.shader));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(1, count_alu(nir_op_fsqrt));
+}
@@ -1027,6 +1027,25 @@ draw_set_mapped_texture(struct draw_context *draw,
 #endif
 }
 
+/**
+ * For multisample textures, set the number of samples and the stride in
+ * bytes between them after draw_set_mapped_texture().  Other textures are
+ * treated as having a single sample.
+ */
+void
+draw_set_mapped_texture_samples(struct draw_context *draw,
+                                enum pipe_shader_type shader_stage,
+                                unsigned sview_idx,
+                                uint32_t num_samples,
+                                uint32_t sample_stride)
+{
+#ifdef HAVE_LLVM
+   if (draw->llvm)
+      draw_llvm_set_mapped_texture_samples(draw, shader_stage, sview_idx,
+                                           num_samples, sample_stride);
+#endif
+}
+
 /**
  * XXX: Results for PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS because there are two
  * different ways of setting textures, and drivers typically only support one.
@@ -187,6 +187,13 @@ draw_set_mapped_texture(struct draw_context *draw,
                         uint32_t img_stride[PIPE_MAX_TEXTURE_LEVELS],
                         uint32_t mip_offsets[PIPE_MAX_TEXTURE_LEVELS]);
 
+void
+draw_set_mapped_texture_samples(struct draw_context *draw,
+                                enum pipe_shader_type shader_stage,
+                                unsigned sview_idx,
+                                uint32_t num_samples,
+                                uint32_t sample_stride);
+
 
 /*
  * Vertex shader functions
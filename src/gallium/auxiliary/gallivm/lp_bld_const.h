@@ -134,13 +134,20 @@ lp_build_const_float(struct gallivm_state *gallivm, float x)
 }
 
 
-/** Return constant-valued pointer to int */
+/**
+ * Return constant-valued pointer to int.
+ * The address is only meaningful in this process, so code using it must not
+ * be put in the shader cache.
+ */
 static inline LLVMValueRef
 lp_build_const_int_pointer(struct gallivm_state *gallivm, const void *ptr)
 {
    LLVMTypeRef int_type;
    LLVMValueRef v;
 
+   if (gallivm->cache)
+      gallivm->cache->dont_cache = TRUE;
+
    /* int type large enough to hold a pointer */
    int_type = LLVMIntTypeInContext(gallivm->context, 8 * sizeof(void *));
    v = LLVMConstInt(int_type, (uintptr_t) ptr, 0);
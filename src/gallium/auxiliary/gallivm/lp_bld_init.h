@@ -39,6 +39,22 @@
 extern "C" {
 #endif
 
+/**
+ * Machine code for a module, as handed to or retrieved from a shader cache.
+ *
+ * If data_size is non-zero when the module is compiled, the object in data
+ * is loaded instead of running LLVM optimization and code generation.
+ * Otherwise the freshly generated object is copied into data so the caller
+ * can store it.  dont_cache is set when the code embeds process-specific
+ * addresses and therefore must not outlive the process.
+ */
+struct lp_cached_code {
+   void *data;
+   size_t data_size;
+   boolean dont_cache;
+   void *jit_obj_cache;
+};
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,7 +66,9 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
    unsigned compiled;
+   boolean fast;   /**< favour compile time over code quality */
 };
 
 
@@ -59,7 +77,11 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
+
+struct gallivm_state *
+gallivm_create_fast(const char *name, LLVMContextRef context);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
@@ -347,6 +347,17 @@ lp_build_select(struct lp_build_context *bld,
 
       res = LLVMBuildSelect(builder, mask, a, b, "");
    }
+   else if (util_cpu_caps.has_avx512f &&
+            type.width * type.length == 512 &&
+            (type.width >= 32 || util_cpu_caps.has_avx512bw)) {
+      /* AVX-512 has no blendv, but selects on a vector of booleans get
+       * a mask register and a masked move/blend, so just compare the mask
+       * against zero rather than bitwise selecting.
+       */
+      mask = LLVMBuildICmp(builder, LLVMIntNE, mask,
+                           LLVMConstNull(bld->int_vec_type), "");
+      res = LLVMBuildSelect(builder, mask, a, b, "");
+   }
    else if (((util_cpu_caps.has_sse4_1 &&
               type.width * type.length == 128) ||
              (util_cpu_caps.has_avx &&
@@ -2584,6 +2584,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                      unsigned texture_unit,
                      const LLVMValueRef *coords,
                      LLVMValueRef explicit_lod,
+                     LLVMValueRef ms_index,
                      const LLVMValueRef *offsets,
                      LLVMValueRef *colors_out)
 {
@@ -2681,6 +2682,36 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                             lp_build_get_mip_offsets(bld, ilevel));
    }
 
+   /*
+    * Multisample surfaces store each sample as a complete image,
+    * sample_stride bytes apart.
+    */
+   if (ms_index && bld->dynamic_state->num_samples) {
+      LLVMValueRef num_samples, sample_stride;
+
+      num_samples = bld->dynamic_state->num_samples(bld->dynamic_state,
+                                                    bld->gallivm,
+                                                    bld->context_ptr,
+                                                    texture_unit);
+      num_samples = lp_build_broadcast_scalar(int_coord_bld, num_samples);
+      sample_stride = bld->dynamic_state->sample_stride(bld->dynamic_state,
+                                                        bld->gallivm,
+                                                        bld->context_ptr,
+                                                        texture_unit);
+      sample_stride = lp_build_broadcast_scalar(int_coord_bld, sample_stride);
+
+      out1 = lp_build_cmp(int_coord_bld, PIPE_FUNC_LESS, ms_index,
+                          int_coord_bld->zero);
+      out_of_bounds = lp_build_or(int_coord_bld, out_of_bounds, out1);
+      out1 = lp_build_cmp(int_coord_bld, PIPE_FUNC_GEQUAL, ms_index,
+                          num_samples);
+      out_of_bounds = lp_build_or(int_coord_bld, out_of_bounds, out1);
+
+      offset = lp_build_add(int_coord_bld, offset,
+                            lp_build_mul(int_coord_bld, ms_index,
+                                         sample_stride));
+   }
+
    offset = lp_build_andnot(int_coord_bld, offset, out_of_bounds);
 
    lp_build_fetch_rgba_soa(bld->gallivm,
@@ -3094,7 +3125,10 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
 
    else if (op_type == LP_SAMPLER_OP_FETCH) {
       lp_build_fetch_texel(&bld, texture_index, newcoords,
-                           lod, offsets,
+                           lod,
+                           (sample_key & LP_SAMPLER_FETCH_MS) ?
+                              newcoords[3] : NULL,
+                           offsets,
                            texel_out);
    }
 
@@ -3456,6 +3490,9 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    if (sample_key & LP_SAMPLER_SHADOW) {
       coords[4] = LLVMGetParam(function, num_param++);
    }
+   if (sample_key & LP_SAMPLER_FETCH_MS) {
+      coords[3] = LLVMGetParam(function, num_param++);
+   }
    if (sample_key & LP_SAMPLER_OFFSETS) {
       for (i = 0; i < num_offsets; i++) {
          offsets[i] = LLVMGetParam(function, num_param++);
@@ -3595,6 +3632,9 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
       if (sample_key & LP_SAMPLER_SHADOW) {
          arg_types[num_param++] = LLVMTypeOf(coords[0]);
       }
+      if (sample_key & LP_SAMPLER_FETCH_MS) {
+         arg_types[num_param++] = LLVMTypeOf(coords[3]);
+      }
       if (sample_key & LP_SAMPLER_OFFSETS) {
          for (i = 0; i < num_offsets; i++) {
             arg_types[num_param++] = LLVMTypeOf(offsets[0]);
@@ -3656,6 +3696,9 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    if (sample_key & LP_SAMPLER_SHADOW) {
       args[num_args++] = coords[4];
    }
+   if (sample_key & LP_SAMPLER_FETCH_MS) {
+      args[num_args++] = coords[3];
+   }
    if (sample_key & LP_SAMPLER_OFFSETS) {
       for (i = 0; i < num_offsets; i++) {
          args[num_args++] = offsets[i];
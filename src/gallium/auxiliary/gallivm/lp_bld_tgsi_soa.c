@@ -1647,6 +1647,26 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = bld->system_values.thread_id[MIN2(swizzle, 2)];
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.block_id[MIN2(swizzle, 2)]);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.grid_size[MIN2(swizzle, 2)]);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.block_size[MIN2(swizzle, 2)]);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -2479,10 +2499,6 @@ emit_fetch_texels( struct lp_build_tgsi_soa_context *bld,
       explicit_lod = lp_build_emit_fetch(&bld->bld_base, inst, 0, 3);
       lod_property = lp_build_lod_property(&bld->bld_base, inst, 0);
    }
-   /*
-    * XXX: for real msaa support, the w component (or src2.x for sample_i_ms)
-    * would be the sample index.
-    */
 
    for (i = 0; i < dims; i++) {
       coords[i] = lp_build_emit_fetch(&bld->bld_base, inst, 0, i);
@@ -2494,6 +2510,21 @@ emit_fetch_texels( struct lp_build_tgsi_soa_context *bld,
    if (layer_coord)
       coords[2] = lp_build_emit_fetch(&bld->bld_base, inst, 0, layer_coord);
 
+   /*
+    * For msaa targets the sample index is the w component (or src2.x for
+    * sample_i_ms), passed along in coords[3].
+    */
+   if (target == TGSI_TEXTURE_2D_MSAA ||
+       target == TGSI_TEXTURE_2D_ARRAY_MSAA) {
+      sample_key |= LP_SAMPLER_FETCH_MS;
+      if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I_MS) {
+         coords[3] = lp_build_emit_fetch(&bld->bld_base, inst, 2, 0);
+      }
+      else {
+         coords[3] = lp_build_emit_fetch(&bld->bld_base, inst, 0, 3);
+      }
+   }
+
    if (inst->Texture.NumOffsets == 1) {
       unsigned dim;
       sample_key |= LP_SAMPLER_OFFSETS;
@@ -2823,6 +2854,36 @@ emit_dump_file(struct lp_build_tgsi_soa_context *bld,
 }
 
 
+/**
+ * Point the address registers first..last at their slots in the per-chunk
+ * storage of compute shaders with barriers, right after the temporaries,
+ * see lp_build_tgsi_cs_iface.
+ */
+static void
+get_cs_addr_ptrs(struct lp_build_tgsi_soa_context *bld,
+                 int first, int last)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int_vec_ptr_type =
+      LLVMPointerType(bld->bld_base.base.int_vec_type, 0);
+   unsigned num_temps = bld->bld_base.info->file_max[TGSI_FILE_TEMPORARY] + 1;
+   int idx;
+   unsigned i;
+
+   for (idx = first; idx <= last; ++idx) {
+      assert(idx < LP_MAX_TGSI_ADDRS);
+      for (i = 0; i < TGSI_NUM_CHANNELS; i++) {
+         LLVMValueRef index =
+            lp_build_const_int32(gallivm, (num_temps + idx) * 4 + i);
+         LLVMValueRef ptr = LLVMBuildGEP(builder, bld->temps_array,
+                                         &index, 1, "");
+         bld->addr[idx][i] = LLVMBuildBitCast(builder, ptr, int_vec_ptr_type,
+                                              "addr");
+      }
+   }
+}
+
 
 void
 lp_emit_declaration_soa(
@@ -2866,6 +2927,10 @@ lp_emit_declaration_soa(
        * an ADDR register for that matter).
        */
       assert(last < LP_MAX_TGSI_ADDRS);
+      if (bld->cs_iface && bld->cs_iface->temps_ptr) {
+         get_cs_addr_ptrs(bld, first, last);
+         break;
+      }
       for (idx = first; idx <= last; ++idx) {
          assert(idx < LP_MAX_TGSI_ADDRS);
          for (i = 0; i < TGSI_NUM_CHANNELS; i++)
@@ -2904,6 +2969,19 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      /* Same as for constants, fetch the pointers only once. */
+      assert(bld->cs_iface);
+      assert(last < LP_MAX_TGSI_SHADER_BUFFERS);
+      for (idx = first; idx <= last; ++idx) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+         bld->ssbos[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+         bld->ssbo_sizes[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3639,12 +3717,364 @@ cont_emit(
    lp_exec_continue(&bld->exec_mask);
 }
 
+/**
+ * Return the base pointer of the shader buffer or shared memory referenced
+ * by the register, cast to i32*, and the number of dwords accessible
+ * through it.
+ */
+static LLVMValueRef
+get_memory_ptr(struct lp_build_tgsi_soa_context *bld,
+               const struct tgsi_full_src_register *reg,
+               LLVMValueRef *num_dwords)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i32ptr_type =
+      LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
+   LLVMValueRef ptr, size;
+
+   assert(bld->cs_iface);
+   assert(!reg->Register.Indirect);
+
+   if (reg->Register.File == TGSI_FILE_MEMORY) {
+      ptr = bld->cs_iface->shared_ptr;
+      size = bld->cs_iface->shared_size;
+   }
+   else {
+      assert(reg->Register.File == TGSI_FILE_BUFFER);
+      assert(reg->Register.Index < LP_MAX_TGSI_SHADER_BUFFERS);
+      ptr = bld->ssbos[reg->Register.Index];
+      size = bld->ssbo_sizes[reg->Register.Index];
+   }
+
+   *num_dwords = LLVMBuildLShr(builder, size,
+                               lp_build_const_int32(gallivm, 2), "");
+   return LLVMBuildBitCast(builder, ptr, i32ptr_type, "");
+}
+
+/**
+ * Fetch the byte address operand of a memory instruction and convert it
+ * to a dword index.  Unaligned accesses are not supported.
+ */
+static LLVMValueRef
+get_memory_index(struct lp_build_tgsi_soa_context *bld,
+                 const struct tgsi_full_instruction *inst,
+                 unsigned src_op)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef offset;
+
+   offset = lp_build_emit_fetch_src(&bld->bld_base, &inst->Src[src_op],
+                                    TGSI_TYPE_UNSIGNED, 0);
+   return lp_build_shr_imm(uint_bld, offset, 2);
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMTypeRef fptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(gallivm->context), 0);
+   LLVMValueRef base_ptr, num_dwords, index, limit;
+   unsigned chan;
+
+   if (inst->Src[0].Register.File != TGSI_FILE_BUFFER &&
+       inst->Src[0].Register.File != TGSI_FILE_MEMORY) {
+      assert(!"image loads are not supported");
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+         emit_data->output[chan] = bld_base->base.zero;
+      }
+      return;
+   }
+
+   base_ptr = get_memory_ptr(bld, &inst->Src[0], &num_dwords);
+   base_ptr = LLVMBuildBitCast(builder, base_ptr, fptr_type, "");
+   index = get_memory_index(bld, inst, 1);
+   limit = lp_build_broadcast_scalar(uint_bld, num_dwords);
+
+   /* Out of bounds loads return zero, like for constant buffers. */
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef chan_index, overflow_mask;
+
+      chan_index = lp_build_add(uint_bld, index,
+                                lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                       chan));
+      overflow_mask = lp_build_compare(gallivm, uint_bld->type,
+                                       PIPE_FUNC_GEQUAL, chan_index, limit);
+      emit_data->output[chan] = build_gather(bld_base, base_ptr, chan_index,
+                                             overflow_mask, NULL);
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   struct tgsi_full_src_register resource;
+   LLVMValueRef base_ptr, num_dwords, index, limit, exec_mask;
+   unsigned chan, i;
+
+   if (inst->Dst[0].Register.File != TGSI_FILE_BUFFER &&
+       inst->Dst[0].Register.File != TGSI_FILE_MEMORY) {
+      assert(!"image stores are not supported");
+      return;
+   }
+
+   memset(&resource, 0, sizeof resource);
+   resource.Register.File = inst->Dst[0].Register.File;
+   resource.Register.Index = inst->Dst[0].Register.Index;
+   base_ptr = get_memory_ptr(bld, &resource, &num_dwords);
+   index = get_memory_index(bld, inst, 0);
+   limit = lp_build_broadcast_scalar(uint_bld, num_dwords);
+   exec_mask = mask_vec(bld_base);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef chan_index, value, store_mask;
+
+      chan_index = lp_build_add(uint_bld, index,
+                                lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                       chan));
+      store_mask = lp_build_compare(gallivm, uint_bld->type,
+                                    PIPE_FUNC_LESS, chan_index, limit);
+      store_mask = LLVMBuildAnd(builder, store_mask, exec_mask, "");
+      value = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                      TGSI_TYPE_UNSIGNED, chan);
+
+      /*
+       * Shader buffers are shared with other threads, so unlike
+       * emit_mask_scatter() we must not write back the old value for
+       * inactive channels.
+       */
+      for (i = 0; i < uint_bld->type.length; i++) {
+         LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+         LLVMValueRef scalar_pred, scalar_ptr, scalar_index;
+         struct lp_build_if_state ifthen;
+
+         scalar_pred = LLVMBuildExtractElement(builder, store_mask, ii, "");
+         scalar_pred = LLVMBuildICmp(builder, LLVMIntNE, scalar_pred,
+                                     lp_build_const_int32(gallivm, 0), "");
+         lp_build_if(&ifthen, gallivm, scalar_pred);
+         scalar_index = LLVMBuildExtractElement(builder, chan_index, ii, "");
+         scalar_ptr = LLVMBuildGEP(builder, base_ptr, &scalar_index, 1, "");
+         LLVMBuildStore(builder,
+                        LLVMBuildExtractElement(builder, value, ii, ""),
+                        scalar_ptr);
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   unsigned chan;
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = bld_base->uint_bld.zero;
+   }
+
+   if (inst->Src[0].Register.File == TGSI_FILE_BUFFER) {
+      assert(!inst->Src[0].Register.Indirect);
+      emit_data->output[0] =
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->ssbo_sizes[inst->Src[0].Register.Index]);
+   }
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, num_dwords, index, value, value2 = NULL;
+   LLVMValueRef atom_mask, result_ptr, result;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   unsigned chan, i;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      return;
+   }
+
+   if (inst->Src[0].Register.File != TGSI_FILE_BUFFER &&
+       inst->Src[0].Register.File != TGSI_FILE_MEMORY) {
+      assert(!"image atomics are not supported");
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+         emit_data->output[chan] = uint_bld->zero;
+      }
+      return;
+   }
+
+   base_ptr = get_memory_ptr(bld, &inst->Src[0], &num_dwords);
+   index = get_memory_index(bld, inst, 1);
+   value = lp_build_emit_fetch_src(bld_base, &inst->Src[2],
+                                   TGSI_TYPE_UNSIGNED, 0);
+   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS)
+      value2 = lp_build_emit_fetch_src(bld_base, &inst->Src[3],
+                                       TGSI_TYPE_UNSIGNED, 0);
+
+   atom_mask = lp_build_compare(gallivm, uint_bld->type, PIPE_FUNC_LESS,
+                                index,
+                                lp_build_broadcast_scalar(uint_bld, num_dwords));
+   atom_mask = LLVMBuildAnd(builder, atom_mask, mask_vec(bld_base), "");
+
+   result_ptr = lp_build_alloca(gallivm, uint_bld->vec_type, "atom_res");
+
+   /* Atomics are done one channel at a time, skipping inactive ones. */
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+      LLVMValueRef scalar_pred, scalar_ptr, scalar_index, scalar;
+      struct lp_build_if_state ifthen;
+
+      scalar_pred = LLVMBuildExtractElement(builder, atom_mask, ii, "");
+      scalar_pred = LLVMBuildICmp(builder, LLVMIntNE, scalar_pred,
+                                  lp_build_const_int32(gallivm, 0), "");
+      lp_build_if(&ifthen, gallivm, scalar_pred);
+
+      scalar_index = LLVMBuildExtractElement(builder, index, ii, "");
+      scalar_ptr = LLVMBuildGEP(builder, base_ptr, &scalar_index, 1, "");
+      scalar = LLVMBuildExtractElement(builder, value, ii, "");
+
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+#if HAVE_LLVM >= 0x0309
+         LLVMValueRef cmp = scalar;
+         scalar = LLVMBuildExtractElement(builder, value2, ii, "");
+         scalar = LLVMBuildAtomicCmpXchg(builder, scalar_ptr, cmp, scalar,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         FALSE);
+         scalar = LLVMBuildExtractValue(builder, scalar, 0, "");
+#else
+         assert(!"ATOMCAS needs LLVM 3.9");
+         scalar = lp_build_const_int32(gallivm, 0);
+#endif
+      }
+      else {
+         scalar = LLVMBuildAtomicRMW(builder, op, scalar_ptr, scalar,
+                                     LLVMAtomicOrderingSequentiallyConsistent,
+                                     FALSE);
+      }
+
+      result = LLVMBuildLoad(builder, result_ptr, "");
+      result = LLVMBuildInsertElement(builder, result, scalar, ii, "");
+      LLVMBuildStore(builder, result, result_ptr);
+
+      lp_build_endif(&ifthen);
+   }
+
+   result = LLVMBuildLoad(builder, result_ptr, "");
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = result;
+   }
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef temps_ptr = NULL;
+
+   /*
+    * GLSL only allows barrier() in uniform control flow outside of any
+    * conditionals or loops, so the execution mask is all ones here.
+    */
+   assert(!bld->exec_mask.has_mask);
+
+   bld->cs_iface->emit_barrier(bld->cs_iface, bld_base,
+                               &bld->system_values, &temps_ptr);
+
+   if (temps_ptr) {
+      LLVMTypeRef vec_ptr_type = LLVMPointerType(bld_base->base.vec_type, 0);
+      bld->temps_array = LLVMBuildBitCast(builder, temps_ptr, vec_ptr_type,
+                                          "temp_array");
+      get_cs_addr_ptrs(bld, 0, bld_base->info->file_max[TGSI_FILE_ADDRESS]);
+   }
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /*
+    * Stores and atomics go straight to memory in program order, so there
+    * is nothing to wait for.
+    */
+}
+
 static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state * gallivm = bld_base->base.gallivm;
 
-   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
+   if (bld->cs_iface && bld->cs_iface->temps_ptr) {
+      /* storage provided by the caller, see lp_build_tgsi_cs_iface */
+      LLVMTypeRef vec_ptr_type = LLVMPointerType(bld_base->base.vec_type, 0);
+      bld->temps_array = LLVMBuildBitCast(gallivm->builder,
+                                          bld->cs_iface->temps_ptr,
+                                          vec_ptr_type, "temp_array");
+   }
+   else if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                          bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
@@ -3782,7 +4212,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3938,6 +4369,29 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+
+      /* temporaries must survive the chunk loop restarts at barriers */
+      if (cs_iface->temps_ptr)
+         bld.indirect_files |= (1 << TGSI_FILE_TEMPORARY);
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
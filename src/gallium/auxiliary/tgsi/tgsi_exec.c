@@ -61,6 +61,7 @@
 #include "util/u_half.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_sse.h"
 #include "util/rounding.h"
 
 
@@ -86,14 +87,52 @@ struct tgsi_double_vector {
    union tgsi_double_channel zw;
 };
 
+#if defined(PIPE_ARCH_SSE)
+
+/* A channel holds one value per lane of the quad, which is exactly one SSE
+ * register, so the float arithmetic below can be done in a single
+ * instruction.  The results are identical to the scalar code, including
+ * for NaNs and signed zeros.
+ */
+static inline __m128
+chan_load(const union tgsi_exec_channel *chan)
+{
+   return _mm_loadu_ps(chan->f);
+}
+
+static inline void
+chan_store(union tgsi_exec_channel *chan, __m128 value)
+{
+   _mm_storeu_ps(chan->f, value);
+}
+
+/* Stores 1.0f for the lanes set in a comparison mask and 0.0f elsewhere. */
+static inline void
+chan_store_bool(union tgsi_exec_channel *chan, __m128 mask)
+{
+   chan_store(chan, _mm_and_ps(mask, _mm_set1_ps(1.0f)));
+}
+
+static inline __m128
+chan_sign_mask(void)
+{
+   return _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+}
+
+#endif /* PIPE_ARCH_SSE */
+
 static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_andnot_ps(chan_sign_mask(), chan_load(src)));
+#else
    dst->f[0] = fabsf(src->f[0]);
    dst->f[1] = fabsf(src->f[1]);
    dst->f[2] = fabsf(src->f[2]);
    dst->f[3] = fabsf(src->f[3]);
+#endif
 }
 
 static void
@@ -132,10 +171,17 @@ micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 mask = _mm_cmplt_ps(chan_load(src0), _mm_setzero_ps());
+
+   chan_store(dst, _mm_or_ps(_mm_and_ps(mask, chan_load(src1)),
+                             _mm_andnot_ps(mask, chan_load(src2))));
+#else
    dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
    dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
    dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
    dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+#endif
 }
 
 static void
@@ -496,10 +542,18 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 s2 = chan_load(src2);
+
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0),
+                                         _mm_sub_ps(chan_load(src1), s2)),
+                              s2));
+#else
    dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
    dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
    dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
    dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+#endif
 }
 
 static void
@@ -508,10 +562,15 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0), chan_load(src1)),
+                              chan_load(src2)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
    dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
    dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
    dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+#endif
 }
 
 static void
@@ -534,10 +593,14 @@ micro_rcp(union tgsi_exec_channel *dst,
    assert(src->f[2] != 0.0f);
    assert(src->f[3] != 0.0f);
 #endif
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_div_ps(_mm_set1_ps(1.0f), chan_load(src)));
+#else
    dst->f[0] = 1.0f / src->f[0];
    dst->f[1] = 1.0f / src->f[1];
    dst->f[2] = 1.0f / src->f[2];
    dst->f[3] = 1.0f / src->f[3];
+#endif
 }
 
 static void
@@ -560,20 +623,28 @@ micro_rsq(union tgsi_exec_channel *dst,
    assert(src->f[2] != 0.0f);
    assert(src->f[3] != 0.0f);
 #endif
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(chan_load(src))));
+#else
    dst->f[0] = 1.0f / sqrtf(src->f[0]);
    dst->f[1] = 1.0f / sqrtf(src->f[1]);
    dst->f[2] = 1.0f / sqrtf(src->f[2]);
    dst->f[3] = 1.0f / sqrtf(src->f[3]);
+#endif
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_sqrt_ps(chan_load(src)));
+#else
    dst->f[0] = sqrtf(src->f[0]);
    dst->f[1] = sqrtf(src->f[1]);
    dst->f[2] = sqrtf(src->f[2]);
    dst->f[3] = sqrtf(src->f[3]);
+#endif
 }
 
 static void
@@ -581,10 +652,14 @@ micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmpeq_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -592,10 +667,14 @@ micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmpge_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -623,10 +702,14 @@ micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmpgt_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -644,10 +727,14 @@ micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmple_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -655,10 +742,14 @@ micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmplt_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -666,10 +757,14 @@ micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store_bool(dst, _mm_cmpneq_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -1350,10 +1445,14 @@ micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] + src1->f[0];
    dst->f[1] = src0->f[1] + src1->f[1];
    dst->f[2] = src0->f[2] + src1->f[2];
    dst->f[3] = src0->f[3] + src1->f[3];
+#endif
 }
 
 static void
@@ -1395,10 +1494,14 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_max_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1406,10 +1509,14 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_min_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1417,10 +1524,14 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_mul_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0];
    dst->f[1] = src0->f[1] * src1->f[1];
    dst->f[2] = src0->f[2] * src1->f[2];
    dst->f[3] = src0->f[3] * src1->f[3];
+#endif
 }
 
 static void
@@ -1428,10 +1539,14 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_xor_ps(chan_sign_mask(), chan_load(src)));
+#else
    dst->f[0] = -src->f[0];
    dst->f[1] = -src->f[1];
    dst->f[2] = -src->f[2];
    dst->f[3] = -src->f[3];
+#endif
 }
 
 static void
@@ -1469,10 +1584,14 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_sub_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] - src1->f[0];
    dst->f[1] = src0->f[1] - src1->f[1];
    dst->f[2] = src0->f[2] - src1->f[2];
    dst->f[3] = src0->f[3] - src1->f[3];
+#endif
 }
 
 static void
@@ -1587,6 +1706,83 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Like fetch_src_file_channel(), for registers which aren't addressed
+ * indirectly.  All lanes read the same register then, so there's no need
+ * to compute and check an index per lane.
+ */
+static void
+fetch_src_file_channel_direct(const struct tgsi_exec_machine *mach,
+                              const uint file,
+                              const uint swizzle,
+                              const int index,
+                              const int index2D,
+                              union tgsi_exec_channel *chan)
+{
+   uint i;
+
+   assert(swizzle < 4);
+
+   switch (file) {
+   case TGSI_FILE_CONSTANT: {
+      assert(index2D >= 0 && index2D < PIPE_MAX_CONSTANT_BUFFERS);
+      assert(mach->Consts[index2D]);
+
+      /* NOTE: copying the const value as a uint instead of float */
+      const uint *buf = (const uint *)mach->Consts[index2D];
+      const int pos = index * 4 + swizzle;
+      uint value = 0;
+
+      /* const buffer bounds check */
+      if (index >= 0 && pos < (int) mach->ConstsSize[index2D])
+         value = buf[pos];
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         chan->u[i] = value;
+      break;
+   }
+
+   case TGSI_FILE_INPUT:
+      assert(index2D * TGSI_EXEC_MAX_INPUT_ATTRIBS + index >= 0);
+      *chan = mach->Inputs[index2D * TGSI_EXEC_MAX_INPUT_ATTRIBS + index].xyzw[swizzle];
+      break;
+
+   case TGSI_FILE_SYSTEM_VALUE:
+      *chan = mach->SystemValue[index].xyzw[swizzle];
+      break;
+
+   case TGSI_FILE_TEMPORARY:
+      assert(index < TGSI_EXEC_NUM_TEMPS);
+      assert(index2D == 0);
+      *chan = mach->Temps[index].xyzw[swizzle];
+      break;
+
+   case TGSI_FILE_IMMEDIATE:
+      assert(index >= 0 && index < (int)mach->ImmLimit);
+      assert(index2D == 0);
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         chan->f[i] = mach->Imms[index][swizzle];
+      break;
+
+   case TGSI_FILE_ADDRESS:
+      assert(index >= 0);
+      assert(index2D == 0);
+      *chan = mach->Addrs[index].xyzw[swizzle];
+      break;
+
+   case TGSI_FILE_OUTPUT:
+      assert(index >= 0);
+      assert(index2D == 0);
+      *chan = mach->Outputs[index].xyzw[swizzle];
+      break;
+
+   default:
+      assert(0);
+      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         chan->u[i] = 0;
+      }
+   }
+}
+
 static void
 fetch_source_d(const struct tgsi_exec_machine *mach,
                union tgsi_exec_channel *chan,
@@ -1598,6 +1794,19 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   /* This is the common case. */
+   if (!reg->Register.Indirect &&
+       !(reg->Register.Dimension && reg->Dimension.Indirect)) {
+      fetch_src_file_channel_direct(mach,
+                                    reg->Register.File,
+                                    tgsi_util_get_full_src_register_swizzle(reg, chan_index),
+                                    reg->Register.Index,
+                                    reg->Register.Dimension ?
+                                       reg->Dimension.Index : 0,
+                                    chan);
+      return;
+   }
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1956,6 +2165,28 @@ store_dest_double(struct tgsi_exec_machine *mach,
          dst->i[i] = chan->i[i];
 }
 
+static void
+micro_sat(union tgsi_exec_channel *dst,
+          const union tgsi_exec_channel *src)
+{
+#if defined(PIPE_ARCH_SSE)
+   /* The operand order makes NaNs pass through, like below. */
+   chan_store(dst, _mm_min_ps(_mm_set1_ps(1.0f),
+                              _mm_max_ps(_mm_setzero_ps(), chan_load(src))));
+#else
+   int i;
+
+   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      if (src->f[i] < 0.0f)
+         dst->f[i] = 0.0f;
+      else if (src->f[i] > 1.0f)
+         dst->f[i] = 1.0f;
+      else
+         dst->i[i] = src->i[i];
+   }
+#endif
+}
+
 static void
 store_dest(struct tgsi_exec_machine *mach,
            const union tgsi_exec_channel *chan,
@@ -1965,6 +2196,7 @@ store_dest(struct tgsi_exec_machine *mach,
            enum tgsi_exec_datatype dst_datatype)
 {
    union tgsi_exec_channel *dst;
+   union tgsi_exec_channel sat;
    const uint execmask = mach->ExecMask;
    int i;
 
@@ -1973,21 +2205,18 @@ store_dest(struct tgsi_exec_machine *mach,
    if (!dst)
       return;
 
-   if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i))
-            dst->i[i] = chan->i[i];
+   if (inst->Instruction.Saturate) {
+      micro_sat(&sat, chan);
+      chan = &sat;
+   }
+
+   if (execmask == (1 << TGSI_QUAD_SIZE) - 1) {
+      *dst = *chan;
    }
    else {
       for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < 0.0f)
-               dst->f[i] = 0.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
+         if (execmask & (1 << i))
+            dst->i[i] = chan->i[i];
    }
 }
 
@@ -30,6 +30,7 @@
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_upload_mgr.h"
+#include "util/os_time.h"
 
 /* 0 = disabled, 1 = assertions, 2 = printfs */
 #define TC_DEBUG 0
@@ -109,6 +110,7 @@ tc_batch_flush(struct threaded_context *tc)
    tc_batch_check(next);
    tc_debug_check(tc);
    p_atomic_add(&tc->num_offloaded_slots, next->num_total_call_slots);
+   p_atomic_inc(&tc->num_batches);
 
    if (next->token) {
       next->token->tc = NULL;
@@ -180,16 +182,19 @@ tc_is_sync(struct threaded_context *tc)
 }
 
 static void
-_tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSED const char *func)
+_tc_sync(struct threaded_context *tc, enum tc_sync_reason reason,
+         MAYBE_UNUSED const char *info, MAYBE_UNUSED const char *func)
 {
    struct tc_batch *last = &tc->batch_slots[tc->last];
    struct tc_batch *next = &tc->batch_slots[tc->next];
    bool synced = false;
+   int64_t start = 0;
 
    tc_debug_check(tc);
 
    /* Only wait for queued calls... */
    if (!util_queue_fence_is_signalled(&last->fence)) {
+      start = os_time_get_nano();
       util_queue_fence_wait(&last->fence);
       synced = true;
    }
@@ -203,6 +208,8 @@ _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSE
 
    /* .. and execute unflushed calls directly. */
    if (next->num_total_call_slots) {
+      if (!start)
+         start = os_time_get_nano();
       p_atomic_add(&tc->num_direct_slots, next->num_total_call_slots);
       tc_batch_execute(next, 0);
       synced = true;
@@ -210,6 +217,8 @@ _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSE
 
    if (synced) {
       p_atomic_inc(&tc->num_syncs);
+      p_atomic_inc(&tc->num_syncs_by_reason[reason]);
+      p_atomic_add(&tc->sync_time_ns, os_time_get_nano() - start);
 
       if (tc_strcmp(func, "tc_destroy") != 0) {
          tc_printf("sync %s %s\n", func, info);
@@ -219,8 +228,8 @@ _tc_sync(struct threaded_context *tc, MAYBE_UNUSED const char *info, MAYBE_UNUSE
    tc_debug_check(tc);
 }
 
-#define tc_sync(tc) _tc_sync(tc, "", __func__)
-#define tc_sync_msg(tc, info) _tc_sync(tc, info, __func__)
+#define tc_sync(tc, reason) _tc_sync(tc, reason, "", __func__)
+#define tc_sync_msg(tc, reason, info) _tc_sync(tc, reason, info, __func__)
 
 /**
  * Call this from fence_finish for same-context fence waits of deferred fences
@@ -246,7 +255,7 @@ threaded_context_flush(struct pipe_context *_pipe,
       if (prefer_async || !util_queue_fence_is_signalled(&last->fence))
          tc_batch_flush(tc);
       else
-         tc_sync(token->tc);
+         tc_sync(token->tc, TC_SYNC_FLUSH);
    }
 }
 
@@ -285,7 +294,7 @@ threaded_context_unwrap_sync(struct pipe_context *pipe)
    if (!pipe || !pipe->priv)
       return pipe;
 
-   tc_sync(threaded_context(pipe));
+   tc_sync(threaded_context(pipe), TC_SYNC_UNWRAP);
    return (struct pipe_context*)pipe->priv;
 }
 
@@ -424,7 +433,7 @@ tc_get_query_result(struct pipe_context *_pipe,
    struct pipe_context *pipe = tc->pipe;
 
    if (!tq->flushed)
-      tc_sync_msg(tc, wait ? "wait" : "nowait");
+      tc_sync_msg(tc, TC_SYNC_QUERY, wait ? "wait" : "nowait");
 
    bool success = pipe->get_query_result(pipe, query, wait, result);
 
@@ -1052,7 +1061,7 @@ tc_set_compute_resources(struct pipe_context *_pipe, unsigned start,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_STATE);
    pipe->set_compute_resources(pipe, start, count, resources);
 }
 
@@ -1064,7 +1073,7 @@ tc_set_global_binding(struct pipe_context *_pipe, unsigned first,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_STATE);
    pipe->set_global_binding(pipe, first, count, resources, handles);
 }
 
@@ -1129,7 +1138,7 @@ tc_create_stream_output_target(struct pipe_context *_pipe,
    struct threaded_resource *tres = threaded_resource(res);
    struct pipe_stream_output_target *view;
 
-   tc_sync(threaded_context(_pipe));
+   tc_sync(threaded_context(_pipe), TC_SYNC_CREATE);
    util_range_add(&tres->valid_buffer_range, buffer_offset,
                   buffer_offset + buffer_size);
 
@@ -1162,7 +1171,7 @@ tc_create_texture_handle(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_CREATE);
    return pipe->create_texture_handle(pipe, view, state);
 }
 
@@ -1219,7 +1228,7 @@ tc_create_image_handle(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_CREATE);
    return pipe->create_image_handle(pipe, image);
 }
 
@@ -1475,7 +1484,8 @@ tc_transfer_map(struct pipe_context *_pipe,
 
    /* Unsychronized buffer mappings don't have to synchronize the thread. */
    if (!(usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
-      tc_sync_msg(tc, resource->target != PIPE_BUFFER ? "  texture" :
+      tc_sync_msg(tc, TC_SYNC_TRANSFER,
+                  resource->target != PIPE_BUFFER ? "  texture" :
                       usage & PIPE_TRANSFER_DISCARD_RANGE ? "  discard_range" :
                       usage & PIPE_TRANSFER_READ ? "  read" : "  ??");
 
@@ -1714,7 +1724,7 @@ tc_texture_subdata(struct pipe_context *_pipe,
    } else {
       struct pipe_context *pipe = tc->pipe;
 
-      tc_sync(tc);
+      tc_sync(tc, TC_SYNC_TRANSFER);
       pipe->texture_subdata(pipe, resource, level, usage, box, data,
                             stride, layer_stride);
    }
@@ -1731,7 +1741,7 @@ tc_texture_subdata(struct pipe_context *_pipe,
    { \
       struct threaded_context *tc = threaded_context(_pipe); \
       struct pipe_context *pipe = tc->pipe; \
-      tc_sync(tc); \
+      tc_sync(tc, TC_SYNC_READBACK); \
       return pipe->func(pipe); \
    }
 
@@ -1746,7 +1756,7 @@ tc_get_sample_position(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_READBACK);
    pipe->get_sample_position(pipe, sample_count, sample_index,
                              out_value);
 }
@@ -1758,7 +1768,7 @@ tc_set_device_reset_callback(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_STATE);
    pipe->set_device_reset_callback(pipe, cb);
 }
 
@@ -1789,7 +1799,7 @@ tc_emit_string_marker(struct pipe_context *_pipe,
    } else {
       struct pipe_context *pipe = tc->pipe;
 
-      tc_sync(tc);
+      tc_sync(tc, TC_SYNC_DEBUG);
       pipe->emit_string_marker(pipe, string, len);
    }
 }
@@ -1801,7 +1811,7 @@ tc_dump_debug_state(struct pipe_context *_pipe, FILE *stream,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_DEBUG);
    pipe->dump_debug_state(pipe, stream, flags);
 }
 
@@ -1819,7 +1829,7 @@ tc_set_debug_callback(struct pipe_context *_pipe,
    if (cb && cb->debug_message && !cb->async)
       return;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_STATE);
    pipe->set_debug_callback(pipe, cb);
 }
 
@@ -1829,7 +1839,7 @@ tc_set_log_context(struct pipe_context *_pipe, struct u_log_context *log)
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_STATE);
    pipe->set_log_context(pipe, log);
 }
 
@@ -1841,7 +1851,7 @@ tc_create_fence_fd(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_FLUSH);
    pipe->create_fence_fd(pipe, fence, fd, type);
 }
 
@@ -1989,7 +1999,8 @@ tc_flush(struct pipe_context *_pipe, struct pipe_fence_handle **fence,
    }
 
 out_of_memory:
-   tc_sync_msg(tc, flags & PIPE_FLUSH_END_OF_FRAME ? "end of frame" :
+   tc_sync_msg(tc, TC_SYNC_FLUSH,
+               flags & PIPE_FLUSH_END_OF_FRAME ? "end of frame" :
                    flags & PIPE_FLUSH_DEFERRED ? "deferred fence" : "normal");
 
    if (!(flags & PIPE_FLUSH_DEFERRED))
@@ -2298,7 +2309,7 @@ tc_clear_render_target(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_CLEAR);
    pipe->clear_render_target(pipe, dst, color, dstx, dsty, width, height,
                              render_condition_enabled);
 }
@@ -2313,7 +2324,7 @@ tc_clear_depth_stencil(struct pipe_context *_pipe,
    struct threaded_context *tc = threaded_context(_pipe);
    struct pipe_context *pipe = tc->pipe;
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_CLEAR);
    pipe->clear_depth_stencil(pipe, dst, clear_flags, depth, stencil,
                              dstx, dsty, width, height,
                              render_condition_enabled);
@@ -2471,7 +2482,7 @@ tc_destroy(struct pipe_context *_pipe)
    if (tc->base.stream_uploader)
       u_upload_destroy(tc->base.stream_uploader);
 
-   tc_sync(tc);
+   tc_sync(tc, TC_SYNC_DESTROY);
 
    if (util_queue_is_initialized(&tc->queue)) {
       util_queue_destroy(&tc->queue);
@@ -232,6 +232,28 @@ struct tc_unflushed_batch_token;
  */
 #define TC_MAX_SUBDATA_BYTES        320
 
+/* Why the application thread had to wait for the driver thread. Each has
+ * its own sync counter, so that drivers can show them on the HUD. Every
+ * sync site passes one explicitly, and TC_DEBUG >= 2 also prints the
+ * function it's in.
+ */
+enum tc_sync_reason {
+   TC_SYNC_TRANSFER,    /* transfer_map and texture_subdata */
+   TC_SYNC_QUERY,       /* get_query_result */
+   TC_SYNC_FLUSH,       /* flush, fence waits and create_fence_fd */
+   TC_SYNC_UNWRAP,      /* threaded_context_unwrap_sync */
+   TC_SYNC_READBACK,    /* get_timestamp, get_sample_position and
+                           get_device_reset_status */
+   TC_SYNC_CREATE,      /* create_stream_output_target and
+                           create_{texture,image}_handle */
+   TC_SYNC_CLEAR,       /* clear_render_target and clear_depth_stencil */
+   TC_SYNC_STATE,       /* set_compute_resources, set_global_binding and
+                           the callback and log context setters */
+   TC_SYNC_DEBUG,       /* dump_debug_state and long string markers */
+   TC_SYNC_DESTROY,     /* destroy, which nothing can query afterwards */
+   TC_NUM_SYNC_REASONS,
+};
+
 typedef void (*tc_replace_buffer_storage_func)(struct pipe_context *ctx,
                                                struct pipe_resource *dst,
                                                struct pipe_resource *src);
@@ -360,6 +382,9 @@ struct threaded_context {
    unsigned num_offloaded_slots;
    unsigned num_direct_slots;
    unsigned num_syncs;
+   unsigned num_syncs_by_reason[TC_NUM_SYNC_REASONS];
+   unsigned num_batches;
+   uint64_t sync_time_ns; /* time the application thread spent in syncs */
 
    struct util_queue queue;
    struct util_queue_fence *fence;
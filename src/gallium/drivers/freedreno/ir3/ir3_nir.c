@@ -105,6 +105,8 @@ ir3_optimize_loop(nir_shader *s)
 			progress |= OPT(s, nir_opt_gcm, true);
 		else if (gcm == 2)
 			progress |= OPT(s, nir_opt_gcm, false);
+		else if (gcm == 3)
+			progress |= OPT(s, nir_opt_licm, true);
 		progress |= OPT(s, nir_opt_peephole_select, 16);
 		progress |= OPT(s, nir_opt_intrinsics);
 		progress |= OPT(s, nir_opt_algebraic);
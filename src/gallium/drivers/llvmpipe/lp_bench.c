@@ -0,0 +1,577 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Rasterization throughput benchmark.
+ *
+ * Draws a few synthetic workloads through a pipe_context of an llvmpipe
+ * screen on the null winsys, so no GL state tracker or window system is
+ * involved, and reports triangle and fill rates.
+ *
+ * The wall time of each stage is reported too, from a second pass which
+ * waits for every frame: vertex processing, measured by drawing with all
+ * triangles culled, setup and binning, the rest of the draw call, and
+ * rasterization, from the flush until the frame's fence signals.
+ *
+ * Usage: lp_bench [-s WIDTHxHEIGHT] [-n FRAMES] [CASE...]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/os_time.h"
+#include "util/u_box.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+#include "util/u_simple_shaders.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_screen.h"
+
+
+#define TEX_SIZE 256
+
+
+struct bench_case
+{
+   const char *name;
+   unsigned cell;      /**< grid of cell x cell pixel quads, or 0 */
+   unsigned layers;    /**< full screen quads, when cell is 0 */
+   boolean texture;
+   boolean blend;
+};
+
+
+static const struct bench_case cases[] = {
+   { "small_tris", 8, 0,  FALSE, FALSE },
+   { "overdraw",   0, 16, FALSE, FALSE },
+   { "texture",    0, 4,  TRUE,  FALSE },
+   { "blend",      0, 8,  FALSE, TRUE },
+};
+
+
+struct bench
+{
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+
+   unsigned width, height;
+   unsigned frames;
+
+   struct pipe_resource *target;
+   struct pipe_surface *surf;
+   struct pipe_resource *tex;
+   struct pipe_sampler_view *view;
+   void *sampler;
+
+   void *rasterizer;
+   void *rasterizer_cull;
+   void *dsa;
+   void *velems;
+};
+
+
+/**
+ * Append a quad as two triangles, each vertex being a position and a
+ * color/texcoord.
+ */
+static float *
+emit_quad(float *v, float x0, float y0, float x1, float y1, float z,
+          const float attr[4])
+{
+   const float pos[6][2] = {
+      { x0, y0 }, { x1, y0 }, { x0, y1 },
+      { x0, y1 }, { x1, y0 }, { x1, y1 },
+   };
+   unsigned i;
+
+   for (i = 0; i < 6; i++) {
+      *v++ = pos[i][0];
+      *v++ = pos[i][1];
+      *v++ = z;
+      *v++ = 1.0f;
+      if (attr) {
+         memcpy(v, attr, 4 * sizeof(float));
+      }
+      else {
+         /* texcoords spanning the quad */
+         v[0] = pos[i][0] * 0.5f + 0.5f;
+         v[1] = pos[i][1] * 0.5f + 0.5f;
+         v[2] = 0.0f;
+         v[3] = 1.0f;
+      }
+      v += 4;
+   }
+
+   return v;
+}
+
+
+/**
+ * Build the vertices of a case.
+ * \return  number of vertices, stored in *verts which the caller frees
+ */
+static unsigned
+build_vertices(const struct bench *b, const struct bench_case *c,
+               float **verts)
+{
+   unsigned nr_quads, i, j;
+   float *v;
+
+   if (c->cell) {
+      unsigned cols = b->width / c->cell;
+      unsigned rows = b->height / c->cell;
+      nr_quads = cols * rows;
+   }
+   else {
+      nr_quads = c->layers;
+   }
+
+   *verts = MALLOC(nr_quads * 6 * 8 * sizeof(float));
+   if (!*verts)
+      return 0;
+
+   v = *verts;
+   if (c->cell) {
+      const float sx = 2.0f * c->cell / b->width;
+      const float sy = 2.0f * c->cell / b->height;
+      unsigned cols = b->width / c->cell;
+      unsigned rows = b->height / c->cell;
+
+      for (j = 0; j < rows; j++) {
+         for (i = 0; i < cols; i++) {
+            const float color[4] = {
+               (float)i / cols, (float)j / rows, 0.5f, 1.0f
+            };
+            v = emit_quad(v, -1.0f + i * sx, -1.0f + j * sy,
+                          -1.0f + (i + 1) * sx, -1.0f + (j + 1) * sy,
+                          0.0f, color);
+         }
+      }
+   }
+   else {
+      for (i = 0; i < c->layers; i++) {
+         const float color[4] = {
+            (float)i / c->layers, 0.25f, 0.75f, 0.5f
+         };
+         v = emit_quad(v, -1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
+                       c->texture ? NULL : color);
+      }
+   }
+
+   return nr_quads * 6;
+}
+
+
+static boolean
+init_bench(struct bench *b)
+{
+   struct pipe_context *pipe;
+   struct pipe_resource templ;
+   struct pipe_surface surf_templ;
+   struct pipe_sampler_view view_templ;
+   struct pipe_sampler_state sampler;
+   struct pipe_rasterizer_state rast;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_vertex_element velems[2];
+   struct pipe_framebuffer_state fb;
+   struct pipe_viewport_state vp;
+   struct pipe_box box;
+   uint32_t *texels;
+   unsigned i;
+
+   b->screen = llvmpipe_create_screen(null_sw_create());
+   if (!b->screen)
+      return FALSE;
+
+   b->pipe = pipe = b->screen->context_create(b->screen, NULL, 0);
+   if (!pipe)
+      return FALSE;
+
+   /* render target */
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = b->width;
+   templ.height0 = b->height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   b->target = b->screen->resource_create(b->screen, &templ);
+   if (!b->target)
+      return FALSE;
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   b->surf = pipe->create_surface(pipe, b->target, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = b->width;
+   fb.height = b->height;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = b->surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   /* texture, a checkerboard */
+   templ.width0 = TEX_SIZE;
+   templ.height0 = TEX_SIZE;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+   b->tex = b->screen->resource_create(b->screen, &templ);
+   if (!b->tex)
+      return FALSE;
+
+   texels = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+   if (!texels)
+      return FALSE;
+   for (i = 0; i < TEX_SIZE * TEX_SIZE; i++) {
+      texels[i] = ((i / 8) ^ (i / (8 * TEX_SIZE))) & 1 ? 0xffc08040 : 0xff204080;
+   }
+   u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+   pipe->texture_subdata(pipe, b->tex, 0, 0, &box, texels,
+                         TEX_SIZE * 4, 0);
+   FREE(texels);
+
+   u_sampler_view_default_template(&view_templ, b->tex, b->tex->format);
+   b->view = pipe->create_sampler_view(pipe, b->tex, &view_templ);
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_t = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_r = PIPE_TEX_WRAP_REPEAT;
+   sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler.normalized_coords = 1;
+   b->sampler = pipe->create_sampler_state(pipe, &sampler);
+
+   /* fixed state */
+   memset(&rast, 0, sizeof rast);
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip = 1;
+   b->rasterizer = pipe->create_rasterizer_state(pipe, &rast);
+   rast.cull_face = PIPE_FACE_FRONT_AND_BACK;
+   b->rasterizer_cull = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, b->rasterizer);
+
+   memset(&dsa, 0, sizeof dsa);
+   b->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, b->dsa);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_offset = 0;
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 4 * sizeof(float);
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   b->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, b->velems);
+
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = 0.5f * b->width;
+   vp.scale[1] = 0.5f * b->height;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = 0.5f * b->width;
+   vp.translate[1] = 0.5f * b->height;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   return TRUE;
+}
+
+
+static void
+finish(struct bench *b)
+{
+   struct pipe_fence_handle *fence = NULL;
+
+   b->pipe->flush(b->pipe, &fence, 0);
+   b->screen->fence_finish(b->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+   b->screen->fence_reference(b->screen, &fence, NULL);
+}
+
+
+/**
+ * Draw the frames of a case one at a time, waiting for each.
+ * \param draw_ns  returns the time spent in the draw calls
+ * \param rast_ns  returns the time from the flush until the fence signals
+ */
+static void
+run_frames_serial(struct bench *b, unsigned nr_verts,
+                  int64_t *draw_ns, int64_t *rast_ns)
+{
+   struct pipe_context *pipe = b->pipe;
+   const union pipe_color_union clear_color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+   unsigned frame;
+
+   *draw_ns = 0;
+   *rast_ns = 0;
+
+   for (frame = 0; frame < b->frames; frame++) {
+      int64_t t0, t1, t2;
+
+      pipe->clear(pipe, PIPE_CLEAR_COLOR, &clear_color, 0.0, 0);
+      t0 = os_time_get_nano();
+      util_draw_arrays(pipe, PIPE_PRIM_TRIANGLES, 0, nr_verts);
+      t1 = os_time_get_nano();
+      finish(b);
+      t2 = os_time_get_nano();
+
+      *draw_ns += t1 - t0;
+      *rast_ns += t2 - t1;
+   }
+}
+
+
+static boolean
+run_case(struct bench *b, const struct bench_case *c)
+{
+   struct pipe_context *pipe = b->pipe;
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION,
+      c->texture ? TGSI_SEMANTIC_GENERIC : TGSI_SEMANTIC_COLOR
+   };
+   const uint semantic_indexes[] = { 0, 0 };
+   const union pipe_color_union clear_color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+   struct pipe_blend_state blend;
+   struct pipe_vertex_buffer vbuf;
+   void *blend_state, *vs, *fs;
+   float *verts;
+   struct llvmpipe_screen *screen = llvmpipe_screen(b->screen);
+   unsigned nr_verts, frame;
+   int64_t t0, t1, draw_ns, rast_ns, vert_ns, unused_ns;
+   double secs, tris, pixels;
+
+   nr_verts = build_vertices(b, c, &verts);
+   if (!nr_verts)
+      return FALSE;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   if (c->blend) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+   blend_state = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_state);
+
+   vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                            semantic_indexes, FALSE);
+   if (c->texture) {
+      fs = util_make_fragment_tex_shader(pipe, TGSI_TEXTURE_2D,
+                                         TGSI_INTERPOLATE_LINEAR,
+                                         TGSI_RETURN_TYPE_FLOAT,
+                                         TGSI_RETURN_TYPE_FLOAT,
+                                         false, false);
+      pipe->bind_sampler_states(pipe, PIPE_SHADER_FRAGMENT, 0, 1,
+                                &b->sampler);
+      pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &b->view);
+   }
+   else {
+      fs = util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                                 TGSI_INTERPOLATE_PERSPECTIVE,
+                                                 TRUE);
+   }
+   pipe->bind_vs_state(pipe, vs);
+   pipe->bind_fs_state(pipe, fs);
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = 8 * sizeof(float);
+   vbuf.is_user_buffer = true;
+   vbuf.buffer.user = verts;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vbuf);
+
+   /* One frame to compile the shaders and fault in the buffers */
+   pipe->clear(pipe, PIPE_CLEAR_COLOR, &clear_color, 0.0, 0);
+   util_draw_arrays(pipe, PIPE_PRIM_TRIANGLES, 0, nr_verts);
+   finish(b);
+
+   /* Measure the optimized fragment shader, not the unoptimized code used
+    * until the compile queue has built it.
+    */
+   if (util_queue_is_initialized(&screen->fs_compile_queue))
+      util_queue_finish(&screen->fs_compile_queue);
+
+   t0 = os_time_get_nano();
+   for (frame = 0; frame < b->frames; frame++) {
+      pipe->clear(pipe, PIPE_CLEAR_COLOR, &clear_color, 0.0, 0);
+      util_draw_arrays(pipe, PIPE_PRIM_TRIANGLES, 0, nr_verts);
+      pipe->flush(pipe, NULL, 0);
+   }
+   finish(b);
+   t1 = os_time_get_nano();
+
+   /* Per stage wall times, without overlap between frames */
+   run_frames_serial(b, nr_verts, &draw_ns, &rast_ns);
+   pipe->bind_rasterizer_state(pipe, b->rasterizer_cull);
+   run_frames_serial(b, nr_verts, &vert_ns, &unused_ns);
+   pipe->bind_rasterizer_state(pipe, b->rasterizer);
+
+   secs = (t1 - t0) / 1e9;
+   tris = (double)b->frames * nr_verts / 3;
+   if (c->cell) {
+      pixels = (double)b->frames * (b->width / c->cell) * c->cell *
+               (b->height / c->cell) * c->cell;
+   }
+   else {
+      pixels = (double)b->frames * c->layers * b->width * b->height;
+   }
+
+   printf("%-12s %8.2f %10.3f %10.3f %10.2f %10.2f %10.2f\n",
+          c->name, secs * 1000.0 / b->frames,
+          tris / secs / 1e6, pixels / secs / 1e9,
+          vert_ns / 1e6 / b->frames,
+          MAX2(draw_ns - vert_ns, 0) / 1e6 / b->frames,
+          rast_ns / 1e6 / b->frames);
+
+   pipe->bind_fs_state(pipe, NULL);
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_blend_state(pipe, NULL);
+   pipe->delete_fs_state(pipe, fs);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_blend_state(pipe, blend_state);
+   pipe->set_vertex_buffers(pipe, 0, 1, NULL);
+   FREE(verts);
+
+   return TRUE;
+}
+
+
+static void
+destroy_bench(struct bench *b)
+{
+   struct pipe_context *pipe = b->pipe;
+
+   if (pipe) {
+      pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, NULL);
+      pipe_sampler_view_reference(&b->view, NULL);
+      if (b->sampler)
+         pipe->delete_sampler_state(pipe, b->sampler);
+      if (b->rasterizer)
+         pipe->delete_rasterizer_state(pipe, b->rasterizer);
+      if (b->rasterizer_cull)
+         pipe->delete_rasterizer_state(pipe, b->rasterizer_cull);
+      if (b->dsa)
+         pipe->delete_depth_stencil_alpha_state(pipe, b->dsa);
+      if (b->velems)
+         pipe->delete_vertex_elements_state(pipe, b->velems);
+      pipe_surface_reference(&b->surf, NULL);
+      pipe->destroy(pipe);
+   }
+   pipe_resource_reference(&b->tex, NULL);
+   pipe_resource_reference(&b->target, NULL);
+   if (b->screen)
+      b->screen->destroy(b->screen);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   struct bench b;
+   boolean ran = FALSE;
+   boolean success = TRUE;
+   unsigned i;
+   int arg;
+
+   memset(&b, 0, sizeof b);
+   b.width = 1024;
+   b.height = 1024;
+   b.frames = 100;
+
+   for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+      if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+         if (sscanf(argv[++arg], "%ux%u", &b.width, &b.height) != 2 ||
+             !b.width || !b.height) {
+            fprintf(stderr, "invalid size %s\n", argv[arg]);
+            return 1;
+         }
+      }
+      else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+         b.frames = MAX2(atoi(argv[++arg]), 1);
+      }
+      else {
+         fprintf(stderr,
+                 "usage: %s [-s WIDTHxHEIGHT] [-n FRAMES] [CASE...]\n",
+                 argv[0]);
+         return 1;
+      }
+   }
+
+   if (!init_bench(&b)) {
+      fprintf(stderr, "failed to create an llvmpipe context\n");
+      destroy_bench(&b);
+      return 1;
+   }
+
+   printf("%ux%u, %u frames\n", b.width, b.height, b.frames);
+   printf("%-12s %8s %10s %10s %10s %10s %10s\n", "case", "ms/frame",
+          "Mtri/s", "Gpix/s", "vert ms", "setup ms", "rast ms");
+
+   for (i = 0; i < ARRAY_SIZE(cases); i++) {
+      boolean selected = arg == argc;
+      int j;
+
+      for (j = arg; j < argc; j++) {
+         if (strcmp(argv[j], cases[i].name) == 0)
+            selected = TRUE;
+      }
+
+      if (selected) {
+         ran = TRUE;
+         if (!run_case(&b, &cases[i])) {
+            fprintf(stderr, "%s: out of memory\n", cases[i].name);
+            success = FALSE;
+         }
+      }
+   }
+
+   if (!ran) {
+      fprintf(stderr, "no such case, cases are:");
+      for (i = 0; i < ARRAY_SIZE(cases); i++)
+         fprintf(stderr, " %s", cases[i].name);
+      fprintf(stderr, "\n");
+      success = FALSE;
+   }
+
+   destroy_bench(&b);
+
+   return success ? 0 : 1;
+}
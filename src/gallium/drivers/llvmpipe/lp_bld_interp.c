@@ -830,3 +830,42 @@ lp_build_interp_soa_update_pos_dyn(struct lp_build_interp_soa_context *bld,
    }
 }
 
+
+/**
+ * Move the interpolated depth of the current quad(s) by (dx, dy) pixels.
+ * Used to evaluate depth at the sample positions of multisample targets,
+ * where the fragment shader itself still runs at the pixel center.
+ */
+LLVMValueRef
+lp_build_interp_soa_offset_z(struct lp_build_interp_soa_context *bld,
+                             struct gallivm_state *gallivm,
+                             LLVMValueRef z,
+                             float dx,
+                             float dy)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *coeff_bld = &bld->coeff_bld;
+   LLVMValueRef index = lp_build_const_int32(gallivm, 2);
+   LLVMValueRef dzdx, dzdy;
+
+   assert(bld->simple_interp);
+
+   dzdx = lp_build_extract_broadcast(gallivm, bld->setup_bld.type,
+                                     coeff_bld->type, bld->dadxaos[0],
+                                     index);
+   dzdy = lp_build_extract_broadcast(gallivm, bld->setup_bld.type,
+                                     coeff_bld->type, bld->dadyaos[0],
+                                     index);
+
+   z = lp_build_fmuladd(builder, dzdx,
+                        lp_build_const_vec(gallivm, coeff_bld->type, dx), z);
+   z = lp_build_fmuladd(builder, dzdy,
+                        lp_build_const_vec(gallivm, coeff_bld->type, dy), z);
+
+   /* Same clamp as for the pixel center value, see attribs_update_simple() */
+   if (!bld->depth_clamp) {
+      z = lp_build_min(coeff_bld, z, coeff_bld->one);
+   }
+
+   return z;
+}
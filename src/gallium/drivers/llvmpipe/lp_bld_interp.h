@@ -136,4 +136,11 @@ lp_build_interp_soa_update_pos_dyn(struct lp_build_interp_soa_context *bld,
                                    struct gallivm_state *gallivm,
                                    LLVMValueRef quad_start_index);
 
+LLVMValueRef
+lp_build_interp_soa_offset_z(struct lp_build_interp_soa_context *bld,
+                             struct gallivm_state *gallivm,
+                             LLVMValueRef z,
+                             float dx,
+                             float dy);
+
 #endif /* LP_BLD_INTERP_H */
@@ -35,10 +35,13 @@
 #include "pipe/p_context.h"
 #include "util/u_draw.h"
 #include "util/u_prim.h"
+#include "util/os_time.h"
 
 #include "lp_context.h"
 #include "lp_state.h"
 #include "lp_query.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
 
 #include "draw/draw_context.h"
 
@@ -56,6 +59,7 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    struct llvmpipe_context *lp = llvmpipe_context(pipe);
    struct draw_context *draw = lp->draw;
    const void *mapped_indices = NULL;
+   int64_t t0 = 0;
    unsigned i;
 
    if (!llvmpipe_check_render_cond(lp))
@@ -69,6 +73,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      t0 = os_time_get();
+
    /*
     * Map vertex buffers
     */
@@ -153,6 +160,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
     * internally when this condition is seen?)
     */
    draw_flush(draw);
+
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD(draw_time, os_time_get() - t0);
 }
 
 
@@ -61,7 +61,15 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+#define LP_MAX_THREADS 128
+
+
+/**
+ * Number of samples of multisample surfaces.  Coverage of a 4x4 block is
+ * kept in a 64-bit mask with 16 bits per sample, so this can't grow
+ * without widening the mask.
+ */
+#define LP_MAX_SAMPLES 4
 
 
 /**
@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "lp_limits.h"
 
 /**
  * Various counters
@@ -62,6 +63,15 @@ struct lp_counters
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   /** Bins rasterized by each thread, from its own band / from other bands */
+   unsigned nr_bins[LP_MAX_THREADS];
+   unsigned nr_stolen_bins[LP_MAX_THREADS];
+
+   /** Time spent in each stage, in microseconds (LP_DEBUG=counters only) */
+   int64_t draw_time;    /**< draw_vbo, including setup and binning */
+   int64_t setup_time;   /**< triangle setup and binning */
+   int64_t rast_time[LP_MAX_THREADS];  /**< rasterizing scenes, per thread */
 };
 
 
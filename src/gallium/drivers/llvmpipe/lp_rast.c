@@ -26,6 +26,11 @@
  **************************************************************************/
 
 #include <limits.h>
+#if defined(__linux__) && defined(HAVE_PTHREAD)
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -33,6 +38,8 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 
 #include "util/os_time.h"
 
@@ -57,6 +64,14 @@ const struct lp_rasterizer_task *jit_task = NULL;
 #endif
 
 
+const int lp_sample_pos_4x[LP_MAX_SAMPLES][2] = {
+   {  96,  32 },
+   { 224,  96 },
+   {  32, 160 },
+   { 160, 224 }
+};
+
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -70,7 +85,7 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->num_threads );
 }
 
 
@@ -83,6 +98,288 @@ lp_rast_end( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Size of the per-thread tile storage needed to keep all of a scene's
+ * color and depth buffers resident, or zero if the scene can't be
+ * rendered that way.
+ */
+static unsigned
+lp_rast_tile_buf_size(const struct lp_scene *scene)
+{
+   unsigned size = 0;
+   unsigned i;
+
+   /* Layered rendering could touch up to 2048 layers per tile, just
+    * render those directly into the surfaces.
+    */
+   if (scene->fb_max_layer > 0)
+      return 0;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i]) {
+         size += TILE_SIZE * TILE_SIZE * scene->cbufs[i].format_bytes *
+                 scene->cbufs[i].nr_samples;
+      }
+   }
+   if (scene->fb.zsbuf) {
+      size += TILE_SIZE * TILE_SIZE * scene->zsbuf.format_bytes *
+              scene->zsbuf.nr_samples;
+   }
+
+   return size;
+}
+
+
+/**
+ * Copy a tile between a surface and the task's tile storage.
+ */
+static void
+lp_rast_tile_copy(struct lp_rasterizer_task *task,
+                  enum pipe_format format,
+                  unsigned nr_samples,
+                  uint8_t *surf, unsigned surf_stride,
+                  unsigned surf_sample_stride,
+                  uint8_t *tile, unsigned tile_stride,
+                  unsigned tile_sample_stride,
+                  boolean store)
+{
+   unsigned s;
+
+   for (s = 0; s < nr_samples; s++) {
+      uint8_t *surf_s = surf + s * surf_sample_stride;
+      uint8_t *tile_s = tile + s * tile_sample_stride;
+
+      if (store) {
+         util_copy_rect(surf_s, format, surf_stride, task->x, task->y,
+                        task->width, task->height,
+                        tile_s, tile_stride, 0, 0);
+      }
+      else {
+         util_copy_rect(tile_s, format, tile_stride, 0, 0,
+                        task->width, task->height,
+                        surf_s, surf_stride, task->x, task->y);
+      }
+   }
+}
+
+
+/**
+ * Bins with fewer shading commands than this which would need a buffer
+ * loaded are rendered directly into the surfaces, since loading and
+ * storing the whole tile costs more than the few blocks they touch.
+ */
+#define LP_RAST_RESIDENT_MIN_SHADE_CMDS 8
+
+
+/**
+ * Whether a shading command with the given state may write color buffer
+ * cbuf or the depth/stencil buffer.  Without a state be conservative.
+ */
+static boolean
+lp_rast_state_writes_color(const struct lp_rast_state *state, unsigned cbuf)
+{
+   const struct pipe_blend_state *blend;
+
+   if (!state || !state->variant)
+      return TRUE;
+
+   blend = &state->variant->key.blend;
+   return blend->rt[blend->independent_blend_enable ? cbuf : 0].colormask != 0;
+}
+
+static boolean
+lp_rast_state_writes_zs(const struct lp_rast_state *state)
+{
+   const struct lp_fragment_shader_variant_key *key;
+
+   if (!state || !state->variant)
+      return TRUE;
+
+   key = &state->variant->key;
+   return (key->depth.enabled && key->depth.writemask) ||
+          (key->stencil[0].enabled && key->stencil[0].writemask) ||
+          (key->stencil[1].enabled && key->stencil[1].writemask);
+}
+
+
+/**
+ * Decide whether to render the bin in the task's tile storage, and which
+ * buffers then need loading and storing.
+ *
+ * A buffer needs no load if the bin starts by clearing all of it, and no
+ * store if no command of the bin may write it.
+ */
+static boolean
+lp_rast_tile_plan(struct lp_rasterizer_task *task,
+                  const struct cmd_bin *bin,
+                  boolean color_cleared[PIPE_MAX_COLOR_BUFS],
+                  boolean *zs_cleared)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_rast_state *state = NULL;
+   const struct cmd_block *block;
+   boolean at_head = TRUE;
+   boolean need_load = FALSE;
+   unsigned num_shade_cmds = 0;
+   uint64_t zs_full_mask = 0;
+   unsigned i, k;
+
+   if (scene->fb.zsbuf) {
+      /* Only the bits holding depth and stencil, e.g. not the X24 of
+       * Z32_FLOAT_S8X24_UINT, are in the clear mask.
+       */
+      zs_full_mask = util_pack64_mask_z_stencil(scene->fb.zsbuf->format,
+                                                0xffffffff, 0xff);
+   }
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      color_cleared[i] = FALSE;
+      task->color_written[i] = FALSE;
+   }
+   *zs_cleared = FALSE;
+   task->zs_written = FALSE;
+
+   for (block = bin->head; block; block = block->next) {
+      for (k = 0; k < block->count; k++) {
+         const union lp_rast_cmd_arg arg = block->arg[k];
+
+         switch (block->cmd[k]) {
+         case LP_RAST_OP_CLEAR_COLOR:
+            if (at_head)
+               color_cleared[arg.clear_rb->cbuf] = TRUE;
+            task->color_written[arg.clear_rb->cbuf] = TRUE;
+            break;
+         case LP_RAST_OP_CLEAR_ZSTENCIL:
+            if (at_head &&
+                (arg.clear_zstencil.mask & zs_full_mask) == zs_full_mask)
+               *zs_cleared = TRUE;
+            task->zs_written = TRUE;
+            break;
+         case LP_RAST_OP_SET_STATE:
+            state = arg.set_state;
+            break;
+         case LP_RAST_OP_BEGIN_QUERY:
+         case LP_RAST_OP_END_QUERY:
+            break;
+         default:
+            /* triangles and tile shading */
+            at_head = FALSE;
+            num_shade_cmds++;
+            for (i = 0; i < scene->fb.nr_cbufs; i++) {
+               if (lp_rast_state_writes_color(state, i))
+                  task->color_written[i] = TRUE;
+            }
+            if (lp_rast_state_writes_zs(state))
+               task->zs_written = TRUE;
+            break;
+         }
+      }
+   }
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && !color_cleared[i])
+         need_load = TRUE;
+   }
+   if (scene->fb.zsbuf && !*zs_cleared)
+      need_load = TRUE;
+
+   return !need_load || num_shade_cmds >= LP_RAST_RESIDENT_MIN_SHADE_CMDS;
+}
+
+
+/**
+ * Point the task's color/depth tiles at its tile storage and fill it
+ * with the current contents of the surfaces, if the bin is worth
+ * rendering that way.  Buffers which the bin starts by clearing
+ * completely aren't loaded.
+ */
+static boolean
+lp_rast_tile_load(struct lp_rasterizer_task *task,
+                  const struct cmd_bin *bin)
+{
+   const struct lp_scene *scene = task->scene;
+   boolean color_cleared[PIPE_MAX_COLOR_BUFS];
+   boolean zs_cleared;
+   uint8_t *tile = task->tile_buf;
+   unsigned i;
+
+   if (!lp_rast_tile_plan(task, bin, color_cleared, &zs_cleared))
+      return FALSE;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i]) {
+         unsigned stride = TILE_SIZE * scene->cbufs[i].format_bytes;
+
+         task->color_tiles[i] = tile;
+         task->color_stride[i] = stride;
+         task->color_layer_stride[i] = 0;
+         task->color_sample_stride[i] = stride * TILE_SIZE;
+
+         if (!color_cleared[i]) {
+            lp_rast_tile_copy(task, scene->fb.cbufs[i]->format,
+                              scene->cbufs[i].nr_samples,
+                              scene->cbufs[i].map, scene->cbufs[i].stride,
+                              scene->cbufs[i].sample_stride,
+                              tile, stride, stride * TILE_SIZE, FALSE);
+         }
+
+         tile += stride * TILE_SIZE * scene->cbufs[i].nr_samples;
+      }
+   }
+
+   if (scene->fb.zsbuf) {
+      unsigned stride = TILE_SIZE * scene->zsbuf.format_bytes;
+
+      task->depth_tile = tile;
+      task->depth_stride = stride;
+      task->depth_layer_stride = 0;
+      task->depth_sample_stride = stride * TILE_SIZE;
+
+      if (!zs_cleared) {
+         lp_rast_tile_copy(task, scene->fb.zsbuf->format,
+                           scene->zsbuf.nr_samples,
+                           scene->zsbuf.map, scene->zsbuf.stride,
+                           scene->zsbuf.sample_stride,
+                           tile, stride, stride * TILE_SIZE, FALSE);
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Write the buffers the bin may have changed from the task's tile storage
+ * back to the surfaces.
+ */
+static void
+lp_rast_tile_store(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && task->color_written[i]) {
+         lp_rast_tile_copy(task, scene->fb.cbufs[i]->format,
+                           scene->cbufs[i].nr_samples,
+                           scene->cbufs[i].map, scene->cbufs[i].stride,
+                           scene->cbufs[i].sample_stride,
+                           task->color_tiles[i], task->color_stride[i],
+                           task->color_sample_stride[i], TRUE);
+      }
+   }
+
+   if (scene->fb.zsbuf && task->zs_written) {
+      lp_rast_tile_copy(task, scene->fb.zsbuf->format,
+                        scene->zsbuf.nr_samples,
+                        scene->zsbuf.map, scene->zsbuf.stride,
+                        scene->zsbuf.sample_stride,
+                        task->depth_tile, task->depth_stride,
+                        task->depth_sample_stride, TRUE);
+   }
+}
+
+
 /**
  * Beginning rasterization of a tile.
  * \param x  window X position of the tile, in pixels
@@ -109,17 +406,28 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
 
+   task->tile_resident = task->scene_resident &&
+                         lp_rast_tile_load(task, bin);
+   if (task->tile_resident)
+      return;
+
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
          task->color_tiles[i] = scene->cbufs[i].map +
                                 scene->cbufs[i].stride * task->y +
                                 scene->cbufs[i].format_bytes * task->x;
+         task->color_stride[i] = scene->cbufs[i].stride;
+         task->color_layer_stride[i] = scene->cbufs[i].layer_stride;
+         task->color_sample_stride[i] = scene->cbufs[i].sample_stride;
       }
    }
    if (task->scene->fb.zsbuf) {
       task->depth_tile = scene->zsbuf.map +
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
+      task->depth_stride = scene->zsbuf.stride;
+      task->depth_layer_stride = scene->zsbuf.layer_stride;
+      task->depth_sample_stride = scene->zsbuf.sample_stride;
    }
 }
 
@@ -137,6 +445,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
    unsigned cbuf = arg.clear_rb->cbuf;
    union util_color uc;
    enum pipe_format format;
+   unsigned s;
 
    /* we never bin clear commands for non-existing buffers */
    assert(cbuf < scene->fb.nr_cbufs);
@@ -153,17 +462,20 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
           __FUNCTION__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
 
 
-   util_fill_box(scene->cbufs[cbuf].map,
-                 format,
-                 scene->cbufs[cbuf].stride,
-                 scene->cbufs[cbuf].layer_stride,
-                 task->x,
-                 task->y,
-                 0,
-                 task->width,
-                 task->height,
-                 scene->fb_max_layer + 1,
-                 &uc);
+   for (s = 0; s < scene->cbufs[cbuf].nr_samples; s++) {
+      util_fill_box(task->color_tiles[cbuf] +
+                       s * task->color_sample_stride[cbuf],
+                    format,
+                    task->color_stride[cbuf],
+                    task->color_layer_stride[cbuf],
+                    0,
+                    0,
+                    0,
+                    task->width,
+                    task->height,
+                    scene->fb_max_layer + 1,
+                    &uc);
+   }
 
    /* this will increase for each rb which probably doesn't mean much */
    LP_COUNT(nr_color_tile_clear);
@@ -186,7 +498,7 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
    uint32_t clear_mask = (uint32_t) clear_mask64;
    const unsigned height = task->height;
    const unsigned width = task->width;
-   const unsigned dst_stride = scene->zsbuf.stride;
+   const unsigned dst_stride = task->depth_stride;
    uint8_t *dst;
    unsigned i, j;
    unsigned block_size;
@@ -199,87 +511,91 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
     */
 
    if (scene->fb.zsbuf) {
-      unsigned layer;
-      uint8_t *dst_layer = task->depth_tile;
+      unsigned layer, s;
+      uint8_t *dst_layer;
       block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
 
       clear_value &= clear_mask;
 
-      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
-         dst = dst_layer;
-
-         switch (block_size) {
-         case 1:
-            assert(clear_mask == 0xff);
-            memset(dst, (uint8_t) clear_value, height * width);
-            break;
-         case 2:
-            if (clear_mask == 0xffff) {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = (uint16_t) clear_value;
-                  dst += dst_stride;
+      for (s = 0; s < scene->zsbuf.nr_samples; s++) {
+         dst_layer = task->depth_tile + s * task->depth_sample_stride;
+
+         for (layer = 0; layer <= scene->fb_max_layer; layer++) {
+            dst = dst_layer;
+
+            switch (block_size) {
+            case 1:
+               assert(clear_mask == 0xff);
+               memset(dst, (uint8_t) clear_value, height * width);
+               break;
+            case 2:
+               if (clear_mask == 0xffff) {
+                  for (i = 0; i < height; i++) {
+                     uint16_t *row = (uint16_t *)dst;
+                     for (j = 0; j < width; j++)
+                        *row++ = (uint16_t) clear_value;
+                     dst += dst_stride;
+                  }
                }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint16_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
+               else {
+                  for (i = 0; i < height; i++) {
+                     uint16_t *row = (uint16_t *)dst;
+                     for (j = 0; j < width; j++) {
+                        uint16_t tmp = ~clear_mask & *row;
+                        *row++ = clear_value | tmp;
+                     }
+                     dst += dst_stride;
                   }
-                  dst += dst_stride;
                }
-            }
-            break;
-         case 4:
-            if (clear_mask == 0xffffffff) {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value;
-                  dst += dst_stride;
+               break;
+            case 4:
+               if (clear_mask == 0xffffffff) {
+                  for (i = 0; i < height; i++) {
+                     uint32_t *row = (uint32_t *)dst;
+                     for (j = 0; j < width; j++)
+                        *row++ = clear_value;
+                     dst += dst_stride;
+                  }
                }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint32_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
+               else {
+                  for (i = 0; i < height; i++) {
+                     uint32_t *row = (uint32_t *)dst;
+                     for (j = 0; j < width; j++) {
+                        uint32_t tmp = ~clear_mask & *row;
+                        *row++ = clear_value | tmp;
+                     }
+                     dst += dst_stride;
                   }
-                  dst += dst_stride;
                }
-            }
-            break;
-         case 8:
-            clear_value64 &= clear_mask64;
-            if (clear_mask64 == 0xffffffffffULL) {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value64;
-                  dst += dst_stride;
+               break;
+            case 8:
+               clear_value64 &= clear_mask64;
+               if (clear_mask64 == 0xffffffffffULL) {
+                  for (i = 0; i < height; i++) {
+                     uint64_t *row = (uint64_t *)dst;
+                     for (j = 0; j < width; j++)
+                        *row++ = clear_value64;
+                     dst += dst_stride;
+                  }
                }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint64_t tmp = ~clear_mask64 & *row;
-                     *row++ = clear_value64 | tmp;
+               else {
+                  for (i = 0; i < height; i++) {
+                     uint64_t *row = (uint64_t *)dst;
+                     for (j = 0; j < width; j++) {
+                        uint64_t tmp = ~clear_mask64 & *row;
+                        *row++ = clear_value64 | tmp;
+                     }
+                     dst += dst_stride;
                   }
-                  dst += dst_stride;
                }
-            }
-            break;
+               break;
 
-         default:
-            assert(0);
-            break;
+            default:
+               assert(0);
+               break;
+            }
+            dst_layer += task->depth_layer_stride;
          }
-         dst_layer += scene->zsbuf.layer_stride;
       }
    }
 }
@@ -300,6 +616,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
+   const uint64_t full_mask = lp_rast_full_mask(scene);
    unsigned x, y;
 
    if (inputs->disable) {
@@ -321,19 +638,24 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
       for (x = 0; x < task->width; x += 4) {
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
+         unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
          uint8_t *depth = NULL;
          unsigned depth_stride = 0;
+         unsigned depth_sample_stride = 0;
+         lp_jit_frag_func shade;
          unsigned i;
 
          /* color buffer */
          for (i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
-               stride[i] = scene->cbufs[i].stride;
+               stride[i] = task->color_stride[i];
+               sample_stride[i] = task->color_sample_stride[i];
                color[i] = lp_rast_get_color_block_pointer(task, i, tile_x + x,
                                                           tile_y + y, inputs->layer);
             }
             else {
                stride[i] = 0;
+               sample_stride[i] = 0;
                color[i] = NULL;
             }
          }
@@ -342,26 +664,32 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          if (scene->zsbuf.map) {
             depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
                                                     tile_y + y, inputs->layer);
-            depth_stride = scene->zsbuf.stride;
+            depth_stride = task->depth_stride;
+            depth_sample_stride = task->depth_sample_stride;
          }
 
          /* Propagate non-interpolated raster state. */
          task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+         /* The optimized code may be swapped in by the compile queue */
+         shade = p_atomic_read(&variant->jit_function[RAST_WHOLE]);
+
          /* run shader on 4x4 block */
          BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+         shade(&state->jit_context,
+               tile_x + x, tile_y + y,
+               inputs->frontfacing,
+               GET_A0(inputs),
+               GET_DADX(inputs),
+               GET_DADY(inputs),
+               color,
+               depth,
+               full_mask,
+               &task->thread_data,
+               stride,
+               depth_stride,
+               sample_stride,
+               depth_sample_stride);
          END_JIT_CALL();
       }
    }
@@ -393,20 +721,26 @@ lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
  * This is a bin command called during bin processing.
  * \param x  X position of quad in window coords
  * \param y  Y position of quad in window coords
+ * \param mask  coverage mask, 16 bits per sample.  If the primitive
+ *              wasn't rasterized per sample only the pixel mask in the
+ *              low 16 bits is used.
  */
 void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
                          unsigned x, unsigned y,
-                         unsigned mask)
+                         uint64_t mask)
 {
    const struct lp_rast_state *state = task->state;
    struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_scene *scene = task->scene;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
+   lp_jit_frag_func shade;
    unsigned i;
 
    assert(state);
@@ -420,22 +754,33 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    assert((x % 4) == 0);
    assert((y % 4) == 0);
 
+   /* Lines, points and non-multisample rasterization cover all samples
+    * of a pixel or none.
+    */
+   if (!inputs->multisample && scene->fb_max_samples > 1) {
+      mask = ((mask & 0xffff) * 0x0001000100010001ULL) &
+             lp_rast_full_mask(scene);
+   }
+
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_stride[i];
+         sample_stride[i] = task->color_sample_stride[i];
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
 
    /* depth buffer */
    if (scene->zsbuf.map) {
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
+      depth_sample_stride = task->depth_sample_stride;
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
    }
 
@@ -453,20 +798,25 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      /* The optimized code may be swapped in by the compile queue */
+      shade = p_atomic_read(&variant->jit_function[RAST_EDGE_TEST]);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
-                                            x, y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            mask,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+      shade(&state->jit_context,
+            x, y,
+            inputs->frontfacing,
+            GET_A0(inputs),
+            GET_DADX(inputs),
+            GET_DADY(inputs),
+            color,
+            depth,
+            mask,
+            &task->thread_data,
+            stride,
+            depth_stride,
+            sample_stride,
+            depth_sample_stride);
       END_JIT_CALL();
    }
 }
@@ -555,6 +905,11 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
 
+   if (task->tile_resident) {
+      lp_rast_tile_store(task);
+      task->tile_resident = FALSE;
+   }
+
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
@@ -679,17 +1034,37 @@ rasterize_scene(struct lp_rasterizer_task *task,
 #endif
 #endif
 
+   task->scene_resident = FALSE;
+   if (task->rast->tile_resident) {
+      unsigned size = lp_rast_tile_buf_size(scene);
+
+      if (size > task->tile_buf_size) {
+         align_free(task->tile_buf);
+         task->tile_buf = align_malloc(size, 64);
+         task->tile_buf_size = task->tile_buf ? size : 0;
+      }
+      task->scene_resident = size && task->tile_buf;
+   }
+
    if (!task->rast->no_rast && !scene->discard) {
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
+         int64_t t0 = 0;
          int i, j;
 
+         if (LP_DEBUG & DEBUG_COUNTERS)
+            t0 = os_time_get();
+
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                             &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
+
+         if (LP_DEBUG & DEBUG_COUNTERS)
+            LP_COUNT_ADD(rast_time[task->thread_index], os_time_get() - t0);
       }
    }
 
@@ -777,6 +1152,62 @@ lp_rast_finish( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Grab jobs from the shared counter until there are none left.
+ */
+static void
+run_jobs( struct lp_rasterizer *rast, unsigned thread_index )
+{
+   unsigned job;
+
+   while ((job = p_atomic_inc_return(&rast->jobs.next_job) - 1) <
+          rast->jobs.num_jobs) {
+      rast->jobs.func(rast->jobs.data, job, thread_index);
+   }
+}
+
+
+/**
+ * Run num_jobs calls of func on the rasterizer threads, and wait for them
+ * to complete.  The threads must be idle, i.e. the caller must hold the
+ * screen's rast_mutex like the scene submission path does.
+ */
+void
+lp_rast_run_jobs( struct lp_rasterizer *rast,
+                  lp_rast_job_func func,
+                  void *data,
+                  unsigned num_jobs )
+{
+   rast->jobs.func = func;
+   rast->jobs.data = data;
+   rast->jobs.num_jobs = num_jobs;
+   rast->jobs.next_job = 0;
+
+   if (rast->num_threads == 0) {
+      /* no threading */
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+
+      run_jobs(rast, 0);
+
+      util_fpstate_set(fpstate);
+   }
+   else {
+      unsigned i;
+
+      for (i = 0; i < rast->num_threads; i++) {
+         pipe_semaphore_signal(&rast->tasks[i].work_ready);
+      }
+
+      lp_rast_finish(rast);
+   }
+
+   rast->jobs.func = NULL;
+   rast->jobs.data = NULL;
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -796,6 +1227,9 @@ thread_function(void *init_data)
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    u_thread_setname(thread_name);
 
+   if (rast->pin_threads)
+      u_thread_pin_to_cpu(task->cpu);
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -811,6 +1245,13 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
+      if (rast->jobs.func) {
+         /* not a scene, see lp_rast_run_jobs() */
+         run_jobs(rast, task->thread_index);
+         pipe_semaphore_signal(&task->work_done);
+         continue;
+      }
+
       if (task->thread_index == 0) {
          /* thread[0]:
           *  - get next scene to rasterize
@@ -875,6 +1316,106 @@ create_rast_threads(struct lp_rasterizer *rast)
 
 
 
+#if defined(__linux__) && defined(HAVE_PTHREAD) && defined(CPU_SET)
+/**
+ * Read a sysfs list like "0-3,8,10-11" into a cpu_set_t.
+ */
+static boolean
+read_sysfs_list(const char *path, cpu_set_t *set)
+{
+   char buf[1024];
+   char *p, *end;
+   FILE *f;
+
+   f = fopen(path, "r");
+   if (!f)
+      return FALSE;
+
+   p = fgets(buf, sizeof buf, f);
+   fclose(f);
+   if (!p)
+      return FALSE;
+
+   CPU_ZERO(set);
+   while (*p >= '0' && *p <= '9') {
+      unsigned long first = strtoul(p, &end, 10), last = first, i;
+
+      if (*end == '-')
+         last = strtoul(end + 1, &end, 10);
+      for (i = first; i <= last && i < CPU_SETSIZE; i++)
+         CPU_SET(i, set);
+
+      p = *end == ',' ? end + 1 : end;
+   }
+
+   return TRUE;
+}
+#endif
+
+
+/**
+ * Choose the CPU each rasterizer thread is bound to with LP_PIN_THREADS.
+ *
+ * Only the CPUs the process may run on are used, ordered node by node, so
+ * that consecutive threads, which rasterize neighbouring bands of tiles,
+ * share a NUMA node.  If there are more threads than CPUs they wrap
+ * around.  Without affinity information thread N is bound to CPU N.
+ */
+static void
+assign_thread_cpus(struct lp_rasterizer *rast)
+{
+   unsigned num_tasks = MAX2(1, rast->num_threads);
+   unsigned i;
+#if defined(__linux__) && defined(HAVE_PTHREAD) && defined(CPU_SET)
+   cpu_set_t allowed, assigned, nodes, node_cpus;
+   unsigned cpus[CPU_SETSIZE];
+   unsigned num_cpus = 0;
+   unsigned node, cpu;
+   char path[64];
+
+   if (sched_getaffinity(0, sizeof allowed, &allowed) == 0) {
+      CPU_ZERO(&assigned);
+
+      /* Nodes may be sparse, so only the online ones are looked at. */
+      if (read_sysfs_list("/sys/devices/system/node/online", &nodes)) {
+         for (node = 0; node < CPU_SETSIZE; node++) {
+            if (!CPU_ISSET(node, &nodes))
+               continue;
+
+            util_snprintf(path, sizeof path,
+                          "/sys/devices/system/node/node%u/cpulist", node);
+            if (!read_sysfs_list(path, &node_cpus))
+               continue;
+
+            for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+               if (CPU_ISSET(cpu, &node_cpus) && CPU_ISSET(cpu, &allowed) &&
+                   !CPU_ISSET(cpu, &assigned)) {
+                  CPU_SET(cpu, &assigned);
+                  cpus[num_cpus++] = cpu;
+               }
+            }
+         }
+      }
+
+      /* CPUs without node information, e.g. kernels without NUMA */
+      for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+         if (CPU_ISSET(cpu, &allowed) && !CPU_ISSET(cpu, &assigned))
+            cpus[num_cpus++] = cpu;
+      }
+   }
+
+   if (num_cpus) {
+      for (i = 0; i < num_tasks; i++)
+         rast->tasks[i].cpu = cpus[i % num_cpus];
+      return;
+   }
+#endif
+
+   for (i = 0; i < num_tasks; i++)
+      rast->tasks[i].cpu = i % util_cpu_caps.nr_cpus;
+}
+
+
 /**
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
@@ -910,6 +1451,11 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->pin_threads = debug_get_bool_option("LP_PIN_THREADS", FALSE);
+   rast->tile_resident = debug_get_bool_option("LP_TILE_RESIDENT", FALSE);
+
+   if (rast->pin_threads)
+      assign_thread_cpus(rast);
 
    create_rast_threads(rast);
 
@@ -970,6 +1516,7 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
    }
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
       align_free(rast->tasks[i].thread_data.cache);
+      align_free(rast->tasks[i].tile_buf);
    }
 
    /* for synchronizing rasterization threads */
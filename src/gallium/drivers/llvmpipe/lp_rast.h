@@ -40,6 +40,7 @@
 #include "pipe/p_compiler.h"
 #include "util/u_pack_color.h"
 #include "lp_jit.h"
+#include "lp_limits.h"
 
 
 struct lp_rasterizer;
@@ -70,6 +71,12 @@ struct cmd_bin;
 
 #define IMUL64(a, b) (((int64_t)(a)) * ((int64_t)(b)))
 
+/**
+ * Sample positions for 4x multisampling, in 1/FIXED_ONE units relative
+ * to the top-left pixel corner.  This is the standard rotated grid.
+ */
+extern const int lp_sample_pos_4x[LP_MAX_SAMPLES][2];
+
 struct lp_rasterizer_task;
 
 
@@ -100,7 +107,8 @@ struct lp_rast_shader_inputs {
    unsigned frontfacing:1;      /** True for front-facing */
    unsigned disable:1;          /** Partially binned, disable this command */
    unsigned opaque:1;           /** Is opaque */
-   unsigned pad0:29;            /* wasted space */
+   unsigned multisample:1;      /** Coverage is computed per sample */
+   unsigned pad0:28;            /* wasted space */
    unsigned stride;             /* how much to advance data between a0, dadx, dady */
    unsigned layer;              /* the layer to render to (from gs, already clamped) */
    unsigned viewport_index;     /* the active viewport index (from gs, already clamped) */
@@ -170,6 +178,22 @@ void
 lp_rast_finish( struct lp_rasterizer *rast );
 
 
+/**
+ * Callback for lp_rast_run_jobs().
+ * \param data          opaque pointer passed to lp_rast_run_jobs()
+ * \param job           index of the job to run, in [0, num_jobs)
+ * \param thread_index  index of the thread running the job
+ */
+typedef void (*lp_rast_job_func)(void *data, unsigned job,
+                                 unsigned thread_index);
+
+void
+lp_rast_run_jobs( struct lp_rasterizer *rast,
+                  lp_rast_job_func func,
+                  void *data,
+                  unsigned num_jobs );
+
+
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
    struct {
@@ -28,6 +28,7 @@
 #ifndef LP_RAST_PRIV_H
 #define LP_RAST_PRIV_H
 
+#include "util/u_atomic.h"
 #include "util/u_format.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
@@ -91,12 +92,41 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /**
+    * Strides for addressing color_tiles/depth_tile.  These are the strides
+    * of the scene's surfaces, or those of tile_buf when the tile is
+    * resident.
+    */
+   unsigned color_stride[PIPE_MAX_COLOR_BUFS];
+   unsigned color_layer_stride[PIPE_MAX_COLOR_BUFS];
+   unsigned color_sample_stride[PIPE_MAX_COLOR_BUFS];
+   unsigned depth_stride;
+   unsigned depth_layer_stride;
+   unsigned depth_sample_stride;
+
+   /**
+    * Per-thread storage holding the current tile's color/depth contents
+    * (LP_TILE_RESIDENT).  Allocated per scene, NULL if the scene renders
+    * directly into the surfaces.
+    */
+   uint8_t *tile_buf;
+   unsigned tile_buf_size;
+   boolean scene_resident;  /**< tile_buf may be used for the current scene */
+   boolean tile_resident;   /**< tile_buf is used for the current tile */
+
+   /** Buffers the current tile's bin may write, stored at tile end */
+   boolean color_written[PIPE_MAX_COLOR_BUFS];
+   boolean zs_written;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
    /** "my" index */
    unsigned thread_index;
 
+   /** CPU the thread is bound to with LP_PIN_THREADS */
+   unsigned cpu;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
@@ -116,6 +146,8 @@ struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
+   boolean pin_threads;  /**< Bind threads to CPUs (LP_PIN_THREADS) */
+   boolean tile_resident;  /**< Render tiles in per-thread storage (LP_TILE_RESIDENT) */
 
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
@@ -131,6 +163,14 @@ struct lp_rasterizer
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
+
+   /** Non-rasterization work handed out by lp_rast_run_jobs() */
+   struct {
+      lp_rast_job_func func;
+      void *data;
+      unsigned num_jobs;
+      unsigned next_job;
+   } jobs;
 };
 
 
@@ -138,7 +178,18 @@ void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
                          unsigned x, unsigned y,
-                         unsigned mask);
+                         uint64_t mask);
+
+
+/**
+ * Coverage mask of a fully covered 4x4 block.  There are 16 bits per
+ * sample, sample 0 in the low bits.
+ */
+static inline uint64_t
+lp_rast_full_mask(const struct lp_scene *scene)
+{
+   return ~(uint64_t)0 >> (64 - 16 * scene->fb_max_samples);
+}
 
 
 /**
@@ -170,11 +221,11 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    py = y % TILE_SIZE;
 
    pixel_offset = px * task->scene->cbufs[buf].format_bytes +
-                  py * task->scene->cbufs[buf].stride;
+                  py * task->color_stride[buf];
    color = task->color_tiles[buf] + pixel_offset;
 
    if (layer) {
-      color += layer * task->scene->cbufs[buf].layer_stride;
+      color += layer * task->color_layer_stride[buf];
    }
 
    assert(lp_check_alignment(color, llvmpipe_get_format_alignment(task->scene->fb.cbufs[buf]->format)));
@@ -204,11 +255,11 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
    py = y % TILE_SIZE;
 
    pixel_offset = px * task->scene->zsbuf.format_bytes +
-                  py * task->scene->zsbuf.stride;
+                  py * task->depth_stride;
    depth = task->depth_tile + pixel_offset;
 
    if (layer) {
-      depth += layer * task->scene->zsbuf.layer_stride;
+      depth += layer * task->depth_layer_stride;
    }
 
    assert(lp_check_alignment(depth, llvmpipe_get_format_alignment(task->scene->fb.zsbuf->format)));
@@ -232,26 +283,32 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    struct lp_fragment_shader_variant *variant = state->variant;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
+   lp_jit_frag_func shade;
    unsigned i;
 
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_stride[i];
+         sample_stride[i] = task->color_sample_stride[i];
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
 
    if (scene->zsbuf.map) {
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
+      depth_sample_stride = task->depth_sample_stride;
    }
 
    /*
@@ -266,20 +323,25 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      /* The optimized code may be swapped in by the compile queue */
+      shade = p_atomic_read(&variant->jit_function[RAST_WHOLE]);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                         x, y,
-                                         inputs->frontfacing,
-                                         GET_A0(inputs),
-                                         GET_DADX(inputs),
-                                         GET_DADY(inputs),
-                                         color,
-                                         depth,
-                                         0xffff,
-                                         &task->thread_data,
-                                         stride,
-                                         depth_stride);
+      shade(&state->jit_context,
+            x, y,
+            inputs->frontfacing,
+            GET_A0(inputs),
+            GET_DADX(inputs),
+            GET_DADY(inputs),
+            color,
+            depth,
+            lp_rast_full_mask(scene),
+            &task->thread_data,
+            stride,
+            depth_stride,
+            sample_stride,
+            depth_sample_stride);
       END_JIT_CALL();
    }
 }
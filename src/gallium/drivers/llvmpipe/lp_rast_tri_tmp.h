@@ -46,19 +46,40 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
                 int x, int y,
                 const int64_t *c)
 {
-   unsigned mask = 0xffff;
+   uint64_t mask = 0;
+   unsigned num_samples = 1;
+   unsigned s;
    int j;
 
-   for (j = 0; j < NR_PLANES; j++) {
+   if (tri->inputs.multisample)
+      num_samples = task->scene->fb_max_samples;
+
+   for (s = 0; s < num_samples; s++) {
+      unsigned sample_mask = 0xffff;
+
+      for (j = 0; j < NR_PLANES; j++) {
+         int64_t cs = c[j];
+
+         /* Planes of multisampled triangles are relative to the pixel
+          * corner, and dcdx/dcdy are in 1/FIXED_ONE pixel units there.
+          */
+         if (tri->inputs.multisample) {
+            cs -= IMUL64(plane[j].dcdx >> FIXED_ORDER, lp_sample_pos_4x[s][0]);
+            cs += IMUL64(plane[j].dcdy >> FIXED_ORDER, lp_sample_pos_4x[s][1]);
+         }
+
 #ifdef RASTER_64
-      mask &= ~BUILD_MASK_LINEAR(((c[j] - 1) >> (int64_t)FIXED_ORDER),
-                                 -plane[j].dcdx >> FIXED_ORDER,
-                                 plane[j].dcdy >> FIXED_ORDER);
+         sample_mask &= ~BUILD_MASK_LINEAR(((cs - 1) >> (int64_t)FIXED_ORDER),
+                                           -plane[j].dcdx >> FIXED_ORDER,
+                                           plane[j].dcdy >> FIXED_ORDER);
 #else
-      mask &= ~BUILD_MASK_LINEAR((c[j] - 1),
-                                 -plane[j].dcdx,
-                                 plane[j].dcdy);
+         sample_mask &= ~BUILD_MASK_LINEAR((cs - 1),
+                                           -plane[j].dcdx,
+                                           plane[j].dcdy);
 #endif
+      }
+
+      mask |= (uint64_t)sample_mask << (16 * s);
    }
 
    /* Now pass to the shader:
@@ -31,9 +31,11 @@
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
+#include "util/u_atomic.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -62,7 +64,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
 
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
@@ -90,7 +91,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -160,6 +160,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
       if (!cbuf) {
          scene->cbufs[i].stride = 0;
          scene->cbufs[i].layer_stride = 0;
+         scene->cbufs[i].sample_stride = 0;
+         scene->cbufs[i].nr_samples = 1;
          scene->cbufs[i].map = NULL;
          continue;
       }
@@ -175,6 +177,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                      cbuf->u.tex.first_layer,
                                                      LP_TEX_USAGE_READ_WRITE);
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].sample_stride =
+            llvmpipe_resource(cbuf->texture)->sample_stride;
+         scene->cbufs[i].nr_samples = MAX2(cbuf->texture->nr_samples, 1);
       }
       else {
          struct llvmpipe_resource *lpr = llvmpipe_resource(cbuf->texture);
@@ -184,6 +189,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
          scene->cbufs[i].map = lpr->data;
          scene->cbufs[i].map += cbuf->u.buf.first_element * pixstride;
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].sample_stride = 0;
+         scene->cbufs[i].nr_samples = 1;
       }
    }
 
@@ -197,6 +204,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                zsbuf->u.tex.first_layer,
                                                LP_TEX_USAGE_READ_WRITE);
       scene->zsbuf.format_bytes = util_format_get_blocksize(zsbuf->format);
+      scene->zsbuf.sample_stride =
+         llvmpipe_resource(zsbuf->texture)->sample_stride;
+      scene->zsbuf.nr_samples = MAX2(zsbuf->texture->nr_samples, 1);
    }
 }
 
@@ -449,61 +459,142 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Estimated cost of rasterizing a bin: its number of commands.
+ */
+static unsigned
+bin_cost(const struct cmd_bin *bin)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
+   const struct cmd_block *block;
+   unsigned cost = 0;
+
+   for (block = bin->head; block; block = block->next)
+      cost += block->count;
+
+   return cost;
 }
 
 
+static int
+compare_bin_cost(const void *a, const void *b)
+{
+   const struct lp_scene_bin_ref *ra = (const struct lp_scene_bin_ref *) a;
+   const struct lp_scene_bin_ref *rb = (const struct lp_scene_bin_ref *) b;
+
+   /* most expensive first */
+   if (ra->cost != rb->cost)
+      return ra->cost < rb->cost ? 1 : -1;
+   return 0;
+}
+
+
+/**
+ * Fill the per-thread bin deques.  Empty bins are left out entirely.
+ * Called once per scene, before any thread calls lp_scene_bin_iter_next().
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
+{
+   unsigned num_tiles = scene->tiles_x * scene->tiles_y;
+   unsigned n = 0;
+   unsigned i, tile;
+
+   scene->num_bands = MAX2(1, num_threads);
+   assert(scene->num_bands <= LP_MAX_THREADS);
+
+   tile = 0;
+   for (i = 0; i < scene->num_bands; i++) {
+      unsigned band_end = num_tiles * (i + 1) / scene->num_bands;
+      unsigned first = n;
+
+      for (; tile < band_end; tile++) {
+         unsigned x = tile % scene->tiles_x;
+         unsigned y = tile / scene->tiles_x;
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+
+         if (bin->head) {
+            scene->bin_order[n].cost = bin_cost(bin);
+            scene->bin_order[n].x = x;
+            scene->bin_order[n].y = y;
+            n++;
+         }
+      }
+
+      qsort(&scene->bin_order[first], n - first,
+            sizeof scene->bin_order[0], compare_bin_cost);
+
+      scene->band[i].range = (uint64_t) first | ((uint64_t) n << 32);
+   }
+}
+
+
+/**
+ * Claim a bin from the front (owner) or back (thief) of a deque.
+ * Returns FALSE if the deque is empty.
+ */
+static boolean
+band_pop(struct lp_scene_band *band, boolean front, unsigned *index)
 {
-   scene->curr_x = scene->curr_y = -1;
+   uint64_t range = p_atomic_read(&band->range);
+
+   for (;;) {
+      unsigned first = (unsigned) range;
+      unsigned last = (unsigned) (range >> 32);
+      uint64_t new_range, old_range;
+
+      if (first >= last)
+         return FALSE;
+
+      if (front) {
+         *index = first;
+         new_range = (uint64_t) (first + 1) | ((uint64_t) last << 32);
+      }
+      else {
+         *index = last - 1;
+         new_range = (uint64_t) first | ((uint64_t) (last - 1) << 32);
+      }
+
+      old_range = p_atomic_cmpxchg(&band->range, range, new_range);
+      if (old_range == range)
+         return TRUE;
+      range = old_range;
+   }
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered by the given thread.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  A thread first empties its own deque,
+ * most expensive bins first, then steals the cheapest remaining bins
+ * from the following threads' deques.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned i, index;
 
-   mtx_lock(&scene->mutex);
+   assert(thread_index < scene->num_bands);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+   for (i = 0; i < scene->num_bands; i++) {
+      unsigned b = (thread_index + i) % scene->num_bands;
+
+      if (band_pop(&scene->band[b], i == 0, &index)) {
+         *x = scene->bin_order[index].x;
+         *y = scene->bin_order[index].y;
+
+         if (i == 0)
+            LP_COUNT(nr_bins[thread_index]);
+         else
+            LP_COUNT(nr_stolen_bins[thread_index]);
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+         return lp_scene_get_bin(scene, *x, *y);
+      }
+   }
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   /* no more bins left */
+   return NULL;
 }
 
 
@@ -546,6 +637,10 @@ void lp_scene_begin_binning( struct lp_scene *scene,
       max_layer = MIN2(max_layer, zsbuf->u.tex.last_layer - zsbuf->u.tex.first_layer);
    }
    scene->fb_max_layer = max_layer;
+
+   scene->fb_max_samples = util_framebuffer_get_num_samples(&scene->fb);
+   assert(scene->fb_max_samples == 1 ||
+          scene->fb_max_samples == LP_MAX_SAMPLES);
 }
 
 
@@ -117,6 +117,31 @@ struct data_block_list {
 
 struct resource_ref;
 
+/**
+ * A non-empty bin queued for rasterization, with its estimated cost.
+ */
+struct lp_scene_bin_ref {
+   unsigned cost;           /**< number of commands in the bin */
+   uint16_t x, y;
+};
+
+
+/**
+ * Per-thread deque of bins, as a slice of lp_scene::bin_order sorted by
+ * decreasing cost.  The owning thread pops from the front, so it starts
+ * with its most expensive bins; other threads steal from the back.
+ * Both ends live in a single word so that either side can claim a bin
+ * with one compare-and-swap.
+ *
+ * Padded to a cache line so that threads working on different deques
+ * don't contend on the same line.
+ */
+struct lp_scene_band {
+   uint64_t range;          /**< front index | back index << 32 */
+   uint8_t pad[64 - sizeof(uint64_t)];
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -143,11 +168,16 @@ struct lp_scene {
       unsigned stride;
       unsigned layer_stride;
       unsigned format_bytes;
+      unsigned sample_stride;
+      unsigned nr_samples;
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
 
    /* The amount of layers in the fb (minimum of all attachments) */
    unsigned fb_max_layer;
 
+   /* The number of samples per pixel of the fb (1 if not multisampled) */
+   unsigned fb_max_samples;
+
    /** the framebuffer to render the scene into */
    struct pipe_framebuffer_state fb;
 
@@ -173,8 +203,16 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /**
+    * For iterating over bins.  The tiles are split, in raster order, into
+    * one contiguous band per rasterizer thread.  Each thread works through
+    * its own band first and only then steals from the others, so a
+    * thread keeps touching the same region of the framebuffer from scene
+    * to scene.
+    */
+   unsigned num_bands;
+   struct lp_scene_band band[LP_MAX_THREADS];
+   struct lp_scene_bin_ref bin_order[TILES_X * TILES_Y];
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -379,10 +417,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y );
 
 
 
@@ -32,10 +32,14 @@
 #include "util/u_format.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/disk_cache.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_misc.h"
+#include "gallivm/lp_bld_debug.h"
 
 #include "os/os_misc.h"
 #include "util/os_time.h"
@@ -208,7 +212,13 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      /*
+       * TGSI compute shaders with shader buffers and shared memory only.
+       * Without images and atomic counters the state tracker doesn't
+       * expose ARB_compute_shader, so this is only reachable through
+       * gallium directly, see lp_test_cs.
+       */
+      return 1;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_VERTEX_BUFFER_OFFSET_4BYTE_ALIGNED_ONLY:
@@ -224,7 +234,7 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_CONSTANT_BUFFER_OFFSET_ALIGNMENT:
       return 16;
    case PIPE_CAP_TEXTURE_MULTISAMPLE:
-      return 0;
+      return 1;
    case PIPE_CAP_MIN_MAP_BUFFER_ALIGNMENT:
       return 64;
    case PIPE_CAP_TEXTURE_BUFFER_OBJECTS:
@@ -400,11 +410,76 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      /* no texturing in compute shaders yet */
+      case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
+      case PIPE_SHADER_CAP_MAX_SAMPLER_VIEWS:
+         return 0;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
 }
 
+
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 64;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -458,8 +533,21 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
           target == PIPE_TEXTURE_CUBE ||
           target == PIPE_TEXTURE_CUBE_ARRAY);
 
-   if (sample_count > 1)
-      return FALSE;
+   if (sample_count > 1) {
+      if (sample_count != LP_MAX_SAMPLES)
+         return FALSE;
+      if (target != PIPE_TEXTURE_2D &&
+          target != PIPE_TEXTURE_2D_ARRAY)
+         return FALSE;
+      if (format == PIPE_FORMAT_NONE ||
+          util_format_is_compressed(format))
+         return FALSE;
+      if (bind & (PIPE_BIND_DISPLAY_TARGET |
+                  PIPE_BIND_SCANOUT |
+                  PIPE_BIND_SHARED |
+                  PIPE_BIND_SHADER_IMAGE))
+         return FALSE;
+   }
 
    if (bind & PIPE_BIND_RENDER_TARGET) {
       if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
@@ -561,11 +649,16 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
 
+   if (util_queue_is_initialized(&screen->fs_compile_queue))
+      util_queue_destroy(&screen->fs_compile_queue);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
    lp_jit_screen_cleanup(screen);
 
+   disk_cache_destroy(screen->disk_shader_cache);
+
    if(winsys->destroy)
       winsys->destroy(winsys);
 
@@ -616,6 +709,124 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+static struct disk_cache *
+llvmpipe_get_disk_shader_cache(struct pipe_screen *_screen)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   return screen->disk_shader_cache;
+}
+
+/**
+ * The CPU features gallivm generates code for, after LP_FORCE_SSE2 and
+ * friends have masked util_cpu_caps. These are what end up in the MAttrs
+ * handed to LLVM, so two runs on the same CPU can still produce code for
+ * different instruction sets.
+ */
+static uint32_t
+lp_cpu_features(void)
+{
+   return (util_cpu_caps.has_sse      <<  0) |
+          (util_cpu_caps.has_sse2     <<  1) |
+          (util_cpu_caps.has_sse3     <<  2) |
+          (util_cpu_caps.has_ssse3    <<  3) |
+          (util_cpu_caps.has_sse4_1   <<  4) |
+          (util_cpu_caps.has_sse4_2   <<  5) |
+          (util_cpu_caps.has_avx      <<  6) |
+          (util_cpu_caps.has_avx2     <<  7) |
+          (util_cpu_caps.has_f16c     <<  8) |
+          (util_cpu_caps.has_fma      <<  9) |
+          (util_cpu_caps.has_avx512f  << 10) |
+          (util_cpu_caps.has_avx512bw << 11) |
+          (util_cpu_caps.has_avx512vl << 12) |
+          (util_cpu_caps.has_altivec  << 13);
+}
+
+/**
+ * Create the on-disk cache for JIT'd shader code.
+ *
+ * The generated code depends on the Mesa and LLVM builds, on the host CPU
+ * LLVM targets, on the CPU features gallivm enables for it and on the
+ * vector width gallivm picked, so all of those go into the cache identity.
+ */
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   uint32_t mesa_timestamp, llvm_timestamp;
+   uint64_t driver_flags;
+   char timestamp_str[128];
+   char *cpu_name;
+
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   cpu_name = lp_get_host_cpu_name();
+   if (!cpu_name)
+      return;
+
+   util_snprintf(timestamp_str, sizeof(timestamp_str), "%u_%u_%s_%x_%u",
+                 mesa_timestamp, llvm_timestamp, cpu_name, lp_cpu_features(),
+                 lp_native_vector_width);
+   free(cpu_name);
+
+   /* These flags affect shader compilation. */
+   driver_flags = (uint64_t)LP_PERF | ((uint64_t)gallivm_debug << 32);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", timestamp_str,
+                                                 driver_flags);
+}
+
+/**
+ * Look up the machine code for a shader in the disk cache.
+ * On a hit, cache->data receives a malloc'ed copy of the object.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          const unsigned char ir_sha1_cache_key[20])
+{
+   cache_key key;
+   size_t binary_size;
+   void *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          key);
+
+   buffer = disk_cache_get(screen->disk_shader_cache, key, &binary_size);
+   if (!buffer) {
+      cache->data_size = 0;
+      return;
+   }
+
+   cache->data = buffer;
+   cache->data_size = binary_size;
+}
+
+/**
+ * Store freshly generated machine code for a shader in the disk cache.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            const unsigned char ir_sha1_cache_key[20])
+{
+   cache_key key;
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          key);
+   disk_cache_put(screen->disk_shader_cache, key, cache->data,
+                  cache->data_size, NULL);
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -652,6 +863,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -660,6 +872,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_disk_shader_cache = llvmpipe_get_disk_shader_cache;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -678,5 +891,19 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   lp_disk_cache_create(screen);
+
+   /* New fragment shader variants are first compiled without optimizations
+    * and then recompiled in the background, so that draws don't stall on
+    * LLVM's optimizer.
+    */
+   if (screen->num_threads &&
+       debug_get_bool_option("LP_ASYNC_COMPILE", TRUE)) {
+      util_queue_init(&screen->fs_compile_queue, "llvmpipe_fs", 64,
+                      MAX2(1, screen->num_threads / 4),
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
+   }
+
    return &screen->base;
 }
@@ -689,6 +689,18 @@ lp_setup_set_stencil_ref_values( struct lp_setup_context *setup,
    }
 }
 
+void
+lp_setup_set_sample_mask( struct lp_setup_context *setup,
+                          uint32_t sample_mask )
+{
+   LP_DBG(DEBUG_SETUP, "%s 0x%x\n", __FUNCTION__, sample_mask);
+
+   if (setup->fs.current.jit_context.sample_mask != sample_mask) {
+      setup->fs.current.jit_context.sample_mask = sample_mask;
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+}
+
 void
 lp_setup_set_blend_color( struct lp_setup_context *setup,
                           const struct pipe_blend_color *blend_color )
@@ -740,6 +752,19 @@ lp_setup_set_rasterizer_discard( struct lp_setup_context *setup,
    }
 }
 
+/**
+ * Enable per-sample coverage for triangles.  Only meaningful when
+ * the bound framebuffer is multisampled.
+ */
+void
+lp_setup_set_multisample( struct lp_setup_context *setup,
+                          boolean multisample )
+{
+   LP_DBG(DEBUG_SETUP, "%s\n", __FUNCTION__);
+
+   setup->multisample = multisample;
+}
+
 void 
 lp_setup_set_vertex_info( struct lp_setup_context *setup,
                           struct vertex_info *vertex_info )
@@ -843,6 +868,8 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                jit_tex->mip_offsets[0] = 0;
                jit_tex->row_stride[0] = 0;
                jit_tex->img_stride[0] = 0;
+               jit_tex->num_samples = 1;
+               jit_tex->sample_stride = 0;
             }
             else {
                jit_tex->width = res->width0;
@@ -850,6 +877,8 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                jit_tex->depth = res->depth0;
                jit_tex->first_level = first_level;
                jit_tex->last_level = last_level;
+               jit_tex->num_samples = MAX2(res->nr_samples, 1);
+               jit_tex->sample_stride = lp_tex->sample_stride;
 
                if (llvmpipe_resource_is_texture(res)) {
                   for (j = first_level; j <= last_level; j++) {
@@ -916,6 +945,8 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
             jit_tex->height = res->height0;
             jit_tex->depth = res->depth0;
             jit_tex->first_level = jit_tex->last_level = 0;
+            jit_tex->num_samples = 1;
+            jit_tex->sample_stride = 0;
             assert(jit_tex->base);
          }
       }
@@ -1347,6 +1378,8 @@ lp_setup_create( struct pipe_context *pipe,
    
    setup->dirty = ~0;
 
+   setup->fs.current.jit_context.sample_mask = ~0;
+
    /* Initialize empty default fb correctly, so the rect is empty */
    setup->framebuffer.x1 = -1;
    setup->framebuffer.y1 = -1;
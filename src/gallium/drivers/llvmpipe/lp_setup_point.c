@@ -486,6 +486,7 @@ try_setup_point( struct lp_setup_context *setup,
 
    point->inputs.disable = FALSE;
    point->inputs.opaque = FALSE;
+   point->inputs.multisample = FALSE;
    point->inputs.layer = layer;
    point->inputs.viewport_index = viewport_index;
 
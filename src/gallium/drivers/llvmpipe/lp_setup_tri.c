@@ -319,6 +319,15 @@ do_triangle_ccw(struct lp_setup_context *setup,
       /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
       bbox.y0 = (MIN3(position->y[0], position->y[1], position->y[2]) + adj) >> FIXED_ORDER;
       bbox.y1 = (MAX3(position->y[0], position->y[1], position->y[2]) - 1 + adj) >> FIXED_ORDER;
+
+      /* Sample positions span the whole pixel, not just its center, so
+       * a triangle may touch samples of the pixel past the last center
+       * it covers.
+       */
+      if (setup->multisample) {
+         bbox.x1++;
+         bbox.y1++;
+      }
    }
 
    if (bbox.x1 < bbox.x0 ||
@@ -384,6 +393,14 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->inputs.frontfacing = frontfacing;
    tri->inputs.disable = FALSE;
    tri->inputs.opaque = setup->fs.current.variant->opaque;
+   if (scene->fb_max_samples > 1) {
+      /* samples disabled by the sample mask keep their contents */
+      unsigned all_samples = (1u << scene->fb_max_samples) - 1;
+      if ((setup->fs.current.jit_context.sample_mask & all_samples) !=
+          all_samples)
+         tri->inputs.opaque = FALSE;
+   }
+   tri->inputs.multisample = setup->multisample;
    tri->inputs.layer = layer;
    tri->inputs.viewport_index = viewport_index;
 
@@ -640,6 +657,19 @@ do_triangle_ccw(struct lp_setup_context *setup,
       }
    }
 
+   /*
+    * For multisampling move the edge functions from the pixel center to
+    * the top-left pixel corner, which is what the sample positions are
+    * relative to.  dcdx and dcdy are multiples of FIXED_ONE so this is
+    * exact.  The trivial accept/reject offsets stay the same.
+    */
+   if (setup->multisample) {
+      int i;
+      for (i = 0; i < 3; i++) {
+         plane[i].c += ((int64_t)plane[i].dcdx - plane[i].dcdy) / 2;
+      }
+   }
+
    if (0) {
       debug_printf("p0: %"PRIx64"/%08x/%08x/%08x\n",
                    plane[0].c,
@@ -686,10 +716,16 @@ do_triangle_ccw(struct lp_setup_context *setup,
       /* why not just use draw_regions */
       struct lp_rast_plane *plane_s = &plane[3];
 
+      /* With multisampling, planes are evaluated relative to the pixel
+       * corner, so the left and top edges have to sit one pixel further
+       * in to reject the samples of the pixels just outside.
+       */
+      const int ms_adj = setup->multisample ? 1 << 8 : 0;
+
       if (s_planes[0]) {
          plane_s->dcdx = -1 << 8;
          plane_s->dcdy = 0;
-         plane_s->c = (1-scissor->x0) << 8;
+         plane_s->c = ((1-scissor->x0) << 8) - ms_adj;
          plane_s->eo = 1 << 8;
          plane_s++;
       }
@@ -703,7 +739,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
       if (s_planes[2]) {
          plane_s->dcdx = 0;
          plane_s->dcdy = 1 << 8;
-         plane_s->c = (1-scissor->y0) << 8;
+         plane_s->c = ((1-scissor->y0) << 8) - ms_adj;
          plane_s->eo = 1 << 8;
          plane_s++;
       }
@@ -800,7 +836,10 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
 
-      if (nr_planes == 3) {
+      /* The special small triangle rasterizers only compute pixel
+       * coverage, so multisampled triangles use the generic path.
+       */
+      if (nr_planes == 3 && !tri->inputs.multisample) {
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
@@ -839,7 +878,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                                                 lp_rast_arg_triangle_contained(tri, px, py) );
          }
       }
-      else if (nr_planes == 4 && sz < 16) 
+      else if (nr_planes == 4 && sz < 16 && !tri->inputs.multisample)
       {
          px = MIN2(px, TILE_SIZE - 16);
          py = MIN2(py, TILE_SIZE - 16);
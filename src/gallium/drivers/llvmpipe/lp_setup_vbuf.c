@@ -41,6 +41,9 @@
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "util/u_memory.h"
+#include "util/os_time.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
 
 
 #define LP_MAX_VBUF_INDEXES 1024
@@ -139,6 +142,7 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    const unsigned stride = setup->vertex_info->size * sizeof(float);
    const void *vertex_buffer = setup->vertex_buffer;
    const boolean flatshade_first = setup->flatshade_first;
+   int64_t t0 = 0;
    unsigned i;
 
    assert(setup->setup.variant);
@@ -146,6 +150,9 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      t0 = os_time_get();
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -324,6 +331,9 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD(setup_time, os_time_get() - t0);
 }
 
 
@@ -339,11 +349,15 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    const void *vertex_buffer =
       (void *) get_vert(setup->vertex_buffer, start, stride);
    const boolean flatshade_first = setup->flatshade_first;
+   int64_t t0 = 0;
    unsigned i;
 
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      t0 = os_time_get();
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -519,6 +533,9 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD(setup_time, os_time_get() - t0);
 }
 
 
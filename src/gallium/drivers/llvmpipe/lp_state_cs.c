@@ -0,0 +1,602 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A compute shader is compiled into a function which runs all invocations
+ * of one block, SIMD-wide chunks at a time.  Blocks are independent, so
+ * launch_grid hands them out to the rasterizer threads.
+ */
+
+#include "pipe/p_defines.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_texture.h"
+
+
+static unsigned cs_no = 0;
+
+
+/**
+ * Compute shader interface, see lp_build_tgsi_cs_iface.
+ */
+struct lp_cs_llvm_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   const struct lp_compute_shader *shader;
+   struct lp_type type;
+
+   struct lp_build_loop_state loop;
+   struct lp_build_mask_context mask;
+
+   /** Temporary storage of the whole block, NULL without barriers */
+   LLVMValueRef temps_base;
+};
+
+
+/**
+ * Begin the loop over the chunks of invocations of a block, and compute
+ * the thread ids and the mask of valid invocations of the current chunk.
+ */
+static void
+cs_begin_chunk(struct lp_cs_llvm_iface *cs,
+               struct gallivm_state *gallivm,
+               struct lp_bld_tgsi_system_values *system_values)
+{
+   const struct lp_compute_shader *shader = cs->shader;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context uint_bld;
+   LLVMValueRef offsets[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef linear_index, index, tmp, mask;
+   unsigned num_invocations;
+   unsigned i;
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs->type));
+
+   lp_build_loop_begin(&cs->loop, gallivm, lp_build_const_int32(gallivm, 0));
+
+   /* linear invocation index of each channel */
+   for (i = 0; i < cs->type.length; i++)
+      offsets[i] = lp_build_const_int32(gallivm, i);
+   linear_index = LLVMBuildMul(builder, cs->loop.counter,
+                               lp_build_const_int32(gallivm, cs->type.length),
+                               "");
+   linear_index = lp_build_broadcast_scalar(&uint_bld, linear_index);
+   linear_index = LLVMBuildAdd(builder, linear_index,
+                               LLVMConstVector(offsets, cs->type.length), "");
+
+   tmp = lp_build_const_int_vec(gallivm, uint_bld.type, shader->block_size[0]);
+   system_values->thread_id[0] = lp_build_mod(&uint_bld, linear_index, tmp);
+   index = lp_build_div(&uint_bld, linear_index, tmp);
+   tmp = lp_build_const_int_vec(gallivm, uint_bld.type, shader->block_size[1]);
+   system_values->thread_id[1] = lp_build_mod(&uint_bld, index, tmp);
+   system_values->thread_id[2] = lp_build_div(&uint_bld, index, tmp);
+
+   /* the last chunk may be partially filled */
+   num_invocations = shader->block_size[0] * shader->block_size[1] *
+                     shader->block_size[2];
+   mask = lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, linear_index,
+                       lp_build_const_int_vec(gallivm, uint_bld.type,
+                                              num_invocations));
+   lp_build_mask_begin(&cs->mask, gallivm, cs->type, mask);
+
+   if (cs->temps_base) {
+      unsigned stride = shader->temps_size / shader->num_chunks;
+      LLVMValueRef offset =
+         LLVMBuildMul(builder, cs->loop.counter,
+                      lp_build_const_int32(gallivm, stride), "");
+      cs->base.temps_ptr = LLVMBuildGEP(builder, cs->temps_base,
+                                        &offset, 1, "temps");
+   }
+}
+
+
+static void
+cs_end_chunk(struct lp_cs_llvm_iface *cs,
+             struct gallivm_state *gallivm)
+{
+   lp_build_mask_end(&cs->mask);
+   lp_build_loop_end_cond(&cs->loop,
+                          lp_build_const_int32(gallivm, cs->shader->num_chunks),
+                          NULL, LLVMIntUGE);
+}
+
+
+/**
+ * All invocations of the block must reach the barrier before any of them
+ * continues, so finish the loop over all chunks and start a new one.  The
+ * temporaries and address registers live in memory which is indexed by
+ * chunk, so their values carry over.
+ */
+static void
+cs_emit_barrier(const struct lp_build_tgsi_cs_iface *cs_base,
+                struct lp_build_tgsi_context *bld_base,
+                struct lp_bld_tgsi_system_values *system_values,
+                LLVMValueRef *temps_ptr)
+{
+   struct lp_cs_llvm_iface *cs = (struct lp_cs_llvm_iface *)cs_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+
+   cs_end_chunk(cs, gallivm);
+   cs_begin_chunk(cs, gallivm, system_values);
+
+   *temps_ptr = cs->base.temps_ptr;
+}
+
+
+static void
+generate_compute(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader)
+{
+   struct gallivm_state *gallivm = shader->gallivm;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int8_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   LLVMTypeRef arg_types[9];
+   LLVMTypeRef func_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_cs_llvm_iface cs;
+   struct lp_type cs_type;
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16);
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   arg_types[0] = shader->jit_context_ptr_type;   /* context */
+   arg_types[1] = int32_type;                     /* block_x */
+   arg_types[2] = int32_type;                     /* block_y */
+   arg_types[3] = int32_type;                     /* block_z */
+   arg_types[4] = int32_type;                     /* grid_x */
+   arg_types[5] = int32_type;                     /* grid_y */
+   arg_types[6] = int32_type;                     /* grid_z */
+   arg_types[7] = int8_ptr_type;                  /* shared */
+   arg_types[8] = int8_ptr_type;                  /* temps */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, "cs", func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   shader->function = function;
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   memset(&system_values, 0, sizeof system_values);
+   memset(&cs, 0, sizeof cs);
+
+   context_ptr = LLVMGetParam(function, 0);
+   for (i = 0; i < 3; i++) {
+      system_values.block_id[i] = LLVMGetParam(function, 1 + i);
+      system_values.grid_size[i] = LLVMGetParam(function, 4 + i);
+      system_values.block_size[i] =
+         lp_build_const_int32(gallivm, shader->block_size[i]);
+   }
+   cs.base.shared_ptr = LLVMGetParam(function, 7);
+   if (shader->temps_size)
+      cs.temps_base = LLVMGetParam(function, 8);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(system_values.block_id[0], "block_x");
+   lp_build_name(system_values.block_id[1], "block_y");
+   lp_build_name(system_values.block_id[2], "block_z");
+   lp_build_name(system_values.grid_size[0], "grid_x");
+   lp_build_name(system_values.grid_size[1], "grid_y");
+   lp_build_name(system_values.grid_size[2], "grid_z");
+   lp_build_name(cs.base.shared_ptr, "shared");
+   lp_build_name(LLVMGetParam(function, 8), "temps");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   cs.base.ssbo_ptr = lp_jit_cs_context_ssbos(gallivm, context_ptr);
+   cs.base.ssbo_sizes_ptr = lp_jit_cs_context_ssbo_sizes(gallivm, context_ptr);
+   cs.base.shared_size =
+      lp_build_const_int32(gallivm, shader->base.req_local_mem);
+   cs.base.emit_barrier = cs_emit_barrier;
+   cs.shader = shader;
+   cs.type = cs_type;
+
+   cs_begin_chunk(&cs, gallivm, &system_values);
+
+   lp_build_tgsi_soa(gallivm, shader->tokens, cs_type, &cs.mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, NULL,
+                     NULL, &shader->info, NULL, &cs.base);
+
+   cs_end_chunk(&cs, gallivm);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader;
+   struct lp_type type;
+   unsigned num_invocations;
+   char module_name[64];
+
+   if (templ->ir_type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   shader->base = *templ;
+   shader->tokens = tgsi_dup_tokens(templ->prog);
+   if (!shader->tokens)
+      goto fail;
+   shader->base.prog = shader->tokens;
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader %p:\n", (void *)shader);
+      tgsi_dump(shader->tokens, 0);
+   }
+
+   tgsi_scan_shader(shader->tokens, &shader->info);
+
+   /* The block size is baked into the code. */
+   shader->block_size[0] =
+      shader->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH];
+   shader->block_size[1] =
+      shader->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT];
+   shader->block_size[2] =
+      shader->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH];
+   if (!shader->block_size[0] || !shader->block_size[1] ||
+       !shader->block_size[2]) {
+      debug_printf("llvmpipe: compute shaders need a fixed block size\n");
+      goto fail;
+   }
+
+   memset(&type, 0, sizeof type);
+   type.floating = TRUE;
+   type.width = 32;
+   type.length = MIN2(lp_native_vector_width / 32, 16);
+
+   num_invocations = shader->block_size[0] * shader->block_size[1] *
+                     shader->block_size[2];
+   shader->num_chunks = DIV_ROUND_UP(num_invocations, type.length);
+
+   /*
+    * Temporaries and address registers only need to be kept in memory
+    * across the chunk loops if there is a barrier, see
+    * lp_build_tgsi_cs_iface.
+    */
+   if (shader->info.opcode_count[TGSI_OPCODE_BARRIER]) {
+      unsigned num_regs = shader->info.file_max[TGSI_FILE_TEMPORARY] + 1 +
+                          shader->info.file_max[TGSI_FILE_ADDRESS] + 1;
+      shader->temps_size = shader->num_chunks * num_regs *
+                           TGSI_NUM_CHANNELS * lp_type_width(type) / 8;
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u", shader->no);
+
+   shader->gallivm = gallivm_create(module_name, llvmpipe->context, NULL);
+   if (!shader->gallivm)
+      goto fail;
+
+   lp_jit_init_cs_types(shader);
+
+   generate_compute(llvmpipe, shader);
+
+   gallivm_compile_module(shader->gallivm);
+
+   shader->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(shader->gallivm, shader->function);
+
+   gallivm_free_ir(shader->gallivm);
+
+   return shader;
+
+fail:
+   tgsi_free_tokens(shader->tokens);
+   FREE(shader);
+   return NULL;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *)cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = (struct lp_compute_shader *)cs;
+
+   if (!shader)
+      return;
+
+   assert(llvmpipe->cs != shader);
+
+   gallivm_destroy(shader->gallivm);
+   tgsi_free_tokens(shader->tokens);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_BUFFERS);
+
+   /* Only compute shaders can access shader buffers. */
+   if (shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[start_slot + i];
+
+      if (buffers && buffers[i].buffer) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+}
+
+
+/**
+ * State shared by all the jobs of a grid launch.
+ */
+struct lp_cs_launch
+{
+   const struct lp_compute_shader *shader;
+   struct lp_jit_cs_context jit_context;
+   uint32_t grid_size[3];
+
+   /* per thread storage, allocated on first use */
+   void *shared[LP_MAX_THREADS];
+   void *temps[LP_MAX_THREADS];
+};
+
+
+/**
+ * Run one block.  This is called from the rasterizer threads.
+ */
+static void
+cs_run_block(void *data, unsigned job, unsigned thread_index)
+{
+   struct lp_cs_launch *launch = (struct lp_cs_launch *)data;
+   const struct lp_compute_shader *shader = launch->shader;
+   unsigned x, y, z;
+
+   assert(thread_index < LP_MAX_THREADS);
+
+   if (shader->base.req_local_mem && !launch->shared[thread_index])
+      launch->shared[thread_index] = align_malloc(shader->base.req_local_mem, 16);
+   if (shader->temps_size && !launch->temps[thread_index])
+      launch->temps[thread_index] = align_malloc(shader->temps_size, 64);
+
+   x = job % launch->grid_size[0];
+   y = (job / launch->grid_size[0]) % launch->grid_size[1];
+   z = job / (launch->grid_size[0] * launch->grid_size[1]);
+
+   shader->jit_function(&launch->jit_context, x, y, z,
+                        launch->grid_size[0],
+                        launch->grid_size[1],
+                        launch->grid_size[2],
+                        launch->shared[thread_index],
+                        launch->temps[thread_index]);
+}
+
+
+static void
+fill_grid_size(struct pipe_context *pipe,
+               const struct pipe_grid_info *info,
+               uint32_t grid_size[3])
+{
+   struct pipe_transfer *transfer;
+   uint32_t *params;
+
+   if (!info->indirect) {
+      grid_size[0] = info->grid[0];
+      grid_size[1] = info->grid[1];
+      grid_size[2] = info->grid[2];
+      return;
+   }
+
+   params = pipe_buffer_map_range(pipe, info->indirect,
+                                  info->indirect_offset,
+                                  3 * sizeof(uint32_t),
+                                  PIPE_TRANSFER_READ,
+                                  &transfer);
+   if (!transfer) {
+      grid_size[0] = grid_size[1] = grid_size[2] = 0;
+      return;
+   }
+
+   grid_size[0] = params[0];
+   grid_size[1] = params[1];
+   grid_size[2] = params[2];
+   pipe_buffer_unmap(pipe, transfer);
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   static const float fake_const_buf[4];
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   const struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_cs_launch *launch;
+   uint64_t num_blocks;
+   unsigned i;
+
+   if (!shader)
+      return;
+
+   assert(info->block[0] == shader->block_size[0] &&
+          info->block[1] == shader->block_size[1] &&
+          info->block[2] == shader->block_size[2]);
+
+   launch = CALLOC_STRUCT(lp_cs_launch);
+   if (!launch)
+      return;
+
+   launch->shader = shader;
+   fill_grid_size(pipe, info, launch->grid_size);
+   num_blocks = (uint64_t)launch->grid_size[0] * launch->grid_size[1] *
+                launch->grid_size[2];
+   if (!num_blocks || num_blocks > UINT_MAX) {
+      FREE(launch);
+      return;
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *)llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *)cb->user_buffer;
+
+      if (data) {
+         launch->jit_context.constants[i] =
+            (const float *)(data + cb->buffer_offset);
+         launch->jit_context.num_constants[i] =
+            MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE) /
+            (sizeof(float) * 4);
+      }
+      else {
+         /* out of bounds fetches still read the first element */
+         launch->jit_context.constants[i] = fake_const_buf;
+         launch->jit_context.num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; i++) {
+      const struct pipe_shader_buffer *sb = &llvmpipe->ssbos[i];
+
+      if (!sb->buffer)
+         continue;
+
+      /* wait for any rendering using the buffer */
+      llvmpipe_flush_resource(pipe, sb->buffer, 0, FALSE, TRUE, FALSE,
+                              __FUNCTION__);
+
+      launch->jit_context.ssbos[i] = (uint32_t *)
+         ((ubyte *)llvmpipe_resource_data(sb->buffer) + sb->buffer_offset);
+      launch->jit_context.ssbo_sizes[i] = sb->buffer_size;
+   }
+
+   /*
+    * The rasterizer threads are idle whenever nobody holds the mutex, as
+    * scenes are rasterized synchronously, see lp_setup_rasterize_scene().
+    */
+   mtx_lock(&screen->rast_mutex);
+   lp_rast_run_jobs(screen->rast, cs_run_block, launch, (unsigned)num_blocks);
+   mtx_unlock(&screen->rast_mutex);
+
+   for (i = 0; i < LP_MAX_THREADS; i++) {
+      align_free(launch->shared[i]);
+      align_free(launch->temps[i]);
+   }
+   FREE(launch);
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
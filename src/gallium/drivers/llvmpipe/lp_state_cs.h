@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef LP_STATE_CS_H_
+#define LP_STATE_CS_H_
+
+
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
+#include "gallivm/lp_bld.h"
+#include "lp_jit.h"
+
+
+struct gallivm_state;
+
+
+/**
+ * Subclass of pipe_compute_state.
+ *
+ * There is no shader state besides the fixed block size, so unlike
+ * fragment shaders there are no variants and the shader is compiled
+ * when it is created.
+ */
+struct lp_compute_shader
+{
+   struct pipe_compute_state base;
+
+   const struct tgsi_token *tokens;
+   struct tgsi_shader_info info;
+
+   unsigned block_size[3];
+
+   /** Number of SIMD-wide chunks needed to run all invocations of a block */
+   unsigned num_chunks;
+
+   /** Bytes of temporary storage per block, zero if not needed */
+   unsigned temps_size;
+
+   struct gallivm_state *gallivm;
+   LLVMTypeRef jit_context_ptr_type;
+   LLVMValueRef function;
+   lp_jit_cs_func jit_function;
+
+   /* For debugging/profiling purposes */
+   unsigned no;
+};
+
+
+#endif /* LP_STATE_CS_H_ */
@@ -59,15 +59,18 @@
 
 #include <limits.h>
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_pointer.h"
 #include "util/u_format.h"
 #include "util/u_dump.h"
+#include "util/u_framebuffer.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -94,6 +97,7 @@
 #include "lp_bld_depth.h"
 #include "lp_bld_interp.h"
 #include "lp_context.h"
+#include "lp_screen.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_setup.h"
@@ -107,6 +111,13 @@
 /** Fragment shader number (for debugging) */
 static unsigned fs_no = 0;
 
+/**
+ * Widest float vector fragment shaders use.  The depth/stencil, quad mask
+ * and blend code only handle 4 and 8 wide vectors, so with 512-bit
+ * vectors (AVX-512) a 4x4 stamp still runs as two 8-wide iterations.
+ */
+#define LP_FS_MAX_VECTOR_WIDTH MIN2(lp_native_vector_width, 256)
+
 
 /**
  * Expand the relevant bits of mask_input to a n*4-dword mask for the
@@ -287,8 +298,161 @@ lp_build_depth_clamp(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Get the pointer to the coverage mask of one sample for the current
+ * iteration of the fragment shader loop.  Sample masks are stored with
+ * all the masks of sample 0 first, then those of sample 1, etc.
+ */
+static LLVMValueRef
+get_sample_mask_ptr(struct gallivm_state *gallivm,
+                    LLVMValueRef sample_mask_store,
+                    LLVMValueRef num_loop,
+                    LLVMValueRef loop_counter,
+                    unsigned sample)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef index;
+
+   index = LLVMBuildMul(builder, num_loop,
+                        lp_build_const_int32(gallivm, sample), "");
+   index = LLVMBuildAdd(builder, index, loop_counter, "");
+
+   return LLVMBuildGEP(builder, sample_mask_store, &index, 1,
+                       "sample_mask_ptr");
+}
+
+
+/**
+ * AND the coverage of each sample with the given per-sample test, and
+ * kill the pixels which have no samples left.
+ */
+static void
+update_sample_masks(struct gallivm_state *gallivm,
+                    struct lp_type type,
+                    struct lp_build_mask_context *mask,
+                    LLVMValueRef sample_mask_store,
+                    LLVMValueRef num_loop,
+                    LLVMValueRef loop_counter,
+                    unsigned nr_samples,
+                    const LLVMValueRef *sample_test)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef any_sample = lp_build_const_int_vec(gallivm, type, 0);
+   unsigned s;
+
+   for (s = 0; s < nr_samples; s++) {
+      LLVMValueRef ptr = get_sample_mask_ptr(gallivm, sample_mask_store,
+                                             num_loop, loop_counter, s);
+      LLVMValueRef sample_mask = LLVMBuildLoad(builder, ptr, "");
+
+      sample_mask = LLVMBuildAnd(builder, sample_mask, sample_test[s], "");
+      LLVMBuildStore(builder, sample_mask, ptr);
+      any_sample = LLVMBuildOr(builder, any_sample, sample_mask, "");
+   }
+
+   lp_build_mask_update(mask, any_sample);
+}
+
+
+/**
+ * Depth/stencil test and write for multisampled depth buffers.
+ *
+ * Each sample is tested against its own depth/stencil values with its
+ * own coverage, using z interpolated at the sample position unless the
+ * shader wrote z.  The pixel mask is reduced to the pixels with at least
+ * one sample passing.
+ */
+static void
+generate_depth_stencil_ms(struct gallivm_state *gallivm,
+                          const struct lp_fragment_shader_variant_key *key,
+                          struct lp_type type,
+                          const struct util_format_description *zs_format_desc,
+                          struct lp_build_interp_soa_context *interp,
+                          struct lp_build_mask_context *mask,
+                          LLVMValueRef sample_mask_store,
+                          LLVMValueRef num_loop,
+                          LLVMValueRef loop_counter,
+                          LLVMValueRef context_ptr,
+                          LLVMValueRef thread_data_ptr,
+                          LLVMValueRef stencil_refs[2],
+                          LLVMValueRef z,
+                          boolean z_per_sample,
+                          LLVMValueRef facing,
+                          LLVMValueRef depth_ptr,
+                          LLVMValueRef depth_stride,
+                          LLVMValueRef depth_sample_stride,
+                          boolean do_write)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef pixel_mask = lp_build_mask_value(mask);
+   LLVMValueRef sample_pass[LP_MAX_SAMPLES];
+   unsigned s;
+
+   assert(key->nr_samples <= LP_MAX_SAMPLES);
+
+   for (s = 0; s < key->nr_samples; s++) {
+      struct lp_build_mask_context sample_mask;
+      LLVMValueRef ptr = get_sample_mask_ptr(gallivm, sample_mask_store,
+                                             num_loop, loop_counter, s);
+      LLVMValueRef offset = LLVMBuildMul(builder, depth_sample_stride,
+                                         lp_build_const_int32(gallivm, s), "");
+      LLVMValueRef sample_depth_ptr = LLVMBuildGEP(builder, depth_ptr,
+                                                   &offset, 1, "");
+      LLVMValueRef sample_z = z;
+      LLVMValueRef z_fb, s_fb, z_value, s_value;
+
+      if (z_per_sample) {
+         sample_z = lp_build_interp_soa_offset_z(interp, gallivm, z,
+                       lp_sample_pos_4x[s][0] / (float)FIXED_ONE - 0.5f,
+                       lp_sample_pos_4x[s][1] / (float)FIXED_ONE - 0.5f);
+      }
+      if (key->depth_clamp) {
+         sample_z = lp_build_depth_clamp(gallivm, builder, type, context_ptr,
+                                         thread_data_ptr, sample_z);
+      }
+
+      lp_build_mask_begin(&sample_mask, gallivm, type,
+                          LLVMBuildAnd(builder, LLVMBuildLoad(builder, ptr, ""),
+                                       pixel_mask, ""));
+
+      lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                           zs_format_desc, key->resource_1d,
+                                           sample_depth_ptr, depth_stride,
+                                           &z_fb, &s_fb, loop_counter);
+      lp_build_depth_stencil_test(gallivm,
+                                  &key->depth,
+                                  key->stencil,
+                                  type,
+                                  zs_format_desc,
+                                  &sample_mask,
+                                  stencil_refs,
+                                  sample_z, z_fb, s_fb,
+                                  facing,
+                                  &z_value, &s_value,
+                                  FALSE);
+      if (do_write) {
+         lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                               zs_format_desc, key->resource_1d,
+                                               NULL, NULL, NULL, loop_counter,
+                                               sample_depth_ptr, depth_stride,
+                                               z_value, s_value);
+      }
+
+      sample_pass[s] = lp_build_mask_end(&sample_mask);
+   }
+
+   update_sample_masks(gallivm, type, mask, sample_mask_store,
+                       num_loop, loop_counter, key->nr_samples, sample_pass);
+}
+
+
 /**
  * Generate the fragment shader, depth/stencil test, and alpha tests.
+ *
+ * For multisampled framebuffers sample_mask_store holds the coverage of
+ * the individual samples and mask_store their union.  The shader runs
+ * once per pixel; depth/stencil, sample mask output and alpha to coverage
+ * are evaluated per sample.
  */
 static void
 generate_fs_loop(struct gallivm_state *gallivm,
@@ -301,9 +465,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_build_interp_soa_context *interp,
                  const struct lp_build_sampler_soa *sampler,
                  LLVMValueRef mask_store,
+                 LLVMValueRef sample_mask_store,
                  LLVMValueRef (*out_color)[4],
                  LLVMValueRef depth_ptr,
                  LLVMValueRef depth_stride,
+                 LLVMValueRef depth_sample_stride,
                  LLVMValueRef facing,
                  LLVMValueRef thread_data_ptr)
 {
@@ -334,6 +500,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
    unsigned chan;
    unsigned cbuf;
    unsigned depth_mode;
+   unsigned s;
 
    struct lp_bld_tgsi_system_values system_values;
 
@@ -375,6 +542,14 @@ generate_fs_loop(struct gallivm_state *gallivm,
                                         (key->stencil[1].enabled &&
                                          key->stencil[1].writemask))))
          depth_mode &= ~(LATE_DEPTH_WRITE | EARLY_DEPTH_WRITE);
+
+      /* The deferred depth write relies on the z/stencil values loaded
+       * for the early test, which would have to be kept for all samples.
+       * Just test late instead.
+       */
+      if (key->nr_samples > 1 &&
+          depth_mode == (EARLY_DEPTH_TEST | LATE_DEPTH_WRITE))
+         depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
    }
    else {
       depth_mode = 0;
@@ -432,7 +607,18 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_interp_soa_update_pos_dyn(interp, gallivm, loop_state.counter);
    z = interp->pos[2];
 
-   if (depth_mode & EARLY_DEPTH_TEST) {
+   if ((depth_mode & EARLY_DEPTH_TEST) && key->nr_samples > 1) {
+      generate_depth_stencil_ms(gallivm, key, type, zs_format_desc,
+                                interp, &mask, sample_mask_store,
+                                num_loop, loop_state.counter,
+                                context_ptr, thread_data_ptr,
+                                stencil_refs, z, TRUE, facing,
+                                depth_ptr, depth_stride, depth_sample_stride,
+                                (depth_mode & EARLY_DEPTH_WRITE) != 0);
+      if (!simple_shader)
+         lp_build_mask_check(&mask);
+   }
+   else if (depth_mode & EARLY_DEPTH_TEST) {
       /*
        * Clamp according to ARB_depth_clamp semantics.
        */
@@ -479,7 +665,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -512,9 +698,28 @@ generate_fs_loop(struct gallivm_state *gallivm,
       if (color0 != -1 && outputs[color0][3]) {
          LLVMValueRef alpha = LLVMBuildLoad(builder, outputs[color0][3], "alpha");
 
-         lp_build_alpha_to_coverage(gallivm, type,
-                                    &mask, alpha,
-                                    (depth_mode & LATE_DEPTH_TEST) != 0);
+         if (key->nr_samples > 1) {
+            /* Enable a number of samples proportional to alpha */
+            struct lp_build_context f_bld;
+            LLVMValueRef sample_test[LP_MAX_SAMPLES];
+
+            lp_build_context_init(&f_bld, gallivm, type);
+            for (s = 0; s < key->nr_samples; s++) {
+               LLVMValueRef ref =
+                  lp_build_const_vec(gallivm, type,
+                                     (s + 0.5) / key->nr_samples);
+               sample_test[s] = lp_build_cmp(&f_bld, PIPE_FUNC_GREATER,
+                                             alpha, ref);
+            }
+            update_sample_masks(gallivm, type, &mask, sample_mask_store,
+                                num_loop, loop_state.counter,
+                                key->nr_samples, sample_test);
+         }
+         else {
+            lp_build_alpha_to_coverage(gallivm, type,
+                                       &mask, alpha,
+                                       (depth_mode & LATE_DEPTH_TEST) != 0);
+         }
       }
    }
 
@@ -528,13 +733,30 @@ generate_fs_loop(struct gallivm_state *gallivm,
 
       assert(smaski >= 0);
       smask = LLVMBuildLoad(builder, outputs[smaski][0], "smask");
-      /*
-       * Pixel is alive according to the first sample in the mask.
-       */
       smask = LLVMBuildBitCast(builder, smask, smask_bld.vec_type, "");
-      smask = lp_build_and(&smask_bld, smask, smask_bld.one);
-      smask = lp_build_cmp(&smask_bld, PIPE_FUNC_NOTEQUAL, smask, smask_bld.zero);
-      lp_build_mask_update(&mask, smask);
+
+      if (key->nr_samples > 1) {
+         LLVMValueRef sample_test[LP_MAX_SAMPLES];
+
+         for (s = 0; s < key->nr_samples; s++) {
+            LLVMValueRef bit = lp_build_const_int_vec(gallivm, int_type,
+                                                      1 << s);
+            sample_test[s] = lp_build_and(&smask_bld, smask, bit);
+            sample_test[s] = lp_build_cmp(&smask_bld, PIPE_FUNC_NOTEQUAL,
+                                          sample_test[s], smask_bld.zero);
+         }
+         update_sample_masks(gallivm, type, &mask, sample_mask_store,
+                             num_loop, loop_state.counter,
+                             key->nr_samples, sample_test);
+      }
+      else {
+         /*
+          * Pixel is alive according to the first sample in the mask.
+          */
+         smask = lp_build_and(&smask_bld, smask, smask_bld.one);
+         smask = lp_build_cmp(&smask_bld, PIPE_FUNC_NOTEQUAL, smask, smask_bld.zero);
+         lp_build_mask_update(&mask, smask);
+      }
    }
 
    /* Late Z test */
@@ -545,16 +767,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
       int s_out = find_output_by_semantic(&shader->info.base,
                                           TGSI_SEMANTIC_STENCIL,
                                           0);
-      if (pos0 != -1 && outputs[pos0][2]) {
+      boolean writes_z = pos0 != -1 && outputs[pos0][2];
+
+      if (writes_z) {
          z = LLVMBuildLoad(builder, outputs[pos0][2], "output.z");
       }
-      /*
-       * Clamp according to ARB_depth_clamp semantics.
-       */
-      if (key->depth_clamp) {
-         z = lp_build_depth_clamp(gallivm, builder, type, context_ptr,
-                                  thread_data_ptr, z);
-      }
 
       if (s_out != -1 && outputs[s_out][1]) {
          /* there's only one value, and spec says to discard additional bits */
@@ -565,29 +782,49 @@ generate_fs_loop(struct gallivm_state *gallivm,
          stencil_refs[1] = stencil_refs[0];
       }
 
-      lp_build_depth_stencil_load_swizzled(gallivm, type,
-                                           zs_format_desc, key->resource_1d,
-                                           depth_ptr, depth_stride,
-                                           &z_fb, &s_fb, loop_state.counter);
+      if (key->nr_samples > 1) {
+         generate_depth_stencil_ms(gallivm, key, type, zs_format_desc,
+                                   interp, &mask, sample_mask_store,
+                                   num_loop, loop_state.counter,
+                                   context_ptr, thread_data_ptr,
+                                   stencil_refs, z, !writes_z, facing,
+                                   depth_ptr, depth_stride,
+                                   depth_sample_stride,
+                                   (depth_mode & LATE_DEPTH_WRITE) != 0);
+      }
+      else {
+         /*
+          * Clamp according to ARB_depth_clamp semantics.
+          */
+         if (key->depth_clamp) {
+            z = lp_build_depth_clamp(gallivm, builder, type, context_ptr,
+                                     thread_data_ptr, z);
+         }
 
-      lp_build_depth_stencil_test(gallivm,
-                                  &key->depth,
-                                  key->stencil,
-                                  type,
-                                  zs_format_desc,
-                                  &mask,
-                                  stencil_refs,
-                                  z, z_fb, s_fb,
-                                  facing,
-                                  &z_value, &s_value,
-                                  !simple_shader);
-      /* Late Z write */
-      if (depth_mode & LATE_DEPTH_WRITE) {
-         lp_build_depth_stencil_write_swizzled(gallivm, type,
-                                               zs_format_desc, key->resource_1d,
-                                               NULL, NULL, NULL, loop_state.counter,
-                                               depth_ptr, depth_stride,
-                                               z_value, s_value);
+         lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                              zs_format_desc, key->resource_1d,
+                                              depth_ptr, depth_stride,
+                                              &z_fb, &s_fb, loop_state.counter);
+
+         lp_build_depth_stencil_test(gallivm,
+                                     &key->depth,
+                                     key->stencil,
+                                     type,
+                                     zs_format_desc,
+                                     &mask,
+                                     stencil_refs,
+                                     z, z_fb, s_fb,
+                                     facing,
+                                     &z_value, &s_value,
+                                     !simple_shader);
+         /* Late Z write */
+         if (depth_mode & LATE_DEPTH_WRITE) {
+            lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                                  zs_format_desc, key->resource_1d,
+                                                  NULL, NULL, NULL, loop_state.counter,
+                                                  depth_ptr, depth_stride,
+                                                  z_value, s_value);
+         }
       }
    }
    else if ((depth_mode & EARLY_DEPTH_TEST) &&
@@ -628,7 +865,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
       }
    }
 
-   if (key->occlusion_count) {
+   if (key->occlusion_count && key->nr_samples <= 1) {
       LLVMValueRef counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
       lp_build_name(counter, "counter");
       lp_build_occlusion_count(gallivm, type,
@@ -637,6 +874,35 @@ generate_fs_loop(struct gallivm_state *gallivm,
 
    mask_val = lp_build_mask_end(&mask);
    LLVMBuildStore(builder, mask_val, mask_ptr);
+
+   /*
+    * Samples of pixels which got killed (possibly skipping the rest of the
+    * shader) are dead too.  This has to happen outside the mask context.
+    */
+   if (key->nr_samples > 1) {
+      LLVMValueRef counter = NULL;
+
+      if (key->occlusion_count) {
+         counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
+         lp_build_name(counter, "counter");
+      }
+
+      for (s = 0; s < key->nr_samples; s++) {
+         LLVMValueRef ptr = get_sample_mask_ptr(gallivm, sample_mask_store,
+                                                num_loop, loop_state.counter,
+                                                s);
+         LLVMValueRef sample_mask = LLVMBuildLoad(builder, ptr, "");
+
+         sample_mask = LLVMBuildAnd(builder, sample_mask, mask_val, "");
+         LLVMBuildStore(builder, sample_mask, ptr);
+
+         /* occlusion queries count samples */
+         if (counter) {
+            lp_build_occlusion_count(gallivm, type, sample_mask, counter);
+         }
+      }
+   }
+
    lp_build_for_loop_end(&loop_state);
 }
 
@@ -1819,7 +2085,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   vector_width    = dst_type.floating ? LP_FS_MAX_VECTOR_WIDTH : lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2410,8 +2676,9 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
-   LLVMTypeRef arg_types[13];
+   LLVMTypeRef arg_types[15];
    LLVMTypeRef func_type;
+   LLVMTypeRef int64_type = LLVMInt64TypeInContext(gallivm->context);
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
    LLVMValueRef context_ptr;
@@ -2424,6 +2691,8 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef stride_ptr;
    LLVMValueRef depth_ptr;
    LLVMValueRef depth_stride;
+   LLVMValueRef sample_stride_ptr;
+   LLVMValueRef depth_sample_stride;
    LLVMValueRef mask_input;
    LLVMValueRef thread_data_ptr;
    LLVMBasicBlockRef block;
@@ -2434,8 +2703,9 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4];
    LLVMValueRef function;
    LLVMValueRef facing;
+   LLVMValueRef sample_mask_store = NULL;
    unsigned num_fs;
-   unsigned i;
+   unsigned i, s;
    unsigned chan;
    unsigned cbuf;
    boolean cbuf0_write_all;
@@ -2468,7 +2738,7 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.sign = TRUE;          /* values are signed */
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
-   fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   fs_type.length = LP_FS_MAX_VECTOR_WIDTH / 32; /* n*4 elements per vector */
 
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
@@ -2486,8 +2756,12 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* Each variant lives in its own module, and the name must not depend on
+    * the shader/variant numbering so that cached code can be matched up
+    * again in a later process.
+    */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2498,10 +2772,12 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(blend_vec_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = int32_type;                          /* mask_input */
+   arg_types[9] = int64_type;                          /* mask_input */
    arg_types[10] = variant->jit_thread_data_ptr_type;  /* per thread data */
    arg_types[11] = LLVMPointerType(int32_type, 0);     /* stride */
    arg_types[12] = int32_type;                         /* depth_stride */
+   arg_types[13] = LLVMPointerType(int32_type, 0);     /* sample_stride */
+   arg_types[14] = int32_type;                         /* depth_sample_stride */
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, ARRAY_SIZE(arg_types), 0);
@@ -2531,6 +2807,8 @@ generate_fragment(struct llvmpipe_context *lp,
    thread_data_ptr  = LLVMGetParam(function, 10);
    stride_ptr   = LLVMGetParam(function, 11);
    depth_stride = LLVMGetParam(function, 12);
+   sample_stride_ptr = LLVMGetParam(function, 13);
+   depth_sample_stride = LLVMGetParam(function, 14);
 
    lp_build_name(context_ptr, "context");
    lp_build_name(x, "x");
@@ -2544,6 +2822,8 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_build_name(thread_data_ptr, "thread_data");
    lp_build_name(stride_ptr, "stride_ptr");
    lp_build_name(depth_stride, "depth_stride");
+   lp_build_name(sample_stride_ptr, "sample_stride_ptr");
+   lp_build_name(depth_sample_stride, "depth_sample_stride");
 
    /*
     * Function body
@@ -2568,9 +2848,56 @@ generate_fragment(struct llvmpipe_context *lp,
       LLVMValueRef mask_store = lp_build_array_alloca(gallivm, mask_type,
                                                       num_loop, "mask_store");
       LLVMValueRef color_store[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS];
+      LLVMValueRef sample_mask_input[LP_MAX_SAMPLES];
+      LLVMValueRef pipe_sample_enabled[LP_MAX_SAMPLES];
       boolean pixel_center_integer =
          shader->info.base.properties[TGSI_PROPERTY_FS_COORD_PIXEL_CENTER];
 
+      /*
+       * The mask input has 16 bits per sample.  For multisampled
+       * framebuffers keep a separate mask per sample, the pixel mask
+       * being their union.
+       */
+      if (key->nr_samples > 1) {
+         sample_mask_store =
+            lp_build_array_alloca(gallivm, mask_type,
+                                  lp_build_const_int32(gallivm,
+                                                       num_fs * key->nr_samples),
+                                  "sample_mask_store");
+      }
+      for (s = 0; s < MAX2(key->nr_samples, 1); s++) {
+         sample_mask_input[s] =
+            LLVMBuildLShr(builder, mask_input,
+                          LLVMConstInt(int64_type, 16 * s, 0), "");
+         sample_mask_input[s] =
+            LLVMBuildTrunc(builder, sample_mask_input[s], int32_type, "");
+      }
+
+      /*
+       * Samples disabled by the pipe sample mask get no coverage.  This
+       * is state of the jit context rather than the key, so that changing
+       * the mask doesn't need a new variant.
+       */
+      if (key->nr_samples > 1) {
+         LLVMValueRef pipe_sample_mask =
+            lp_jit_context_sample_mask(gallivm, context_ptr);
+
+         for (s = 0; s < key->nr_samples; s++) {
+            LLVMValueRef bit =
+               LLVMBuildLShr(builder, pipe_sample_mask,
+                             lp_build_const_int32(gallivm, s), "");
+            bit = LLVMBuildAnd(builder, bit,
+                               lp_build_const_int32(gallivm, 1), "");
+            /* 0 or ~0 */
+            pipe_sample_enabled[s] =
+               LLVMBuildNeg(builder, bit, "sample_enabled");
+            pipe_sample_enabled[s] =
+               lp_build_broadcast(gallivm, lp_build_int_vec_type(gallivm,
+                                                                 fs_type),
+                                  pipe_sample_enabled[s]);
+         }
+      }
+
       /*
        * The shader input interpolation info is not explicitely baked in the
        * shader key, but everything it derives from (TGSI, and flatshade) is
@@ -2592,9 +2919,32 @@ generate_fragment(struct llvmpipe_context *lp,
          LLVMValueRef mask_ptr = LLVMBuildGEP(builder, mask_store,
                                               &indexi, 1, "mask_ptr");
 
-         if (partial_mask) {
+         if (key->nr_samples > 1) {
+            mask = lp_build_const_int_vec(gallivm, fs_type, 0);
+            for (s = 0; s < key->nr_samples; s++) {
+               LLVMValueRef sample_mask;
+               LLVMValueRef index = lp_build_const_int32(gallivm,
+                                                         s * num_fs + i);
+
+               if (partial_mask) {
+                  sample_mask = generate_quad_mask(gallivm, fs_type,
+                                                   i*fs_type.length/4,
+                                                   sample_mask_input[s]);
+               }
+               else {
+                  sample_mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
+               }
+               sample_mask = LLVMBuildAnd(builder, sample_mask,
+                                          pipe_sample_enabled[s], "");
+               LLVMBuildStore(builder, sample_mask,
+                              LLVMBuildGEP(builder, sample_mask_store,
+                                           &index, 1, ""));
+               mask = LLVMBuildOr(builder, mask, sample_mask, "");
+            }
+         }
+         else if (partial_mask) {
             mask = generate_quad_mask(gallivm, fs_type,
-                                      i*fs_type.length/4, mask_input);
+                                      i*fs_type.length/4, sample_mask_input[0]);
          }
          else {
             mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
@@ -2611,9 +2961,11 @@ generate_fragment(struct llvmpipe_context *lp,
                        &interp,
                        sampler,
                        mask_store, /* output */
+                       sample_mask_store, /* output */
                        color_store,
                        depth_ptr,
                        depth_stride,
+                       depth_sample_stride,
                        facing,
                        thread_data_ptr);
 
@@ -2669,11 +3021,55 @@ generate_fragment(struct llvmpipe_context *lp,
                                 LLVMBuildGEP(builder, stride_ptr, &index, 1, ""),
                                 "");
 
-         generate_unswizzled_blend(gallivm, cbuf, variant,
-                                   key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
-                                   context_ptr, color_ptr, stride,
-                                   partial_mask, do_branch);
+         if (key->nr_samples > 1) {
+            /* Blend each sample with its own coverage */
+            LLVMValueRef sample_stride =
+               LLVMBuildLoad(builder,
+                             LLVMBuildGEP(builder, sample_stride_ptr,
+                                          &index, 1, ""),
+                             "");
+
+            for (s = 0; s < key->nr_samples; s++) {
+               LLVMValueRef sample_fs_mask[16 / 4];
+               LLVMValueRef offset =
+                  LLVMBuildMul(builder, sample_stride,
+                               lp_build_const_int32(gallivm, s), "");
+               LLVMValueRef sample_color_ptr;
+
+               sample_color_ptr =
+                  LLVMBuildBitCast(builder, color_ptr,
+                                   LLVMPointerType(int8_type, 0), "");
+               sample_color_ptr =
+                  LLVMBuildGEP(builder, sample_color_ptr, &offset, 1, "");
+               sample_color_ptr =
+                  LLVMBuildBitCast(builder, sample_color_ptr,
+                                   LLVMTypeOf(color_ptr), "");
+
+               for (i = 0; i < num_fs; i++) {
+                  LLVMValueRef indexi =
+                     lp_build_const_int32(gallivm, s * num_fs + i);
+                  sample_fs_mask[i] =
+                     LLVMBuildLoad(builder,
+                                   LLVMBuildGEP(builder, sample_mask_store,
+                                                &indexi, 1, ""),
+                                   "sample_mask");
+               }
+
+               generate_unswizzled_blend(gallivm, cbuf, variant,
+                                         key->cbuf_format[cbuf],
+                                         num_fs, fs_type, sample_fs_mask,
+                                         fs_out_color,
+                                         context_ptr, sample_color_ptr,
+                                         stride, partial_mask, do_branch);
+            }
+         }
+         else {
+            generate_unswizzled_blend(gallivm, cbuf, variant,
+                                      key->cbuf_format[cbuf],
+                                      num_fs, fs_type, fs_mask, fs_out_color,
+                                      context_ptr, color_ptr, stride,
+                                      partial_mask, do_branch);
+         }
       }
    }
 
@@ -2696,6 +3092,9 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
    for (i = 0; i < key->nr_cbufs; ++i) {
       debug_printf("cbuf_format[%u] = %s\n", i, util_format_name(key->cbuf_format[i]));
    }
+   if (key->nr_samples > 1) {
+      debug_printf("nr_samples = %u\n", key->nr_samples);
+   }
    if (key->depth.enabled || key->stencil[0].enabled) {
       debug_printf("depth.format = %s\n", util_format_name(key->zsbuf_format));
    }
@@ -2788,19 +3187,188 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Compute the disk cache key of a variant: a hash of the shader tokens and
+ * of the variant key, which together determine the generated code.
+ */
+static void
+lp_fs_get_ir_cache_key(const struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key,
+                       unsigned char val[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, shader->base.tokens,
+                     tgsi_num_tokens(shader->base.tokens) *
+                     sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_final(&ctx, val);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
  */
+/**
+ * Generate the IR for a variant into its gallivm and compile it.
+ */
+static void
+compile_variant(struct llvmpipe_context *lp,
+                struct lp_fragment_shader *shader,
+                struct lp_fragment_shader_variant *variant)
+{
+   lp_jit_init_types(variant);
+   
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(lp, shader, variant, RAST_WHOLE);
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(variant->gallivm,
+                                    variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+}
+
+
+struct lp_fs_compile_job
+{
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+};
+
+
+/**
+ * Compile the optimized code for a variant which is already in use with
+ * unoptimized code.  Runs on the screen's fs_compile_queue.
+ *
+ * The code is generated into a scratch variant, with an LLVM context of
+ * its own since LLVM contexts can't be shared between threads, and then
+ * the new functions are swapped into the variant.  The context only holds
+ * IR, so it is disposed of once the code is generated.  The old code is
+ * kept around until the variant is destroyed, as scenes which are still
+ * being rasterized may be using it.
+ */
+static void
+compile_optimized_variant(void *data, int thread_index)
+{
+   struct lp_fs_compile_job *job = data;
+   struct llvmpipe_screen *screen = job->screen;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader *shader = variant->shader;
+   struct lp_fragment_shader_variant *opt;
+   LLVMContextRef context;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+
+   FREE(job);
+
+   opt = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!opt)
+      return;
+
+   context = LLVMContextCreate();
+   if (!context) {
+      FREE(opt);
+      return;
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u_opt",
+                 shader->no, variant->no);
+
+   if (screen->disk_shader_cache) {
+      lp_fs_get_ir_cache_key(shader, &variant->key, ir_sha1_cache_key);
+      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   /* Only install an object cache when there is a disk cache to fill. */
+   opt->gallivm = gallivm_create(module_name, context,
+                                 screen->disk_shader_cache ? &cached : NULL);
+   if (!opt->gallivm) {
+      free(cached.data);
+      LLVMContextDispose(context);
+      FREE(opt);
+      return;
+   }
+
+   memcpy(&opt->key, &variant->key, shader->variant_key_size);
+   opt->shader = shader;
+   opt->no = variant->no;
+   opt->opaque = variant->opaque;
+   opt->ps_inv_multiplier = variant->ps_inv_multiplier;
+
+   compile_variant(NULL, shader, opt);
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   /* This also releases the cached code */
+   gallivm_free_ir(opt->gallivm);
+   LLVMContextDispose(context);
+
+   variant->opt_gallivm = opt->gallivm;
+
+   /* Rasterizer threads pick up the function pointers on their next call.
+    * The release stores pair with their p_atomic_read, so the generated
+    * code is visible before the pointers to it.
+    */
+   p_atomic_set(&variant->jit_function[RAST_EDGE_TEST],
+                opt->jit_function[RAST_EDGE_TEST]);
+   p_atomic_set(&variant->jit_function[RAST_WHOLE],
+                opt->jit_function[RAST_WHOLE]);
+
+   FREE(opt);
+}
+
+
+/**
+ * Generate a new fragment shader variant.
+ *
+ * With the fs_compile_queue enabled and no cached code for the variant,
+ * the variant is compiled without optimizations and an optimized version
+ * is queued to replace it.
+ */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+   boolean deferred = FALSE;
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
@@ -2809,12 +3377,31 @@ generate_variant(struct llvmpipe_context *lp,
    util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
                  shader->no, shader->variants_created);
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
+   if (screen->disk_shader_cache) {
+      lp_fs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   if (util_queue_is_initialized(&screen->fs_compile_queue) &&
+       !cached.data_size) {
+      deferred = TRUE;
+      needs_caching = FALSE;
+      variant->gallivm = gallivm_create_fast(module_name, lp->context);
+   }
+   else {
+      variant->gallivm = gallivm_create(module_name, lp->context,
+                                        screen->disk_shader_cache ?
+                                           &cached : NULL);
+   }
    if (!variant->gallivm) {
+      free(cached.data);
       FREE(variant);
       return NULL;
    }
 
+   util_queue_fence_init(&variant->compile_fence);
+
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2854,42 +3441,25 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+   compile_variant(lp, shader, variant);
 
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
 
-   /*
-    * Compile everything
-    */
-
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
-   }
+   /* This also releases the cached code */
+   gallivm_free_ir(variant->gallivm);
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   if (deferred) {
+      struct lp_fs_compile_job *job = CALLOC_STRUCT(lp_fs_compile_job);
+      if (job) {
+         job->screen = screen;
+         job->variant = variant;
+         util_queue_add_job(&screen->fs_compile_queue, job,
+                            &variant->compile_fence,
+                            compile_optimized_variant, NULL);
+      }
    }
 
-   gallivm_free_ir(variant->gallivm);
-
    return variant;
 }
 
@@ -3024,7 +3594,13 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   /* The optimized code may still be being compiled */
+   util_queue_fence_wait(&variant->compile_fence);
+   util_queue_fence_destroy(&variant->compile_fence);
+
    gallivm_destroy(variant->gallivm);
+   if (variant->opt_gallivm)
+      gallivm_destroy(variant->opt_gallivm);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3116,7 +3692,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3213,6 +3789,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->alpha.func = lp->depth_stencil->alpha.func;
    /* alpha.ref_value is passed in jit_context */
 
+   key->nr_samples = util_framebuffer_get_num_samples(&lp->framebuffer);
+
    key->flatshade = lp->rasterizer->flatshade;
    if (lp->active_occlusion_queries) {
       key->occlusion_count = TRUE;
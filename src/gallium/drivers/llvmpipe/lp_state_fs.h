@@ -35,6 +35,7 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "util/u_queue.h" /* for util_queue_fence */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 
 
@@ -77,6 +78,7 @@ struct lp_fragment_shader_variant_key
    unsigned occlusion_count:1;
    unsigned resource_1d:1;
    unsigned depth_clamp:1;
+   unsigned nr_samples:4;       /* 1 if the framebuffer isn't multisampled */
 
    enum pipe_format zsbuf_format;
    enum pipe_format cbuf_format[PIPE_MAX_COLOR_BUFS];
@@ -110,6 +112,13 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /**
+    * Optimized code compiled on the screen's fs_compile_queue.  Until it
+    * is ready jit_function[] points at unoptimized code in gallivm.
+    */
+   struct util_queue_fence compile_fence;
+   struct gallivm_state *opt_gallivm;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -334,6 +334,11 @@ prepare_shader_sampling(
                                  first_level, last_level,
                                  addr,
                                  row_stride, img_stride, mip_offsets);
+         /* multisample textures store the samples sample_stride apart */
+         if (tex->nr_samples > 1 && !lp_tex->dt)
+            draw_set_mapped_texture_samples(lp->draw, shader_type, i,
+                                            tex->nr_samples,
+                                            lp_tex->sample_stride);
       }
    }
 }
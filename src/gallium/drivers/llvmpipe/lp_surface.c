@@ -25,6 +25,9 @@
  * 
  **************************************************************************/
 
+#include "util/u_format.h"
+#include "util/u_memory.h"
+#include "util/u_pack_color.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "lp_context.h"
@@ -56,11 +59,131 @@ lp_resource_copy(struct pipe_context *pipe,
                            FALSE, /* do_not_block */
                            "blit src");
 
+   /* Transfers only see sample 0, so copy the samples directly */
+   if (src->nr_samples > 1 && dst->nr_samples == src->nr_samples) {
+      struct llvmpipe_resource *src_tex = llvmpipe_resource(src);
+      struct llvmpipe_resource *dst_tex = llvmpipe_resource(dst);
+      const uint8_t *src_map;
+      uint8_t *dst_map;
+      unsigned s;
+
+      src_map = llvmpipe_resource_map(src, src_level, 0, LP_TEX_USAGE_READ);
+      dst_map = llvmpipe_resource_map(dst, dst_level, 0,
+                                      LP_TEX_USAGE_READ_WRITE);
+
+      for (s = 0; s < src->nr_samples; s++) {
+         util_copy_box(dst_map + s * dst_tex->sample_stride, dst->format,
+                       dst_tex->row_stride[dst_level],
+                       dst_tex->img_stride[dst_level],
+                       dstx, dsty, dstz,
+                       src_box->width, src_box->height, src_box->depth,
+                       src_map + s * src_tex->sample_stride,
+                       src_tex->row_stride[src_level],
+                       src_tex->img_stride[src_level],
+                       src_box->x, src_box->y, src_box->z);
+      }
+
+      llvmpipe_resource_unmap(dst, dst_level, 0);
+      llvmpipe_resource_unmap(src, src_level, 0);
+      return;
+   }
+
    util_resource_copy_region(pipe, dst, dst_level, dstx, dsty, dstz,
                              src, src_level, src_box);
 }
 
 
+/**
+ * Resolve a multisample color resource by averaging the samples of each
+ * pixel.  Only handles the common unscaled, unscissored case, returning
+ * FALSE for anything else.
+ */
+static boolean
+lp_resolve_color(struct pipe_context *pipe,
+                 const struct pipe_blit_info *info)
+{
+   struct pipe_resource *src = info->src.resource;
+   struct llvmpipe_resource *src_tex = llvmpipe_resource(src);
+   const unsigned nr_samples = src->nr_samples;
+   const unsigned width = info->dst.box.width;
+   const unsigned height = info->dst.box.height;
+   struct pipe_transfer *dst_transfer;
+   struct pipe_box dst_box;
+   uint8_t *dst_map;
+   float *row, *sum;
+   unsigned layer;
+
+   if (info->mask != PIPE_MASK_RGBA ||
+       info->scissor_enable ||
+       info->src.box.width != info->dst.box.width ||
+       info->src.box.height != info->dst.box.height ||
+       info->src.box.depth != info->dst.box.depth ||
+       info->dst.box.width <= 0 ||
+       info->dst.box.height <= 0 ||
+       info->src.box.x < 0 || info->src.box.y < 0 ||
+       util_format_is_pure_integer(info->dst.format))
+      return FALSE;
+
+   row = MALLOC(width * 4 * sizeof(float));
+   sum = MALLOC(width * 4 * sizeof(float));
+   if (!row || !sum) {
+      FREE(row);
+      FREE(sum);
+      return FALSE;
+   }
+
+   llvmpipe_flush_resource(pipe, src, info->src.level,
+                           TRUE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           "resolve src");
+
+   dst_box = info->dst.box;
+   dst_map = pipe->transfer_map(pipe, info->dst.resource, info->dst.level,
+                                PIPE_TRANSFER_WRITE, &dst_box, &dst_transfer);
+   if (!dst_map) {
+      FREE(row);
+      FREE(sum);
+      return FALSE;
+   }
+
+   for (layer = 0; layer < info->dst.box.depth; layer++) {
+      const uint8_t *src_map =
+         llvmpipe_resource_map(src, info->src.level,
+                               info->src.box.z + layer, LP_TEX_USAGE_READ);
+      unsigned y;
+
+      for (y = 0; y < height; y++) {
+         unsigned s, i;
+
+         memset(sum, 0, width * 4 * sizeof(float));
+         for (s = 0; s < nr_samples; s++) {
+            util_format_read_4f(info->src.format, row, 0,
+                                src_map + s * src_tex->sample_stride,
+                                src_tex->row_stride[info->src.level],
+                                info->src.box.x, info->src.box.y + y,
+                                width, 1);
+            for (i = 0; i < width * 4; i++)
+               sum[i] += row[i];
+         }
+         for (i = 0; i < width * 4; i++)
+            sum[i] *= 1.0f / nr_samples;
+
+         util_format_write_4f(info->dst.format, sum, 0,
+                              dst_map + layer * dst_transfer->layer_stride,
+                              dst_transfer->stride, 0, y, width, 1);
+      }
+
+      llvmpipe_resource_unmap(src, info->src.level, info->src.box.z + layer);
+   }
+
+   pipe->transfer_unmap(pipe, dst_transfer);
+   FREE(row);
+   FREE(sum);
+   return TRUE;
+}
+
+
 static void lp_blit(struct pipe_context *pipe,
                     const struct pipe_blit_info *blit_info)
 {
@@ -73,9 +196,9 @@ static void lp_blit(struct pipe_context *pipe,
    if (info.src.resource->nr_samples > 1 &&
        info.dst.resource->nr_samples <= 1 &&
        !util_format_is_depth_or_stencil(info.src.resource->format) &&
-       !util_format_is_pure_integer(info.src.resource->format)) {
-      debug_printf("llvmpipe: color resolve unimplemented\n");
-      return;
+       !util_format_is_pure_integer(info.src.resource->format) &&
+       lp_resolve_color(pipe, &info)) {
+      return; /* done */
    }
 
    if (util_try_blit_via_copy_region(pipe, &info)) {
@@ -198,6 +321,42 @@ llvmpipe_clear_render_target(struct pipe_context *pipe,
    if (render_condition_enabled && !llvmpipe_check_render_cond(llvmpipe))
       return;
 
+   /* Transfers only see sample 0, so fill all samples directly */
+   if (dst->texture->nr_samples > 1) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(dst->texture);
+      const unsigned level = dst->u.tex.level;
+      union util_color uc;
+      uint8_t *map;
+      unsigned s;
+
+      if (util_format_is_pure_sint(dst->format)) {
+         util_format_write_4i(dst->format, color->i, 0, &uc, 0, 0, 0, 1, 1);
+      } else if (util_format_is_pure_uint(dst->format)) {
+         util_format_write_4ui(dst->format, color->ui, 0, &uc, 0, 0, 0, 1, 1);
+      } else {
+         util_pack_color(color->f, dst->format, &uc);
+      }
+
+      llvmpipe_flush_resource(pipe, dst->texture, level,
+                              FALSE, /* read_only */
+                              TRUE, /* cpu_access */
+                              FALSE, /* do_not_block */
+                              "clear_render_target");
+
+      map = llvmpipe_resource_map(dst->texture, level,
+                                  dst->u.tex.first_layer,
+                                  LP_TEX_USAGE_READ_WRITE);
+      for (s = 0; s < dst->texture->nr_samples; s++) {
+         util_fill_box(map + s * lpr->sample_stride, dst->format,
+                       lpr->row_stride[level], lpr->img_stride[level],
+                       dstx, dsty, 0, width, height,
+                       dst->u.tex.last_layer - dst->u.tex.first_layer + 1,
+                       &uc);
+      }
+      llvmpipe_resource_unmap(dst->texture, level, dst->u.tex.first_layer);
+      return;
+   }
+
    util_clear_render_target(pipe, dst, color,
                             dstx, dsty, width, height);
 }
@@ -218,6 +377,64 @@ llvmpipe_clear_depth_stencil(struct pipe_context *pipe,
    if (render_condition_enabled && !llvmpipe_check_render_cond(llvmpipe))
       return;
 
+   /* Transfers only see sample 0, so clear all samples directly */
+   if (dst->texture->nr_samples > 1) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(dst->texture);
+      const unsigned level = dst->u.tex.level;
+      const unsigned num_layers =
+         dst->u.tex.last_layer - dst->u.tex.first_layer + 1;
+      const unsigned blocksize = util_format_get_blocksize(dst->format);
+      const uint64_t zsvalue = util_pack64_z_stencil(dst->format, depth,
+                                                     stencil);
+      const uint64_t zsmask = util_pack64_mask_z_stencil(dst->format,
+         (clear_flags & PIPE_CLEAR_DEPTH) ? ~0 : 0,
+         (clear_flags & PIPE_CLEAR_STENCIL) ? 0xff : 0);
+      uint8_t *map;
+      unsigned s, layer, x, y;
+
+      llvmpipe_flush_resource(pipe, dst->texture, level,
+                              FALSE, /* read_only */
+                              TRUE, /* cpu_access */
+                              FALSE, /* do_not_block */
+                              "clear_depth_stencil");
+
+      map = llvmpipe_resource_map(dst->texture, level,
+                                  dst->u.tex.first_layer,
+                                  LP_TEX_USAGE_READ_WRITE);
+      for (s = 0; s < dst->texture->nr_samples; s++) {
+         for (layer = 0; layer < num_layers; layer++) {
+            for (y = 0; y < height; y++) {
+               uint8_t *row = map + s * lpr->sample_stride +
+                              layer * lpr->img_stride[level] +
+                              (dsty + y) * lpr->row_stride[level] +
+                              dstx * blocksize;
+
+               for (x = 0; x < width; x++) {
+                  switch (blocksize) {
+                  case 2:
+                     ((uint16_t *)row)[x] = (uint16_t)zsvalue;
+                     break;
+                  case 4:
+                     ((uint32_t *)row)[x] =
+                        (((uint32_t *)row)[x] & ~(uint32_t)zsmask) |
+                        ((uint32_t)zsvalue & (uint32_t)zsmask);
+                     break;
+                  case 8:
+                     ((uint64_t *)row)[x] =
+                        (((uint64_t *)row)[x] & ~zsmask) |
+                        (zsvalue & zsmask);
+                     break;
+                  default:
+                     assert(0);
+                  }
+               }
+            }
+         }
+      }
+      llvmpipe_resource_unmap(dst->texture, level, dst->u.tex.first_layer);
+      return;
+   }
+
    util_clear_depth_stencil(pipe, dst, clear_flags,
                             depth, stencil,
                             dstx, dsty, width, height);
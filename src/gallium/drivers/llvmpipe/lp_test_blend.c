@@ -452,7 +452,7 @@ test_one(unsigned verbose,
       dump_blend_type(stdout, blend, type);
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module", context);
+   gallivm = gallivm_create("test_module", context, NULL);
 
    func = add_blend_test(gallivm, blend, type);
 
@@ -624,6 +624,8 @@ blend_funcs[] = {
 const struct lp_type blend_types[] = {
    /* float, fixed,  sign,  norm, width, len */
    {   TRUE, FALSE,  TRUE, FALSE,    32,   4 }, /* f32 x 4 */
+   {   TRUE, FALSE,  TRUE, FALSE,    32,   8 }, /* f32 x 8 */
+   {   TRUE, FALSE,  TRUE, FALSE,    32,  16 }, /* f32 x 16 */
    {  FALSE, FALSE, FALSE,  TRUE,     8,  16 }, /* u8n x 16 */
 };
 
@@ -658,6 +660,9 @@ test_all(unsigned verbose, FILE *fp)
                            *alpha_dst_factor == PIPE_BLENDFACTOR_SRC_ALPHA_SATURATE)
                            continue;
 
+                        if(lp_type_width(*type) > lp_native_vector_width)
+                           continue;
+
                         memset(&blend, 0, sizeof blend);
                         blend.rt[0].blend_enable      = 1;
                         blend.rt[0].rgb_func          = *rgb_func;
@@ -712,7 +717,9 @@ test_some(unsigned verbose, FILE *fp,
          alpha_dst_factor = &blend_factors[rand() % num_factors];
       } while(*alpha_dst_factor == PIPE_BLENDFACTOR_SRC_ALPHA_SATURATE);
 
-      type = &blend_types[rand() % num_types];
+      do {
+         type = &blend_types[rand() % num_types];
+      } while(lp_type_width(*type) > lp_native_vector_width);
 
       memset(&blend, 0, sizeof blend);
       blend.rt[0].blend_enable      = 1;
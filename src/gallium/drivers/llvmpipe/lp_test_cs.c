@@ -0,0 +1,307 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Unit tests for compute shaders.
+ *
+ * Runs small TGSI compute shaders through a llvmpipe context and checks
+ * what they write to a shader buffer.  This exercises the partially
+ * filled last chunk of a block, and temporaries and address registers
+ * being carried across a barrier.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+struct cs_test_case
+{
+   const char *name;
+   const char *text;
+   unsigned req_local_mem;
+   unsigned block[3];
+   unsigned grid[3];
+
+   /** Expected value of the num_values dwords written to the buffer */
+   unsigned num_values;
+   uint32_t (*expected)(unsigned index);
+};
+
+
+/*
+ * Every invocation of a 5x3x2 block writes a value encoding its thread
+ * and block ids.  30 invocations don't fill the last SIMD chunk.
+ */
+static const char thread_id_text[] =
+   "COMP\n"
+   "PROPERTY CS_FIXED_BLOCK_WIDTH 5\n"
+   "PROPERTY CS_FIXED_BLOCK_HEIGHT 3\n"
+   "PROPERTY CS_FIXED_BLOCK_DEPTH 2\n"
+   "DCL SV[0], THREAD_ID\n"
+   "DCL SV[1], BLOCK_ID\n"
+   "DCL BUFFER[0]\n"
+   "DCL TEMP[0..1]\n"
+   "IMM[0] UINT32 {1, 10, 100, 1000}\n"
+   "IMM[1] UINT32 {10000, 5, 15, 30}\n"
+   "IMM[2] UINT32 {2, 4, 0, 0}\n"
+   "  0: UMAD TEMP[0].x, SV[0].yyyy, IMM[0].yyyy, SV[0].xxxx\n"
+   "  1: UMAD TEMP[0].x, SV[0].zzzz, IMM[0].zzzz, TEMP[0].xxxx\n"
+   "  2: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].wwww, TEMP[0].xxxx\n"
+   "  3: UMAD TEMP[0].x, SV[1].yyyy, IMM[1].xxxx, TEMP[0].xxxx\n"
+   "  4: UMAD TEMP[1].x, SV[0].yyyy, IMM[1].yyyy, SV[0].xxxx\n"
+   "  5: UMAD TEMP[1].x, SV[0].zzzz, IMM[1].zzzz, TEMP[1].xxxx\n"
+   "  6: UMAD TEMP[1].y, SV[1].yyyy, IMM[2].xxxx, SV[1].xxxx\n"
+   "  7: UMAD TEMP[1].x, TEMP[1].yyyy, IMM[1].wwww, TEMP[1].xxxx\n"
+   "  8: UMUL TEMP[1].x, TEMP[1].xxxx, IMM[2].yyyy\n"
+   "  9: STORE BUFFER[0].x, TEMP[1].xxxx, TEMP[0].xxxx\n"
+   " 10: END\n";
+
+static uint32_t
+thread_id_expected(unsigned index)
+{
+   unsigned block = index / 30, local = index % 30;
+
+   return (local % 5) + 10 * ((local / 5) % 3) + 100 * (local / 15) +
+          1000 * (block % 2) + 10000 * (block / 2);
+}
+
+
+/*
+ * Every invocation of a 37 wide block stores its id to shared memory and
+ * computes an address register before a barrier, and reads back the id
+ * stored by the mirrored invocation and indexes the immediates with the
+ * address register after it.
+ */
+static const char barrier_text[] =
+   "COMP\n"
+   "PROPERTY CS_FIXED_BLOCK_WIDTH 37\n"
+   "PROPERTY CS_FIXED_BLOCK_HEIGHT 1\n"
+   "PROPERTY CS_FIXED_BLOCK_DEPTH 1\n"
+   "DCL SV[0], THREAD_ID\n"
+   "DCL SV[1], BLOCK_ID\n"
+   "DCL BUFFER[0]\n"
+   "DCL MEMORY[0], SHARED\n"
+   "DCL TEMP[0..4]\n"
+   "DCL ADDR[0]\n"
+   "IMM[0] UINT32 {4, 37, 3, 36}\n"
+   "IMM[1] UINT32 {100, 0, 0, 0}\n"
+   "IMM[2] UINT32 {200, 0, 0, 0}\n"
+   "IMM[3] UINT32 {300, 0, 0, 0}\n"
+   "IMM[4] UINT32 {400, 0, 0, 0}\n"
+   "  0: UMUL TEMP[0].x, SV[0].xxxx, IMM[0].xxxx\n"
+   "  1: STORE MEMORY[0].x, TEMP[0].xxxx, SV[0].xxxx\n"
+   "  2: AND TEMP[1].x, SV[0].xxxx, IMM[0].zzzz\n"
+   "  3: UARL ADDR[0].x, TEMP[1].xxxx\n"
+   "  4: BARRIER\n"
+   "  5: INEG TEMP[1].x, SV[0].xxxx\n"
+   "  6: UADD TEMP[1].x, TEMP[1].xxxx, IMM[0].wwww\n"
+   "  7: UMUL TEMP[1].x, TEMP[1].xxxx, IMM[0].xxxx\n"
+   "  8: LOAD TEMP[3].x, MEMORY[0], TEMP[1].xxxx\n"
+   "  9: MOV TEMP[2].x, IMM[ADDR[0].x+1].xxxx\n"
+   " 10: UADD TEMP[3].x, TEMP[3].xxxx, TEMP[2].xxxx\n"
+   " 11: UMAD TEMP[4].x, SV[1].xxxx, IMM[0].yyyy, SV[0].xxxx\n"
+   " 12: UMUL TEMP[4].x, TEMP[4].xxxx, IMM[0].xxxx\n"
+   " 13: STORE BUFFER[0].x, TEMP[4].xxxx, TEMP[3].xxxx\n"
+   " 14: END\n";
+
+static uint32_t
+barrier_expected(unsigned index)
+{
+   unsigned local = index % 37;
+
+   return (36 - local) + 100 * (1 + (local & 3));
+}
+
+
+static const struct cs_test_case test_cases[] = {
+   { "thread_id", thread_id_text, 0, { 5, 3, 2 }, { 2, 2, 1 }, 4 * 30,
+     thread_id_expected },
+   { "barrier", barrier_text, 37 * 4, { 37, 1, 1 }, { 3, 1, 1 }, 3 * 37,
+     barrier_expected },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct cs_test_case *test,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%s\n", test->name);
+
+   fflush(fp);
+}
+
+
+static boolean
+test_one(struct pipe_context *pipe, unsigned verbose, FILE *fp,
+         const struct cs_test_case *test)
+{
+   struct tgsi_token tokens[1024];
+   struct pipe_compute_state cs_templ;
+   struct pipe_shader_buffer sb;
+   struct pipe_grid_info info;
+   struct pipe_resource *buffer;
+   uint32_t *values;
+   unsigned size = (test->num_values + 1) * sizeof(uint32_t);
+   boolean success = TRUE;
+   void *cs;
+   unsigned i;
+
+   if (!tgsi_text_translate(test->text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "%s: failed to translate shader\n", test->name);
+      return FALSE;
+   }
+
+   memset(&cs_templ, 0, sizeof cs_templ);
+   cs_templ.ir_type = PIPE_SHADER_IR_TGSI;
+   cs_templ.prog = tokens;
+   cs_templ.req_local_mem = test->req_local_mem;
+   cs = pipe->create_compute_state(pipe, &cs_templ);
+   if (!cs) {
+      fprintf(stderr, "%s: failed to create compute state\n", test->name);
+      return FALSE;
+   }
+
+   /* one extra dword to catch out of bounds writes */
+   values = MALLOC(size);
+   memset(values, 0xcd, size);
+   buffer = pipe_buffer_create(pipe->screen, PIPE_BIND_SHADER_BUFFER,
+                               PIPE_USAGE_DEFAULT, size);
+   pipe_buffer_write(pipe, buffer, 0, size, values);
+
+   memset(&sb, 0, sizeof sb);
+   sb.buffer = buffer;
+   sb.buffer_size = size;
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, &sb);
+   pipe->bind_compute_state(pipe, cs);
+
+   memset(&info, 0, sizeof info);
+   for (i = 0; i < 3; i++) {
+      info.block[i] = test->block[i];
+      info.grid[i] = test->grid[i];
+   }
+   pipe->launch_grid(pipe, &info);
+
+   pipe_buffer_read(pipe, buffer, 0, size, values);
+
+   for (i = 0; i < test->num_values; i++) {
+      uint32_t expected = test->expected(i);
+      if (values[i] != expected) {
+         if (verbose || success)
+            fprintf(stderr, "%s: value %u is 0x%08x, expected 0x%08x\n",
+                    test->name, i, values[i], expected);
+         success = FALSE;
+      }
+   }
+   if (values[test->num_values] != 0xcdcdcdcd) {
+      fprintf(stderr, "%s: out of bounds write\n", test->name);
+      success = FALSE;
+   }
+
+   if (verbose)
+      printf("%s: %s\n", test->name, success ? "pass" : "fail");
+
+   if (fp)
+      write_tsv_row(fp, test, success);
+
+   pipe->bind_compute_state(pipe, NULL);
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL);
+   pipe->delete_compute_state(pipe, cs);
+   pipe_resource_reference(&buffer, NULL);
+   FREE(values);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   boolean success = TRUE;
+   unsigned i;
+
+   screen = llvmpipe_create_screen(null_sw_create());
+   if (!screen)
+      return FALSE;
+
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return FALSE;
+   }
+
+   for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+      if (!test_one(pipe, verbose, fp, &test_cases[i]))
+         success = FALSE;
+   }
+
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
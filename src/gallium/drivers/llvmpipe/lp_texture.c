@@ -166,6 +166,15 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       depth = u_minify(depth, 1);
    }
 
+   /* Multisample resources store each sample as a complete miptree. */
+   lpr->sample_stride = total_size;
+   if (pt->nr_samples > 1) {
+      total_size *= pt->nr_samples;
+      if (total_size > LP_MAX_TEXTURE_SIZE) {
+         goto fail;
+      }
+   }
+
    if (allocate) {
       lpr->tex_data = align_malloc(total_size, mip_align);
       if (!lpr->tex_data) {
@@ -257,6 +266,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
                             PIPE_BIND_SCANOUT |
                             PIPE_BIND_SHARED)) {
          /* displayable surface */
+         if (lpr->base.nr_samples > 1)
+            goto fail;
          if (!llvmpipe_displaytarget_layout(screen, lpr, map_front_private))
             goto fail;
       }
@@ -66,6 +66,8 @@ struct llvmpipe_resource
    unsigned img_stride[LP_MAX_TEXTURE_LEVELS];
    /** Offset to start of mipmap level, in bytes */
    unsigned mip_offsets[LP_MAX_TEXTURE_LEVELS];
+   /** Offset between samples of multisample resources, in bytes */
+   unsigned sample_stride;
    /** allocated total size (for non-display target texture resources only) */
    unsigned total_alloc_size;
 
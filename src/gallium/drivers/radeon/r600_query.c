@@ -64,6 +64,22 @@ static void r600_query_sw_destroy(struct si_screen *sscreen,
 	FREE(query);
 }
 
+static enum tc_sync_reason tc_sync_reason_from_type(unsigned type)
+{
+	switch (type) {
+	case R600_QUERY_TC_SYNCS_TRANSFER: return TC_SYNC_TRANSFER;
+	case R600_QUERY_TC_SYNCS_QUERY: return TC_SYNC_QUERY;
+	case R600_QUERY_TC_SYNCS_FLUSH: return TC_SYNC_FLUSH;
+	case R600_QUERY_TC_SYNCS_UNWRAP: return TC_SYNC_UNWRAP;
+	case R600_QUERY_TC_SYNCS_READBACK: return TC_SYNC_READBACK;
+	case R600_QUERY_TC_SYNCS_CREATE: return TC_SYNC_CREATE;
+	case R600_QUERY_TC_SYNCS_CLEAR: return TC_SYNC_CLEAR;
+	case R600_QUERY_TC_SYNCS_STATE: return TC_SYNC_STATE;
+	case R600_QUERY_TC_SYNCS_DEBUG: return TC_SYNC_DEBUG;
+	default: unreachable("query type does not correspond to tc sync reason");
+	}
+}
+
 static enum radeon_value_id winsys_id_from_type(unsigned type)
 {
 	switch (type) {
@@ -161,6 +177,25 @@ static bool r600_query_sw_begin(struct r600_common_context *rctx,
 	case R600_QUERY_TC_NUM_SYNCS:
 		query->begin_result = rctx->tc ? rctx->tc->num_syncs : 0;
 		break;
+	case R600_QUERY_TC_SYNCS_TRANSFER:
+	case R600_QUERY_TC_SYNCS_QUERY:
+	case R600_QUERY_TC_SYNCS_FLUSH:
+	case R600_QUERY_TC_SYNCS_UNWRAP:
+	case R600_QUERY_TC_SYNCS_READBACK:
+	case R600_QUERY_TC_SYNCS_CREATE:
+	case R600_QUERY_TC_SYNCS_CLEAR:
+	case R600_QUERY_TC_SYNCS_STATE:
+	case R600_QUERY_TC_SYNCS_DEBUG:
+		query->begin_result = rctx->tc ?
+			rctx->tc->num_syncs_by_reason[tc_sync_reason_from_type(query->b.type)] : 0;
+		break;
+	case R600_QUERY_TC_SYNC_TIME:
+		query->begin_result = rctx->tc ? rctx->tc->sync_time_ns : 0;
+		break;
+	case R600_QUERY_TC_BATCH_SIZE:
+		query->begin_result = rctx->tc ? rctx->tc->num_offloaded_slots : 0;
+		query->begin_time = rctx->tc ? rctx->tc->num_batches : 0;
+		break;
 	case R600_QUERY_REQUESTED_VRAM:
 	case R600_QUERY_REQUESTED_GTT:
 	case R600_QUERY_MAPPED_VRAM:
@@ -321,6 +356,25 @@ static bool r600_query_sw_end(struct r600_common_context *rctx,
 	case R600_QUERY_TC_NUM_SYNCS:
 		query->end_result = rctx->tc ? rctx->tc->num_syncs : 0;
 		break;
+	case R600_QUERY_TC_SYNCS_TRANSFER:
+	case R600_QUERY_TC_SYNCS_QUERY:
+	case R600_QUERY_TC_SYNCS_FLUSH:
+	case R600_QUERY_TC_SYNCS_UNWRAP:
+	case R600_QUERY_TC_SYNCS_READBACK:
+	case R600_QUERY_TC_SYNCS_CREATE:
+	case R600_QUERY_TC_SYNCS_CLEAR:
+	case R600_QUERY_TC_SYNCS_STATE:
+	case R600_QUERY_TC_SYNCS_DEBUG:
+		query->end_result = rctx->tc ?
+			rctx->tc->num_syncs_by_reason[tc_sync_reason_from_type(query->b.type)] : 0;
+		break;
+	case R600_QUERY_TC_SYNC_TIME:
+		query->end_result = rctx->tc ? rctx->tc->sync_time_ns : 0;
+		break;
+	case R600_QUERY_TC_BATCH_SIZE:
+		query->end_result = rctx->tc ? rctx->tc->num_offloaded_slots : 0;
+		query->end_time = rctx->tc ? rctx->tc->num_batches : 0;
+		break;
 	case R600_QUERY_REQUESTED_VRAM:
 	case R600_QUERY_REQUESTED_GTT:
 	case R600_QUERY_MAPPED_VRAM:
@@ -438,6 +492,14 @@ static bool r600_query_sw_get_result(struct r600_common_context *rctx,
 		result->u64 = (query->end_result - query->begin_result) /
 			      (query->end_time - query->begin_time);
 		return true;
+	case R600_QUERY_TC_BATCH_SIZE:
+		/* Average number of call slots per batch. */
+		if (query->end_time == query->begin_time)
+			result->u64 = 0;
+		else
+			result->u64 = (query->end_result - query->begin_result) /
+				      (query->end_time - query->begin_time);
+		return true;
 	case R600_QUERY_CS_THREAD_BUSY:
 	case R600_QUERY_GALLIUM_THREAD_BUSY:
 		result->u64 = (query->end_result - query->begin_result) * 100 /
@@ -464,6 +526,7 @@ static bool r600_query_sw_get_result(struct r600_common_context *rctx,
 
 	switch (query->b.type) {
 	case R600_QUERY_BUFFER_WAIT_TIME:
+	case R600_QUERY_TC_SYNC_TIME:
 	case R600_QUERY_GPU_TEMPERATURE:
 		result->u64 /= 1000;
 		break;
@@ -1922,6 +1985,17 @@ static struct pipe_driver_query_info r600_driver_query_list[] = {
 	X("tc-offloaded-slots",		TC_OFFLOADED_SLOTS,     UINT64, AVERAGE),
 	X("tc-direct-slots",		TC_DIRECT_SLOTS,	UINT64, AVERAGE),
 	X("tc-num-syncs",		TC_NUM_SYNCS,		UINT64, AVERAGE),
+	X("tc-syncs-transfer",		TC_SYNCS_TRANSFER,	UINT64, AVERAGE),
+	X("tc-syncs-query",		TC_SYNCS_QUERY,		UINT64, AVERAGE),
+	X("tc-syncs-flush",		TC_SYNCS_FLUSH,		UINT64, AVERAGE),
+	X("tc-syncs-unwrap",		TC_SYNCS_UNWRAP,	UINT64, AVERAGE),
+	X("tc-syncs-readback",		TC_SYNCS_READBACK,	UINT64, AVERAGE),
+	X("tc-syncs-create",		TC_SYNCS_CREATE,	UINT64, AVERAGE),
+	X("tc-syncs-clear",		TC_SYNCS_CLEAR,		UINT64, AVERAGE),
+	X("tc-syncs-state",		TC_SYNCS_STATE,		UINT64, AVERAGE),
+	X("tc-syncs-debug",		TC_SYNCS_DEBUG,		UINT64, AVERAGE),
+	X("tc-sync-time",		TC_SYNC_TIME,		MICROSECONDS, CUMULATIVE),
+	X("tc-batch-size",		TC_BATCH_SIZE,		UINT64, AVERAGE),
 	X("CS-thread-busy",		CS_THREAD_BUSY,		UINT64, AVERAGE),
 	X("gallium-thread-busy",	GALLIUM_THREAD_BUSY,	UINT64, AVERAGE),
 	X("requested-VRAM",		REQUESTED_VRAM,		BYTES, AVERAGE),
@@ -57,6 +57,17 @@ enum {
 	R600_QUERY_TC_OFFLOADED_SLOTS,
 	R600_QUERY_TC_DIRECT_SLOTS,
 	R600_QUERY_TC_NUM_SYNCS,
+	R600_QUERY_TC_SYNCS_TRANSFER,
+	R600_QUERY_TC_SYNCS_QUERY,
+	R600_QUERY_TC_SYNCS_FLUSH,
+	R600_QUERY_TC_SYNCS_UNWRAP,
+	R600_QUERY_TC_SYNCS_READBACK,
+	R600_QUERY_TC_SYNCS_CREATE,
+	R600_QUERY_TC_SYNCS_CLEAR,
+	R600_QUERY_TC_SYNCS_STATE,
+	R600_QUERY_TC_SYNCS_DEBUG,
+	R600_QUERY_TC_SYNC_TIME,
+	R600_QUERY_TC_BATCH_SIZE,
 	R600_QUERY_CS_THREAD_BUSY,
 	R600_QUERY_GALLIUM_THREAD_BUSY,
 	R600_QUERY_REQUESTED_VRAM,
@@ -0,0 +1,372 @@
+/**************************************************************************
+ *
+ * Copyright 2018 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ *  Benchmark for tgsi_exec.
+ *
+ *  Runs a set of small vertex and fragment shaders, shaped like the ones
+ *  piglit's GLSL tests compile to, the way draw and softpipe run them: four
+ *  vertices or one quad per tgsi_exec_machine_run() call. Fragment inputs
+ *  are interpolated from coefficients like in softpipe. Texture sampling
+ *  isn't covered, since its cost is in the sampler rather than in the
+ *  interpreter.
+ *
+ *  For each shader, the best time per run out of a few repetitions is
+ *  printed along with a hash of all outputs and kill masks, so that two
+ *  builds of the interpreter can be compared for both speed and results.
+ *
+ *  Usage: tgsi_exec_bench [runs per repetition]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+
+
+#define NUM_REPETITIONS 3
+#define MAX_TOKENS 1024
+#define NUM_CONSTS 20
+
+struct bench_shader {
+   const char *name;
+   const char *text;
+};
+
+static const struct bench_shader shaders[] = {
+   { "vs-passthrough",
+     "VERT\n"
+     "DCL IN[0]\n"
+     "DCL IN[1]\n"
+     "DCL OUT[0], POSITION\n"
+     "DCL OUT[1], GENERIC[0]\n"
+     "  0: MOV OUT[0], IN[0]\n"
+     "  1: MOV OUT[1], IN[1]\n"
+     "  2: END\n" },
+
+   { "vs-transform-lighting",
+     "VERT\n"
+     "DCL IN[0]\n"
+     "DCL IN[1]\n"
+     "DCL OUT[0], POSITION\n"
+     "DCL OUT[1], COLOR\n"
+     "DCL CONST[0][0..7]\n"
+     "DCL TEMP[0..3]\n"
+     "IMM[0] FLT32 { 0.5, 1.0, 2.0, 0.0 }\n"
+     "  0: MUL TEMP[0], IN[0].xxxx, CONST[0][0]\n"
+     "  1: MAD TEMP[0], IN[0].yyyy, CONST[0][1], TEMP[0]\n"
+     "  2: MAD TEMP[0], IN[0].zzzz, CONST[0][2], TEMP[0]\n"
+     "  3: MAD OUT[0], IN[0].wwww, CONST[0][3], TEMP[0]\n"
+     "  4: DP3 TEMP[1].x, IN[1], CONST[0][4]\n"
+     "  5: MAX TEMP[1].x, TEMP[1].xxxx, IMM[0].wwww\n"
+     "  6: MUL TEMP[2], CONST[0][5], TEMP[1].xxxx\n"
+     "  7: ADD TEMP[2], TEMP[2], CONST[0][6]\n"
+     "  8: RSQ TEMP[3].x, |TEMP[2].xxxx|\n"
+     "  9: LRP TEMP[2], IMM[0].xxxx, TEMP[2], -TEMP[3].xxxx\n"
+     " 10: SGE TEMP[3], TEMP[2], IMM[0].xxxx\n"
+     " 11: CMP TEMP[2], -TEMP[3], TEMP[2], IMM[0].yyyy\n"
+     " 12: MIN TEMP[2], TEMP[2], IMM[0].zzzz\n"
+     " 13: MOV_SAT OUT[1], TEMP[2]\n"
+     " 14: END\n" },
+
+   { "vs-skinning",
+     "VERT\n"
+     "DCL IN[0]\n"
+     "DCL IN[1]\n"
+     "DCL OUT[0], POSITION\n"
+     "DCL CONST[0][0..19]\n"
+     "DCL TEMP[0..1]\n"
+     "DCL ADDR[0]\n"
+     "IMM[0] FLT32 { 4.0, 0.0, 0.0, 0.0 }\n"
+     "  0: MUL TEMP[0].x, |IN[1].xxxx|, IMM[0].xxxx\n"
+     "  1: ARL ADDR[0].x, TEMP[0].xxxx\n"
+     "  2: MUL TEMP[1], IN[0].xxxx, CONST[0][ADDR[0].x]\n"
+     "  3: MAD TEMP[1], IN[0].yyyy, CONST[0][ADDR[0].x+1], TEMP[1]\n"
+     "  4: MAD TEMP[1], IN[0].zzzz, CONST[0][ADDR[0].x+2], TEMP[1]\n"
+     "  5: MAD OUT[0], IN[0].wwww, CONST[0][ADDR[0].x+3], TEMP[1]\n"
+     "  6: END\n" },
+
+   { "vs-fog-exp",
+     "VERT\n"
+     "DCL IN[0]\n"
+     "DCL OUT[0], POSITION\n"
+     "DCL OUT[1], GENERIC[0]\n"
+     "DCL CONST[0][0..3]\n"
+     "DCL TEMP[0..1]\n"
+     "IMM[0] FLT32 { 1.442695, 0.5, 2.2, 0.0 }\n"
+     "  0: DP4 TEMP[0].x, IN[0], CONST[0][0]\n"
+     "  1: MUL TEMP[0].x, TEMP[0].xxxx, IMM[0].xxxx\n"
+     "  2: EX2 TEMP[1].x, -|TEMP[0].xxxx|\n"
+     "  3: POW TEMP[1].y, |IN[0].yyyy|, IMM[0].zzzz\n"
+     "  4: LG2 TEMP[1].z, |IN[0].zzzz|\n"
+     "  5: MOV TEMP[1].w, IMM[0].yyyy\n"
+     "  6: MOV OUT[0], IN[0]\n"
+     "  7: MOV OUT[1], TEMP[1]\n"
+     "  8: END\n" },
+
+   { "fs-mix",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL IN[1], GENERIC[1], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL CONST[0][0..1]\n"
+     "DCL TEMP[0]\n"
+     "  0: LRP TEMP[0], IN[0].wwww, IN[0], IN[1]\n"
+     "  1: MUL TEMP[0], TEMP[0], CONST[0][0]\n"
+     "  2: ADD_SAT OUT[0], TEMP[0], CONST[0][1]\n"
+     "  3: END\n" },
+
+   { "fs-phong",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL IN[1], GENERIC[1], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL CONST[0][0..2]\n"
+     "DCL TEMP[0..2]\n"
+     "IMM[0] FLT32 { 0.0, 16.0, 1.0, 0.0 }\n"
+     "  0: DP3 TEMP[0].x, IN[0], IN[0]\n"
+     "  1: RSQ TEMP[0].x, TEMP[0].xxxx\n"
+     "  2: MUL TEMP[0].xyz, IN[0], TEMP[0].xxxx\n"
+     "  3: DP3 TEMP[1].x, IN[1], IN[1]\n"
+     "  4: RSQ TEMP[1].x, TEMP[1].xxxx\n"
+     "  5: MUL TEMP[1].xyz, IN[1], TEMP[1].xxxx\n"
+     "  6: DP3 TEMP[2].x, TEMP[0], TEMP[1]\n"
+     "  7: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+     "  8: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+     "  9: MAD TEMP[1], CONST[0][0], TEMP[2].xxxx, CONST[0][2]\n"
+     " 10: MAD OUT[0], CONST[0][1], TEMP[2].yyyy, TEMP[1]\n"
+     " 11: END\n" },
+
+   { "fs-if-else",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL TEMP[0..1]\n"
+     "IMM[0] FLT32 { 0.0, 1.0, 0.5, 0.25 }\n"
+     "  0: SLT TEMP[0].x, IN[0].xxxx, IMM[0].zzzz\n"
+     "  1: IF TEMP[0].xxxx :3\n"
+     "  2:   MUL TEMP[1], IN[0], IMM[0].wwww\n"
+     "  3: ELSE :5\n"
+     "  4:   ADD TEMP[1], IN[0], -IMM[0].zzzz\n"
+     "  5: ENDIF\n"
+     "  6: MOV OUT[0], TEMP[1]\n"
+     "  7: END\n" },
+
+   { "fs-loop",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL TEMP[0..2]\n"
+     "IMM[0] INT32 { 0, 1, 8, 0 }\n"
+     "IMM[1] FLT32 { 0.0, 0.125, 0.0, 0.0 }\n"
+     "  0: MOV TEMP[0], IMM[1].xxxx\n"
+     "  1: MOV TEMP[1].x, IMM[0].xxxx\n"
+     "  2: BGNLOOP :9\n"
+     "  3:   ISGE TEMP[2].x, TEMP[1].xxxx, IMM[0].zzzz\n"
+     "  4:   UIF TEMP[2].xxxx :6\n"
+     "  5:     BRK\n"
+     "  6:   ENDIF\n"
+     "  7:   MAD TEMP[0], IN[0], IMM[1].yyyy, TEMP[0]\n"
+     "  8:   UADD TEMP[1].x, TEMP[1].xxxx, IMM[0].yyyy\n"
+     "  9: ENDLOOP :2\n"
+     " 10: MOV OUT[0], TEMP[0]\n"
+     " 11: END\n" },
+
+   { "fs-discard",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL TEMP[0]\n"
+     "IMM[0] FLT32 { 0.5, 0.0, 0.0, 0.0 }\n"
+     "  0: ADD TEMP[0].x, IN[0].wwww, -IMM[0].xxxx\n"
+     "  1: KILL_IF TEMP[0].xxxx\n"
+     "  2: MOV OUT[0], IN[0]\n"
+     "  3: END\n" },
+
+   { "fs-trig",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL TEMP[0..1]\n"
+     "IMM[0] FLT32 { 6.2831853, 4.0, 0.5, 0.0 }\n"
+     "  0: MUL TEMP[0], IN[0], IMM[0].yyyy\n"
+     "  1: FRC TEMP[1], TEMP[0]\n"
+     "  2: FLR TEMP[0], TEMP[0]\n"
+     "  3: MUL TEMP[1].x, TEMP[1].xxxx, IMM[0].xxxx\n"
+     "  4: SIN TEMP[1].y, TEMP[1].xxxx\n"
+     "  5: COS TEMP[1].z, TEMP[1].xxxx\n"
+     "  6: MAD OUT[0], TEMP[1], IMM[0].zzzz, TEMP[0]\n"
+     "  7: END\n" },
+
+   { "fs-integer",
+     "FRAG\n"
+     "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+     "DCL OUT[0], COLOR\n"
+     "DCL TEMP[0..1]\n"
+     "IMM[0] FLT32 { 255.0, 0.0039215689, 0.0, 0.0 }\n"
+     "IMM[1] INT32 { 255, 8, 3, 0 }\n"
+     "  0: MUL TEMP[0], |IN[0]|, IMM[0].xxxx\n"
+     "  1: F2I TEMP[0], TEMP[0]\n"
+     "  2: AND TEMP[1], TEMP[0], IMM[1].xxxx\n"
+     "  3: SHL TEMP[1].x, TEMP[1].xxxx, IMM[1].yyyy\n"
+     "  4: OR TEMP[1].x, TEMP[1].xxxx, TEMP[1].yyyy\n"
+     "  5: UMUL TEMP[1].z, TEMP[1].zzzz, IMM[1].zzzz\n"
+     "  6: I2F TEMP[1], TEMP[1]\n"
+     "  7: MUL OUT[0], TEMP[1], IMM[0].yyyy\n"
+     "  8: END\n" },
+};
+
+
+static uint64_t
+hash_outputs(uint64_t hash, const struct tgsi_exec_machine *mach)
+{
+   for (unsigned i = 0; i < mach->NumOutputs; i++) {
+      for (unsigned c = 0; c < TGSI_NUM_CHANNELS; c++) {
+         for (unsigned l = 0; l < TGSI_QUAD_SIZE; l++) {
+            hash = (hash ^ mach->Outputs[i].xyzw[c].u[l]) *
+                   1099511628211ull;
+         }
+      }
+   }
+   return hash;
+}
+
+static void
+set_vertex_inputs(struct tgsi_exec_machine *mach, unsigned n)
+{
+   for (unsigned a = 0; a < 2; a++) {
+      for (unsigned c = 0; c < TGSI_NUM_CHANNELS; c++) {
+         for (unsigned l = 0; l < TGSI_QUAD_SIZE; l++) {
+            mach->Inputs[a].xyzw[c].f[l] =
+               (float) ((n + a * 3 + c * 5 + l) % 17) * 0.125f - 1.0f;
+         }
+      }
+   }
+}
+
+/* Puts the quad at a different position every run, like softpipe's
+ * setup_pos_vector().
+ */
+static void
+set_quad_pos(struct tgsi_exec_machine *mach, unsigned n)
+{
+   const float x = (float) (n % 64) * 2;
+   const float y = (float) (n / 64 % 64) * 2;
+
+   for (unsigned l = 0; l < TGSI_QUAD_SIZE; l++) {
+      mach->QuadPos.xyzw[0].f[l] = x + (l & 1);
+      mach->QuadPos.xyzw[1].f[l] = y + (l >> 1);
+      mach->QuadPos.xyzw[2].f[l] = 0.5f;
+      mach->QuadPos.xyzw[3].f[l] = 1.0f + mach->QuadPos.xyzw[0].f[l] / 256;
+   }
+}
+
+static void
+run_shader(const struct bench_shader *shader, unsigned num_runs)
+{
+   struct tgsi_token tokens[MAX_TOKENS];
+   struct tgsi_interp_coef coefs[PIPE_MAX_SHADER_INPUTS];
+   static float consts[NUM_CONSTS * 4];
+   const void *bufs[PIPE_MAX_CONSTANT_BUFFERS] = { consts };
+   unsigned buf_sizes[PIPE_MAX_CONSTANT_BUFFERS] = { sizeof(consts) };
+   struct tgsi_exec_machine *mach;
+   enum pipe_shader_type type;
+   int64_t best = INT64_MAX;
+   uint64_t hash = 0;
+
+   if (!tgsi_text_translate(shader->text, tokens, MAX_TOKENS)) {
+      fprintf(stderr, "%s: failed to parse\n", shader->name);
+      exit(EXIT_FAILURE);
+   }
+
+   type = strncmp(shader->text, "FRAG", 4) == 0 ?
+      PIPE_SHADER_FRAGMENT : PIPE_SHADER_VERTEX;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(consts); i++)
+      consts[i] = (float) (i * 7 % 11) * 0.25f - 1.0f;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(coefs); i++) {
+      for (unsigned c = 0; c < TGSI_NUM_CHANNELS; c++) {
+         coefs[i].a0[c] = (float) (i + c) * 0.1f - 0.5f;
+         coefs[i].dadx[c] = 1.0f / 64;
+         coefs[i].dady[c] = -1.0f / 128;
+      }
+   }
+
+   mach = tgsi_exec_machine_create(type);
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL, NULL, NULL);
+   tgsi_exec_set_constant_buffers(mach, 1, bufs, buf_sizes);
+   mach->InterpCoefs = coefs;
+
+   for (unsigned r = 0; r < NUM_REPETITIONS; r++) {
+      int64_t start = os_time_get_nano();
+
+      hash = 14695981039346656037ull;
+      for (unsigned n = 0; n < num_runs; n++) {
+         uint mask;
+
+         if (type == PIPE_SHADER_FRAGMENT) {
+            set_quad_pos(mach, n);
+            mach->NonHelperMask = 0xf;
+         } else {
+            set_vertex_inputs(mach, n);
+         }
+
+         mask = tgsi_exec_machine_run(mach, 0);
+         hash = hash_outputs(hash ^ mask, mach);
+      }
+
+      best = MIN2(best, os_time_get_nano() - start);
+   }
+
+   printf("%-24s %4u insns %8.1f ns/run  %016llx\n", shader->name,
+          mach->NumInstructions, (double) best / num_runs,
+          (unsigned long long) hash);
+
+   tgsi_exec_machine_destroy(mach);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_runs = argc > 1 ? atoi(argv[1]) : 1000000;
+
+   util_init_math();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(shaders); i++)
+      run_shader(&shaders[i], num_runs);
+
+   return 0;
+}
@@ -89,6 +89,12 @@ class PrintCode(gl_XML.gl_print_base):
         out('debug_print_sync_fallback("{0}");'.format(func.name))
         self.print_sync_call(func)
 
+    def print_call_after(self, func):
+        # Lets the main thread keep track of state it needs to know about,
+        # such as where the current vertex arrays are.
+        if func.marshal_call_after:
+            out('{0};'.format(func.marshal_call_after))
+
     def print_sync_body(self, func):
         out('/* {0}: marshalled synchronously */'.format(func.name))
         out('static {0} GLAPIENTRY'.format(func.return_type))
@@ -96,13 +102,30 @@ class PrintCode(gl_XML.gl_print_base):
         out('{')
         with indent():
             out('GET_CURRENT_CONTEXT(ctx);')
+            if func.marshal_shadow:
+                self.print_shadow(func)
             out('_mesa_glthread_finish(ctx);')
             out('debug_print_sync("{0}");'.format(func.name))
             self.print_sync_call(func)
+            if func.return_type == 'void':
+                self.print_call_after(func)
         out('}')
         out('')
         out('')
 
+    def print_shadow(self, func):
+        # The condition answers the call from the state glthread tracks,
+        # storing the return value, if any, in "result".
+        if func.return_type == 'void':
+            out('if ({0})'.format(func.marshal_shadow))
+            with indent():
+                out('return;')
+        else:
+            out('{0} result;'.format(func.return_type))
+            out('if ({0})'.format(func.marshal_shadow))
+            with indent():
+                out('return result;')
+
     def print_async_dispatch(self, func):
         out('cmd = _mesa_glthread_allocate_command(ctx, '
             'DISPATCH_CMD_{0}, cmd_size);'.format(func.name))
@@ -252,9 +275,19 @@ class PrintCode(gl_XML.gl_print_base):
                     out('return;')
                 out('}')
 
+            if func.marshal_sync:
+                out('if ({0}) {{'.format(func.marshal_sync))
+                with indent():
+                    out('_mesa_glthread_finish(ctx);')
+                    self.print_sync_dispatch(func)
+                    self.print_call_after(func)
+                    out('return;')
+                out('}')
+
             out('if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {')
             with indent():
                 self.print_async_dispatch(func)
+                self.print_call_after(func)
                 out('return;')
             out('}')
 
@@ -264,6 +297,7 @@ class PrintCode(gl_XML.gl_print_base):
         with indent():
             out('_mesa_glthread_finish(ctx);')
             self.print_sync_dispatch(func)
+            self.print_call_after(func)
 
         out('}')
 
@@ -1159,6 +1159,8 @@ _mesa_PopAttrib(void)
                _mesa_Hint(GL_FOG_HINT, hint->Fog);
                _mesa_Hint(GL_TEXTURE_COMPRESSION_HINT_ARB,
                           hint->TextureCompression);
+               _mesa_MaxShaderCompilerThreadsARB(
+                  hint->MaxShaderCompilerThreads);
             }
             break;
          case GL_LIGHTING_BIT:
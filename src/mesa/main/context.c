@@ -1759,6 +1759,12 @@ _mesa_make_current( struct gl_context *newCtx,
          handle_first_current(newCtx);
          newCtx->FirstTimeCurrent = GL_FALSE;
       }
+
+      /* The viewport may have been initialized above, and the driver may
+       * have changed other state behind glthread's back.
+       */
+      if (newCtx->GLThread)
+         _mesa_glthread_invalidate_state(newCtx);
    }
 
    return GL_TRUE;
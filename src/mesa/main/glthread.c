@@ -33,9 +33,14 @@
  */
 
 #include "main/mtypes.h"
+#include "main/bufferobj.h"
+#include "main/extensions.h"
+#include "main/glformats.h"
 #include "main/glthread.h"
 #include "main/marshal.h"
 #include "main/marshal_generated.h"
+#include "main/teximage.h"
+#include "main/texstate.h"
 #include "util/u_atomic.h"
 #include "util/u_thread.h"
 
@@ -95,6 +100,13 @@ _mesa_glthread_init(struct gl_context *ctx)
    ctx->CurrentClientDispatch = ctx->MarshalExec;
    ctx->GLThread = glthread;
 
+   _mesa_glthread_update_client_arrays(ctx);
+
+   glthread->unpack.store = ctx->Unpack;
+   glthread->unpack.store.BufferObj = NULL;
+   glthread->unpack.buffer = ctx->Unpack.BufferObj->Name;
+   glthread->state.element_array_buffer_known = true;
+
    /* Execute the thread initialization function in the thread. */
    struct util_queue_fence fence;
    util_queue_fence_init(&fence);
@@ -218,3 +230,1124 @@ _mesa_glthread_finish(struct gl_context *ctx)
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
 }
+
+
+/**
+ * Copies the vertex array state of the context into the main thread's copy.
+ *
+ * This may only be called when the worker thread is idle, i.e. at init time
+ * or after a synchronous call.
+ */
+void
+_mesa_glthread_update_client_arrays(struct gl_context *ctx)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   const struct gl_vertex_array_object *vao = ctx->Array.VAO;
+
+   arrays->enabled = vao->_Enabled;
+   arrays->user_bindings = 0;
+   arrays->client_active_texture = ctx->Array.ActiveTexture;
+   arrays->array_buffer = ctx->Array.ArrayBufferObj->Name;
+   arrays->element_array_buffer = vao->IndexBufferObj->Name;
+   arrays->primitive_restart = ctx->Array.PrimitiveRestart;
+   arrays->primitive_restart_fixed_index =
+      ctx->Array.PrimitiveRestartFixedIndex;
+   arrays->restart_index = ctx->Array.RestartIndex;
+   arrays->primitive_restart_valid = true;
+
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++) {
+      const struct gl_array_attributes *attrib = &vao->VertexAttrib[i];
+      const struct gl_vertex_buffer_binding *binding = &vao->BufferBinding[i];
+
+      arrays->attribs[i].pointer = attrib->Ptr;
+      arrays->attribs[i].element_size = attrib->_ElementSize;
+      arrays->attribs[i].binding = attrib->BufferBindingIndex;
+      arrays->bindings[i].stride = binding->Stride;
+      arrays->bindings[i].divisor = binding->InstanceDivisor;
+
+      if (!_mesa_is_bufferobj(binding->BufferObj))
+         arrays->user_bindings |= 1u << i;
+   }
+}
+
+/* Component types for glthread_pointer_format::types. */
+#define BYTE_BIT           (1 << 0)
+#define UNSIGNED_BYTE_BIT  (1 << 1)
+#define SHORT_BIT          (1 << 2)
+#define UNSIGNED_SHORT_BIT (1 << 3)
+#define INT_BIT            (1 << 4)
+#define UNSIGNED_INT_BIT   (1 << 5)
+#define FLOAT_BIT          (1 << 6)
+#define DOUBLE_BIT         (1 << 7)
+#define ALL_TYPE_BITS      0xff
+
+/**
+ * The sizes and types a gl*Pointer function accepts, as checked by the
+ * function in varray.c.  Only the plain integer and float types are listed:
+ * whether the half-float, fixed and packed types are legal depends on the
+ * API and extensions, so we leave calls using them, or GL_BGRA, to the
+ * context and reload the state afterwards.
+ */
+struct glthread_pointer_format
+{
+   GLint size_min;
+   GLint size_max;
+   GLbitfield types;
+};
+
+static const struct glthread_pointer_format desktop_pointer_formats[] = {
+   [VERT_ATTRIB_POS] = { 2, 4, SHORT_BIT | INT_BIT | FLOAT_BIT | DOUBLE_BIT },
+   [VERT_ATTRIB_NORMAL] = { 3, 3, BYTE_BIT | SHORT_BIT | INT_BIT |
+                                  FLOAT_BIT | DOUBLE_BIT },
+   [VERT_ATTRIB_COLOR0] = { 3, 4, ALL_TYPE_BITS },
+   [VERT_ATTRIB_COLOR1] = { 3, 4, ALL_TYPE_BITS },
+   [VERT_ATTRIB_FOG] = { 1, 1, FLOAT_BIT | DOUBLE_BIT },
+   [VERT_ATTRIB_COLOR_INDEX] = { 1, 1, UNSIGNED_BYTE_BIT | SHORT_BIT |
+                                       INT_BIT | FLOAT_BIT | DOUBLE_BIT },
+   [VERT_ATTRIB_EDGEFLAG] = { 1, 1, UNSIGNED_BYTE_BIT },
+   /* glPointSizePointerOES only exists in ES 1.x. */
+   [VERT_ATTRIB_POINT_SIZE] = { 1, 0, 0 },
+};
+
+static const struct glthread_pointer_format es1_pointer_formats[] = {
+   [VERT_ATTRIB_POS] = { 2, 4, BYTE_BIT | SHORT_BIT | FLOAT_BIT },
+   [VERT_ATTRIB_NORMAL] = { 3, 3, BYTE_BIT | SHORT_BIT | FLOAT_BIT },
+   [VERT_ATTRIB_COLOR0] = { 4, 4, UNSIGNED_BYTE_BIT | FLOAT_BIT },
+   [VERT_ATTRIB_POINT_SIZE] = { 1, 1, FLOAT_BIT },
+};
+
+static const struct glthread_pointer_format desktop_tex_coord_format =
+   { 1, 4, SHORT_BIT | INT_BIT | FLOAT_BIT | DOUBLE_BIT };
+static const struct glthread_pointer_format es1_tex_coord_format =
+   { 2, 4, BYTE_BIT | SHORT_BIT | FLOAT_BIT };
+
+static const struct glthread_pointer_format generic_format =
+   { 1, 4, ALL_TYPE_BITS };
+static const struct glthread_pointer_format generic_integer_format =
+   { 1, 4, BYTE_BIT | UNSIGNED_BYTE_BIT | SHORT_BIT | UNSIGNED_SHORT_BIT |
+           INT_BIT | UNSIGNED_INT_BIT };
+static const struct glthread_pointer_format generic_double_format =
+   { 1, 4, DOUBLE_BIT };
+
+static GLbitfield
+get_type_bit(GLenum type)
+{
+   switch (type) {
+   case GL_BYTE:
+      return BYTE_BIT;
+   case GL_UNSIGNED_BYTE:
+      return UNSIGNED_BYTE_BIT;
+   case GL_SHORT:
+      return SHORT_BIT;
+   case GL_UNSIGNED_SHORT:
+      return UNSIGNED_SHORT_BIT;
+   case GL_INT:
+      return INT_BIT;
+   case GL_UNSIGNED_INT:
+      return UNSIGNED_INT_BIT;
+   case GL_FLOAT:
+      return FLOAT_BIT;
+   case GL_DOUBLE:
+      return DOUBLE_BIT;
+   default:
+      return 0;
+   }
+}
+
+static const struct glthread_pointer_format *
+get_pointer_format(const struct gl_context *ctx, gl_vert_attrib attrib)
+{
+   if (attrib >= VERT_ATTRIB_TEX0 && attrib <= VERT_ATTRIB_TEX7) {
+      return ctx->API == API_OPENGLES ? &es1_tex_coord_format
+                                      : &desktop_tex_coord_format;
+   }
+
+   if (ctx->API == API_OPENGLES) {
+      assert(attrib < ARRAY_SIZE(es1_pointer_formats));
+      return &es1_pointer_formats[attrib];
+   }
+
+   assert(attrib < ARRAY_SIZE(desktop_pointer_formats));
+   return &desktop_pointer_formats[attrib];
+}
+
+enum pointer_check
+{
+   POINTER_VALID,
+   POINTER_INVALID,
+   /** Only the context can tell. */
+   POINTER_UNKNOWN,
+};
+
+/** Mirrors validate_array_format() for the types we know about. */
+static enum pointer_check
+check_pointer_format(const struct gl_context *ctx,
+                     const struct glthread_pointer_format *format,
+                     GLint size, GLenum type)
+{
+   const GLbitfield type_bit = get_type_bit(type);
+   GLbitfield types = format->types;
+
+   /* Like get_legal_types_mask(). */
+   if (_mesa_is_gles(ctx)) {
+      types &= ~DOUBLE_BIT;
+      if (ctx->Version < 30)
+         types &= ~(INT_BIT | UNSIGNED_INT_BIT);
+   }
+
+   if (!type_bit) {
+      /* Not a vertex array type at all, as opposed to one we don't know
+       * the rules for.
+       */
+      if (_mesa_bytes_per_vertex_attrib(4, type) <= 0)
+         return POINTER_INVALID;
+      return POINTER_UNKNOWN;
+   }
+
+   if (!(types & type_bit))
+      return POINTER_INVALID;
+
+   if (size == GL_BGRA)
+      return POINTER_UNKNOWN;
+
+   if (size < format->size_min || size > format->size_max)
+      return POINTER_INVALID;
+
+   return POINTER_VALID;
+}
+
+/**
+ * Waits for a call we can't follow and takes the resulting vertex array
+ * state from the context.
+ */
+static void
+reload_client_arrays(struct gl_context *ctx)
+{
+   _mesa_glthread_finish(ctx);
+   _mesa_glthread_update_client_arrays(ctx);
+}
+
+static void
+attrib_pointer(struct gl_context *ctx, gl_vert_attrib attrib,
+               const struct glthread_pointer_format *format, GLint size,
+               GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   switch (check_pointer_format(ctx, format, size, type)) {
+   case POINTER_INVALID:
+      /* The call throws an error and leaves the state alone. */
+      return;
+   case POINTER_UNKNOWN:
+      reload_client_arrays(ctx);
+      return;
+   case POINTER_VALID:
+      break;
+   }
+
+   /* A negative stride is an error, but it doesn't stop varray.c from
+    * setting the array, so let the context decide what it ends up as.
+    */
+   if (stride < 0) {
+      reload_client_arrays(ctx);
+      return;
+   }
+
+   const GLint element_size = _mesa_bytes_per_vertex_attrib(size, type);
+
+   /* Like update_array(), this resets the binding of the attribute to its
+    * own binding point.
+    */
+   arrays->attribs[attrib].pointer = pointer;
+   arrays->attribs[attrib].element_size = element_size;
+   arrays->attribs[attrib].binding = attrib;
+   arrays->bindings[attrib].stride = stride ? stride : element_size;
+
+   if (arrays->array_buffer)
+      arrays->user_bindings &= ~(1u << attrib);
+   else
+      arrays->user_bindings |= 1u << attrib;
+}
+
+/**
+ * Makes sure the primitive restart state matches the context, waiting for
+ * the worker if it might not.
+ */
+void
+_mesa_glthread_validate_primitive_restart(struct gl_context *ctx)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (arrays->primitive_restart_valid)
+      return;
+
+   _mesa_glthread_finish(ctx);
+   arrays->primitive_restart = ctx->Array.PrimitiveRestart;
+   arrays->primitive_restart_fixed_index =
+      ctx->Array.PrimitiveRestartFixedIndex;
+   arrays->restart_index = ctx->Array.RestartIndex;
+   arrays->primitive_restart_valid = true;
+}
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const GLvoid *pointer)
+{
+   attrib_pointer(ctx, attrib, get_pointer_format(ctx, attrib), size, type,
+                  stride, pointer);
+}
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size, GLenum type,
+                               GLsizei stride, const GLvoid *pointer)
+{
+   const GLuint unit = ctx->GLThread->arrays.client_active_texture;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_TEX(unit), size, type,
+                                stride, pointer);
+}
+
+static bool
+is_generic_index_valid(const struct gl_context *ctx, GLuint index)
+{
+   return index < ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs &&
+          index < VERT_ATTRIB_GENERIC_MAX;
+}
+
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                   GLint size, GLenum type, GLsizei stride,
+                                   const GLvoid *pointer)
+{
+   if (!is_generic_index_valid(ctx, index))
+      return;
+
+   attrib_pointer(ctx, VERT_ATTRIB_GENERIC(index), &generic_format, size,
+                  type, stride, pointer);
+}
+
+void
+_mesa_glthread_VertexAttribIPointer(struct gl_context *ctx, GLuint index,
+                                    GLint size, GLenum type, GLsizei stride,
+                                    const GLvoid *pointer)
+{
+   if (!is_generic_index_valid(ctx, index))
+      return;
+
+   attrib_pointer(ctx, VERT_ATTRIB_GENERIC(index), &generic_integer_format,
+                  size, type, stride, pointer);
+}
+
+void
+_mesa_glthread_VertexAttribLPointer(struct gl_context *ctx, GLuint index,
+                                    GLint size, GLenum type, GLsizei stride,
+                                    const GLvoid *pointer)
+{
+   if (!is_generic_index_valid(ctx, index))
+      return;
+
+   attrib_pointer(ctx, VERT_ATTRIB_GENERIC(index), &generic_double_format,
+                  size, type, stride, pointer);
+}
+
+static void
+attrib_format(struct gl_context *ctx, GLuint attribindex,
+              const struct glthread_pointer_format *format, GLint size,
+              GLenum type)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (!is_generic_index_valid(ctx, attribindex))
+      return;
+
+   switch (check_pointer_format(ctx, format, size, type)) {
+   case POINTER_INVALID:
+      return;
+   case POINTER_UNKNOWN:
+      reload_client_arrays(ctx);
+      return;
+   case POINTER_VALID:
+      break;
+   }
+
+   arrays->attribs[VERT_ATTRIB_GENERIC(attribindex)].element_size =
+      _mesa_bytes_per_vertex_attrib(size, type);
+}
+
+void
+_mesa_glthread_VertexAttribFormat(struct gl_context *ctx, GLuint attribindex,
+                                  GLint size, GLenum type)
+{
+   attrib_format(ctx, attribindex, &generic_format, size, type);
+}
+
+void
+_mesa_glthread_VertexAttribIFormat(struct gl_context *ctx, GLuint attribindex,
+                                   GLint size, GLenum type)
+{
+   attrib_format(ctx, attribindex, &generic_integer_format, size, type);
+}
+
+void
+_mesa_glthread_VertexAttribLFormat(struct gl_context *ctx, GLuint attribindex,
+                                   GLint size, GLenum type)
+{
+   attrib_format(ctx, attribindex, &generic_double_format, size, type);
+}
+
+void
+_mesa_glthread_AttribBinding(struct gl_context *ctx, GLuint attribindex,
+                             GLuint bindingindex)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (attribindex >= VERT_ATTRIB_GENERIC_MAX ||
+       bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   arrays->attribs[VERT_ATTRIB_GENERIC(attribindex)].binding =
+      VERT_ATTRIB_GENERIC(bindingindex);
+}
+
+void
+_mesa_glthread_BindingDivisor(struct gl_context *ctx, GLuint bindingindex,
+                              GLuint divisor)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   arrays->bindings[VERT_ATTRIB_GENERIC(bindingindex)].divisor = divisor;
+}
+
+void
+_mesa_glthread_AttribDivisor(struct gl_context *ctx, GLuint index,
+                             GLuint divisor)
+{
+   /* This is how glVertexAttribDivisor() is defined by
+    * ARB_vertex_attrib_binding.
+    */
+   _mesa_glthread_AttribBinding(ctx, index, index);
+   _mesa_glthread_BindingDivisor(ctx, index, divisor);
+}
+
+void
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint bindingindex,
+                                GLuint buffer, GLsizei stride)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (bindingindex >= VERT_ATTRIB_GENERIC_MAX || stride < 0)
+      return;
+
+   /* Unbinding the buffer doesn't give the binding a client pointer, it
+    * leaves it with nothing to draw from, so don't copy anything for it.
+    */
+   arrays->bindings[VERT_ATTRIB_GENERIC(bindingindex)].stride = stride;
+   arrays->user_bindings &= ~(1u << VERT_ATTRIB_GENERIC(bindingindex));
+   (void) buffer;
+}
+
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint first,
+                                 GLsizei count, const GLuint *buffers,
+                                 const GLsizei *strides)
+{
+   if (!buffers || !strides)
+      return;
+
+   for (GLsizei i = 0; i < count; i++)
+      _mesa_glthread_BindVertexBuffer(ctx, first + i, buffers[i], strides[i]);
+}
+
+static void
+set_attrib_enabled(struct glthread_client_arrays *arrays,
+                   gl_vert_attrib attrib, bool enable)
+{
+   if (attrib >= VERT_ATTRIB_MAX)
+      return;
+
+   if (enable)
+      arrays->enabled |= VERT_BIT(attrib);
+   else
+      arrays->enabled &= ~VERT_BIT(attrib);
+}
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable)
+{
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   set_attrib_enabled(&ctx->GLThread->arrays, VERT_ATTRIB_GENERIC(index),
+                      enable);
+}
+
+/** Mirrors client_state() in enable.c. */
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      set_attrib_enabled(arrays, VERT_ATTRIB_POS, enable);
+      break;
+   case GL_NORMAL_ARRAY:
+      set_attrib_enabled(arrays, VERT_ATTRIB_NORMAL, enable);
+      break;
+   case GL_COLOR_ARRAY:
+      set_attrib_enabled(arrays, VERT_ATTRIB_COLOR0, enable);
+      break;
+   case GL_INDEX_ARRAY:
+      set_attrib_enabled(arrays, VERT_ATTRIB_COLOR_INDEX, enable);
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      set_attrib_enabled(arrays,
+                         VERT_ATTRIB_TEX(arrays->client_active_texture),
+                         enable);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      set_attrib_enabled(arrays, VERT_ATTRIB_EDGEFLAG, enable);
+      break;
+   case GL_FOG_COORDINATE_ARRAY_EXT:
+      set_attrib_enabled(arrays, VERT_ATTRIB_FOG, enable);
+      break;
+   case GL_SECONDARY_COLOR_ARRAY_EXT:
+      set_attrib_enabled(arrays, VERT_ATTRIB_COLOR1, enable);
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      set_attrib_enabled(arrays, VERT_ATTRIB_POINT_SIZE, enable);
+      break;
+   case GL_PRIMITIVE_RESTART_NV:
+      if (ctx->Extensions.NV_primitive_restart)
+         arrays->primitive_restart = enable;
+      break;
+   }
+}
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const GLuint unit = texture - GL_TEXTURE0;
+
+   if (unit < VERT_ATTRIB_TEX_MAX)
+      ctx->GLThread->arrays.client_active_texture = unit;
+}
+
+/**
+ * The capabilities glIsEnabled can answer from glthread_server_state.  They
+ * exist in all APIs, so glEnable never fails for them.
+ */
+static const GLenum glthread_enable_caps[] = {
+   GL_BLEND,
+   GL_CULL_FACE,
+   GL_DEPTH_TEST,
+   GL_DITHER,
+   GL_POLYGON_OFFSET_FILL,
+   GL_SAMPLE_ALPHA_TO_COVERAGE,
+   GL_SAMPLE_COVERAGE,
+   GL_SCISSOR_TEST,
+   GL_STENCIL_TEST,
+};
+
+static int
+get_enable_bit(GLenum cap)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(glthread_enable_caps); i++) {
+      if (glthread_enable_caps[i] == cap)
+         return i;
+   }
+   return -1;
+}
+
+/**
+ * Copies the state in glthread_server_state from the context.  Like
+ * _mesa_glthread_update_client_arrays(), this may only be called when the
+ * worker thread is idle.
+ */
+static void
+load_server_state(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_server_state *state = &glthread->state;
+   const bool enabled[] = {
+      ctx->Color.BlendEnabled & 1,
+      ctx->Polygon.CullFlag,
+      ctx->Depth.Test,
+      ctx->Color.DitherFlag,
+      ctx->Polygon.OffsetFill,
+      ctx->Multisample.SampleAlphaToCoverage,
+      ctx->Multisample.SampleCoverage,
+      ctx->Scissor.EnableFlags & 1,
+      ctx->Stencil.Enabled,
+   };
+   STATIC_ASSERT(ARRAY_SIZE(enabled) == ARRAY_SIZE(glthread_enable_caps));
+
+   state->enabled = 0;
+   for (unsigned i = 0; i < ARRAY_SIZE(enabled); i++) {
+      if (enabled[i])
+         state->enabled |= 1u << i;
+   }
+
+   state->active_texture = ctx->Texture.CurrentUnit;
+   state->current_program =
+      ctx->Shader.ActiveProgram ? ctx->Shader.ActiveProgram->Name : 0;
+   state->vertex_array = ctx->Array.VAO->Name;
+   state->element_array_buffer_known = true;
+   state->viewport[0] = ctx->ViewportArray[0].X;
+   state->viewport[1] = ctx->ViewportArray[0].Y;
+   state->viewport[2] = ctx->ViewportArray[0].Width;
+   state->viewport[3] = ctx->ViewportArray[0].Height;
+
+   glthread->arrays.element_array_buffer = ctx->Array.VAO->IndexBufferObj->Name;
+
+   state->valid = true;
+}
+
+/**
+ * Makes sure glthread_server_state matches the context, waiting for the
+ * worker if it might not.
+ */
+void
+_mesa_glthread_validate_state(struct gl_context *ctx)
+{
+   if (ctx->GLThread->state.valid)
+      return;
+
+   _mesa_glthread_finish(ctx);
+   load_server_state(ctx);
+}
+
+/**
+ * Waits for the worker and reloads everything the bindings queries are
+ * answered from, putting it back in step with the context.
+ */
+static void
+reload_bindings(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _mesa_glthread_finish(ctx);
+   _mesa_glthread_update_client_arrays(ctx);
+   load_server_state(ctx);
+   glthread->unpack.buffer = ctx->Unpack.BufferObj->Name;
+}
+
+/**
+ * Called after something which may change the shadowed state in ways we
+ * don't follow, like glCallList or glPopAttrib, or before the first query.
+ */
+void
+_mesa_glthread_invalidate_state(struct gl_context *ctx)
+{
+   ctx->GLThread->state.valid = false;
+   ctx->GLThread->arrays.primitive_restart_valid = false;
+}
+
+static void
+set_enable(struct gl_context *ctx, GLenum cap, bool enable)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   struct glthread_server_state *state = &ctx->GLThread->state;
+   const int bit = get_enable_bit(cap);
+
+   if (bit >= 0) {
+      if (enable)
+         state->enabled |= 1u << bit;
+      else
+         state->enabled &= ~(1u << bit);
+      return;
+   }
+
+   /* The primitive restart caps mirror the checks in _mesa_set_enable(),
+    * since following a failed call would make us skip indices which the
+    * draw actually reads.
+    */
+   switch (cap) {
+   case GL_PRIMITIVE_RESTART:
+      if (_mesa_is_desktop_gl(ctx) && ctx->Version >= 31)
+         arrays->primitive_restart = enable;
+      break;
+   case GL_PRIMITIVE_RESTART_FIXED_INDEX:
+      if (_mesa_is_gles3(ctx) || ctx->Extensions.ARB_ES3_compatibility)
+         arrays->primitive_restart_fixed_index = enable;
+      break;
+   case GL_VERTEX_ARRAY:
+   case GL_NORMAL_ARRAY:
+   case GL_COLOR_ARRAY:
+   case GL_TEXTURE_COORD_ARRAY:
+   case GL_INDEX_ARRAY:
+   case GL_EDGE_FLAG_ARRAY:
+   case GL_FOG_COORDINATE_ARRAY_EXT:
+   case GL_SECONDARY_COLOR_ARRAY_EXT:
+   case GL_POINT_SIZE_ARRAY_OES:
+      _mesa_glthread_ClientState(ctx, cap, enable);
+      break;
+   }
+}
+
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap)
+{
+   set_enable(ctx, cap, true);
+}
+
+void
+_mesa_glthread_Disable(struct gl_context *ctx, GLenum cap)
+{
+   set_enable(ctx, cap, false);
+}
+
+/**
+ * glEnablei/glDisablei only change glIsEnabled for index 0, but we'd have to
+ * validate the index like the context does, so just start over.
+ */
+void
+_mesa_glthread_EnableDisablei(struct gl_context *ctx, GLenum cap)
+{
+   if (get_enable_bit(cap) >= 0)
+      _mesa_glthread_invalidate_state(ctx);
+}
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const GLuint unit = texture - GL_TEXTURE0;
+
+   if (unit < _mesa_max_tex_unit(ctx))
+      ctx->GLThread->state.active_texture = unit;
+}
+
+/**
+ * We can't tell whether the program is linked from here, so this also
+ * follows calls which fail for that reason.  The shadow is only trusted in
+ * KHR_no_error contexts, see _mesa_glthread_GetIntegerv().
+ */
+void
+_mesa_glthread_UseProgram(struct gl_context *ctx, GLuint program)
+{
+   ctx->GLThread->state.current_program = program;
+}
+
+/**
+ * Like glUseProgram, this can fail for reasons we can't check here: the
+ * name may never have been generated.
+ */
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array)
+{
+   struct glthread_server_state *state = &ctx->GLThread->state;
+
+   if (state->vertex_array != array) {
+      state->vertex_array = array;
+      state->element_array_buffer_known = false;
+   }
+}
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_server_state *state = &ctx->GLThread->state;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      if (arrays[i] && arrays[i] == state->vertex_array)
+         _mesa_glthread_BindVertexArray(ctx, 0);
+   }
+}
+
+/** Mirrors viewport() and clamp_viewport(). */
+void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height)
+{
+   GLfloat *viewport = ctx->GLThread->state.viewport;
+
+   if (width < 0 || height < 0)
+      return;
+
+   viewport[0] = x;
+   viewport[1] = y;
+   viewport[2] = MIN2((GLfloat) width, (GLfloat) ctx->Const.MaxViewportWidth);
+   viewport[3] = MIN2((GLfloat) height, (GLfloat) ctx->Const.MaxViewportHeight);
+
+   if (_mesa_has_ARB_viewport_array(ctx) ||
+       _mesa_has_OES_viewport_array(ctx)) {
+      viewport[0] = CLAMP(viewport[0], ctx->Const.ViewportBounds.Min,
+                          ctx->Const.ViewportBounds.Max);
+      viewport[1] = CLAMP(viewport[1], ctx->Const.ViewportBounds.Min,
+                          ctx->Const.ViewportBounds.Max);
+   }
+}
+
+/**
+ * For glViewportArrayv and glViewportIndexed*, which we only need to care
+ * about when they change viewport 0.
+ */
+void
+_mesa_glthread_ViewportIndexed(struct gl_context *ctx, GLuint first)
+{
+   if (first == 0)
+      _mesa_glthread_invalidate_state(ctx);
+}
+
+/**
+ * Answers the binding queries.  We follow glUseProgram, glBindBuffer and
+ * glBindVertexArray even when the call fails on the worker, because the
+ * program isn't linked or the name was never generated in a core context.
+ * Only a KHR_no_error context promises that doesn't happen, so anywhere
+ * else we sync, and reload the shadows while the worker is idle so that
+ * they're back in step with the context.
+ */
+static bool
+get_binding(struct gl_context *ctx, GLenum pname, GLint *params)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_server_state *state = &glthread->state;
+
+   switch (pname) {
+   case GL_ARRAY_BUFFER_BINDING:
+   case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+      break;
+   case GL_PIXEL_UNPACK_BUFFER_BINDING:
+      if (!_mesa_has_EXT_pixel_buffer_object(ctx) && !_mesa_is_gles3(ctx))
+         return false;
+      break;
+   case GL_CURRENT_PROGRAM:
+      if (ctx->API == API_OPENGLES)
+         return false;
+      break;
+   case GL_VERTEX_ARRAY_BINDING:
+      if (ctx->API != API_OPENGL_CORE)
+         return false;
+      break;
+   default:
+      return false;
+   }
+
+   if (!(ctx->Const.ContextFlags & GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR) ||
+       !state->valid || !state->element_array_buffer_known)
+      reload_bindings(ctx);
+
+   switch (pname) {
+   case GL_ARRAY_BUFFER_BINDING:
+      *params = glthread->arrays.array_buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+      *params = glthread->arrays.element_array_buffer;
+      break;
+   case GL_PIXEL_UNPACK_BUFFER_BINDING:
+      *params = glthread->unpack.buffer;
+      break;
+   case GL_CURRENT_PROGRAM:
+      *params = state->current_program;
+      break;
+   case GL_VERTEX_ARRAY_BINDING:
+      *params = state->vertex_array;
+      break;
+   }
+   return true;
+}
+
+/**
+ * Answers glGetIntegerv from the shadowed state.  Returns false for
+ * anything we don't track, or which may not exist in this context, in
+ * which case the caller has to ask the worker.
+ */
+bool
+_mesa_glthread_GetIntegerv(struct gl_context *ctx, GLenum pname,
+                           GLint *params)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_server_state *state = &glthread->state;
+
+   if (!params)
+      return false;
+
+   /* Things that only the main thread changes. */
+   switch (pname) {
+   case GL_CLIENT_ACTIVE_TEXTURE:
+      if (ctx->API != API_OPENGL_COMPAT && ctx->API != API_OPENGLES)
+         return false;
+      *params = GL_TEXTURE0 + glthread->arrays.client_active_texture;
+      return true;
+   case GL_UNPACK_ALIGNMENT:
+      *params = glthread->unpack.store.Alignment;
+      return true;
+   }
+
+   if (get_binding(ctx, pname, params))
+      return true;
+
+   /* Things that glCallList and glPopAttrib may change. */
+   switch (pname) {
+   case GL_ACTIVE_TEXTURE:
+   case GL_VIEWPORT:
+      break;
+   default:
+      return false;
+   }
+
+   /* This is a sync if the state isn't valid, but then we would have had to
+    * sync anyway.
+    */
+   _mesa_glthread_validate_state(ctx);
+
+   switch (pname) {
+   case GL_ACTIVE_TEXTURE:
+      *params = GL_TEXTURE0 + state->active_texture;
+      return true;
+   case GL_VIEWPORT:
+      for (unsigned i = 0; i < 4; i++)
+         params[i] = IROUND(state->viewport[i]);
+      return true;
+   default:
+      return false;
+   }
+}
+
+bool
+_mesa_glthread_IsEnabled(struct gl_context *ctx, GLenum cap,
+                         GLboolean *result)
+{
+   const struct glthread_server_state *state = &ctx->GLThread->state;
+   const int bit = get_enable_bit(cap);
+
+   if (bit < 0)
+      return false;
+
+   _mesa_glthread_validate_state(ctx);
+   *result = (state->enabled & (1u << bit)) ? GL_TRUE : GL_FALSE;
+   return true;
+}
+
+/**
+ * Errors are generated on the worker, so we only know there aren't any in
+ * a KHR_no_error context.
+ */
+bool
+_mesa_glthread_GetError(struct gl_context *ctx, GLenum *result)
+{
+   if (!(ctx->Const.ContextFlags & GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR))
+      return false;
+
+   *result = GL_NO_ERROR;
+   return true;
+}
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index)
+{
+   if (ctx->Extensions.NV_primitive_restart || ctx->Version >= 31)
+      ctx->GLThread->arrays.restart_index = index;
+}
+
+/**
+ * Mirrors the unpack half of pixel_storei(), including the error checks, so
+ * that we stay in sync with the context when the call fails.
+ */
+void
+_mesa_glthread_PixelStorei(struct gl_context *ctx, GLenum pname, GLint param)
+{
+   struct gl_pixelstore_attrib *unpack = &ctx->GLThread->unpack.store;
+
+   switch (pname) {
+   case GL_UNPACK_ALIGNMENT:
+      if (param == 1 || param == 2 || param == 4 || param == 8)
+         unpack->Alignment = param;
+      return;
+   case GL_UNPACK_SWAP_BYTES:
+   case GL_UNPACK_LSB_FIRST:
+      /* These don't change how much memory is read. */
+      return;
+   }
+
+   if (param < 0)
+      return;
+
+   switch (pname) {
+   case GL_UNPACK_ROW_LENGTH:
+      if (ctx->API != API_OPENGLES)
+         unpack->RowLength = param;
+      break;
+   case GL_UNPACK_SKIP_PIXELS:
+      if (ctx->API != API_OPENGLES)
+         unpack->SkipPixels = param;
+      break;
+   case GL_UNPACK_SKIP_ROWS:
+      if (ctx->API != API_OPENGLES)
+         unpack->SkipRows = param;
+      break;
+   case GL_UNPACK_IMAGE_HEIGHT:
+      if (_mesa_is_desktop_gl(ctx) || _mesa_is_gles3(ctx))
+         unpack->ImageHeight = param;
+      break;
+   case GL_UNPACK_SKIP_IMAGES:
+      if (_mesa_is_desktop_gl(ctx) || _mesa_is_gles3(ctx))
+         unpack->SkipImages = param;
+      break;
+   case GL_UNPACK_COMPRESSED_BLOCK_WIDTH:
+      if (_mesa_is_desktop_gl(ctx))
+         unpack->CompressedBlockWidth = param;
+      break;
+   case GL_UNPACK_COMPRESSED_BLOCK_HEIGHT:
+      if (_mesa_is_desktop_gl(ctx))
+         unpack->CompressedBlockHeight = param;
+      break;
+   case GL_UNPACK_COMPRESSED_BLOCK_DEPTH:
+      if (_mesa_is_desktop_gl(ctx))
+         unpack->CompressedBlockDepth = param;
+      break;
+   case GL_UNPACK_COMPRESSED_BLOCK_SIZE:
+      if (_mesa_is_desktop_gl(ctx))
+         unpack->CompressedBlockSize = param;
+      break;
+   }
+}
+
+void
+_mesa_glthread_PixelStoref(struct gl_context *ctx, GLenum pname,
+                           GLfloat param)
+{
+   _mesa_glthread_PixelStorei(ctx, pname, IROUND(param));
+}
+
+/**
+ * Whether a glTex(Sub)Image or glCompressedTex(Sub)Image call passes the
+ * target, level, border and size checks of the context.  The application's
+ * pointer may not be good for the size of a call GL rejects, so we only
+ * copy pixels for calls which get past these.  They only depend on the
+ * constants and extensions of the context, which don't change, so they can
+ * be done on the main thread.
+ *
+ * glTexSubImage sizes are compared with the largest image the level can
+ * have, as we don't know the size of the texture.
+ */
+bool
+_mesa_glthread_tex_image_is_legal(struct gl_context *ctx, GLuint dims,
+                                  bool sub_image, GLenum target, GLint level,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei depth, GLint border)
+{
+   if (sub_image) {
+      if (!_mesa_legal_texsubimage_target(ctx, dims, target, false))
+         return false;
+   } else {
+      if (!_mesa_legal_teximage_target(ctx, dims, target))
+         return false;
+
+      /* Like texture_error_check(). */
+      if (border < 0 || border > 1 ||
+          ((ctx->API != API_OPENGL_COMPAT ||
+            target == GL_TEXTURE_RECTANGLE_NV ||
+            target == GL_PROXY_TEXTURE_RECTANGLE_NV) && border != 0))
+         return false;
+   }
+
+   const GLint max_levels = _mesa_max_texture_levels(ctx, target);
+   if (level < 0 || level >= max_levels)
+      return false;
+
+   if (width < 0 || height < 0 || depth < 0)
+      return false;
+
+   if (!sub_image) {
+      return _mesa_legal_texture_dimensions(ctx, target, level, width,
+                                            height, depth, border);
+   }
+
+   /* Leave room for a border, which only compatibility contexts have. */
+   const GLsizei max_size = ((1 << (max_levels - 1)) >> level) +
+                            (ctx->API == API_OPENGL_COMPAT ? 2 : 0);
+   GLsizei max_width = max_size;
+   GLsizei max_height = dims > 1 ? max_size : 1;
+   GLsizei max_depth = dims > 2 ? max_size : 1;
+
+   switch (target) {
+   case GL_TEXTURE_RECTANGLE_NV:
+      max_width = max_height = ctx->Const.MaxTextureRectSize;
+      break;
+   case GL_TEXTURE_1D_ARRAY_EXT:
+      max_height = ctx->Const.MaxArrayTextureLayers;
+      break;
+   case GL_TEXTURE_2D_ARRAY_EXT:
+   case GL_TEXTURE_CUBE_MAP_ARRAY:
+   case GL_PROXY_TEXTURE_CUBE_MAP_ARRAY:
+      max_depth = ctx->Const.MaxArrayTextureLayers;
+      break;
+   }
+
+   return width <= max_width && height <= max_height && depth <= max_depth;
+}
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !buffers)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      const GLuint buffer = buffers[i];
+
+      if (!buffer)
+         continue;
+
+      if (buffer == glthread->arrays.array_buffer)
+         glthread->arrays.array_buffer = 0;
+      if (buffer == glthread->arrays.element_array_buffer)
+         glthread->arrays.element_array_buffer = 0;
+      if (buffer == glthread->unpack.buffer)
+         glthread->unpack.buffer = 0;
+   }
+}
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->client_attrib_stack_depth >= MAX_CLIENT_ATTRIB_STACK_DEPTH)
+      return;
+
+   /* The saved primitive restart state has to be accurate, as we're going
+    * to trust it again after glPopClientAttrib.
+    */
+   if (mask & GL_CLIENT_VERTEX_ARRAY_BIT)
+      _mesa_glthread_validate_primitive_restart(ctx);
+
+   struct glthread_client_attrib_node *node =
+      &glthread->client_attrib_stack[glthread->client_attrib_stack_depth++];
+
+   node->mask = mask;
+   if (mask & GL_CLIENT_VERTEX_ARRAY_BIT)
+      node->arrays = glthread->arrays;
+   if (mask & GL_CLIENT_PIXEL_STORE_BIT)
+      node->unpack = glthread->unpack;
+}
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->client_attrib_stack_depth == 0)
+      return;
+
+   struct glthread_client_attrib_node *node =
+      &glthread->client_attrib_stack[--glthread->client_attrib_stack_depth];
+
+   if (node->mask & GL_CLIENT_VERTEX_ARRAY_BIT)
+      glthread->arrays = node->arrays;
+   if (node->mask & GL_CLIENT_PIXEL_STORE_BIT)
+      glthread->unpack = node->unpack;
+}
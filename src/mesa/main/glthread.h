@@ -49,7 +49,130 @@
 #include <stdbool.h>
 #include "util/u_queue.h"
 
-enum marshal_dispatch_cmd_id;
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A vertex attribute, as seen by the main thread. */
+struct glthread_attrib
+{
+   /** The pointer passed to gl*Pointer, an offset if a VBO was bound. */
+   const GLvoid *pointer;
+
+   /** Size of one element in bytes. */
+   GLuint element_size;
+
+   /** The vertex buffer binding the attribute reads from. */
+   GLuint binding;
+};
+
+/** A vertex buffer binding point, as seen by the main thread. */
+struct glthread_binding
+{
+   /** Stride in bytes, with 0 already replaced by the element size. */
+   GLsizei stride;
+
+   GLuint divisor;
+};
+
+/**
+ * The vertex array state of the default vertex array object.
+ *
+ * glthread is turned off when a compatibility or ES context binds any other
+ * VAO, so this is all the main thread needs to know to find the client
+ * memory a draw reads.  It's everything glPushClientAttrib saves that we
+ * care about, so the attrib stack is just an array of these.
+ */
+struct glthread_client_arrays
+{
+   /** Enabled attributes, a bitmask of VERT_BIT_*. */
+   GLbitfield enabled;
+
+   /** Bindings with no buffer object, i.e. which point at client memory. */
+   GLbitfield user_bindings;
+
+   /** Index of the texture unit glTexCoordPointer sets. */
+   GLuint client_active_texture;
+
+   /** Names of the GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER bindings. */
+   GLuint array_buffer;
+   GLuint element_array_buffer;
+
+   /**
+    * Primitive restart state.  It isn't client state, so glCallList and
+    * glPopAttrib may change it, in which case primitive_restart_valid is
+    * cleared and it's reloaded from the context before it's used again.
+    */
+   bool primitive_restart_valid;
+   bool primitive_restart;
+   bool primitive_restart_fixed_index;
+   GLuint restart_index;
+
+   struct glthread_attrib attribs[VERT_ATTRIB_MAX];
+   struct glthread_binding bindings[VERT_ATTRIB_MAX];
+};
+
+/**
+ * Pixel unpacking state, as seen by the main thread, so that we know how
+ * much client memory a texture upload reads.
+ */
+struct glthread_pixel_unpack
+{
+   /** glPixelStore parameters.  BufferObj is unused and always NULL. */
+   struct gl_pixelstore_attrib store;
+
+   /**
+    * Name of the bound pixel unpack buffer, or 0.  It's a name rather than a
+    * flag so that we notice when glDeleteBuffers unbinds it.
+    */
+   GLuint buffer;
+};
+
+/**
+ * Other context state shadowed on the main thread, so that common glGet*
+ * and glIsEnabled queries don't have to wait for the worker.
+ *
+ * glCallList and glPopAttrib can change it behind our back, in which case
+ * it's marked invalid and reloaded from the context after a sync the next
+ * time it's needed.  (glNewList disables glthread, but lists can still come
+ * from a context we share them with.)
+ *
+ * The bindings also follow calls which fail, so outside of KHR_no_error
+ * contexts they're reloaded before every query that reads them.
+ */
+struct glthread_server_state
+{
+   bool valid;
+
+   /** Capabilities from glthread_enable_caps[], one bit each. */
+   GLbitfield enabled;
+
+   /** Index of the active texture unit. */
+   GLuint active_texture;
+
+   /** Name of the program set with glUseProgram. */
+   GLuint current_program;
+
+   /**
+    * Name of the bound vertex array object.  Only core contexts get to bind
+    * one without disabling glthread.  The element array buffer binding is
+    * part of it, so we lose track of that when it changes.
+    */
+   GLuint vertex_array;
+   bool element_array_buffer_known;
+
+   /** Viewport 0, clamped like the context does. */
+   GLfloat viewport[4];
+};
+
+struct glthread_client_attrib_node
+{
+   /** The mask passed to glPushClientAttrib. */
+   GLbitfield mask;
+
+   struct glthread_client_arrays arrays;
+   struct glthread_pixel_unpack unpack;
+};
 
 /** A single batch of commands queued up for execution. */
 struct glthread_batch
@@ -85,16 +208,21 @@ struct glthread_state
    unsigned next;
 
    /**
-    * Tracks on the main thread side whether the current vertex array binding
-    * is in a VBO.
+    * Vertex array state tracked on the main thread side, including whether
+    * the current vertex array and element array (index buffer) bindings are
+    * in VBOs.
     */
-   bool vertex_array_is_vbo;
+   struct glthread_client_arrays arrays;
 
-   /**
-    * Tracks on the main thread side whether the current element array (index
-    * buffer) binding is in a VBO.
-    */
-   bool element_array_is_vbo;
+   /** Pixel unpacking state tracked on the main thread side. */
+   struct glthread_pixel_unpack unpack;
+
+   /** Context state answering queries on the main thread side. */
+   struct glthread_server_state state;
+
+   /** glPushClientAttrib stack of the above. */
+   struct glthread_client_attrib_node client_attrib_stack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   unsigned client_attrib_stack_depth;
 };
 
 void _mesa_glthread_init(struct gl_context *ctx);
@@ -104,4 +232,89 @@ void _mesa_glthread_restore_dispatch(struct gl_context *ctx);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
 
+void _mesa_glthread_update_client_arrays(struct gl_context *ctx);
+void _mesa_glthread_validate_primitive_restart(struct gl_context *ctx);
+void _mesa_glthread_validate_state(struct gl_context *ctx);
+void _mesa_glthread_invalidate_state(struct gl_context *ctx);
+void _mesa_glthread_AttribPointer(struct gl_context *ctx,
+                                  gl_vert_attrib attrib, GLint size,
+                                  GLenum type, GLsizei stride,
+                                  const GLvoid *pointer);
+void _mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                                    GLenum type, GLsizei stride,
+                                    const GLvoid *pointer);
+void _mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                        GLint size, GLenum type,
+                                        GLsizei stride, const GLvoid *pointer);
+void _mesa_glthread_VertexAttribIPointer(struct gl_context *ctx, GLuint index,
+                                         GLint size, GLenum type,
+                                         GLsizei stride,
+                                         const GLvoid *pointer);
+void _mesa_glthread_VertexAttribLPointer(struct gl_context *ctx, GLuint index,
+                                         GLint size, GLenum type,
+                                         GLsizei stride,
+                                         const GLvoid *pointer);
+void _mesa_glthread_VertexAttribFormat(struct gl_context *ctx,
+                                       GLuint attribindex, GLint size,
+                                       GLenum type);
+void _mesa_glthread_VertexAttribIFormat(struct gl_context *ctx,
+                                        GLuint attribindex, GLint size,
+                                        GLenum type);
+void _mesa_glthread_VertexAttribLFormat(struct gl_context *ctx,
+                                        GLuint attribindex, GLint size,
+                                        GLenum type);
+void _mesa_glthread_AttribBinding(struct gl_context *ctx, GLuint attribindex,
+                                  GLuint bindingindex);
+void _mesa_glthread_BindingDivisor(struct gl_context *ctx,
+                                   GLuint bindingindex, GLuint divisor);
+void _mesa_glthread_AttribDivisor(struct gl_context *ctx, GLuint index,
+                                  GLuint divisor);
+void _mesa_glthread_BindVertexBuffer(struct gl_context *ctx,
+                                     GLuint bindingindex, GLuint buffer,
+                                     GLsizei stride);
+void _mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint first,
+                                      GLsizei count, const GLuint *buffers,
+                                      const GLsizei *strides);
+void _mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                      bool enable);
+void _mesa_glthread_ClientState(struct gl_context *ctx, GLenum array,
+                                bool enable);
+void _mesa_glthread_ClientActiveTexture(struct gl_context *ctx,
+                                        GLenum texture);
+void _mesa_glthread_Enable(struct gl_context *ctx, GLenum cap);
+void _mesa_glthread_Disable(struct gl_context *ctx, GLenum cap);
+void _mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx,
+                                          GLuint index);
+void _mesa_glthread_PixelStorei(struct gl_context *ctx, GLenum pname,
+                                GLint param);
+void _mesa_glthread_PixelStoref(struct gl_context *ctx, GLenum pname,
+                                GLfloat param);
+bool _mesa_glthread_tex_image_is_legal(struct gl_context *ctx, GLuint dims,
+                                       bool sub_image, GLenum target,
+                                       GLint level, GLsizei width,
+                                       GLsizei height, GLsizei depth,
+                                       GLint border);
+void _mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *buffers);
+void _mesa_glthread_EnableDisablei(struct gl_context *ctx, GLenum cap);
+void _mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture);
+void _mesa_glthread_UseProgram(struct gl_context *ctx, GLuint program);
+void _mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array);
+void _mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                       const GLuint *arrays);
+void _mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                             GLsizei width, GLsizei height);
+void _mesa_glthread_ViewportIndexed(struct gl_context *ctx, GLuint first);
+bool _mesa_glthread_GetIntegerv(struct gl_context *ctx, GLenum pname,
+                                GLint *params);
+bool _mesa_glthread_IsEnabled(struct gl_context *ctx, GLenum cap,
+                              GLboolean *result);
+bool _mesa_glthread_GetError(struct gl_context *ctx, GLenum *result);
+void _mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask);
+void _mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _GLTHREAD_H*/
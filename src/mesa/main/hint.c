@@ -130,6 +130,22 @@ invalid_target:
    return;
 }
 
+/* GL_ARB_parallel_shader_compile */
+void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (MESA_VERBOSE & VERBOSE_API)
+      _mesa_debug(ctx, "glMaxShaderCompilerThreadsARB %u\n", count);
+
+   /* Takes effect on the next glCompileShader, see compile_shader_async().
+    * 0 makes compiles synchronous, 0xffffffff means "implementation
+    * defined", which we take as one thread per CPU.
+    */
+   ctx->Hint.MaxShaderCompilerThreads = count;
+}
+
 
 /**********************************************************************/
 /*****                      Initialization                        *****/
@@ -146,4 +162,5 @@ void _mesa_init_hint( struct gl_context * ctx )
    ctx->Hint.TextureCompression = GL_DONT_CARE;
    ctx->Hint.GenerateMipmap = GL_DONT_CARE;
    ctx->Hint.FragmentShaderDerivative = GL_DONT_CARE;
+   ctx->Hint.MaxShaderCompilerThreads = 0xffffffff;
 }
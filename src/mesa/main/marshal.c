@@ -27,8 +27,14 @@
  * thread when automatic code generation isn't appropriate.
  */
 
+#include "main/mtypes.h"
 #include "main/enums.h"
+#include "main/glformats.h"
+#include "main/image.h"
 #include "main/macros.h"
+#include "main/texcompress.h"
+#include "main/teximage.h"
+#include "main/varray.h"
 #include "marshal.h"
 #include "dispatch.h"
 #include "marshal_generated.h"
@@ -95,6 +101,7 @@ _mesa_marshal_Enable(GLenum cap)
                                             sizeof(*cmd));
       cmd->cap = cap;
       _mesa_post_marshal_hook(ctx);
+      _mesa_glthread_Enable(ctx, cap);
       return;
    }
 
@@ -234,14 +241,18 @@ track_vbo_binding(struct gl_context *ctx, GLenum target, GLuint buffer)
 
    switch (target) {
    case GL_ARRAY_BUFFER:
-      glthread->vertex_array_is_vbo = (buffer != 0);
+      glthread->arrays.array_buffer = buffer;
       break;
    case GL_ELEMENT_ARRAY_BUFFER:
       /* The current element array buffer binding is actually tracked in the
        * vertex array object instead of the context, so this would need to
        * change on vertex array object updates.
        */
-      glthread->element_array_is_vbo = (buffer != 0);
+      glthread->arrays.element_array_buffer = buffer;
+      glthread->state.element_array_buffer_known = true;
+      break;
+   case GL_PIXEL_UNPACK_BUFFER:
+      glthread->unpack.buffer = buffer;
       break;
    }
 }
@@ -747,3 +758,1503 @@ _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                          (buffer, drawbuffer, depth, stencil));
    }
 }
+
+
+/* Draws.
+ *
+ * Compatibility and ES contexts can draw from vertex arrays and indices in
+ * client memory, which the application is free to change as soon as the
+ * draw returns.  We copy the parts of it the draw reads into the batch, or
+ * into a separate allocation if they don't fit, and the worker points the
+ * arrays at the copies for the duration of the draw.
+ */
+struct marshal_cmd_draw
+{
+   struct marshal_cmd_base cmd_base;
+
+   /**
+    * Client arrays (VERT_BIT_*) the draw reads.  One pointer to the copy of
+    * each follows the command.
+    */
+   GLbitfield user_arrays;
+
+   /** Allocation holding the copies if they didn't fit in the batch. */
+   void *heap;
+};
+
+/** A range of client memory read by one or more vertex arrays. */
+struct user_buffer
+{
+   const GLubyte *start;
+   const GLubyte *end;
+};
+
+/** Client memory a draw reads, found on the main thread. */
+struct user_data
+{
+   GLbitfield arrays;
+   unsigned num_buffers;
+   struct user_buffer buffers[VERT_ATTRIB_MAX];
+   /** Index into buffers[] of each of the arrays. */
+   unsigned buffer_of[VERT_ATTRIB_MAX];
+
+   const GLvoid *indices;
+   size_t indices_size;
+};
+
+static unsigned
+get_index_size(GLenum type)
+{
+   switch (type) {
+   case GL_UNSIGNED_BYTE:
+      return 1;
+   case GL_UNSIGNED_SHORT:
+      return 2;
+   case GL_UNSIGNED_INT:
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+#define GET_INDEX_BOUNDS(T)                                    \
+   do {                                                        \
+      const T *idx = indices;                                  \
+      for (GLsizei i = 0; i < count; i++) {                    \
+         if (restart && idx[i] == restart_index)               \
+            continue;                                          \
+         *min_index = MIN2(*min_index, idx[i]);                \
+         *max_index = MAX2(*max_index, idx[i]);                \
+      }                                                        \
+   } while (0)
+
+/**
+ * Finds the lowest and highest index a draw reads from client memory,
+ * skipping primitive restart indices.  Leaves *min_index > *max_index if
+ * there are none.
+ */
+static void
+get_index_bounds(const struct glthread_client_arrays *arrays,
+                 unsigned index_size, const GLvoid *indices, GLsizei count,
+                 unsigned *min_index, unsigned *max_index)
+{
+   const bool restart = arrays->primitive_restart ||
+                        arrays->primitive_restart_fixed_index;
+   const GLuint restart_index = arrays->primitive_restart_fixed_index ?
+      0xffffffffu >> (32 - index_size * 8) : arrays->restart_index;
+
+   *min_index = ~0u;
+   *max_index = 0;
+
+   switch (index_size) {
+   case 1:
+      GET_INDEX_BOUNDS(GLubyte);
+      break;
+   case 2:
+      GET_INDEX_BOUNDS(GLushort);
+      break;
+   case 4:
+      GET_INDEX_BOUNDS(GLuint);
+      break;
+   }
+}
+
+#undef GET_INDEX_BOUNDS
+
+/**
+ * Works out the client memory the arrays in \p data read for vertices
+ * \p min_index to \p max_index and the given instances.  Arrays which are
+ * interleaved share a buffer, so that the data is only copied once.
+ */
+static void
+get_user_buffers(const struct glthread_client_arrays *arrays,
+                 struct user_data *data, unsigned min_index,
+                 unsigned max_index, GLuint baseinstance, GLsizei primcount)
+{
+   GLbitfield mask = data->arrays;
+
+   data->num_buffers = 0;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      const struct glthread_attrib *attrib = &arrays->attribs[i];
+      const struct glthread_binding *binding =
+         &arrays->bindings[attrib->binding];
+      const GLubyte *pointer = (const GLubyte *) attrib->pointer;
+      unsigned first = min_index, last = max_index;
+      unsigned j;
+
+      if (binding->divisor) {
+         first = baseinstance;
+         last = baseinstance + (primcount - 1) / binding->divisor;
+      }
+
+      const GLubyte *start = pointer + (size_t) first * binding->stride;
+      const GLubyte *end = pointer + (size_t) last * binding->stride +
+                           attrib->element_size;
+
+      for (j = 0; j < data->num_buffers; j++) {
+         struct user_buffer *buf = &data->buffers[j];
+
+         if (start <= buf->end && end >= buf->start) {
+            buf->start = MIN2(buf->start, start);
+            buf->end = MAX2(buf->end, end);
+            break;
+         }
+      }
+
+      if (j == data->num_buffers) {
+         data->buffers[j].start = start;
+         data->buffers[j].end = end;
+         data->num_buffers++;
+      }
+
+      data->buffer_of[i] = j;
+   }
+}
+
+/**
+ * Allocates a draw command of \p cmd_size bytes followed by the array
+ * pointers and copies of everything in \p data, and points \p *indices at
+ * the copy of the indices if there is one.  Returns NULL if we failed to
+ * allocate memory, in which case the draw has to be done synchronously.
+ */
+static struct marshal_cmd_draw *
+allocate_draw(struct gl_context *ctx, uint16_t cmd_id, size_t cmd_size,
+              const struct user_data *data, const GLvoid **indices)
+{
+   const size_t pointers_size = _mesa_bitcount(data->arrays) * sizeof(void *);
+   size_t copy_size = ALIGN(data->indices_size, 8);
+   size_t buffer_offset[VERT_ATTRIB_MAX];
+   struct marshal_cmd_draw *cmd;
+   GLubyte *copy;
+   void *heap = NULL;
+
+   for (unsigned i = 0; i < data->num_buffers; i++) {
+      buffer_offset[i] = copy_size;
+      copy_size += ALIGN(data->buffers[i].end - data->buffers[i].start, 8);
+   }
+
+   if (cmd_size + pointers_size + copy_size <= MARSHAL_MAX_CMD_SIZE) {
+      cmd = _mesa_glthread_allocate_command(ctx, cmd_id,
+                                            cmd_size + pointers_size +
+                                            copy_size);
+      copy = (GLubyte *) cmd + cmd_size + pointers_size;
+   } else {
+      heap = malloc(copy_size);
+      if (!heap)
+         return NULL;
+
+      cmd = _mesa_glthread_allocate_command(ctx, cmd_id,
+                                            cmd_size + pointers_size);
+      copy = heap;
+   }
+
+   cmd->user_arrays = data->arrays;
+   cmd->heap = heap;
+
+   if (data->indices_size) {
+      memcpy(copy, data->indices, data->indices_size);
+      *indices = copy;
+   }
+
+   for (unsigned i = 0; i < data->num_buffers; i++) {
+      memcpy(copy + buffer_offset[i], data->buffers[i].start,
+             data->buffers[i].end - data->buffers[i].start);
+   }
+
+   /* Point each array at the copy such that the same vertices are read. */
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   const GLubyte **pointers =
+      (const GLubyte **) ((GLubyte *) cmd + cmd_size);
+   GLbitfield mask = data->arrays;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      const unsigned buf = data->buffer_of[i];
+      const GLubyte *pointer = (const GLubyte *) arrays->attribs[i].pointer;
+
+      *pointers++ = copy + buffer_offset[buf] +
+                    (pointer - data->buffers[buf].start);
+   }
+
+   return cmd;
+}
+
+static void
+bind_user_arrays(struct gl_context *ctx, const struct marshal_cmd_draw *cmd,
+                 size_t cmd_size, const GLvoid **saved)
+{
+   const GLvoid * const *pointers =
+      (const GLvoid * const *) ((const GLubyte *) cmd + cmd_size);
+   GLbitfield mask = cmd->user_arrays;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      saved[i] = _mesa_set_client_array_pointer(ctx, i, *pointers++);
+   }
+}
+
+static void
+restore_user_arrays(struct gl_context *ctx,
+                    const struct marshal_cmd_draw *cmd,
+                    const GLvoid **saved)
+{
+   GLbitfield mask = cmd->user_arrays;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      _mesa_set_client_array_pointer(ctx, i, saved[i]);
+   }
+
+   free(cmd->heap);
+}
+
+
+/* DrawArrays and friends */
+struct marshal_cmd_DrawArrays
+{
+   struct marshal_cmd_draw draw;
+   GLenum mode;
+   GLint first;
+   GLsizei count;
+   GLsizei primcount;
+   GLuint baseinstance;
+};
+
+static bool
+marshal_draw_arrays(struct gl_context *ctx, uint16_t cmd_id, GLenum mode,
+                    GLint first, GLsizei count, GLsizei primcount,
+                    GLuint baseinstance)
+{
+   struct marshal_cmd_DrawArrays *cmd;
+   struct user_data data;
+
+   data.arrays = 0;
+   data.num_buffers = 0;
+   data.indices = NULL;
+   data.indices_size = 0;
+
+   /* Nothing is read for empty or invalid draws, so leave the error
+    * checking to the worker.
+    */
+   if (first >= 0 && count > 0 && primcount > 0) {
+      data.arrays = _mesa_glthread_get_user_vertex_arrays(ctx);
+      if (data.arrays) {
+         get_user_buffers(&ctx->GLThread->arrays, &data, first,
+                          (unsigned) first + count - 1, baseinstance,
+                          primcount);
+      }
+   }
+
+   cmd = (struct marshal_cmd_DrawArrays *)
+      allocate_draw(ctx, cmd_id, sizeof(*cmd), &data, NULL);
+   if (!cmd)
+      return false;
+
+   cmd->mode = mode;
+   cmd->first = first;
+   cmd->count = count;
+   cmd->primcount = primcount;
+   cmd->baseinstance = baseinstance;
+   _mesa_post_marshal_hook(ctx);
+   return true;
+}
+
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawArrays(ctx->CurrentServerDispatch,
+                   (cmd->mode, cmd->first, cmd->count));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawArrays");
+
+   if (marshal_draw_arrays(ctx, DISPATCH_CMD_DrawArrays, mode, first, count,
+                           1, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawArrays");
+   CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+}
+
+void
+_mesa_unmarshal_DrawArraysInstancedARB(struct gl_context *ctx,
+                                       const struct marshal_cmd_DrawArrays *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawArraysInstancedARB(ctx->CurrentServerDispatch,
+                               (cmd->mode, cmd->first, cmd->count,
+                                cmd->primcount));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArraysInstancedARB(GLenum mode, GLint first, GLsizei count,
+                                     GLsizei primcount)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawArraysInstancedARB");
+
+   if (marshal_draw_arrays(ctx, DISPATCH_CMD_DrawArraysInstancedARB, mode,
+                           first, count, primcount, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawArraysInstancedARB");
+   CALL_DrawArraysInstancedARB(ctx->CurrentServerDispatch,
+                               (mode, first, count, primcount));
+}
+
+void
+_mesa_unmarshal_DrawArraysInstancedBaseInstance(struct gl_context *ctx,
+                                                const struct marshal_cmd_DrawArrays *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawArraysInstancedBaseInstance(ctx->CurrentServerDispatch,
+                                        (cmd->mode, cmd->first, cmd->count,
+                                         cmd->primcount, cmd->baseinstance));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArraysInstancedBaseInstance(GLenum mode, GLint first,
+                                              GLsizei count,
+                                              GLsizei primcount,
+                                              GLuint baseinstance)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawArraysInstancedBaseInstance");
+
+   if (marshal_draw_arrays(ctx, DISPATCH_CMD_DrawArraysInstancedBaseInstance,
+                           mode, first, count, primcount, baseinstance))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawArraysInstancedBaseInstance");
+   CALL_DrawArraysInstancedBaseInstance(ctx->CurrentServerDispatch,
+                                        (mode, first, count, primcount,
+                                         baseinstance));
+}
+
+
+/* DrawElements and friends */
+struct marshal_cmd_DrawElements
+{
+   struct marshal_cmd_draw draw;
+   GLenum mode;
+   GLuint start;
+   GLuint end;
+   GLsizei count;
+   GLenum type;
+   const GLvoid *indices;
+   GLint basevertex;
+   GLsizei primcount;
+   GLuint baseinstance;
+};
+
+/**
+ * \p index_bounds_valid says whether \p start and \p end come from the
+ * application, as with glDrawRangeElements(), in which case we trust them
+ * when we can't read the indices from here.
+ */
+static bool
+marshal_draw_elements(struct gl_context *ctx, uint16_t cmd_id, GLenum mode,
+                      bool index_bounds_valid, GLuint start, GLuint end,
+                      GLsizei count, GLenum type, const GLvoid *indices,
+                      GLint basevertex, GLsizei primcount,
+                      GLuint baseinstance)
+{
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   const unsigned index_size = get_index_size(type);
+   struct marshal_cmd_DrawElements *cmd;
+   struct user_data data;
+
+   data.arrays = 0;
+   data.num_buffers = 0;
+   data.indices = NULL;
+   data.indices_size = 0;
+
+   if (count > 0 && primcount > 0 && index_size) {
+      unsigned min_index = start, max_index = end;
+
+      if (_mesa_glthread_is_non_vbo_draw_elements(ctx)) {
+         data.indices = indices;
+         data.indices_size = (size_t) count * index_size;
+      }
+
+      data.arrays = _mesa_glthread_get_user_vertex_arrays(ctx);
+      if (data.arrays) {
+         if (data.indices) {
+            /* The primitive restart state is needed to skip the restart
+             * index, so reload it if a display list may have changed it.
+             */
+            _mesa_glthread_validate_primitive_restart(ctx);
+            get_index_bounds(arrays, index_size, indices, count,
+                             &min_index, &max_index);
+         } else if (!index_bounds_valid) {
+            /* The indices are in a buffer object, which we can't look at
+             * without waiting for the worker.
+             */
+            return false;
+         }
+
+         if (min_index > max_index) {
+            /* Only restart indices, nothing to copy. */
+            data.arrays = 0;
+         } else if ((int64_t) min_index + basevertex < 0 ||
+                    (int64_t) max_index + basevertex > UINT32_MAX) {
+            return false;
+         } else {
+            get_user_buffers(arrays, &data, min_index + basevertex,
+                             max_index + basevertex, baseinstance,
+                             primcount);
+         }
+      }
+   } else if (!index_size && _mesa_glthread_is_non_vbo_draw_elements(ctx)) {
+      /* We don't know how much to copy, let the driver throw the error. */
+      return false;
+   }
+
+   cmd = (struct marshal_cmd_DrawElements *)
+      allocate_draw(ctx, cmd_id, sizeof(*cmd), &data, &indices);
+   if (!cmd)
+      return false;
+
+   cmd->mode = mode;
+   cmd->start = start;
+   cmd->end = end;
+   cmd->count = count;
+   cmd->type = type;
+   cmd->indices = indices;
+   cmd->basevertex = basevertex;
+   cmd->primcount = primcount;
+   cmd->baseinstance = baseinstance;
+   _mesa_post_marshal_hook(ctx);
+   return true;
+}
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElements(ctx->CurrentServerDispatch,
+                     (cmd->mode, cmd->count, cmd->type, cmd->indices));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElements");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawElements, mode, false,
+                             0, 0, count, type, indices, 0, 1, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElements");
+   CALL_DrawElements(ctx->CurrentServerDispatch,
+                     (mode, count, type, indices));
+}
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                          (cmd->mode, cmd->start, cmd->end, cmd->count,
+                           cmd->type, cmd->indices));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElements");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawRangeElements, mode,
+                             start <= end, start, end, count, type, indices,
+                             0, 1, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawRangeElements");
+   CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                          (mode, start, end, count, type, indices));
+}
+
+void
+_mesa_unmarshal_DrawElementsBaseVertex(struct gl_context *ctx,
+                                       const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElementsBaseVertex(ctx->CurrentServerDispatch,
+                               (cmd->mode, cmd->count, cmd->type,
+                                cmd->indices, cmd->basevertex));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                                     const GLvoid *indices, GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsBaseVertex");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawElementsBaseVertex, mode,
+                             false, 0, 0, count, type, indices, basevertex,
+                             1, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsBaseVertex");
+   CALL_DrawElementsBaseVertex(ctx->CurrentServerDispatch,
+                               (mode, count, type, indices, basevertex));
+}
+
+void
+_mesa_unmarshal_DrawRangeElementsBaseVertex(struct gl_context *ctx,
+                                            const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawRangeElementsBaseVertex(ctx->CurrentServerDispatch,
+                                    (cmd->mode, cmd->start, cmd->end,
+                                     cmd->count, cmd->type, cmd->indices,
+                                     cmd->basevertex));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElementsBaseVertex(GLenum mode, GLuint start,
+                                          GLuint end, GLsizei count,
+                                          GLenum type, const GLvoid *indices,
+                                          GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElementsBaseVertex");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawRangeElementsBaseVertex,
+                             mode, start <= end, start, end, count, type,
+                             indices, basevertex, 1, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawRangeElementsBaseVertex");
+   CALL_DrawRangeElementsBaseVertex(ctx->CurrentServerDispatch,
+                                    (mode, start, end, count, type, indices,
+                                     basevertex));
+}
+
+void
+_mesa_unmarshal_DrawElementsInstancedARB(struct gl_context *ctx,
+                                         const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElementsInstancedARB(ctx->CurrentServerDispatch,
+                                 (cmd->mode, cmd->count, cmd->type,
+                                  cmd->indices, cmd->primcount));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedARB(GLenum mode, GLsizei count,
+                                       GLenum type, const GLvoid *indices,
+                                       GLsizei primcount)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsInstancedARB");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawElementsInstancedARB, mode,
+                             false, 0, 0, count, type, indices, 0,
+                             primcount, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsInstancedARB");
+   CALL_DrawElementsInstancedARB(ctx->CurrentServerDispatch,
+                                 (mode, count, type, indices, primcount));
+}
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseVertex(struct gl_context *ctx,
+                                                const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElementsInstancedBaseVertex(ctx->CurrentServerDispatch,
+                                        (cmd->mode, cmd->count, cmd->type,
+                                         cmd->indices, cmd->primcount,
+                                         cmd->basevertex));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count,
+                                              GLenum type,
+                                              const GLvoid *indices,
+                                              GLsizei primcount,
+                                              GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsInstancedBaseVertex");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawElementsInstancedBaseVertex,
+                             mode, false, 0, 0, count, type, indices,
+                             basevertex, primcount, 0))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsInstancedBaseVertex");
+   CALL_DrawElementsInstancedBaseVertex(ctx->CurrentServerDispatch,
+                                        (mode, count, type, indices,
+                                         primcount, basevertex));
+}
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseInstance(struct gl_context *ctx,
+                                                  const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElementsInstancedBaseInstance(ctx->CurrentServerDispatch,
+                                          (cmd->mode, cmd->count, cmd->type,
+                                           cmd->indices, cmd->primcount,
+                                           cmd->baseinstance));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseInstance(GLenum mode, GLsizei count,
+                                                GLenum type,
+                                                const GLvoid *indices,
+                                                GLsizei primcount,
+                                                GLuint baseinstance)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsInstancedBaseInstance");
+
+   if (marshal_draw_elements(ctx,
+                             DISPATCH_CMD_DrawElementsInstancedBaseInstance,
+                             mode, false, 0, 0, count, type, indices, 0,
+                             primcount, baseinstance))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsInstancedBaseInstance");
+   CALL_DrawElementsInstancedBaseInstance(ctx->CurrentServerDispatch,
+                                          (mode, count, type, indices,
+                                           primcount, baseinstance));
+}
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseVertexBaseInstance(struct gl_context *ctx,
+                                                            const struct marshal_cmd_DrawElements *cmd)
+{
+   const GLvoid *saved[VERT_ATTRIB_MAX];
+
+   bind_user_arrays(ctx, &cmd->draw, sizeof(*cmd), saved);
+   CALL_DrawElementsInstancedBaseVertexBaseInstance(ctx->CurrentServerDispatch,
+                                                    (cmd->mode, cmd->count,
+                                                     cmd->type, cmd->indices,
+                                                     cmd->primcount,
+                                                     cmd->basevertex,
+                                                     cmd->baseinstance));
+   restore_user_arrays(ctx, &cmd->draw, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseVertexBaseInstance(GLenum mode,
+                                                          GLsizei count,
+                                                          GLenum type,
+                                                          const GLvoid *indices,
+                                                          GLsizei primcount,
+                                                          GLint basevertex,
+                                                          GLuint baseinstance)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsInstancedBaseVertexBaseInstance");
+
+   if (marshal_draw_elements(ctx,
+                             DISPATCH_CMD_DrawElementsInstancedBaseVertexBaseInstance,
+                             mode, false, 0, 0, count, type, indices,
+                             basevertex, primcount, baseinstance))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsInstancedBaseVertexBaseInstance");
+   CALL_DrawElementsInstancedBaseVertexBaseInstance(ctx->CurrentServerDispatch,
+                                                    (mode, count, type,
+                                                     indices, primcount,
+                                                     basevertex,
+                                                     baseinstance));
+}
+
+
+/* Texture uploads.
+ *
+ * Without a pixel unpack buffer, glTex(Sub)Image and their compressed
+ * variants read from client memory.  Like with draws, we copy the bytes the
+ * driver is going to read into the batch or a separate allocation, so that
+ * streaming textures doesn't make the application wait for the worker.
+ */
+struct marshal_cmd_TexImage
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum target;
+   GLint level;
+   GLint internalformat;
+   GLint xoffset;
+   GLint yoffset;
+   GLint zoffset;
+   GLsizei width;
+   GLsizei height;
+   GLsizei depth;
+   GLint border;
+   GLenum format;
+   GLenum type;
+   GLsizei image_size;
+
+   /** The pointer the application passed, used if data_size is 0. */
+   const GLvoid *pixels;
+
+   /**
+    * Size of the copy of the pixels, which follows the command unless it
+    * didn't fit, in which case it's in \c heap.
+    */
+   size_t data_size;
+   void *heap;
+};
+
+/**
+ * Finds the client memory an upload reads, starting from the first pixel
+ * after the skipped ones.  Returns false if we can't tell, in which case
+ * the upload has to be done synchronously.
+ */
+static bool
+get_unpack_range(const struct gl_pixelstore_attrib *unpack, GLuint dims,
+                 bool compressed, GLsizei width, GLsizei height,
+                 GLsizei depth, GLenum format, GLenum type,
+                 GLsizei image_size, const GLvoid *pixels,
+                 const GLubyte **start, size_t *size)
+{
+   if (compressed) {
+      /* The compressed pixel storage parameters make the driver skip around
+       * in the data instead of reading image_size bytes from the start.
+       */
+      if (image_size < 0 || unpack->CompressedBlockSize)
+         return false;
+
+      /* A wrong size is an error, don't trust it to tell how much the
+       * application gave us.
+       */
+      const mesa_format tex_format = _mesa_glenum_to_compressed_format(format);
+      if (tex_format == MESA_FORMAT_NONE ||
+          _mesa_format_image_size(tex_format, width, height, depth) !=
+          (GLuint) image_size)
+         return false;
+
+      *start = pixels;
+      *size = image_size;
+      return true;
+   }
+
+   /* Skipped pixels aren't whole bytes with GL_BITMAP. */
+   if (type == GL_BITMAP || _mesa_bytes_per_pixel(format, type) <= 0)
+      return false;
+
+   const GLintptr first = _mesa_image_offset(dims, unpack, width, height,
+                                             format, type, 0, 0, 0);
+   const GLintptr end = _mesa_image_offset(dims, unpack, width, height,
+                                           format, type, depth - 1,
+                                           height - 1, width);
+   if (first < 0 || end < first)
+      return false;
+
+   *start = (const GLubyte *) pixels + first;
+   *size = end - first;
+   return true;
+}
+
+/**
+ * Allocates a texture upload command followed by a copy of the pixels it
+ * reads from client memory, if any.  Returns NULL if the upload has to be
+ * done synchronously, which includes uploads from client memory that the
+ * context would reject.
+ */
+static struct marshal_cmd_TexImage *
+allocate_tex_image(struct gl_context *ctx, uint16_t cmd_id, GLuint dims,
+                   bool compressed, bool sub_image, GLenum target,
+                   GLint level, GLsizei width, GLsizei height, GLsizei depth,
+                   GLint border, GLenum format, GLenum type,
+                   GLsizei image_size, const GLvoid *pixels)
+{
+   const struct glthread_pixel_unpack *unpack = &ctx->GLThread->unpack;
+   struct marshal_cmd_TexImage *cmd;
+   const GLubyte *data = NULL;
+   size_t data_size = 0;
+   void *heap = NULL;
+
+   /* With a pixel unpack buffer bound, pixels is an offset into it.  Proxy
+    * targets and empty images don't read anything.
+    */
+   if (!unpack->buffer && pixels && !_mesa_is_proxy_texture(target) &&
+       width > 0 && height > 0 && depth > 0) {
+      if (!_mesa_glthread_tex_image_is_legal(ctx, dims, sub_image, target,
+                                             level, width, height, depth,
+                                             border))
+         return NULL;
+
+      if (!get_unpack_range(&unpack->store, dims, compressed, width, height,
+                            depth, format, type, image_size, pixels,
+                            &data, &data_size))
+         return NULL;
+   }
+
+   if (sizeof(*cmd) + data_size <= MARSHAL_MAX_CMD_SIZE) {
+      cmd = _mesa_glthread_allocate_command(ctx, cmd_id,
+                                            sizeof(*cmd) + data_size);
+      if (data_size)
+         memcpy(cmd + 1, data, data_size);
+   } else {
+      heap = malloc(data_size);
+      if (!heap)
+         return NULL;
+
+      memcpy(heap, data, data_size);
+      cmd = _mesa_glthread_allocate_command(ctx, cmd_id, sizeof(*cmd));
+   }
+
+   cmd->pixels = pixels;
+   cmd->data_size = data_size;
+   cmd->heap = heap;
+   return cmd;
+}
+
+/**
+ * Returns the pixels to pass to the driver.  If they were copied, the copy
+ * starts at the first pixel read, so the skip parameters are cleared until
+ * end_tex_image().
+ */
+static const GLvoid *
+begin_tex_image(struct gl_context *ctx,
+                const struct marshal_cmd_TexImage *cmd,
+                struct gl_pixelstore_attrib *saved)
+{
+   if (!cmd->data_size)
+      return cmd->pixels;
+
+   saved->SkipPixels = ctx->Unpack.SkipPixels;
+   saved->SkipRows = ctx->Unpack.SkipRows;
+   saved->SkipImages = ctx->Unpack.SkipImages;
+   ctx->Unpack.SkipPixels = 0;
+   ctx->Unpack.SkipRows = 0;
+   ctx->Unpack.SkipImages = 0;
+
+   return cmd->heap ? cmd->heap : (const GLvoid *) (cmd + 1);
+}
+
+static void
+end_tex_image(struct gl_context *ctx,
+              const struct marshal_cmd_TexImage *cmd,
+              const struct gl_pixelstore_attrib *saved)
+{
+   if (!cmd->data_size)
+      return;
+
+   ctx->Unpack.SkipPixels = saved->SkipPixels;
+   ctx->Unpack.SkipRows = saved->SkipRows;
+   ctx->Unpack.SkipImages = saved->SkipImages;
+   free(cmd->heap);
+}
+
+void
+_mesa_unmarshal_TexImage1D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexImage1D(ctx->CurrentServerDispatch,
+                   (cmd->target, cmd->level, cmd->internalformat, cmd->width,
+                    cmd->border, cmd->format, cmd->type, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexImage1D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLint border, GLenum format,
+                         GLenum type, const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexImage1D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexImage1D, 1, false, false,
+                            target, level, width, 1, 1, border, format, type,
+                            0, pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->border = border;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexImage1D");
+   CALL_TexImage1D(ctx->CurrentServerDispatch,
+                   (target, level, internalformat, width, border, format, type,
+                    pixels));
+}
+
+void
+_mesa_unmarshal_TexImage2D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexImage2D(ctx->CurrentServerDispatch,
+                   (cmd->target, cmd->level, cmd->internalformat, cmd->width,
+                    cmd->height, cmd->border, cmd->format, cmd->type, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexImage2D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLsizei height, GLint border,
+                         GLenum format, GLenum type, const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexImage2D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexImage2D, 2, false, false,
+                            target, level, width, height, 1, border, format,
+                            type, 0, pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->border = border;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexImage2D");
+   CALL_TexImage2D(ctx->CurrentServerDispatch,
+                   (target, level, internalformat, width, height, border,
+                    format, type, pixels));
+}
+
+void
+_mesa_unmarshal_TexImage3D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexImage3D(ctx->CurrentServerDispatch,
+                   (cmd->target, cmd->level, cmd->internalformat, cmd->width,
+                    cmd->height, cmd->depth, cmd->border, cmd->format,
+                    cmd->type, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexImage3D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLsizei height, GLsizei depth,
+                         GLint border, GLenum format, GLenum type,
+                         const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexImage3D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexImage3D, 3, false, false,
+                            target, level, width, height, depth, border,
+                            format, type, 0, pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->depth = depth;
+      cmd->border = border;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexImage3D");
+   CALL_TexImage3D(ctx->CurrentServerDispatch,
+                   (target, level, internalformat, width, height, depth,
+                    border, format, type, pixels));
+}
+
+void
+_mesa_unmarshal_TexSubImage1D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexSubImage1D(ctx->CurrentServerDispatch,
+                      (cmd->target, cmd->level, cmd->xoffset, cmd->width,
+                       cmd->format, cmd->type, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage1D(GLenum target, GLint level, GLint xoffset,
+                            GLsizei width, GLenum format, GLenum type,
+                            const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexSubImage1D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexSubImage1D, 1, false, true,
+                            target, level, width, 1, 1, 0, format, type, 0,
+                            pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->width = width;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexSubImage1D");
+   CALL_TexSubImage1D(ctx->CurrentServerDispatch,
+                      (target, level, xoffset, width, format, type, pixels));
+}
+
+void
+_mesa_unmarshal_TexSubImage2D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexSubImage2D(ctx->CurrentServerDispatch,
+                      (cmd->target, cmd->level, cmd->xoffset, cmd->yoffset,
+                       cmd->width, cmd->height, cmd->format, cmd->type,
+                       pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage2D(GLenum target, GLint level, GLint xoffset,
+                            GLint yoffset, GLsizei width, GLsizei height,
+                            GLenum format, GLenum type, const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexSubImage2D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexSubImage2D, 2, false, true,
+                            target, level, width, height, 1, 0, format, type,
+                            0, pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->yoffset = yoffset;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexSubImage2D");
+   CALL_TexSubImage2D(ctx->CurrentServerDispatch,
+                      (target, level, xoffset, yoffset, width, height, format,
+                       type, pixels));
+}
+
+void
+_mesa_unmarshal_TexSubImage3D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_TexSubImage3D(ctx->CurrentServerDispatch,
+                      (cmd->target, cmd->level, cmd->xoffset, cmd->yoffset,
+                       cmd->zoffset, cmd->width, cmd->height, cmd->depth,
+                       cmd->format, cmd->type, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage3D(GLenum target, GLint level, GLint xoffset,
+                            GLint yoffset, GLint zoffset, GLsizei width,
+                            GLsizei height, GLsizei depth, GLenum format,
+                            GLenum type, const GLvoid *pixels)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("TexSubImage3D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_TexSubImage3D, 3, false, true,
+                            target, level, width, height, depth, 0, format,
+                            type, 0, pixels);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->yoffset = yoffset;
+      cmd->zoffset = zoffset;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->depth = depth;
+      cmd->format = format;
+      cmd->type = type;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("TexSubImage3D");
+   CALL_TexSubImage3D(ctx->CurrentServerDispatch,
+                      (target, level, xoffset, yoffset, zoffset, width, height,
+                       depth, format, type, pixels));
+}
+
+void
+_mesa_unmarshal_CompressedTexImage1D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexImage1D(ctx->CurrentServerDispatch,
+                             (cmd->target, cmd->level, cmd->internalformat,
+                              cmd->width, cmd->border, cmd->image_size,
+                              pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage1D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLint border, GLsizei imageSize,
+                                   const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexImage1D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexImage1D, 1, true,
+                            false, target, level, width, 1, 1, border,
+                            internalformat, 0, imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->border = border;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexImage1D");
+   CALL_CompressedTexImage1D(ctx->CurrentServerDispatch,
+                             (target, level, internalformat, width, border,
+                              imageSize, data));
+}
+
+void
+_mesa_unmarshal_CompressedTexImage2D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexImage2D(ctx->CurrentServerDispatch,
+                             (cmd->target, cmd->level, cmd->internalformat,
+                              cmd->width, cmd->height, cmd->border,
+                              cmd->image_size, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage2D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLsizei height, GLint border,
+                                   GLsizei imageSize, const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexImage2D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexImage2D, 2, true,
+                            false, target, level, width, height, 1, border,
+                            internalformat, 0, imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->border = border;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexImage2D");
+   CALL_CompressedTexImage2D(ctx->CurrentServerDispatch,
+                             (target, level, internalformat, width, height,
+                              border, imageSize, data));
+}
+
+void
+_mesa_unmarshal_CompressedTexImage3D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexImage3D(ctx->CurrentServerDispatch,
+                             (cmd->target, cmd->level, cmd->internalformat,
+                              cmd->width, cmd->height, cmd->depth, cmd->border,
+                              cmd->image_size, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage3D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLsizei height, GLsizei depth, GLint border,
+                                   GLsizei imageSize, const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexImage3D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexImage3D, 3, true,
+                            false, target, level, width, height, depth, border,
+                            internalformat, 0, imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->internalformat = internalformat;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->depth = depth;
+      cmd->border = border;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexImage3D");
+   CALL_CompressedTexImage3D(ctx->CurrentServerDispatch,
+                             (target, level, internalformat, width, height,
+                              depth, border, imageSize, data));
+}
+
+void
+_mesa_unmarshal_CompressedTexSubImage1D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexSubImage1D(ctx->CurrentServerDispatch,
+                                (cmd->target, cmd->level, cmd->xoffset,
+                                 cmd->width, cmd->format, cmd->image_size,
+                                 pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage1D(GLenum target, GLint level,
+                                      GLint xoffset, GLsizei width,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexSubImage1D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexSubImage1D, 1, true,
+                            true, target, level, width, 1, 1, 0, format, 0,
+                            imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->width = width;
+      cmd->format = format;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexSubImage1D");
+   CALL_CompressedTexSubImage1D(ctx->CurrentServerDispatch,
+                                (target, level, xoffset, width, format,
+                                 imageSize, data));
+}
+
+void
+_mesa_unmarshal_CompressedTexSubImage2D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexSubImage2D(ctx->CurrentServerDispatch,
+                                (cmd->target, cmd->level, cmd->xoffset,
+                                 cmd->yoffset, cmd->width, cmd->height,
+                                 cmd->format, cmd->image_size, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage2D(GLenum target, GLint level,
+                                      GLint xoffset, GLint yoffset,
+                                      GLsizei width, GLsizei height,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexSubImage2D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexSubImage2D, 2, true,
+                            true, target, level, width, height, 1, 0, format,
+                            0, imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->yoffset = yoffset;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->format = format;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexSubImage2D");
+   CALL_CompressedTexSubImage2D(ctx->CurrentServerDispatch,
+                                (target, level, xoffset, yoffset, width,
+                                 height, format, imageSize, data));
+}
+
+void
+_mesa_unmarshal_CompressedTexSubImage3D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd)
+{
+   struct gl_pixelstore_attrib saved;
+   const GLvoid *pixels = begin_tex_image(ctx, cmd, &saved);
+
+   CALL_CompressedTexSubImage3D(ctx->CurrentServerDispatch,
+                                (cmd->target, cmd->level, cmd->xoffset,
+                                 cmd->yoffset, cmd->zoffset, cmd->width,
+                                 cmd->height, cmd->depth, cmd->format,
+                                 cmd->image_size, pixels));
+   end_tex_image(ctx, cmd, &saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage3D(GLenum target, GLint level,
+                                      GLint xoffset, GLint yoffset,
+                                      GLint zoffset, GLsizei width,
+                                      GLsizei height, GLsizei depth,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_TexImage *cmd;
+   debug_print_marshal("CompressedTexSubImage3D");
+
+   cmd = allocate_tex_image(ctx, DISPATCH_CMD_CompressedTexSubImage3D, 3, true,
+                            true, target, level, width, height, depth, 0,
+                            format, 0, imageSize, data);
+   if (cmd) {
+      cmd->target = target;
+      cmd->level = level;
+      cmd->xoffset = xoffset;
+      cmd->yoffset = yoffset;
+      cmd->zoffset = zoffset;
+      cmd->width = width;
+      cmd->height = height;
+      cmd->depth = depth;
+      cmd->format = format;
+      cmd->image_size = imageSize;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("CompressedTexSubImage3D");
+   CALL_CompressedTexSubImage3D(ctx->CurrentServerDispatch,
+                                (target, level, xoffset, yoffset, zoffset,
+                                 width, height, depth, format, imageSize,
+                                 data));
+}
@@ -33,6 +33,7 @@
 #include "main/glthread.h"
 #include "main/context.h"
 #include "main/macros.h"
+#include "util/bitscan.h"
 
 struct marshal_cmd_base
 {
@@ -70,28 +71,51 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
 }
 
 /**
- * Instead of conditionally handling marshaling previously-bound user vertex
- * array data in draw calls (deprecated and removed in GL core), we just
- * disable threading at the point where the user sets a user vertex array.
+ * Returns the enabled vertex arrays which are in client memory (deprecated
+ * and removed in GL core), and which draws need to copy the data of before
+ * returning to the application.
  */
-static inline bool
-_mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
+static inline GLbitfield
+_mesa_glthread_get_user_vertex_arrays(const struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   GLbitfield enabled = arrays->enabled;
+   GLbitfield user_arrays = 0;
+
+   if (ctx->API == API_OPENGL_CORE || !arrays->user_bindings)
+      return 0;
+
+   while (enabled) {
+      const int i = u_bit_scan(&enabled);
 
-   return ctx->API != API_OPENGL_CORE && !glthread->vertex_array_is_vbo;
+      if (arrays->user_bindings & (1u << arrays->attribs[i].binding))
+         user_arrays |= VERT_BIT(i);
+   }
+
+   return user_arrays;
 }
 
 /**
- * Instead of conditionally handling marshaling immediate index data in draw
- * calls (deprecated and removed in GL core), we just disable threading.
+ * Draws which can't tell the range of vertices they read, such as
+ * glMultiDrawArrays() and glDrawTransformFeedback(), are executed
+ * synchronously when they would read client memory.
+ */
+static inline bool
+_mesa_glthread_has_non_vbo_vertex_arrays(const struct gl_context *ctx)
+{
+   return _mesa_glthread_get_user_vertex_arrays(ctx) != 0;
+}
+
+/**
+ * Whether a glDraw*Elements() call reads its indices from client memory
+ * (deprecated and removed in GL core).
  */
 static inline bool
 _mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
 {
    struct glthread_state *glthread = ctx->GLThread;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->element_array_is_vbo;
+   return ctx->API != API_OPENGL_CORE && !glthread->arrays.element_array_buffer;
 }
 
 #define DEBUG_MARSHAL_PRINT_CALLS 0
@@ -187,6 +211,39 @@ struct marshal_cmd_ClearBuffer;
 #define marshal_cmd_ClearBufferiv   marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferuiv  marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferfi   marshal_cmd_ClearBuffer
+struct marshal_cmd_DrawArrays;
+#define marshal_cmd_DrawArraysInstancedARB \
+   marshal_cmd_DrawArrays
+#define marshal_cmd_DrawArraysInstancedBaseInstance \
+   marshal_cmd_DrawArrays
+struct marshal_cmd_DrawElements;
+#define marshal_cmd_DrawRangeElements \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawElementsBaseVertex \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawRangeElementsBaseVertex \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawElementsInstancedARB \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawElementsInstancedBaseVertex \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawElementsInstancedBaseInstance \
+   marshal_cmd_DrawElements
+#define marshal_cmd_DrawElementsInstancedBaseVertexBaseInstance \
+   marshal_cmd_DrawElements
+struct marshal_cmd_TexImage;
+#define marshal_cmd_TexImage1D marshal_cmd_TexImage
+#define marshal_cmd_TexImage2D marshal_cmd_TexImage
+#define marshal_cmd_TexImage3D marshal_cmd_TexImage
+#define marshal_cmd_TexSubImage1D marshal_cmd_TexImage
+#define marshal_cmd_TexSubImage2D marshal_cmd_TexImage
+#define marshal_cmd_TexSubImage3D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexImage1D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexImage2D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexImage3D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexSubImage1D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexSubImage2D marshal_cmd_TexImage
+#define marshal_cmd_CompressedTexSubImage3D marshal_cmd_TexImage
 
 void
 _mesa_unmarshal_Enable(struct gl_context *ctx,
@@ -281,4 +338,227 @@ void GLAPIENTRY
 _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                             const GLfloat depth, const GLint stencil);
 
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+void
+_mesa_unmarshal_DrawArraysInstancedARB(struct gl_context *ctx,
+                                       const struct marshal_cmd_DrawArrays *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArraysInstancedARB(GLenum mode, GLint first, GLsizei count,
+                                     GLsizei primcount);
+
+void
+_mesa_unmarshal_DrawArraysInstancedBaseInstance(struct gl_context *ctx,
+                                                const struct marshal_cmd_DrawArrays *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArraysInstancedBaseInstance(GLenum mode, GLint first,
+                                              GLsizei count,
+                                              GLsizei primcount,
+                                              GLuint baseinstance);
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawElementsBaseVertex(struct gl_context *ctx,
+                                       const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                                     const GLvoid *indices, GLint basevertex);
+
+void
+_mesa_unmarshal_DrawRangeElementsBaseVertex(struct gl_context *ctx,
+                                            const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElementsBaseVertex(GLenum mode, GLuint start,
+                                          GLuint end, GLsizei count,
+                                          GLenum type, const GLvoid *indices,
+                                          GLint basevertex);
+
+void
+_mesa_unmarshal_DrawElementsInstancedARB(struct gl_context *ctx,
+                                         const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedARB(GLenum mode, GLsizei count,
+                                       GLenum type, const GLvoid *indices,
+                                       GLsizei primcount);
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseVertex(struct gl_context *ctx,
+                                                const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count,
+                                              GLenum type,
+                                              const GLvoid *indices,
+                                              GLsizei primcount,
+                                              GLint basevertex);
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseInstance(struct gl_context *ctx,
+                                                  const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseInstance(GLenum mode, GLsizei count,
+                                                GLenum type,
+                                                const GLvoid *indices,
+                                                GLsizei primcount,
+                                                GLuint baseinstance);
+
+void
+_mesa_unmarshal_DrawElementsInstancedBaseVertexBaseInstance(struct gl_context *ctx,
+                                                            const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsInstancedBaseVertexBaseInstance(GLenum mode,
+                                                          GLsizei count,
+                                                          GLenum type,
+                                                          const GLvoid *indices,
+                                                          GLsizei primcount,
+                                                          GLint basevertex,
+                                                          GLuint baseinstance);
+
+void
+_mesa_unmarshal_TexImage1D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexImage1D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLint border, GLenum format,
+                         GLenum type, const GLvoid *pixels);
+
+void
+_mesa_unmarshal_TexImage2D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexImage2D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLsizei height, GLint border,
+                         GLenum format, GLenum type, const GLvoid *pixels);
+
+void
+_mesa_unmarshal_TexImage3D(struct gl_context *ctx,
+                           const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexImage3D(GLenum target, GLint level, GLint internalformat,
+                         GLsizei width, GLsizei height, GLsizei depth,
+                         GLint border, GLenum format, GLenum type,
+                         const GLvoid *pixels);
+
+void
+_mesa_unmarshal_TexSubImage1D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage1D(GLenum target, GLint level, GLint xoffset,
+                            GLsizei width, GLenum format, GLenum type,
+                            const GLvoid *pixels);
+
+void
+_mesa_unmarshal_TexSubImage2D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage2D(GLenum target, GLint level, GLint xoffset,
+                            GLint yoffset, GLsizei width, GLsizei height,
+                            GLenum format, GLenum type, const GLvoid *pixels);
+
+void
+_mesa_unmarshal_TexSubImage3D(struct gl_context *ctx,
+                              const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_TexSubImage3D(GLenum target, GLint level, GLint xoffset,
+                            GLint yoffset, GLint zoffset, GLsizei width,
+                            GLsizei height, GLsizei depth, GLenum format,
+                            GLenum type, const GLvoid *pixels);
+
+void
+_mesa_unmarshal_CompressedTexImage1D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage1D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLint border, GLsizei imageSize,
+                                   const GLvoid *data);
+
+void
+_mesa_unmarshal_CompressedTexImage2D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage2D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLsizei height, GLint border,
+                                   GLsizei imageSize, const GLvoid *data);
+
+void
+_mesa_unmarshal_CompressedTexImage3D(struct gl_context *ctx,
+                                     const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexImage3D(GLenum target, GLint level,
+                                   GLenum internalformat, GLsizei width,
+                                   GLsizei height, GLsizei depth, GLint border,
+                                   GLsizei imageSize, const GLvoid *data);
+
+void
+_mesa_unmarshal_CompressedTexSubImage1D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage1D(GLenum target, GLint level,
+                                      GLint xoffset, GLsizei width,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data);
+
+void
+_mesa_unmarshal_CompressedTexSubImage2D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage2D(GLenum target, GLint level,
+                                      GLint xoffset, GLint yoffset,
+                                      GLsizei width, GLsizei height,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data);
+
+void
+_mesa_unmarshal_CompressedTexSubImage3D(struct gl_context *ctx,
+                                        const struct marshal_cmd_TexImage *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_CompressedTexSubImage3D(GLenum target, GLint level,
+                                      GLint xoffset, GLint yoffset,
+                                      GLint zoffset, GLsizei width,
+                                      GLsizei height, GLsizei depth,
+                                      GLenum format, GLsizei imageSize,
+                                      const GLvoid *data);
+
 #endif /* MARSHAL_H */
@@ -48,6 +48,7 @@
 #include "compiler/glsl/list.h"
 #include "util/simple_mtx.h"
 #include "util/u_dynarray.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -676,6 +677,7 @@ struct gl_hint_attrib
    GLenum16 TextureCompression;   /**< GL_ARB_texture_compression */
    GLenum16 GenerateMipmap;       /**< GL_SGIS_generate_mipmap */
    GLenum16 FragmentShaderDerivative; /**< GL_ARB_fragment_shader */
+   GLuint MaxShaderCompilerThreads; /**< GL_ARB_parallel_shader_compile */
 };
 
 
@@ -2687,6 +2689,14 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /**
+    * Signalled once a compile queued by glCompileShader has finished.
+    * Everything filled in by the compiler (CompileStatus, InfoLog, ir, ...)
+    * must only be looked at after waiting on it, see
+    * _mesa_wait_shader_compile().
+    */
+   struct util_queue_fence CompileFence;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -4961,6 +4971,13 @@ struct gl_context
    struct gl_pipeline_shader_state Pipeline; /**< GLSL pipeline shader object state */
    struct gl_pipeline_object Shader; /**< GLSL shader object state */
 
+   /**
+    * Worker threads for glCompileShader, created on first use.
+    * \sa GL_ARB_parallel_shader_compile
+    */
+   struct util_queue ShaderCompileQueue;
+   bool ShaderCompileQueueEnabled; /**< MESA_PARALLEL_COMPILE */
+
    /**
     * Current active shader pipeline state
     *
@@ -41,6 +41,7 @@
 #include <c99_alloca.h>
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/debug_output.h"
 #include "main/dispatch.h"
 #include "main/enums.h"
 #include "main/glspirv.h"
@@ -64,6 +65,11 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/debug.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -139,6 +145,10 @@ _mesa_init_shader_state(struct gl_context *ctx)
 
    ctx->Shader.Flags = _mesa_get_shader_flags();
 
+   memset(&ctx->ShaderCompileQueue, 0, sizeof(ctx->ShaderCompileQueue));
+   ctx->ShaderCompileQueueEnabled =
+      env_var_as_boolean("MESA_PARALLEL_COMPILE", true);
+
    if (ctx->Shader.Flags != 0)
       ctx->Const.GenerateTemporaryNames = true;
 
@@ -158,6 +168,11 @@ _mesa_init_shader_state(struct gl_context *ctx)
 void
 _mesa_free_shader_state(struct gl_context *ctx)
 {
+   if (util_queue_is_initialized(&ctx->ShaderCompileQueue)) {
+      util_queue_finish(&ctx->ShaderCompileQueue);
+      util_queue_destroy(&ctx->ShaderCompileQueue);
+   }
+
    for (int i = 0; i < MESA_SHADER_STAGES; i++) {
       _mesa_reference_program(ctx, &ctx->Shader.CurrentProgram[i], NULL);
    }
@@ -690,6 +705,13 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
    case GL_LINK_STATUS:
       *params = shProg->data->LinkStatus ? GL_TRUE : GL_FALSE;
       return;
+   case GL_COMPLETION_STATUS_ARB:
+      if (!_mesa_is_desktop_gl(ctx))
+         break;
+
+      /* Linking is always done by the time glLinkProgram returns. */
+      *params = GL_TRUE;
+      return;
    case GL_VALIDATE_STATUS:
       *params = shProg->data->Validated;
       return;
@@ -959,9 +981,16 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = shader->DeletePending;
       break;
    case GL_COMPILE_STATUS:
+      _mesa_wait_shader_compile(shader);
       *params = shader->CompileStatus ? GL_TRUE : GL_FALSE;
       break;
+   case GL_COMPLETION_STATUS_ARB:
+      if (!_mesa_is_desktop_gl(ctx))
+         goto invalid_pname;
+      *params = util_queue_fence_is_signalled(&shader->CompileFence);
+      break;
    case GL_INFO_LOG_LENGTH:
+      _mesa_wait_shader_compile(shader);
       *params = (shader->InfoLog && shader->InfoLog[0] != '\0') ?
          strlen(shader->InfoLog) + 1 : 0;
       break;
@@ -972,9 +1001,12 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = (shader->spirv_data != NULL);
       break;
    default:
-      _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
-      return;
+      goto invalid_pname;
    }
+   return;
+
+invalid_pname:
+   _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
 }
 
 
@@ -1027,6 +1059,7 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   _mesa_wait_shader_compile(sh);
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -1062,6 +1095,9 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 {
    assert(sh);
 
+   /* A compile still running on the queue reads the old source. */
+   _mesa_wait_shader_compile(sh);
+
    /* The GL_ARB_gl_spirv spec adds the following to the end of the description
     * of ShaderSource:
     *
@@ -1099,6 +1135,8 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    if (!sh)
       return;
 
+   _mesa_wait_shader_compile(sh);
+
    /* The GL_ARB_gl_spirv spec says:
     *
     *    "Add a new error for the CompileShader command:
@@ -1126,7 +1164,8 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
       /* this call will set the shader->CompileStatus field to indicate if
        * compilation was successful.
        */
-      _mesa_glsl_compile_shader(ctx, sh, false, false, false);
+      _mesa_glsl_compile_shader(ctx, sh, false, false, false,
+                                ctx->_Shader->Flags);
 
       if (ctx->_Shader->Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
@@ -1168,6 +1207,117 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+struct compile_shader_job {
+   struct gl_context *ctx;
+   struct gl_shader *sh;
+
+   /* The application may rebind or delete the current pipeline while the
+    * job runs, so its flags are sampled when the job is queued.
+    */
+   GLbitfield flags;
+};
+
+static void
+compile_shader_job_execute(void *data, int thread_index)
+{
+   struct compile_shader_job *job = data;
+
+   _mesa_glsl_compile_shader(job->ctx, job->sh, false, false, false,
+                             job->flags);
+}
+
+static void
+compile_shader_job_cleanup(void *data, int thread_index)
+{
+   free(data);
+}
+
+static unsigned
+get_num_cpus(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+   long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   if (num_cpus > 0)
+      return num_cpus;
+#endif
+   return 1;
+}
+
+/**
+ * Make sure the compile queue has as many threads as the
+ * GL_ARB_parallel_shader_compile hint asks for, capped to the number of
+ * CPUs.  Returns false if compiles should happen on the calling thread.
+ */
+static bool
+init_shader_compile_queue(struct gl_context *ctx)
+{
+   struct util_queue *queue = &ctx->ShaderCompileQueue;
+
+   if (!ctx->ShaderCompileQueueEnabled)
+      return false;
+
+   const unsigned num_threads = MIN2(ctx->Hint.MaxShaderCompilerThreads,
+                                     get_num_cpus());
+
+   /* util_queue can't be resized, start over with a new one when the hint
+    * changes.  Pending compiles have to finish first, their fences would
+    * never be signalled otherwise.
+    */
+   if (util_queue_is_initialized(queue) && queue->num_threads != num_threads) {
+      util_queue_finish(queue);
+      util_queue_destroy(queue);
+      memset(queue, 0, sizeof(*queue));
+   }
+
+   if (num_threads == 0)
+      return false;
+
+   return util_queue_is_initialized(queue) ||
+          util_queue_init(queue, "glsl", 32, num_threads,
+                          UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+}
+
+/**
+ * Queue the compile of \p sh on one of the compiler threads and return
+ * without waiting for it.  Anything that looks at the results waits for it
+ * with _mesa_wait_shader_compile().
+ *
+ * Returns false if the shader has to be compiled synchronously instead,
+ * which is the case when compiler output has to show up in order with the
+ * GL calls: MESA_GLSL dumps and logs and synchronous debug output.
+ */
+static bool
+compile_shader_async(struct gl_context *ctx, struct gl_shader *sh)
+{
+   const GLbitfield sync_flags = GLSL_DUMP | GLSL_LOG | GLSL_DUMP_ON_ERROR |
+                                 GLSL_REPORT_ERRORS | GLSL_CACHE_INFO;
+
+   if (!sh->Source || sh->spirv_data || (ctx->_Shader->Flags & sync_flags))
+      return false;
+
+   if (ctx->Debug &&
+       _mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB))
+      return false;
+
+   if (!init_shader_compile_queue(ctx))
+      return false;
+
+   struct compile_shader_job *job = malloc(sizeof(*job));
+   if (!job)
+      return false;
+
+   job->ctx = ctx;
+   job->sh = sh;
+   job->flags = ctx->_Shader->Flags;
+
+   /* The fence may only be reset once the previous compile is done. */
+   _mesa_wait_shader_compile(sh);
+   util_queue_add_job(&ctx->ShaderCompileQueue, job, &sh->CompileFence,
+                      compile_shader_job_execute, compile_shader_job_cleanup);
+   return true;
+}
+
+
 /**
  * Link a program's shaders.
  */
@@ -1200,6 +1350,9 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
          }
    }
 
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      _mesa_wait_shader_compile(shProg->Shaders[i]);
+
    FLUSH_VERTICES(ctx, 0);
    _mesa_glsl_link_shader(ctx, shProg);
 
@@ -1476,8 +1629,12 @@ _mesa_CompileShader(GLuint shaderObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glCompileShader %u\n", shaderObj);
-   _mesa_compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
-                                                     "glCompileShader"));
+   struct gl_shader *sh = _mesa_lookup_shader_err(ctx, shaderObj,
+                                                  "glCompileShader");
+   if (sh && compile_shader_async(ctx, sh))
+      return;
+
+   _mesa_compile_shader(ctx, sh);
 }
 
 
@@ -85,6 +85,15 @@ _mesa_new_shader(GLuint name, gl_shader_stage type);
 extern void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh);
 
+/**
+ * Wait for a compile of \p sh queued by glCompileShader to finish.
+ */
+static inline void
+_mesa_wait_shader_compile(struct gl_shader *sh)
+{
+   util_queue_fence_wait(&sh->CompileFence);
+}
+
 extern void
 _mesa_delete_linked_shader(struct gl_context *ctx,
                            struct gl_linked_shader *sh);
@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name glthread_tex_image.cpp
+ *
+ * Check which texture uploads glthread considers legal enough to copy the
+ * pixels of from client memory.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/context.h"
+#include "main/extensions.h"
+#include "main/glthread.h"
+#include "main/mtypes.h"
+
+class GLThreadTexImage_test : public ::testing::Test {
+public:
+   void SetUpCtx(gl_api api, unsigned int version);
+
+   bool tex_image(GLuint dims, GLenum target, GLint level, GLsizei width,
+                  GLsizei height, GLsizei depth, GLint border);
+   bool tex_sub_image(GLuint dims, GLenum target, GLint level, GLsizei width,
+                      GLsizei height, GLsizei depth);
+
+   struct gl_context ctx;
+   GLsizei max_size;
+};
+
+void
+GLThreadTexImage_test::SetUpCtx(gl_api api, unsigned int version)
+{
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.API = api;
+   ctx.Version = version;
+   _mesa_init_constants(&ctx.Const, api);
+   _mesa_init_extensions(&ctx.Extensions);
+   ctx.Extensions.ARB_texture_cube_map = GL_TRUE;
+   ctx.Extensions.ARB_texture_non_power_of_two = GL_TRUE;
+   ctx.Extensions.EXT_texture_array = GL_TRUE;
+   ctx.Extensions.NV_texture_rectangle = GL_TRUE;
+
+   max_size = 1 << (ctx.Const.MaxTextureLevels - 1);
+}
+
+bool
+GLThreadTexImage_test::tex_image(GLuint dims, GLenum target, GLint level,
+                                 GLsizei width, GLsizei height, GLsizei depth,
+                                 GLint border)
+{
+   return _mesa_glthread_tex_image_is_legal(&ctx, dims, false, target, level,
+                                            width, height, depth, border);
+}
+
+bool
+GLThreadTexImage_test::tex_sub_image(GLuint dims, GLenum target, GLint level,
+                                     GLsizei width, GLsizei height,
+                                     GLsizei depth)
+{
+   return _mesa_glthread_tex_image_is_legal(&ctx, dims, true, target, level,
+                                            width, height, depth, 0);
+}
+
+TEST_F(GLThreadTexImage_test, TexImageSize)
+{
+   SetUpCtx(API_OPENGL_COMPAT, 30);
+
+   EXPECT_TRUE(tex_image(2, GL_TEXTURE_2D, 0, 64, 32, 1, 0));
+   EXPECT_TRUE(tex_image(2, GL_TEXTURE_2D, 0, max_size, max_size, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, max_size + 1, 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, 1, max_size + 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 1, max_size, 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, -1, 1, 1, 0));
+   EXPECT_FALSE(tex_image(1, GL_TEXTURE_1D, 0, 1 << 30, 1, 1, 0));
+   EXPECT_FALSE(tex_image(3, GL_TEXTURE_3D, 0, 1 << 16, 1 << 16, 1 << 16,
+                          0));
+}
+
+TEST_F(GLThreadTexImage_test, TexImageLevel)
+{
+   SetUpCtx(API_OPENGL_COMPAT, 30);
+
+   EXPECT_TRUE(tex_image(2, GL_TEXTURE_2D, ctx.Const.MaxTextureLevels - 1,
+                         1, 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, ctx.Const.MaxTextureLevels,
+                          1, 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, -1, 1, 1, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_RECTANGLE, 1, 1, 1, 1, 0));
+}
+
+TEST_F(GLThreadTexImage_test, TexImageBorder)
+{
+   SetUpCtx(API_OPENGL_COMPAT, 30);
+
+   EXPECT_TRUE(tex_image(2, GL_TEXTURE_2D, 0, 66, 66, 1, 1));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, 68, 68, 1, 2));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, 64, 64, 1, -1));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_RECTANGLE, 0, 66, 66, 1, 1));
+
+   SetUpCtx(API_OPENGL_CORE, 31);
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_2D, 0, 66, 66, 1, 1));
+}
+
+TEST_F(GLThreadTexImage_test, TexImageTarget)
+{
+   SetUpCtx(API_OPENGL_COMPAT, 30);
+
+   EXPECT_TRUE(tex_image(2, GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 16, 16, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 16, 8, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_CUBE_MAP, 0, 16, 16, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_3D, 0, 16, 16, 1, 0));
+   EXPECT_FALSE(tex_image(3, GL_TEXTURE_2D, 0, 16, 16, 1, 0));
+   EXPECT_FALSE(tex_image(2, GL_TEXTURE_BUFFER, 0, 16, 16, 1, 0));
+
+   EXPECT_TRUE(tex_image(3, GL_TEXTURE_2D_ARRAY, 0, 16, 16,
+                         ctx.Const.MaxArrayTextureLayers, 0));
+   EXPECT_FALSE(tex_image(3, GL_TEXTURE_2D_ARRAY, 0, 16, 16,
+                          ctx.Const.MaxArrayTextureLayers + 1, 0));
+}
+
+TEST_F(GLThreadTexImage_test, TexSubImage)
+{
+   SetUpCtx(API_OPENGL_COMPAT, 30);
+
+   /* A compatibility texture may have a border. */
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_2D, 0, max_size + 2, 1, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_2D, 0, max_size + 3, 1, 1));
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_2D, 2, max_size / 4, 1, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_2D, 2, max_size, 1, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_2D, 0, 1, -1, 1));
+
+   /* Sub-images don't have to be square or a power of two. */
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, 3, 5, 1));
+
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_RECTANGLE, 0,
+                             ctx.Const.MaxTextureRectSize, 1, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_RECTANGLE, 0,
+                              ctx.Const.MaxTextureRectSize + 1, 1, 1));
+
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_1D_ARRAY, 0, 1,
+                             ctx.Const.MaxArrayTextureLayers, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_1D_ARRAY, 0, 1,
+                              ctx.Const.MaxArrayTextureLayers + 1, 1));
+
+   /* Proxy targets can't be updated. */
+   EXPECT_FALSE(tex_sub_image(2, GL_PROXY_TEXTURE_2D, 0, 1, 1, 1));
+
+   SetUpCtx(API_OPENGL_CORE, 31);
+   EXPECT_TRUE(tex_sub_image(2, GL_TEXTURE_2D, 0, max_size, 1, 1));
+   EXPECT_FALSE(tex_sub_image(2, GL_TEXTURE_2D, 0, max_size + 1, 1, 1));
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name parallel_shader_compile.cpp
+ *
+ * Compile shaders on the compiler queue and check that the completion
+ * status and the compile and link results come out right.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/context.h"
+#include "main/hint.h"
+#include "main/mtypes.h"
+#include "main/shaderapi.h"
+#include "drivers/common/driverfuncs.h"
+#include "program/ir_to_mesa.h"
+
+#define NUM_SHADERS 8
+
+static const GLchar *vs_source =
+   "#version 110\n"
+   "uniform mat4 mvp;\n"
+   "varying vec4 color;\n"
+   "void main() {\n"
+   "   gl_Position = mvp * gl_Vertex;\n"
+   "   color = gl_Color;\n"
+   "}\n";
+
+static const GLchar *fs_source =
+   "#version 110\n"
+   "varying vec4 color;\n"
+   "void main() {\n"
+   "   gl_FragColor = color * 0.5;\n"
+   "}\n";
+
+static const GLchar *bad_fs_source =
+   "#version 110\n"
+   "void main() {\n"
+   "   gl_FragColor = undeclared;\n"
+   "}\n";
+
+class ParallelShaderCompile_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   GLuint compile(GLenum type, const GLchar *source);
+   GLint shader_param(GLuint shader, GLenum pname);
+   GLint program_param(GLuint program, GLenum pname);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+};
+
+void
+ParallelShaderCompile_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.LinkShader = _mesa_ir_link_shader;
+
+   _mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual, NULL,
+                            &driver_functions);
+   ctx.Version = 20;
+   _mesa_make_current(&ctx, NULL, NULL);
+
+   /* Always use a worker thread, even with a single CPU. */
+   ctx.ShaderCompileQueueEnabled = true;
+   _mesa_MaxShaderCompilerThreadsARB(1);
+}
+
+void
+ParallelShaderCompile_test::TearDown()
+{
+   _mesa_make_current(NULL, NULL, NULL);
+   _mesa_free_context_data(&ctx);
+}
+
+GLuint
+ParallelShaderCompile_test::compile(GLenum type, const GLchar *source)
+{
+   GLuint shader = _mesa_CreateShader(type);
+
+   _mesa_ShaderSource(shader, 1, &source, NULL);
+   _mesa_CompileShader(shader);
+   return shader;
+}
+
+GLint
+ParallelShaderCompile_test::shader_param(GLuint shader, GLenum pname)
+{
+   GLint value = -1;
+
+   _mesa_GetShaderiv(shader, pname, &value);
+   return value;
+}
+
+GLint
+ParallelShaderCompile_test::program_param(GLuint program, GLenum pname)
+{
+   GLint value = -1;
+
+   _mesa_GetProgramiv(program, pname, &value);
+   return value;
+}
+
+TEST_F(ParallelShaderCompile_test, CompileStatus)
+{
+   GLuint shaders[NUM_SHADERS];
+
+   for (unsigned i = 0; i < NUM_SHADERS; i++) {
+      shaders[i] = compile(GL_FRAGMENT_SHADER,
+                           i % 3 == 2 ? bad_fs_source : fs_source);
+   }
+
+   EXPECT_TRUE(util_queue_is_initialized(&ctx.ShaderCompileQueue));
+
+   /* Completion may or may not be reached yet, but asking for the compile
+    * status waits for it.
+    */
+   for (unsigned i = 0; i < NUM_SHADERS; i++) {
+      GLint done = shader_param(shaders[i], GL_COMPLETION_STATUS_ARB);
+      EXPECT_TRUE(done == GL_TRUE || done == GL_FALSE);
+   }
+
+   for (unsigned i = 0; i < NUM_SHADERS; i++) {
+      if (i % 3 == 2) {
+         EXPECT_EQ(GL_FALSE, shader_param(shaders[i], GL_COMPILE_STATUS));
+         EXPECT_LT(0, shader_param(shaders[i], GL_INFO_LOG_LENGTH));
+      } else {
+         EXPECT_EQ(GL_TRUE, shader_param(shaders[i], GL_COMPILE_STATUS));
+      }
+      EXPECT_EQ(GL_TRUE, shader_param(shaders[i], GL_COMPLETION_STATUS_ARB));
+   }
+
+   for (unsigned i = 0; i < NUM_SHADERS; i++)
+      _mesa_DeleteShader(shaders[i]);
+}
+
+TEST_F(ParallelShaderCompile_test, LinkWaitsForCompiles)
+{
+   GLuint programs[NUM_SHADERS / 2];
+
+   /* Link right after queueing the compiles, without looking at them. */
+   for (unsigned i = 0; i < NUM_SHADERS / 2; i++) {
+      GLuint vs = compile(GL_VERTEX_SHADER, vs_source);
+      GLuint fs = compile(GL_FRAGMENT_SHADER,
+                          i == 1 ? bad_fs_source : fs_source);
+
+      programs[i] = _mesa_CreateProgram();
+      _mesa_AttachShader(programs[i], vs);
+      _mesa_AttachShader(programs[i], fs);
+      _mesa_LinkProgram(programs[i]);
+      _mesa_DeleteShader(vs);
+      _mesa_DeleteShader(fs);
+   }
+
+   for (unsigned i = 0; i < NUM_SHADERS / 2; i++) {
+      EXPECT_EQ(GL_TRUE, program_param(programs[i], GL_COMPLETION_STATUS_ARB));
+      EXPECT_EQ(i == 1 ? GL_FALSE : GL_TRUE,
+                program_param(programs[i], GL_LINK_STATUS));
+      _mesa_DeleteProgram(programs[i]);
+   }
+}
+
+TEST_F(ParallelShaderCompile_test, NoThreads)
+{
+   _mesa_MaxShaderCompilerThreadsARB(0);
+
+   GLuint shader = compile(GL_VERTEX_SHADER, vs_source);
+
+   /* Without compiler threads the compile is done when it returns. */
+   EXPECT_FALSE(util_queue_is_initialized(&ctx.ShaderCompileQueue));
+   EXPECT_EQ(GL_TRUE, shader_param(shader, GL_COMPLETION_STATUS_ARB));
+   EXPECT_EQ(GL_TRUE, shader_param(shader, GL_COMPILE_STATUS));
+
+   _mesa_DeleteShader(shader);
+}
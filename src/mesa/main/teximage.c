@@ -1522,8 +1522,8 @@ _mesa_target_can_be_compressed(const struct gl_context *ctx, GLenum target,
  * Check if the given texture target value is legal for a
  * glTexImage1/2/3D call.
  */
-static GLboolean
-legal_teximage_target(struct gl_context *ctx, GLuint dims, GLenum target)
+GLboolean
+_mesa_legal_teximage_target(struct gl_context *ctx, GLuint dims, GLenum target)
 {
    switch (dims) {
    case 1:
@@ -1578,7 +1578,8 @@ legal_teximage_target(struct gl_context *ctx, GLuint dims, GLenum target)
          return GL_FALSE;
       }
    default:
-      _mesa_problem(ctx, "invalid dims=%u in legal_teximage_target()", dims);
+      _mesa_problem(ctx, "invalid dims=%u in _mesa_legal_teximage_target()",
+                    dims);
       return GL_FALSE;
    }
 }
@@ -1587,12 +1588,12 @@ legal_teximage_target(struct gl_context *ctx, GLuint dims, GLenum target)
 /**
  * Check if the given texture target value is legal for a
  * glTexSubImage, glCopyTexSubImage or glCopyTexImage call.
- * The difference compared to legal_teximage_target() above is that
+ * The difference compared to _mesa_legal_teximage_target() above is that
  * proxy targets are not supported.
  */
-static GLboolean
-legal_texsubimage_target(struct gl_context *ctx, GLuint dims, GLenum target,
-                         bool dsa)
+GLboolean
+_mesa_legal_texsubimage_target(struct gl_context *ctx, GLuint dims,
+                               GLenum target, bool dsa)
 {
    switch (dims) {
    case 1:
@@ -1637,7 +1638,7 @@ legal_texsubimage_target(struct gl_context *ctx, GLuint dims, GLenum target,
          return GL_FALSE;
       }
    default:
-      _mesa_problem(ctx, "invalid dims=%u in legal_texsubimage_target()",
+      _mesa_problem(ctx, "invalid dims=%u in _mesa_legal_texsubimage_target()",
                     dims);
       return GL_FALSE;
    }
@@ -2302,7 +2303,7 @@ copytexture_error_check( struct gl_context *ctx, GLuint dimensions,
    GLenum rb_internal_format;
 
    /* check target */
-   if (!legal_texsubimage_target(ctx, dimensions, target, false)) {
+   if (!_mesa_legal_texsubimage_target(ctx, dimensions, target, false)) {
       _mesa_error(ctx, GL_INVALID_ENUM, "glCopyTexImage%uD(target=%s)",
                   dimensions, _mesa_enum_to_string(target));
       return GL_TRUE;
@@ -2941,7 +2942,7 @@ teximage(struct gl_context *ctx, GLboolean compressed, GLuint dims,
 
    if (!no_error) {
       /* target error checking */
-      if (!legal_teximage_target(ctx, dims, target)) {
+      if (!_mesa_legal_teximage_target(ctx, dims, target)) {
          _mesa_error(ctx, GL_INVALID_ENUM, "%s%uD(target=%s)",
                      func, dims, _mesa_enum_to_string(target));
          return;
@@ -3358,7 +3359,7 @@ texsubimage_err(struct gl_context *ctx, GLuint dims, GLenum target, GLint level,
    struct gl_texture_image *texImage;
 
    /* check target (proxies not allowed) */
-   if (!legal_texsubimage_target(ctx, dims, target, false)) {
+   if (!_mesa_legal_texsubimage_target(ctx, dims, target, false)) {
       _mesa_error(ctx, GL_INVALID_ENUM, "glTexSubImage%uD(target=%s)",
                   dims, _mesa_enum_to_string(target));
       return;
@@ -3445,7 +3446,7 @@ texturesubimage(struct gl_context *ctx, GLuint dims,
 
    if (!no_error) {
       /* check target (proxies not allowed) */
-      if (!legal_texsubimage_target(ctx, dims, texObj->Target, true)) {
+      if (!_mesa_legal_texsubimage_target(ctx, dims, texObj->Target, true)) {
          _mesa_error(ctx, GL_INVALID_ENUM, "%s(target=%s)",
                      callerName, _mesa_enum_to_string(texObj->Target));
          return;
@@ -4151,7 +4152,7 @@ _mesa_CopyTexSubImage1D(GLenum target, GLint level,
    /* Check target (proxies not allowed). Target must be checked prior to
     * calling _mesa_get_current_tex_object.
     */
-   if (!legal_texsubimage_target(ctx, 1, target, false)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 1, target, false)) {
       _mesa_error(ctx, GL_INVALID_ENUM, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(target));
       return;
@@ -4178,7 +4179,7 @@ _mesa_CopyTexSubImage2D(GLenum target, GLint level,
    /* Check target (proxies not allowed). Target must be checked prior to
     * calling _mesa_get_current_tex_object.
     */
-   if (!legal_texsubimage_target(ctx, 2, target, false)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 2, target, false)) {
       _mesa_error(ctx, GL_INVALID_ENUM, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(target));
       return;
@@ -4205,7 +4206,7 @@ _mesa_CopyTexSubImage3D(GLenum target, GLint level,
    /* Check target (proxies not allowed). Target must be checked prior to
     * calling _mesa_get_current_tex_object.
     */
-   if (!legal_texsubimage_target(ctx, 3, target, false)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 3, target, false)) {
       _mesa_error(ctx, GL_INVALID_ENUM, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(target));
       return;
@@ -4233,7 +4234,7 @@ _mesa_CopyTextureSubImage1D(GLuint texture, GLint level,
       return;
 
    /* Check target (proxies not allowed). */
-   if (!legal_texsubimage_target(ctx, 1, texObj->Target, true)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 1, texObj->Target, true)) {
       _mesa_error(ctx, GL_INVALID_OPERATION, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(texObj->Target));
       return;
@@ -4258,7 +4259,7 @@ _mesa_CopyTextureSubImage2D(GLuint texture, GLint level,
       return;
 
    /* Check target (proxies not allowed). */
-   if (!legal_texsubimage_target(ctx, 2, texObj->Target, true)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 2, texObj->Target, true)) {
       _mesa_error(ctx, GL_INVALID_OPERATION, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(texObj->Target));
       return;
@@ -4283,7 +4284,7 @@ _mesa_CopyTextureSubImage3D(GLuint texture, GLint level,
       return;
 
    /* Check target (proxies not allowed). */
-   if (!legal_texsubimage_target(ctx, 3, texObj->Target, true)) {
+   if (!_mesa_legal_texsubimage_target(ctx, 3, texObj->Target, true)) {
       _mesa_error(ctx, GL_INVALID_OPERATION, "%s(invalid target %s)", self,
                   _mesa_enum_to_string(texObj->Target));
       return;
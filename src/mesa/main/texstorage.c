@@ -45,7 +45,7 @@
 /**
  * Check if the given texture target is a legal texture object target
  * for a glTexStorage() command.
- * This is a bit different than legal_teximage_target() when it comes
+ * This is a bit different than _mesa_legal_teximage_target() when it comes
  * to cube maps.
  */
 static bool
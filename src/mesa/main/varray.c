@@ -221,6 +221,31 @@ _mesa_bind_vertex_buffer(struct gl_context *ctx,
 }
 
 
+/**
+ * Points a client array of the current VAO at different memory without
+ * touching its format or binding, and returns the old pointer.
+ *
+ * glthread uses this to draw from its own copies of the application's
+ * arrays, and to put the application's pointers back afterwards.
+ */
+const GLvoid *
+_mesa_set_client_array_pointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                               const GLvoid *ptr)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   struct gl_array_attributes *array = &vao->VertexAttrib[attrib];
+   const GLvoid *old_ptr = array->Ptr;
+
+   if (old_ptr != ptr) {
+      FLUSH_VERTICES(ctx, _NEW_ARRAY);
+      array->Ptr = ptr;
+      vao->NewArrays |= vao->_Enabled & VERT_BIT(attrib);
+   }
+
+   return old_ptr;
+}
+
+
 /**
  * Sets the InstanceDivisor field in the vertex buffer binding point
  * given by bindingIndex.
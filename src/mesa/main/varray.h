@@ -103,6 +103,10 @@ _mesa_bind_vertex_buffer(struct gl_context *ctx,
                          struct gl_buffer_object *vbo,
                          GLintptr offset, GLsizei stride, bool flush_vertices);
 
+extern const GLvoid *
+_mesa_set_client_array_pointer(struct gl_context *ctx,
+                               gl_vert_attrib attrib, const GLvoid *ptr);
+
 extern void GLAPIENTRY
 _mesa_VertexPointer_no_error(GLint size, GLenum type, GLsizei stride,
                              const GLvoid *ptr);
@@ -79,6 +79,7 @@
 #include "st_vdpau.h"
 #include "st_texture.h"
 #include "pipe/p_context.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_inlines.h"
 #include "util/u_upload_mgr.h"
 #include "util/u_vbuf.h"
@@ -86,6 +87,7 @@
 
 
 DEBUG_GET_ONCE_BOOL_OPTION(mesa_mvp_dp4, "MESA_MVP_DP4", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(mesa_parallel_link, "MESA_PARALLEL_LINK", TRUE)
 
 
 /**
@@ -166,6 +168,93 @@ st_get_active_states(struct gl_context *ctx)
 }
 
 
+struct st_link_stage_job {
+   struct gl_context *ctx;
+   struct gl_shader_program *prog;
+   struct gl_linked_shader *shader;
+   st_link_stage_func func;
+   struct util_queue_fence fence;
+};
+
+static void
+st_link_stage_execute(void *data, int thread_index)
+{
+   struct st_link_stage_job *job = (struct st_link_stage_job *)data;
+
+   job->func(job->ctx, job->prog, job->shader);
+}
+
+static bool
+st_init_link_queue(struct st_context *st)
+{
+   if (util_queue_is_initialized(&st->link_queue))
+      return true;
+
+   if (!debug_get_option_mesa_parallel_link())
+      return false;
+
+   util_cpu_detect();
+   if (util_cpu_caps.nr_cpus < 2)
+      return false;
+
+   /* The calling thread handles one of the stages itself, and compute
+    * shaders can't be linked together with any other stage.
+    */
+   unsigned num_threads = MIN2(util_cpu_caps.nr_cpus - 1,
+                               MESA_SHADER_STAGES - 2);
+
+   return util_queue_init(&st->link_queue, "st_link", MESA_SHADER_STAGES,
+                          num_threads, 0);
+}
+
+/**
+ * Call func for every linked stage of prog.
+ *
+ * Once the stages have been linked against each other, the lowering and
+ * optimization of each stage doesn't depend on the others anymore.  So if
+ * there is more than one stage, they are spread over st->link_queue and the
+ * calling thread, and this returns when all of them are done.  func must
+ * not touch anything shared between stages, such as the info log.
+ */
+void
+st_link_for_each_stage(struct st_context *st, struct gl_shader_program *prog,
+                       st_link_stage_func func)
+{
+   struct st_link_stage_job jobs[MESA_SHADER_STAGES];
+   unsigned num_jobs = 0;
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] == NULL)
+         continue;
+
+      jobs[num_jobs].ctx = st->ctx;
+      jobs[num_jobs].prog = prog;
+      jobs[num_jobs].shader = prog->_LinkedShaders[i];
+      jobs[num_jobs].func = func;
+      num_jobs++;
+   }
+
+   if (num_jobs < 2 || !st_init_link_queue(st)) {
+      for (unsigned i = 0; i < num_jobs; i++)
+         func(st->ctx, prog, jobs[i].shader);
+      return;
+   }
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&st->link_queue, &jobs[i], &jobs[i].fence,
+                         st_link_stage_execute, NULL);
+   }
+
+   func(st->ctx, prog, jobs[0].shader);
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
+
 void
 st_invalidate_buffers(struct st_context *st)
 {
@@ -256,6 +345,9 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
 {
    uint i;
 
+   if (util_queue_is_initialized(&st->link_queue))
+      util_queue_destroy(&st->link_queue);
+
    st_destroy_atoms(st);
    st_destroy_draw(st);
    st_destroy_clear(st);
@@ -34,6 +34,7 @@
 #include "state_tracker/st_atom.h"
 #include "util/u_inlines.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -294,6 +295,11 @@ struct st_context
 
    /* Winsys buffers */
    struct list_head winsys_buffers;
+
+   /* Worker threads for the per-stage parts of linking, created on first
+    * use.  See st_link_for_each_stage().
+    */
+   struct util_queue link_queue;
 };
 
 
@@ -396,6 +402,14 @@ st_destroy_context(struct st_context *st);
 uint64_t
 st_get_active_states(struct gl_context *ctx);
 
+typedef void (*st_link_stage_func)(struct gl_context *ctx,
+                                   struct gl_shader_program *prog,
+                                   struct gl_linked_shader *shader);
+
+extern void
+st_link_for_each_stage(struct st_context *st, struct gl_shader_program *prog,
+                       st_link_stage_func func);
+
 
 #ifdef __cplusplus
 }
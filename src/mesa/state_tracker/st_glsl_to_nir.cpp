@@ -466,7 +466,6 @@ st_nir_get_mesa_program(struct gl_context *ctx,
                         struct gl_shader_program *shader_program,
                         struct gl_linked_shader *shader)
 {
-   struct st_context *st = st_context(ctx);
    struct gl_program *prog;
 
    validate_ir_tree(shader->ir);
@@ -490,11 +489,41 @@ st_nir_get_mesa_program(struct gl_context *ctx,
 
    prog->ExternalSamplersUsed = gl_external_samplers(prog);
    _mesa_update_shader_textures_used(shader_program, prog);
+}
 
-   nir_shader *nir = st_glsl_to_nir(st, prog, shader_program, shader->Stage);
+/* Translate a linked stage to NIR and run the first round of optimizations
+ * on it.  This only looks at its own stage, so st_link_nir() runs it for all
+ * stages in parallel.
+ */
+static void
+st_nir_opt_linked_shader(struct gl_context *ctx,
+                         struct gl_shader_program *shader_program,
+                         struct gl_linked_shader *shader)
+{
+   struct gl_program *prog = shader->Program;
+   nir_shader *nir = st_glsl_to_nir(st_context(ctx), prog, shader_program,
+                                    shader->Stage);
 
    set_st_program(prog, shader_program, nir);
    prog->nir = nir;
+
+   /* The inputs of the first stage and the outputs of the last stage are
+    * the interface of the program and have to stay as they are.
+    */
+   const unsigned stage = shader->Stage;
+   nir_variable_mode mask = (nir_variable_mode) 0;
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (i == stage || !shader_program->_LinkedShaders[i])
+         continue;
+
+      if (i < stage)
+         mask = (nir_variable_mode)(mask | nir_var_shader_in);
+      else
+         mask = (nir_variable_mode)(mask | nir_var_shader_out);
+   }
+
+   nir_lower_io_to_scalar_early(nir, mask);
+   st_nir_opts(nir);
 }
 
 static void
@@ -538,15 +567,11 @@ st_link_nir(struct gl_context *ctx,
 {
    struct st_context *st = st_context(ctx);
 
-   /* Determine first and last stage. */
-   unsigned first = MESA_SHADER_STAGES;
+   /* Determine last stage. */
    unsigned last = 0;
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
-      if (!shader_program->_LinkedShaders[i])
-         continue;
-      if (first == MESA_SHADER_STAGES)
-         first = i;
-      last = i;
+      if (shader_program->_LinkedShaders[i])
+         last = i;
    }
 
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
@@ -555,19 +580,10 @@ st_link_nir(struct gl_context *ctx,
          continue;
 
       st_nir_get_mesa_program(ctx, shader_program, shader);
-
-      nir_variable_mode mask = (nir_variable_mode) 0;
-      if (i != first)
-         mask = (nir_variable_mode)(mask | nir_var_shader_in);
-
-      if (i != last)
-         mask = (nir_variable_mode)(mask | nir_var_shader_out);
-
-      nir_shader *nir = shader->Program->nir;
-      nir_lower_io_to_scalar_early(nir, mask);
-      st_nir_opts(nir);
    }
 
+   st_link_for_each_stage(st, shader_program, st_nir_opt_linked_shader);
+
    /* Linking the stages in the opposite order (from fragment to vertex)
     * ensures that inter-shader outputs written to in an earlier stage
     * are eliminated if they are (transitively) not used in a later
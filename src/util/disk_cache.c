@@ -39,6 +39,10 @@
 #include <dirent.h>
 #include "zlib.h"
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
 #include "util/crc32.h"
 #include "util/debug.h"
 #include "util/rand_xor.h"
@@ -72,7 +76,29 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
+
+/* Compression used for the data of a cache entry, recorded in the entry's
+ * cache_entry_file_data so that entries written with either format can be
+ * read back regardless of how this build was configured.
+ */
+enum cache_entry_compression {
+   CACHE_COMPRESSION_ZLIB = 0,
+   CACHE_COMPRESSION_ZSTD = 1,
+};
+
+#ifdef HAVE_ZSTD
+#define CACHE_COMPRESSION CACHE_COMPRESSION_ZSTD
+#define CACHE_COMPRESSION_LEVEL_MIN 1
+/* Levels above 19 are zstd's "ultra" levels, which need much more memory */
+#define CACHE_COMPRESSION_LEVEL_MAX MIN2(19, ZSTD_maxCLevel())
+#define CACHE_COMPRESSION_LEVEL_DEFAULT 3
+#else
+#define CACHE_COMPRESSION CACHE_COMPRESSION_ZLIB
+#define CACHE_COMPRESSION_LEVEL_MIN Z_BEST_SPEED
+#define CACHE_COMPRESSION_LEVEL_MAX Z_BEST_COMPRESSION
+#define CACHE_COMPRESSION_LEVEL_DEFAULT Z_BEST_COMPRESSION
+#endif
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -98,6 +124,9 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Compression level used when writing cache entries. */
+   int compression_level;
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
@@ -194,7 +223,7 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 {
    void *local;
    struct disk_cache *cache = NULL;
-   char *path, *max_size_str;
+   char *path, *max_size_str, *compression_level_str;
    uint64_t max_size;
    int fd = -1;
    struct stat sb;
@@ -370,6 +399,18 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 
    cache->max_size = max_size;
 
+   cache->compression_level = CACHE_COMPRESSION_LEVEL_DEFAULT;
+
+   compression_level_str = getenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL");
+   if (compression_level_str) {
+      char *end;
+      long level = strtol(compression_level_str, &end, 10);
+      if (end != compression_level_str) {
+         cache->compression_level = CLAMP(level, CACHE_COMPRESSION_LEVEL_MIN,
+                                          CACHE_COMPRESSION_LEVEL_MAX);
+      }
+   }
+
    /* 1 thread was chosen because we don't really care about getting things
     * to disk quickly just that it's not blocking other tasks.
     *
@@ -730,7 +771,7 @@ write_all(int fd, const void *buf, size_t count)
  */
 static size_t
 deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+                          int level)
 {
    unsigned char out[BUFSIZE];
 
@@ -742,7 +783,7 @@ deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
    strm.next_in = (uint8_t *) in_data;
    strm.avail_in = in_data_size;
 
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
+   int ret = deflateInit(&strm, level);
    if (ret != Z_OK)
        return 0;
 
@@ -787,6 +828,53 @@ deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
    return compressed_size;
 }
 
+#ifdef HAVE_ZSTD
+/**
+ * Compresses cache entry in memory with zstd and writes it to disk. Returns
+ * the size of the data written to disk.
+ */
+static size_t
+zstd_compress_and_write_to_disk(const void *in_data, size_t in_data_size,
+                                int dest, int level)
+{
+   size_t out_size = ZSTD_compressBound(in_data_size);
+   void *out = malloc(out_size);
+   if (!out)
+      return 0;
+
+   size_t compressed_size = ZSTD_compress(out, out_size, in_data, in_data_size,
+                                          level);
+   if (ZSTD_isError(compressed_size) ||
+       write_all(dest, out, compressed_size) == -1)
+      compressed_size = 0;
+
+   free(out);
+   return compressed_size;
+}
+#endif
+
+/**
+ * Compresses cache entry with the given format and writes it to disk.
+ * Returns the size of the data written to disk.
+ */
+static size_t
+compress_and_write_to_disk(enum cache_entry_compression compression,
+                           const void *in_data, size_t in_data_size, int dest,
+                           int level)
+{
+   switch (compression) {
+#ifdef HAVE_ZSTD
+   case CACHE_COMPRESSION_ZSTD:
+      return zstd_compress_and_write_to_disk(in_data, in_data_size, dest,
+                                             level);
+#endif
+   case CACHE_COMPRESSION_ZLIB:
+      return deflate_and_write_to_disk(in_data, in_data_size, dest, level);
+   default:
+      return 0;
+   }
+}
+
 static struct disk_cache_put_job *
 create_put_job(struct disk_cache *cache, const cache_key key,
                const void *data, size_t size,
@@ -846,6 +934,7 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   uint32_t compression; /* enum cache_entry_compression */
 };
 
 static void
@@ -961,6 +1050,7 @@ cache_put(void *job, int thread_index)
    struct cache_entry_file_data cf_data;
    cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
    cf_data.uncompressed_size = dc_job->size;
+   cf_data.compression = CACHE_COMPRESSION;
 
    size_t cf_data_size = sizeof(cf_data);
    ret = write_all(fd, &cf_data, cf_data_size);
@@ -973,8 +1063,10 @@ cache_put(void *job, int thread_index)
     * rename them atomically to the destination filename, and also
     * perform an atomic increment of the total cache size.
     */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
+   size_t file_size = compress_and_write_to_disk(cf_data.compression,
+                                                 dc_job->data, dc_job->size,
+                                                 fd,
+                                                 dc_job->cache->compression_level);
    if (file_size == 0) {
       unlink(filename_tmp);
       goto done;
@@ -1068,6 +1160,32 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
+/**
+ * Decompresses cache entry written with the given format, returns true if
+ * successful.
+ */
+static bool
+decompress_cache_data(uint32_t compression,
+                      uint8_t *in_data, size_t in_data_size,
+                      uint8_t *out_data, size_t out_data_size)
+{
+   switch (compression) {
+#ifdef HAVE_ZSTD
+   case CACHE_COMPRESSION_ZSTD: {
+      size_t ret = ZSTD_decompress(out_data, out_data_size,
+                                   in_data, in_data_size);
+      return !ZSTD_isError(ret) && ret == out_data_size;
+   }
+#endif
+   case CACHE_COMPRESSION_ZLIB:
+      return inflate_cache_data(in_data, in_data_size,
+                                out_data, out_data_size);
+   default:
+      /* Written by a build with a compressor we don't have. */
+      return false;
+   }
+}
+
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
 {
@@ -1177,8 +1295,11 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
 
    /* Uncompress the cache data */
    uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
+   if (!uncompressed_data)
+      goto fail;
+
+   if (!decompress_cache_data(cf_data.compression, data, cache_data_size,
+                              uncompressed_data, cf_data.uncompressed_size))
       goto fail;
 
    /* Check the data for corruption */
@@ -1279,4 +1400,10 @@ disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
    cache->blob_get_cb = get;
 }
 
+int
+disk_cache_get_compression_level(struct disk_cache *cache)
+{
+   return cache->compression_level;
+}
+
 #endif /* ENABLE_SHADER_CACHE */
@@ -219,6 +219,13 @@ void
 disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
                          disk_cache_get_cb get);
 
+/**
+ * Return the level entries are compressed with, after clamping
+ * MESA_GLSL_CACHE_COMPRESSION_LEVEL to the compressor's range.
+ */
+int
+disk_cache_get_compression_level(struct disk_cache *cache);
+
 #else
 
 static inline struct disk_cache *
@@ -279,6 +286,12 @@ disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
    return;
 }
 
+static inline int
+disk_cache_get_compression_level(struct disk_cache *cache)
+{
+   return 0;
+}
+
 #endif /* ENABLE_SHADER_CACHE */
 
 #ifdef __cplusplus
@@ -478,8 +478,158 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+/**
+ * Binary heap of node indices, ordered by a comparison callback that
+ * returns true if node a has to come out of the heap before node b.
+ *
+ * A node is in at most one heap at a time, so the heaps of a graph share an
+ * array mapping each node to its position in its heap, which allows nodes
+ * to be removed or moved up after their q total changed.
+ */
+struct ra_node_heap {
+   unsigned int *nodes;
+   unsigned int count;
+   unsigned int *pos;
+   bool (*before)(struct ra_graph *g, unsigned int a, unsigned int b);
+};
+
+static void
+ra_node_heap_set(struct ra_node_heap *h, unsigned int i, unsigned int n)
+{
+   h->nodes[i] = n;
+   h->pos[n] = i;
+}
+
+static void
+ra_node_heap_sift_up(struct ra_graph *g, struct ra_node_heap *h,
+                     unsigned int i)
+{
+   unsigned int n = h->nodes[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+
+      if (!h->before(g, n, h->nodes[parent]))
+         break;
+
+      ra_node_heap_set(h, i, h->nodes[parent]);
+      i = parent;
+   }
+
+   ra_node_heap_set(h, i, n);
+}
+
+static void
+ra_node_heap_sift_down(struct ra_graph *g, struct ra_node_heap *h,
+                       unsigned int i)
+{
+   unsigned int n = h->nodes[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= h->count)
+         break;
+
+      if (child + 1 < h->count &&
+          h->before(g, h->nodes[child + 1], h->nodes[child]))
+         child++;
+
+      if (!h->before(g, h->nodes[child], n))
+         break;
+
+      ra_node_heap_set(h, i, h->nodes[child]);
+      i = child;
+   }
+
+   ra_node_heap_set(h, i, n);
+}
+
+static void
+ra_node_heap_push(struct ra_graph *g, struct ra_node_heap *h, unsigned int n)
+{
+   ra_node_heap_set(h, h->count++, n);
+   ra_node_heap_sift_up(g, h, h->count - 1);
+}
+
 static void
-decrement_q(struct ra_graph *g, unsigned int n)
+ra_node_heap_remove(struct ra_graph *g, struct ra_node_heap *h,
+                    unsigned int n)
+{
+   unsigned int i = h->pos[n];
+
+   h->count--;
+   if (i == h->count)
+      return;
+
+   unsigned int last = h->nodes[h->count];
+
+   ra_node_heap_set(h, i, last);
+   ra_node_heap_sift_up(g, h, i);
+   ra_node_heap_sift_down(g, h, h->pos[last]);
+}
+
+static unsigned int
+ra_node_heap_pop(struct ra_graph *g, struct ra_node_heap *h)
+{
+   unsigned int n = h->nodes[0];
+
+   ra_node_heap_remove(g, h, n);
+
+   return n;
+}
+
+/* Visits nodes from the highest index down. */
+static bool
+ra_node_before_index(struct ra_graph *g, unsigned int a, unsigned int b)
+{
+   return a > b;
+}
+
+/* Visits nodes by increasing q total, then from the highest index down. */
+static bool
+ra_node_before_q_total(struct ra_graph *g, unsigned int a, unsigned int b)
+{
+   if (g->nodes[a].q_total != g->nodes[b].q_total)
+      return g->nodes[a].q_total < g->nodes[b].q_total;
+
+   return a > b;
+}
+
+/**
+ * Worklists for ra_simplify().
+ *
+ * Simplification used to rescan the whole graph after every pass, which is
+ * quadratic in the number of nodes.  Instead, every unallocated node not yet
+ * in the stack lives in exactly one of these lists, and nodes only move from
+ * "unready" to one of the ready lists when a decrement_q() makes their
+ * pq_test() pass.
+ *
+ * The lists reproduce the order the old scan pushed nodes in: a pass walked
+ * the nodes from the highest index down, so a node that becomes colorable
+ * below the current position is pushed later in the same pass (ready),
+ * while one above it waits for the next pass (pending).  When a whole pass
+ * found nothing to push, the node with the lowest q total, and the highest
+ * index among those, was pushed optimistically, which is the top of the
+ * unready heap.
+ */
+struct ra_simplify_state {
+   /* Colorable nodes below the current scan position. */
+   struct ra_node_heap ready;
+
+   /* Colorable nodes above the current scan position. */
+   unsigned int *pending;
+   unsigned int pending_count;
+
+   /* Nodes that are not trivially colorable (yet). */
+   struct ra_node_heap unready;
+
+   /* Index of the last node pushed in the current pass. */
+   unsigned int scan_pos;
+};
+
+static void
+decrement_q(struct ra_graph *g, unsigned int n, struct ra_simplify_state *s)
 {
    unsigned int i;
    int n_class = g->nodes[n].class;
@@ -489,12 +639,38 @@ decrement_q(struct ra_graph *g, unsigned int n)
       unsigned int n2_class = g->nodes[n2].class;
 
       if (!g->nodes[n2].in_stack) {
+         bool was_colorable = pq_test(g, n2);
+
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+
+         if (was_colorable || g->nodes[n2].reg != NO_REG)
+            continue;
+
+         if (pq_test(g, n2)) {
+            ra_node_heap_remove(g, &s->unready, n2);
+
+            if (n2 < s->scan_pos)
+               ra_node_heap_push(g, &s->ready, n2);
+            else
+               s->pending[s->pending_count++] = n2;
+         } else {
+            ra_node_heap_sift_up(g, &s->unready, s->unready.pos[n2]);
+         }
       }
    }
 }
 
+static void
+ra_simplify_push(struct ra_graph *g, struct ra_simplify_state *s,
+                 unsigned int n)
+{
+   g->nodes[n].in_stack = true;
+   decrement_q(g, n, s);
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -508,48 +684,75 @@ decrement_q(struct ra_graph *g, unsigned int n)
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
-
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
-
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
+   struct ra_simplify_state s;
+   unsigned int *heap_pos;
+   bool progress = false;
+   unsigned int i;
+
+   heap_pos = malloc(g->count * sizeof(unsigned int));
+
+   s.ready.nodes = malloc(g->count * sizeof(unsigned int));
+   s.ready.count = 0;
+   s.ready.pos = heap_pos;
+   s.ready.before = ra_node_before_index;
+   s.unready.nodes = malloc(g->count * sizeof(unsigned int));
+   s.unready.count = 0;
+   s.unready.pos = heap_pos;
+   s.unready.before = ra_node_before_q_total;
+   s.pending = malloc(g->count * sizeof(unsigned int));
+   s.pending_count = 0;
+   s.scan_pos = g->count;
+
+   for (i = 0; i < g->count; i++) {
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
+         continue;
+
+      if (pq_test(g, i))
+         ra_node_heap_push(g, &s.ready, i);
+      else
+         ra_node_heap_push(g, &s.unready, i);
+   }
+
+   for (;;) {
+      if (s.ready.count) {
+         unsigned int n = ra_node_heap_pop(g, &s.ready);
+
+         s.scan_pos = n;
+         ra_simplify_push(g, &s, n);
+         progress = true;
+         continue;
       }
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+      /* End of a pass: start over from the top of the graph. */
+      s.scan_pos = g->count;
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+      if (progress) {
+         for (i = 0; i < s.pending_count; i++)
+            ra_node_heap_push(g, &s.ready, s.pending[i]);
+         s.pending_count = 0;
+         progress = false;
+         continue;
       }
+
+      if (!s.unready.count)
+         break;
+
+      if (stack_optimistic_start == UINT_MAX)
+         stack_optimistic_start = g->stack_count;
+
+      /* The old scan started a new pass after an optimistic push, so
+       * everything it makes colorable is visited from the top.
+       */
+      ra_simplify_push(g, &s, ra_node_heap_pop(g, &s.unready));
    }
 
    g->stack_optimistic_start = stack_optimistic_start;
+
+   free(heap_pos);
+   free(s.ready.nodes);
+   free(s.unready.nodes);
+   free(s.pending);
 }
 
 static bool
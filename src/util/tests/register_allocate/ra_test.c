@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2018 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Allocates registers for interference graphs built from random live ranges
+ * of scalar, pair and vec4 values, the way the backends do for straight-line
+ * code, and checks the results.
+ *
+ * The register assignments of the fixed-seed graphs are hashed and compared
+ * against the hash of the original implementation, so that changes to the
+ * allocator that alter its choices are caught.
+ *
+ * Run with "bench" as the argument to time ra_allocate() on large graphs
+ * instead.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/ralloc.h"
+#include "util/rand_xor.h"
+#include "util/register_allocate.h"
+
+#define BASE_REGS 64
+#define PAIR_REGS (BASE_REGS / 2)
+#define VEC4_REGS (BASE_REGS / 4)
+#define NUM_REGS (BASE_REGS + PAIR_REGS + VEC4_REGS)
+
+/* Hash of the allocations of the graphs checked by main(). */
+#define EXPECTED_HASH 0x05093c309f396c94ull
+
+enum {
+   CLASS_SCALAR,
+   CLASS_PAIR,
+   CLASS_VEC4,
+   NUM_CLASSES,
+};
+
+static unsigned classes[NUM_CLASSES];
+
+static void
+reg_range(unsigned reg, unsigned *start, unsigned *size)
+{
+   if (reg < BASE_REGS) {
+      *start = reg;
+      *size = 1;
+   } else if (reg < BASE_REGS + PAIR_REGS) {
+      *start = (reg - BASE_REGS) * 2;
+      *size = 2;
+   } else {
+      *start = (reg - BASE_REGS - PAIR_REGS) * 4;
+      *size = 4;
+   }
+}
+
+static struct ra_regs *
+create_reg_set(void)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(NULL, NUM_REGS, true);
+
+   for (unsigned c = 0; c < NUM_CLASSES; c++)
+      classes[c] = ra_alloc_reg_class(regs);
+
+   for (unsigned r = 0; r < NUM_REGS; r++) {
+      unsigned start, size;
+
+      reg_range(r, &start, &size);
+      for (unsigned i = 0; i < size; i++)
+         ra_add_transitive_reg_conflict(regs, start + i, r);
+
+      ra_class_add_reg(regs, classes[size == 1 ? CLASS_SCALAR :
+                                     size == 2 ? CLASS_PAIR : CLASS_VEC4], r);
+   }
+
+   ra_set_finalize(regs, NULL);
+
+   return regs;
+}
+
+struct graph {
+   struct ra_graph *g;
+   unsigned count;
+   unsigned *start, *end;
+};
+
+static void
+build_graph(struct graph *graph, struct ra_regs *regs, unsigned count,
+            unsigned program_length, uint64_t *seed)
+{
+   graph->count = count;
+   graph->g = ra_alloc_interference_graph(regs, count);
+   graph->start = malloc(count * sizeof(unsigned));
+   graph->end = malloc(count * sizeof(unsigned));
+
+   for (unsigned n = 0; n < count; n++) {
+      unsigned length = 1 + rand_xorshift128plus(seed) % 64;
+
+      /* Number the nodes roughly in definition order, like the backends. */
+      graph->start[n] = (uint64_t) n * program_length / count +
+                        rand_xorshift128plus(seed) % 16;
+      graph->end[n] = graph->start[n] + length;
+
+      ra_set_node_class(graph->g, n,
+                        classes[rand_xorshift128plus(seed) % NUM_CLASSES]);
+      ra_set_node_spill_cost(graph->g, n, 1.0f / length);
+   }
+
+   /* Pin a few of the nodes, like payload registers. */
+   for (unsigned n = 0; n < count / 64 && n < BASE_REGS; n++)
+      ra_set_node_reg(graph->g, n, n % BASE_REGS);
+
+   for (unsigned a = 0; a < count; a++) {
+      for (unsigned b = a + 1; b < count; b++) {
+         if (graph->start[a] < graph->end[b] &&
+             graph->start[b] < graph->end[a])
+            ra_add_node_interference(graph->g, a, b);
+      }
+   }
+}
+
+static void
+free_graph(struct graph *graph)
+{
+   ralloc_free(graph->g);
+   free(graph->start);
+   free(graph->end);
+}
+
+static bool
+check_graph(struct graph *graph)
+{
+   for (unsigned a = 0; a < graph->count; a++) {
+      unsigned a_start, a_size;
+
+      reg_range(ra_get_node_reg(graph->g, a), &a_start, &a_size);
+
+      for (unsigned b = a + 1; b < graph->count; b++) {
+         unsigned b_start, b_size;
+
+         if (graph->start[a] >= graph->end[b] ||
+             graph->start[b] >= graph->end[a])
+            continue;
+
+         reg_range(ra_get_node_reg(graph->g, b), &b_start, &b_size);
+         if (a_start < b_start + b_size && b_start < a_start + a_size) {
+            fprintf(stderr, "nodes %u and %u are both assigned to reg %u\n",
+                    a, b, a_start > b_start ? a_start : b_start);
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static uint64_t
+hash_u32(uint64_t hash, uint32_t value)
+{
+   /* FNV-1a */
+   for (unsigned i = 0; i < 4; i++) {
+      hash ^= (value >> (i * 8)) & 0xff;
+      hash *= 0x100000001b3ull;
+   }
+
+   return hash;
+}
+
+static double
+now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+bench(struct ra_regs *regs)
+{
+   static const unsigned sizes[] = { 1000, 4000, 16000 };
+   uint64_t seed[2] = { 0x12345678, 0x9abcdef0 };
+
+   for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      struct graph graph;
+
+      /* Keep the register pressure at the edge of spilling, which is where
+       * simplification has to do the most work.
+       */
+      build_graph(&graph, regs, sizes[i], sizes[i] / 2, seed);
+
+      double start = now();
+      bool ok = ra_allocate(graph.g);
+      double end = now();
+
+      printf("%6u nodes: %8.3f ms (%s)\n", sizes[i], (end - start) * 1000.0,
+             ok ? "allocated" : "spilled");
+
+      free_graph(&graph);
+   }
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct ra_regs *regs = create_reg_set();
+   uint64_t seed[2] = { 1, 2 };
+   uint64_t hash = 0xcbf29ce484222325ull;
+   unsigned allocated = 0, spilled = 0;
+   int ret = 0;
+
+   if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+      ret = bench(regs);
+      ralloc_free(regs);
+      return ret;
+   }
+
+   for (unsigned i = 0; i < 200; i++) {
+      struct graph graph;
+      unsigned count = 16 + rand_xorshift128plus(seed) % 512;
+      unsigned program_length = 16 + rand_xorshift128plus(seed) % 1024;
+
+      build_graph(&graph, regs, count, program_length, seed);
+
+      if (ra_allocate(graph.g)) {
+         allocated++;
+         if (!check_graph(&graph))
+            ret = 1;
+
+         for (unsigned n = 0; n < count; n++)
+            hash = hash_u32(hash, ra_get_node_reg(graph.g, n));
+      } else {
+         spilled++;
+         hash = hash_u32(hash, ra_get_best_spill_node(graph.g));
+      }
+
+      free_graph(&graph);
+   }
+
+   if (allocated == 0 || spilled == 0) {
+      fprintf(stderr, "expected both colorable and spilling graphs "
+              "(%u allocated, %u spilled)\n", allocated, spilled);
+      ret = 1;
+   }
+
+   if (hash != EXPECTED_HASH) {
+      fprintf(stderr, "allocation hash 0x%016llx, expected 0x%016llx\n",
+              (unsigned long long) hash, (unsigned long long) EXPECTED_HASH);
+      ret = 1;
+   }
+
+   ralloc_free(regs);
+
+   return ret;
+}
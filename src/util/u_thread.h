@@ -70,6 +70,22 @@ static inline void u_thread_setname( const char *name )
    (void)name;
 }
 
+/**
+ * Restrict the calling thread to run on the given CPU only.
+ * This is a no-op where thread affinity isn't supported.
+ */
+static inline void u_thread_pin_to_cpu( unsigned cpu )
+{
+#if defined(HAVE_PTHREAD) && defined(__linux__) && defined(CPU_SET)
+   cpu_set_t set;
+
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+   (void)cpu;
+}
+
 /*
  * Thread statistics.
  */